@@ -0,0 +1,733 @@
+#include "Main.h"
+
+#define VERSION "v0.1"
+#define APPLICATION_NAME "NaShaderCompiler Batch" " " VERSION
+
+// Compiles every .hlsl file below a directory through the same Core/Shader path as the preview, writes one .cso per
+// file (per unique variant for files declaring @option axes) and a manifest.json. Exit code 0 when everything compiled,
+// 1 when a file failed, 2 for bad arguments or unwritable output.
+// Outside Windows only the fake backend exists: g++ -std=c++17 -O2 Main.cpp -o nsc -lpthread
+
+class Options
+{
+public:
+	fs::path input = "";
+	fs::path output = "";
+	fs::path cache = "";
+	int jobs = (int)std::max(1u, std::thread::hardware_concurrency());
+#ifdef _WIN32
+	std::string backend = "d3d";
+#else
+	std::string backend = "fake";
+#endif
+	std::string target = "ps_5_0";
+	std::string entry = "main";
+	std::vector<std::pair<std::string, std::string>> defines = {};
+	std::vector<fs::path> includeDirectories = {};
+	uint32_t flags = ShaderCompiler::Flags::None;
+	bool useCache = true;
+	bool variants = true;
+	bool preprocessOnly = false;
+	bool quiet = false;
+	bool worker = false;
+	bool serve = false;
+	// Name of the compile server to serve as or to send compiles to
+	std::string server = "NaShaderCompiler";
+	bool useServer = false;
+	// Remote cache server to run, and the one to use as second cache tier, as host:port
+	bool serveCache = false;
+	std::string bind = "127.0.0.1";
+	uint16_t port = 0;
+	std::string remote = "";
+};
+
+class VariantReport
+{
+public:
+	ShaderPermutations::Key key = 0;
+	std::string defines = "";
+	std::string output = "";
+};
+
+class FileReport
+{
+public:
+	std::string source = "";
+	std::string output = "";
+	bool success = false;
+	bool cached = false;
+	float milliseconds = 0.f;
+	size_t bytes = 0;
+	std::string digest = "";
+	// Container checksum and static cost of the bytecode, when it is DXBC
+	std::string checksum = "";
+	bool analyzed = false;
+	DxbcContainer::Statistics cost = DxbcContainer::Statistics();
+	std::string log = "";
+	std::vector<std::string> includes = {};
+	uint64_t uniqueVariants = 0;
+	std::vector<VariantReport> variants = {};
+};
+
+static void PrintUsage()
+{
+	std::cout << APPLICATION_NAME << "\n"
+		"Usage: Compiler <input directory> -o <output directory> [options]\n"
+		"       Compiler --worker [--backend <name>]\n"
+		"       Compiler --serve [--server <name>] [--cache <directory>] [-j <workers>] [--backend <name>] [--remote <host:port>]\n"
+		"       Compiler --serve-cache <port> [--bind <address>] [--cache <directory>]\n"
+		"  -j <jobs>            Files compiled at once (default: hardware threads)\n"
+		"  -T <target>          Shader target (default: ps_5_0)\n"
+		"  -E <entry>           Entry point (default: main)\n"
+		"  -D <name>[=<value>]  Define a macro, may repeat\n"
+		"  -I <directory>       Include search path, may repeat\n"
+		"  -O3 | -Od | -Zi      Optimization level 3, skip optimization, debug information\n"
+		"  -WX                  Treat warnings as errors\n"
+		"  -P                   Only preprocess, writes <name>.i instead of bytecode\n"
+		"  --backend <name>     d3d (Windows only) or fake\n"
+		"  --cache <directory>  Shader cache directory (default: <output>/.cache)\n"
+		"  --no-cache           Always compile\n"
+		"  --no-variants        Ignore @option axes, compile each file once\n"
+		"  --quiet              Only report failures\n"
+		"  --worker             Serve compile requests framed on stdin/stdout for the preview's worker pool\n"
+		"  --serve              Run a compile server shared by every instance on this machine (default cache: ./cache/shaders)\n"
+		"  --server <name>      Compile through the server of that name, locally when it is not running\n"
+		"  --remote <host:port> Use a remote cache server as second tier behind the local cache\n"
+		"  --serve-cache <port> Run a remote cache server, 0 picks a free port (default cache: ./cache/remote)\n"
+		"  --bind <address>     Address the remote cache server listens on (default: 127.0.0.1)\n";
+}
+
+static bool ParseArguments(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		// Options taking a value
+		auto Value = [&](std::string& value) {
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Missing value for " << argument << std::endl;
+				return false;
+			}
+			value = argv[++i];
+			return true;
+			};
+		std::string value = "";
+		if (argument == "-o")
+		{
+			if (!Value(value))
+				return false;
+			options.output = value;
+		}
+		else if (argument == "-j")
+		{
+			if (!Value(value))
+				return false;
+			options.jobs = std::max(1, atoi(value.c_str()));
+		}
+		else if (argument == "-T")
+		{
+			if (!Value(options.target))
+				return false;
+		}
+		else if (argument == "-E")
+		{
+			if (!Value(options.entry))
+				return false;
+		}
+		else if (argument == "-D")
+		{
+			if (!Value(value))
+				return false;
+			const size_t equals = value.find('=');
+			options.defines.push_back({ value.substr(0, equals), equals == std::string::npos ? "1" : value.substr(equals + 1) });
+		}
+		else if (argument == "-I")
+		{
+			if (!Value(value))
+				return false;
+			options.includeDirectories.push_back(value);
+		}
+		else if (argument == "-O3")
+			options.flags |= ShaderCompiler::Flags::OptimizationLevel3;
+		else if (argument == "-Od")
+			options.flags |= ShaderCompiler::Flags::SkipOptimization;
+		else if (argument == "-Zi")
+			options.flags |= ShaderCompiler::Flags::Debug;
+		else if (argument == "-WX")
+			options.flags |= ShaderCompiler::Flags::WarningsAreErrors;
+		else if (argument == "-P")
+			options.preprocessOnly = true;
+		else if (argument == "--backend")
+		{
+			if (!Value(options.backend))
+				return false;
+		}
+		else if (argument == "--cache")
+		{
+			if (!Value(value))
+				return false;
+			options.cache = value;
+		}
+		else if (argument == "--no-cache")
+			options.useCache = false;
+		else if (argument == "--no-variants")
+			options.variants = false;
+		else if (argument == "--quiet")
+			options.quiet = true;
+		else if (argument == "--worker")
+			options.worker = true;
+		else if (argument == "--serve")
+			options.serve = true;
+		else if (argument == "--server")
+		{
+			if (!Value(options.server))
+				return false;
+			options.useServer = true;
+		}
+		else if (argument == "--serve-cache")
+		{
+			if (!Value(value))
+				return false;
+			const int port = atoi(value.c_str());
+			if (port < 0 || port > 65535)
+			{
+				std::cerr << "Bad port: " << value << std::endl;
+				return false;
+			}
+			options.serveCache = true;
+			options.port = (uint16_t)port;
+		}
+		else if (argument == "--bind")
+		{
+			if (!Value(options.bind))
+				return false;
+		}
+		else if (argument == "--remote")
+		{
+			std::string host = "";
+			uint16_t port = 0;
+			if (!Value(options.remote))
+				return false;
+			if (!RemoteCache::ParseAddress(options.remote, host, port))
+			{
+				std::cerr << "Expected host:port for --remote, got " << options.remote << std::endl;
+				return false;
+			}
+		}
+		else if (!argument.empty() && argument[0] != '-' && options.input.empty())
+			options.input = argument;
+		else
+		{
+			std::cerr << "Unknown argument: " << argument << std::endl;
+			return false;
+		}
+	}
+	if (options.worker)
+		return true;
+	if (options.serveCache)
+	{
+		if (options.cache.empty())
+			options.cache = fs::current_path() / "cache" / "remote";
+		return true;
+	}
+	if (options.serve)
+	{
+		if (options.cache.empty())
+			options.cache = fs::current_path() / "cache" / "shaders";
+		return true;
+	}
+	if (options.input.empty() || options.output.empty())
+		return false;
+	if (options.cache.empty())
+		options.cache = options.output / ".cache";
+	return true;
+}
+
+static std::unique_ptr<ShaderCompiler> CreateBackend(const std::string& name)
+{
+#ifdef _WIN32
+	if (name == "d3d")
+		return std::make_unique<D3DCompilerBackend>();
+#endif
+	if (name == "fake")
+		return std::make_unique<FakeCompilerBackend>();
+	return nullptr;
+}
+
+// Compiles requests from the app until stdin closes. With the fake backend a source containing NA_WORKER_CRASH
+// or NA_WORKER_HANG makes the worker abort or stop answering, so the pool's recovery can be tested anywhere.
+static int RunWorker(ShaderCompiler* compiler, bool injectFaults)
+{
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	auto read = [](void* data, size_t size, bool) { return fread(data, 1, size, stdin) == size; };
+	auto write = [](const void* data, size_t size) { return fwrite(data, 1, size, stdout) == size && fflush(stdout) == 0; };
+	auto compile = [compiler, injectFaults](const ShaderCompiler::Request& request) {
+		if (injectFaults && request.source.find("NA_WORKER_CRASH") != std::string::npos)
+			std::abort();
+		while (injectFaults && request.source.find("NA_WORKER_HANG") != std::string::npos)
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+		return compiler->Compile(request);
+		};
+	return CompilerProtocol::Serve(compile, read, write);
+}
+
+// Sets up the remote tier of cache when --remote was given
+static void ConnectRemote(const Options& options, ShaderCache& cache, RemoteCache& remote)
+{
+	if (options.remote.empty())
+		return;
+	RemoteCache::ParseAddress(options.remote, remote.host, remote.port);
+	cache.remote = &remote;
+}
+
+// Compiles for every instance on this machine until killed, through worker processes started from executable.
+// The cache directory outlives the server, a restarted server answers from it right away.
+static int RunServer(const Options& options, const std::string& executable, ShaderCompiler* compiler)
+{
+	WorkerPoolBackend workers({ executable, "--worker", "--backend", options.backend }, options.jobs, compiler);
+	RemoteCache remote;
+	ShaderCache cache(options.cache);
+	ConnectRemote(options, cache, remote);
+	CompileServer server(&workers, &cache);
+	std::string error = "";
+	if (!server.Start(options.server, error))
+	{
+		std::cerr << error << std::endl;
+		return 2;
+	}
+	if (!options.quiet)
+	{
+		std::cout << APPLICATION_NAME << ": serving on " << LocalConnection::PathFor(options.server) << ", " << options.jobs << " workers, cache "
+			<< cache.directory.string() << std::endl;
+	}
+	uint64_t reported = 0;
+	while (true)
+	{
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		const CompileServer::Statistics statistics = server.GetStatistics();
+		if (options.quiet || statistics.requests == reported)
+			continue;
+		reported = statistics.requests;
+		const WorkerPoolBackend::Statistics pool = workers.GetStatistics();
+		std::cout << statistics.requests << " requests from " << statistics.connections << " connections: " << statistics.hits << " cache hits, "
+			<< statistics.deduplicated << " deduplicated, " << statistics.compiles << " compiled (" << pool.crashes << " worker crashes, "
+			<< pool.timeouts << " timeouts)" << std::endl;
+	}
+}
+
+// Stores compile results for other machines until killed. The listening line is printed even with --quiet,
+// with port 0 it is the only way to learn the port.
+static int RunCacheServer(const Options& options)
+{
+	RemoteCacheServer server(options.cache);
+	std::string error = "";
+	if (!server.Start(options.bind, options.port, error))
+	{
+		std::cerr << error << std::endl;
+		return 2;
+	}
+	std::cout << APPLICATION_NAME << ": listening on " << options.bind << ":" << server.GetPort() << ", cache " << server.directory.string() << std::endl;
+	uint64_t reported = 0;
+	while (true)
+	{
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		const RemoteCacheServer::Statistics statistics = server.GetStatistics();
+		const uint64_t requests = statistics.gets + statistics.puts + statistics.rejected + statistics.queried;
+		if (options.quiet || requests == reported)
+			continue;
+		reported = requests;
+		std::cout << statistics.gets << " gets (" << statistics.hits << " hits), " << statistics.puts << " puts, " << statistics.rejected
+			<< " rejected, " << statistics.queried << " queried, " << statistics.bytesSent << " bytes sent, " << statistics.bytesReceived
+			<< " received" << std::endl;
+	}
+}
+
+static std::string EscapeJson(const std::string& text)
+{
+	std::string escaped = "";
+	for (const char c : text)
+	{
+		switch (c)
+		{
+		case '"':
+			escaped += "\\\"";
+			break;
+		case '\\':
+			escaped += "\\\\";
+			break;
+		case '\n':
+			escaped += "\\n";
+			break;
+		case '\r':
+			escaped += "\\r";
+			break;
+		case '\t':
+			escaped += "\\t";
+			break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned)c);
+				escaped += buffer;
+			}
+			else
+			{
+				escaped += c;
+			}
+			break;
+		}
+	}
+	return escaped;
+}
+
+static bool WriteFile(const fs::path& path, const void* data, size_t size)
+{
+	std::error_code error;
+	fs::create_directories(path.parent_path(), error);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+	file.write((const char*)data, size);
+	return file.good();
+}
+
+static bool ReadFile(const fs::path& path, std::string& content)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+	const std::streamoff size = file.tellg();
+	if (size < 0)
+		return false;
+	content.resize((size_t)size);
+	file.seekg(0);
+	file.read(content.data(), size);
+	content.resize((size_t)file.gcount());
+	return true;
+}
+
+static bool WriteManifest(const fs::path& path, const Options& options, const char* backend, const std::vector<FileReport>& reports, float milliseconds)
+{
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+	size_t failed = 0;
+	for (const FileReport& report : reports)
+		failed += report.success ? 0 : 1;
+	file << "{\n";
+	file << "  \"backend\": \"" << EscapeJson(backend) << "\",\n";
+	file << "  \"target\": \"" << EscapeJson(options.target) << "\",\n";
+	file << "  \"entry\": \"" << EscapeJson(options.entry) << "\",\n";
+	file << "  \"flags\": " << options.flags << ",\n";
+	file << "  \"jobs\": " << options.jobs << ",\n";
+	file << "  \"milliseconds\": " << milliseconds << ",\n";
+	file << "  \"failed\": " << failed << ",\n";
+	file << "  \"files\": [";
+	for (size_t i = 0; i < reports.size(); i++)
+	{
+		const FileReport& report = reports[i];
+		file << (i == 0 ? "\n" : ",\n") << "    {\n";
+		file << "      \"source\": \"" << EscapeJson(report.source) << "\",\n";
+		file << "      \"success\": " << (report.success ? "true" : "false") << ",\n";
+		if (report.success && report.variants.empty())
+		{
+			file << "      \"output\": \"" << EscapeJson(report.output) << "\",\n";
+			file << "      \"bytes\": " << report.bytes << ",\n";
+			file << "      \"sha256\": \"" << report.digest << "\",\n";
+		}
+		if (report.analyzed)
+		{
+			file << "      \"checksum\": \"" << report.checksum << "\",\n";
+			file << "      \"cost\": { \"instructions\": " << report.cost.instructions << ", \"alu\": " << report.cost.alu << ", \"texture\": "
+				<< report.cost.texture << ", \"flowControl\": " << report.cost.flowControl << ", \"temps\": " << report.cost.temps + report.cost.indexableTemps
+				<< " },\n";
+		}
+		file << "      \"cached\": " << (report.cached ? "true" : "false") << ",\n";
+		file << "      \"milliseconds\": " << report.milliseconds << ",\n";
+		file << "      \"includes\": [";
+		for (size_t j = 0; j < report.includes.size(); j++)
+			file << (j == 0 ? "" : ", ") << "\"" << EscapeJson(report.includes[j]) << "\"";
+		file << "],\n";
+		if (!report.variants.empty())
+		{
+			file << "      \"uniqueVariants\": " << report.uniqueVariants << ",\n";
+			file << "      \"variants\": [";
+			for (size_t j = 0; j < report.variants.size(); j++)
+			{
+				const VariantReport& variant = report.variants[j];
+				file << (j == 0 ? "\n" : ",\n") << "        { \"key\": " << variant.key << ", \"defines\": \"" << EscapeJson(variant.defines)
+					<< "\", \"output\": \"" << EscapeJson(variant.output) << "\" }";
+			}
+			file << "\n      ],\n";
+		}
+		file << "      \"log\": \"" << EscapeJson(report.log) << "\"\n";
+		file << "    }";
+	}
+	file << "\n  ]\n}\n";
+	return file.good();
+}
+
+// Compiles one file, every unique variant when it declares @option axes
+static void CompileFile(const Options& options, ShaderCompiler* compiler, ShaderCache* cache, IncludeResolver* resolver,
+	const fs::path& source, FileReport& report)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const fs::path relative = source.lexically_relative(options.input);
+	report.source = relative.generic_string();
+	ShaderCompiler::Request request;
+	if (!ReadFile(source, request.source))
+	{
+		report.log = report.source + ": error: cannot read file\n";
+		return;
+	}
+	request.sourceName = report.source;
+	request.directory = source.parent_path().string();
+	request.resolver = resolver;
+	request.entry = options.entry;
+	request.target = options.target;
+	request.defines = options.defines;
+	request.flags = options.flags;
+
+	fs::path output = options.output / relative;
+	output.replace_extension(".cso");
+	const ShaderPermutations permutations = options.variants && !options.preprocessOnly ? ShaderPermutations::Parse(request.source) : ShaderPermutations();
+	std::vector<ShaderCompiler::Include> includes = {};
+	if (options.preprocessOnly)
+	{
+		std::string text = "";
+		report.success = compiler->Preprocess(request, text, report.log, includes);
+		if (report.success)
+		{
+			output.replace_extension(".i");
+			report.output = output.lexically_relative(options.output).generic_string();
+			report.bytes = text.size();
+			report.digest = Sha256::ToHex(Sha256::Hash(text.data(), text.size()));
+			if (!WriteFile(output, text.data(), text.size()))
+			{
+				report.success = false;
+				report.log += report.output + ": error: cannot write output\n";
+			}
+		}
+	}
+	else if (permutations.IsEmpty())
+	{
+		ShaderCompiler::Result result = cache != nullptr ? cache->Compile(compiler, request) : compiler->Compile(request);
+		report.success = result.success;
+		report.cached = result.cached;
+		report.log = result.log;
+		includes = result.includes;
+		if (result.success)
+		{
+			report.output = output.lexically_relative(options.output).generic_string();
+			report.bytes = result.bytecode.size();
+			report.digest = Sha256::ToHex(Sha256::Hash(result.bytecode.data(), result.bytecode.size()));
+			DxbcContainer container;
+			std::string error = "";
+			report.analyzed = container.Parse(result.bytecode.data(), result.bytecode.size(), error) && container.hasProgram;
+			report.cost = container.statistics;
+			report.checksum = container.checksumValid ? DxbcContainer::ToHex(container.checksum) : "";
+			if (!WriteFile(output, result.bytecode.data(), result.bytecode.size()))
+			{
+				report.success = false;
+				report.log += report.output + ": error: cannot write output\n";
+			}
+		}
+	}
+	else
+	{
+		// Shares the pool, the calling worker takes part in the variant builds
+		ShaderVariantSet set(permutations);
+		std::string error = "";
+		if (!set.Build(SingleInstance<ThreadPool>::Get(), compiler, cache, request, error))
+		{
+			report.log = report.source + ": error: " + error + "\n";
+			report.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return;
+		}
+		report.success = set.statistics.failed == 0;
+		report.cached = set.statistics.cached == set.statistics.unique;
+		report.uniqueVariants = set.statistics.unique;
+		// One file per unique result, variants point at theirs
+		std::unordered_map<const ShaderCompiler::Result*, std::string> written = {};
+		for (ShaderPermutations::Key key = 0; key < set.statistics.variants; key++)
+		{
+			const ShaderCompiler::Result* result = set.Find(key);
+			VariantReport variant;
+			variant.key = key;
+			variant.defines = permutations.Describe(key);
+			auto it = written.find(result);
+			if (it == written.end())
+			{
+				fs::path file = output;
+				file.replace_extension("." + std::to_string(written.size()) + ".cso");
+				const std::string name = file.lexically_relative(options.output).generic_string();
+				if (result->success && !WriteFile(file, result->bytecode.data(), result->bytecode.size()))
+				{
+					report.success = false;
+					report.log += name + ": error: cannot write output\n";
+				}
+				if (!result->success)
+					report.log += "[" + variant.defines + "]\n" + result->log;
+				if (includes.empty())
+					includes = result->includes;
+				it = written.emplace(result, result->success ? name : "").first;
+			}
+			variant.output = it->second;
+			report.variants.push_back(variant);
+		}
+	}
+	for (const ShaderCompiler::Include& include : includes)
+		report.includes.push_back(include.path);
+	report.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseArguments(argc, argv, options))
+	{
+		PrintUsage();
+		return 2;
+	}
+	std::unique_ptr<ShaderCompiler> compiler = CreateBackend(options.backend);
+	if (compiler == nullptr)
+	{
+		std::cerr << "Unknown or unavailable backend: " << options.backend << std::endl;
+		return 2;
+	}
+	if (options.worker)
+		return RunWorker(compiler.get(), options.backend == "fake");
+	if (options.serveCache)
+		return RunCacheServer(options);
+	if (options.serve)
+	{
+		const std::string executable = argv[0];
+		return RunServer(options, executable.find_first_of("/\\") != std::string::npos ? fs::absolute(executable).string() : executable, compiler.get());
+	}
+	std::unique_ptr<ShaderCompiler> local = nullptr;
+	if (options.useServer)
+	{
+		local = std::move(compiler);
+		compiler = std::make_unique<CompileServerBackend>(options.server, local.get());
+	}
+	std::error_code error;
+	options.input = fs::absolute(options.input, error).lexically_normal();
+	options.output = fs::absolute(options.output, error).lexically_normal();
+	if (!fs::is_directory(options.input, error))
+	{
+		std::cerr << "Not a directory: " << options.input.string() << std::endl;
+		return 2;
+	}
+	fs::create_directories(options.output, error);
+	if (error)
+	{
+		std::cerr << "Cannot create " << options.output.string() << ": " << error.message() << std::endl;
+		return 2;
+	}
+
+	// Largest files first, so one big shader does not start last and hold up the whole build
+	std::vector<std::pair<uintmax_t, fs::path>> files = {};
+	for (auto it = fs::recursive_directory_iterator(options.input, error); it != fs::recursive_directory_iterator(); it.increment(error))
+	{
+		if (error)
+			break;
+		if (it->is_directory(error) && it->path() == options.output)
+		{
+			it.disable_recursion_pending();
+			continue;
+		}
+		if (it->is_regular_file(error) && it->path().extension() == ".hlsl")
+			files.push_back({ it->file_size(error), it->path() });
+	}
+	std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.first != b.first ? a.first > b.first : a.second < b.second; });
+
+	IncludeResolver resolver;
+	for (const fs::path& directory : options.includeDirectories)
+		resolver.AddSearchPath(fs::absolute(directory, error));
+	RemoteCache remote;
+	ShaderCache cache(options.cache);
+	ConnectRemote(options, cache, remote);
+	// The calling thread works too, jobs counts it
+	SingleInstance<ThreadPool>::Get(options.jobs - 1)->Start();
+
+	if (!options.quiet)
+	{
+		std::cout << APPLICATION_NAME << ": " << files.size() << " files, " << options.jobs << " jobs, " << compiler->GetName() << " backend" << std::endl;
+	}
+	std::vector<FileReport> reports(files.size());
+	std::mutex outputMutex;
+	std::atomic<size_t> finished{ 0 };
+	const auto start = std::chrono::steady_clock::now();
+	SingleInstance<ThreadPool>::Get()->ParallelFor(files.size(), [&](size_t index) {
+		FileReport& report = reports[index];
+		CompileFile(options, compiler.get(), options.useCache ? &cache : nullptr, &resolver, files[index].second, report);
+		const size_t done = ++finished;
+		std::lock_guard<std::mutex> lock(outputMutex);
+		if (!options.quiet || !report.success)
+		{
+			char line[64];
+			snprintf(line, sizeof(line), "[%4zu/%zu] %9.2f ms  %-6s  ", done, files.size(), report.milliseconds,
+				!report.success ? "FAILED" : report.cached ? "cached" : "ok");
+			std::cout << line << report.source;
+			if (!report.variants.empty())
+				std::cout << " (" << report.variants.size() << " variants, " << report.uniqueVariants << " unique)";
+			std::cout << std::endl;
+		}
+		if (!report.log.empty() && (!report.success || !options.quiet))
+			std::cerr << report.log << std::flush;
+		});
+	const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	// Uploads finish before exit, the next machine should find them
+	remote.Flush();
+
+	std::sort(reports.begin(), reports.end(), [](const FileReport& a, const FileReport& b) { return a.source < b.source; });
+	size_t failed = 0;
+	float compileTime = 0.f;
+	for (const FileReport& report : reports)
+	{
+		failed += report.success ? 0 : 1;
+		compileTime += report.milliseconds;
+	}
+	if (!WriteManifest(options.output / "manifest.json", options, compiler->GetName(), reports, milliseconds))
+	{
+		std::cerr << "Cannot write " << (options.output / "manifest.json").string() << std::endl;
+		return 2;
+	}
+	const ShaderCache::Statistics statistics = cache.GetStatistics();
+	std::cout << files.size() - failed << " compiled, " << failed << " failed in " << milliseconds << " ms (" << compileTime
+		<< " ms of file time, " << statistics.memoryHits + statistics.diskHits + statistics.remoteHits << " cache hits)" << std::endl;
+	// Files whose bytecode is identical to an earlier one, by container checksum
+	std::unordered_map<std::string, std::vector<std::string>> checksums = {};
+	for (const FileReport& report : reports)
+	{
+		if (report.success && !report.checksum.empty())
+			checksums[report.checksum].push_back(report.source);
+	}
+	size_t duplicates = 0;
+	for (const auto& [checksum, sources] : checksums)
+	{
+		if (sources.size() < 2)
+			continue;
+		duplicates += sources.size() - 1;
+		if (options.quiet)
+			continue;
+		std::cout << "Same bytecode (" << checksum.substr(0, 16) << "):";
+		for (const std::string& source : sources)
+			std::cout << " " << source;
+		std::cout << std::endl;
+	}
+	if (duplicates > 0)
+		std::cout << duplicates << " files compile to the same bytecode as another file" << std::endl;
+	if (cache.remote != nullptr)
+	{
+		const RemoteCache::Statistics shared = remote.GetStatistics();
+		std::cout << "Remote cache " << options.remote << ": " << shared.hits << " hits, " << shared.misses << " misses, " << shared.uploads
+			<< " uploaded, " << shared.skipped << " already there, " << shared.dropped << " dropped, " << shared.errors << " errors" << std::endl;
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#ifdef _WIN32
+#include <WinSock2.h>
+#include <Windows.h>
+#include <fcntl.h>
+#include <io.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+namespace fs = std::filesystem;
+
+#include "../Desktop/Dependence/SingleInstance.h"
+#include "../Desktop/Dependence/ThreadPool.h"
+#include "../Desktop/Dependence/Sha256.h"
+#include "../Desktop/Dependence/ChildProcess.h"
+#include "../Desktop/Dependence/LocalSocket.h"
+#include "../Desktop/Dependence/TcpSocket.h"
+#include "../Desktop/Dependence/Lz.h"
+#include "../Desktop/Dependence/Http.h"
+
+#include "../Desktop/Core/Shader/IncludeResolver.h"
+#include "../Desktop/Core/Shader/ShaderCompiler.h"
+#include "../Desktop/Core/Shader/ShaderPermutations.h"
+#include "../Desktop/Core/Shader/ShaderPreprocessor.h"
+#ifdef _WIN32
+#include "../Desktop/Core/Shader/D3DCompilerBackend.h"
+#endif
+#include "../Desktop/Core/Shader/DxbcContainer.h"
+#include "../Desktop/Core/Shader/FakeCompilerBackend.h"
+#include "../Desktop/Core/Shader/CompilerProtocol.h"
+#include "../Desktop/Core/Shader/WorkerPoolBackend.h"
+#include "../Desktop/Core/Shader/CompileServerBackend.h"
+#include "../Desktop/Core/Shader/RemoteCache.h"
+#include "../Desktop/Core/Shader/ShaderCache.h"
+#include "../Desktop/Core/Shader/ShaderVariantSet.h"
+#include "../Desktop/Core/Shader/CompileServer.h"
+#include "../Desktop/Core/Shader/RemoteCacheServer.h"
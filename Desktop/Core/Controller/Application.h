@@ -17,31 +17,39 @@ public:
 	private:
 		CallbackManager<CallbackPeriod, Window*> callbackManager = CallbackManager<CallbackPeriod, Window*>();
 	public:
-		HWND handl = NULL;
-		WNDPROC wndProc = DefWindowProcA;
+		Platform* platform = nullptr;
 		int width = 0;
 		int height = 0;
 		std::string title = "";
 		bool close = false;
 
-		void AddCallback(CallbackPeriod period, std::function<void(Window*)> callback)
+		size_t AddCallback(CallbackPeriod period, std::function<void(Window*)> callback, std::string name = "")
 		{
-			callbackManager.AddCallback(period, callback);
+			if (name.empty())
+				name = "Callback #" + std::to_string(callbackManager.CallbackCount());
+			Profiler::Item* item = SingleInstance<Profiler>::Get()->GetItem("Window/" + name, Profiler::Category::Callback);
+			return callbackManager.AddCallback(period, [item, callback](Window* window) {
+				Profiler::Scope scope(item);
+				callback(window);
+				});
 		}
 
-		void SetWindowsProcess(WNDPROC process)
+		bool RemoveCallback(size_t id)
 		{
-			wndProc = process;
+			return callbackManager.RemoveCallback(id);
+		}
+
+		void SetPlatform(Platform* platform)
+		{
+			this->platform = platform;
 		}
 
 		int SetWidth(int newWidth)
 		{
 			width = newWidth;
-			if (handl != NULL)
+			if (platform != nullptr)
 			{
-				RECT rect;
-				GetWindowRect(handl, &rect);
-				MoveWindow(handl, rect.left, rect.top, width, height, true);
+				platform->SetSize(width, height);
 			}
 			return width;
 		}
@@ -49,11 +57,9 @@ public:
 		int SetHeight(int newHeight)
 		{
 			height = newHeight;
-			if (handl != NULL)
+			if (platform != nullptr)
 			{
-				RECT rect;
-				GetWindowRect(handl, &rect);
-				MoveWindow(handl, rect.left, rect.top, width, height, true);
+				platform->SetSize(width, height);
 			}
 			return height;
 		}
@@ -66,74 +72,50 @@ public:
 
 		void Minimize()
 		{
-			ShowWindow(handl, SW_MINIMIZE);
+			if (platform != nullptr)
+			{
+				platform->Minimize();
+			}
 		}
 
 		void Move(int offsetX, int offsetY)
 		{
-			if (handl != NULL)
+			if (platform != nullptr)
 			{
-				RECT rect;
-				GetWindowRect(handl, &rect);
-				MoveWindow(handl, rect.left + offsetX, rect.top + offsetY, rect.right - rect.left, rect.bottom - rect.top, true);
+				platform->Move(offsetX, offsetY);
 			}
 		}
 
-		float* GetPosition()
+		ImVec2 GetPosition()
 		{
-			float position[2] = { 0, 0 };
-			if (handl != NULL)
+			if (platform != nullptr)
 			{
-				RECT rect;
-				GetWindowRect(handl, &rect);
-				position[0] = (float)rect.left;
-				position[1] = (float)rect.top;
+				return platform->GetPosition();
 			}
-			return position;
+			return ImVec2(0, 0);
 		}
 
 		std::string SetTitle(std::string newTitle)
 		{
 			title = newTitle;
-			if (handl != NULL)
+			if (platform != nullptr)
 			{
-				SetWindowTextA(handl, title.c_str());
+				platform->SetTitle(title);
 			}
 			return title;
 		}
 
-		Window& Create(const std::wstring& title, const int& width, const int& height)
+		Window& Create(const std::string& title, const int& width, const int& height)
 		{
 			// Set window size
 			this->width = width;
 			this->height = height;
 			// Set window title
-			this->title = std::string(title.begin(), title.end());
-			// Register window class
-			WNDCLASSEX wc = { 0 };
-			wc.cbSize = sizeof(WNDCLASSEXA);
-			wc.style = CS_HREDRAW | CS_VREDRAW;
-			wc.lpfnWndProc = wndProc;
-			wc.hInstance = GetModuleHandle(NULL);
-			wc.hCursor = LoadCursor(NULL, IDC_ARROW);
-			wc.lpszClassName = L"NaShaderCompiler";
-			if (!RegisterClassEx(&wc))
+			this->title = title;
+			if (platform == nullptr || !platform->Create(title, width, height))
 			{
-				MessageBoxA(NULL, "Failed to register window class", "Error", MB_OK | MB_ICONERROR);
 				return *this;
 			}
-			// Create window
-			handl = CreateWindow(L"NaShaderCompiler", title.c_str(), WS_OVERLAPPEDWINDOW, 100, 100, width, height, NULL, NULL, GetModuleHandle(NULL), NULL);
-
-			if (handl == NULL)
-			{
-				MessageBoxA(NULL, "Failed to create window", "Error", MB_OK | MB_ICONERROR);
-				return *this;
-			}
-
-			// Show window
-			ShowWindow(handl, SW_SHOWDEFAULT);
-			UpdateWindow(handl);
 
 			// Invoke callbacks
 			callbackManager.InvokeCallbacks(CallbackPeriod::Create, this);
@@ -142,21 +124,32 @@ public:
 
 		void JoinMessageLoop()
 		{
+			FrameScheduler* scheduler = SingleInstance<FrameScheduler>::Get();
+			EventLoop* eventLoop = SingleInstance<EventLoop>::Get();
 			while (!close)
 			{
-				MSG msg;
-				while (::PeekMessage(&msg, nullptr, 0U, 0U, PM_REMOVE))
 				{
-					::TranslateMessage(&msg);
-					::DispatchMessage(&msg);
-					if (msg.message == WM_QUIT)
+					TIMELINE_ZONE("Pump Messages");
+					if (!platform->PumpEvents())
 						Close();
 				}
 				if (close)
 					break;
+				eventLoop->RunDueTimers();
+
+				if (scheduler->ShouldRender())
+				{
+					scheduler->BeginFrame();
+					Timeline::MarkFrame();
+					TIMELINE_ZONE("Frame");
+					Profiler::Scope frame(SingleInstance<Profiler>::Get()->GetFrame());
+					callbackManager.InvokeCallbacks(CallbackPeriod::Update, this);
+					continue;
+				}
 
-				callbackManager.InvokeCallbacks(CallbackPeriod::Update, this);
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				// Sleep until a message, a wake or a timer arrives or the next frame is due
+				TIMELINE_ZONE("Wait");
+				eventLoop->Wait(scheduler->TimeUntilNextFrame());
 			}
 		}
 	};
@@ -172,4 +165,4 @@ public:
 
 	// Getters
 	Window& GetMainWindow() { return mainWindow; }
-};
+};
\ No newline at end of file
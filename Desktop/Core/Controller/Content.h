@@ -1,82 +1,244 @@
 #pragma once
+#include <string_view>
 
 class Content
 {
 public:
+	// Compact id of an interned window or overlay path
+	using Id = uint32_t;
+	static constexpr Id InvalidId = 0xFFFFFFFF;
+
 	class Window
 	{
 	public:
-		const std::string path = "";
+		Id id = InvalidId;
 		std::function<void(bool*)> render = [](bool*) {};
 		bool open = false;
+		Profiler::Item* profile = nullptr;
 
 		Window() {}
-		Window(std::string path, std::function<void(bool*)> render, bool open = false) : path(path), open(open)
+		Window(std::string_view path, std::function<void(bool*)> render, bool open = false) : open(open)
 		{
 			this->render = render;
-			SingleInstance<Content>::Get()->AddWindow(this);
+			id = SingleInstance<Content>::Get()->AddWindow(path, this);
+			profile = SingleInstance<Profiler>::Get()->GetItem("Window/" + GetPath(), Profiler::Category::Window);
+		}
+
+		const std::string& GetPath() const
+		{
+			return SingleInstance<Content>::Get()->GetPath(id);
 		}
 
 		void Render()
 		{
+			Profiler::Scope scope(profile);
 			render(&open);
 		}
 	};
 	class Overlay
 	{
 	public:
-		const std::string path = "";
+		Id id = InvalidId;
 		std::function<void()> render = []() {};
+		Profiler::Item* profile = nullptr;
 
 		Overlay() {}
-		Overlay(std::string path, std::function<void()> render) : path(path)
+		Overlay(std::string_view path, std::function<void()> render)
 		{
 			this->render = render;
-			SingleInstance<Content>::Get()->AddOverlay(this);
+			id = SingleInstance<Content>::Get()->AddOverlay(path, this);
+			profile = SingleInstance<Profiler>::Get()->GetItem("Overlay/" + GetPath(), Profiler::Category::Overlay);
+		}
+
+		const std::string& GetPath() const
+		{
+			return SingleInstance<Content>::Get()->GetPath(id);
 		}
 
 		void Render()
 		{
+			Profiler::Scope scope(profile);
 			render();
 		}
 	};
-public:
-	std::vector<Window*> windows = {};
-	std::vector<Overlay*> overlays = {};
-public:
-	void AddWindow(Window* window)
+	// Node of the "Windows Controller" menu, built from the '/' separated window paths at registration
+	class MenuNode
 	{
-		windows.push_back(window);
+	public:
+		std::string name = "";
+		std::vector<uint32_t> children = {};
+		Window* window = nullptr;
+
+		MenuNode() {}
+		MenuNode(std::string_view name) : name(name) {}
+	};
+private:
+	// Interned paths, indexed by id
+	std::vector<std::string> paths = {};
+	std::vector<uint64_t> hashes = {};
+	// Open addressing index with linear probing, each slot holds id + 1 (0 is empty)
+	std::vector<uint32_t> slots = std::vector<uint32_t>(64, 0);
+	std::vector<Window*> windowById = {};
+	std::vector<Overlay*> overlayById = {};
+	// Node 0 is the root
+	std::vector<MenuNode> menu = { MenuNode() };
+
+	static uint64_t Hash(std::string_view path)
+	{
+		// FNV-1a
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : path)
+		{
+			hash ^= (uint8_t)c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
 	}
-	void AddOverlay(Overlay* overlay)
+
+	void Grow()
 	{
-		overlays.push_back(overlay);
+		std::vector<uint32_t> grown(slots.size() * 2, 0);
+		const size_t mask = grown.size() - 1;
+		for (uint32_t slot : slots)
+		{
+			if (slot == 0)
+				continue;
+			size_t index = hashes[slot - 1] & mask;
+			while (grown[index] != 0)
+				index = (index + 1) & mask;
+			grown[index] = slot;
+		}
+		slots.swap(grown);
 	}
-	Overlay* GetOverlay(std::string path)
+
+	Id Intern(std::string_view path)
 	{
-		for (auto& overlay : overlays)
+		Id id = Find(path);
+		if (id != InvalidId)
+			return id;
+		if ((paths.size() + 1) * 2 > slots.size())
+			Grow();
+		id = (Id)paths.size();
+		paths.emplace_back(path);
+		hashes.push_back(Hash(path));
+		windowById.push_back(nullptr);
+		overlayById.push_back(nullptr);
+		const size_t mask = slots.size() - 1;
+		size_t index = hashes[id] & mask;
+		while (slots[index] != 0)
+			index = (index + 1) & mask;
+		slots[index] = id + 1;
+		return id;
+	}
+
+	void AddMenuEntry(std::string_view path, Window* window)
+	{
+		uint32_t node = 0;
+		while (!path.empty())
 		{
-			if (overlay->path == path)
+			size_t separator = path.find('/');
+			std::string_view name = path.substr(0, separator);
+			path = separator == std::string_view::npos ? std::string_view() : path.substr(separator + 1);
+			uint32_t next = 0;
+			for (uint32_t child : menu[node].children)
+			{
+				if (menu[child].name == name)
+				{
+					next = child;
+					break;
+				}
+			}
+			if (next == 0)
 			{
-				return overlay;
+				next = (uint32_t)menu.size();
+				menu.emplace_back(name);
+				menu[node].children.push_back(next);
 			}
+			node = next;
 		}
-		return nullptr;
+		menu[node].window = window;
 	}
 
-	void SetWindowState(std::string path, int open = -1)
+	void RenderMenu(uint32_t node)
 	{
-		for (auto& window : windows)
+		for (uint32_t child : menu[node].children)
 		{
-			if (window->path == path)
+			MenuNode& entry = menu[child];
+			ImGui::PushID((int)child);
+			if (entry.window != nullptr)
 			{
-				if (open == -1)
-				{
-					open = !window->open;
-				}
-				window->open = open;
+				ImGui::Checkbox(entry.name.c_str(), &entry.window->open);
 			}
+			// Same label as the checkbox of a window that is also a menu parent, so the tree node gets its own ID
+			if (!entry.children.empty() && ImGui::TreeNodeEx("##tree", ImGuiTreeNodeFlags_DefaultOpen, "%s", entry.name.c_str()))
+			{
+				RenderMenu(child);
+				ImGui::TreePop();
+			}
+			ImGui::PopID();
+		}
+	}
+public:
+	std::vector<Window*> windows = {};
+	std::vector<Overlay*> overlays = {};
+public:
+	// Does not allocate
+	Id Find(std::string_view path) const
+	{
+		const size_t mask = slots.size() - 1;
+		const uint64_t hash = Hash(path);
+		for (size_t index = hash & mask; slots[index] != 0; index = (index + 1) & mask)
+		{
+			const Id id = slots[index] - 1;
+			if (hashes[id] == hash && paths[id] == path)
+				return id;
 		}
+		return InvalidId;
+	}
+
+	const std::string& GetPath(Id id) const
+	{
+		return paths[id];
+	}
+
+	Id AddWindow(std::string_view path, Window* window)
+	{
+		Id id = Intern(path);
+		windowById[id] = window;
+		windows.push_back(window);
+		AddMenuEntry(path, window);
+		return id;
+	}
+	Id AddOverlay(std::string_view path, Overlay* overlay)
+	{
+		Id id = Intern(path);
+		overlayById[id] = overlay;
+		overlays.push_back(overlay);
+		return id;
+	}
+	Overlay* GetOverlay(Id id)
+	{
+		return id < overlayById.size() ? overlayById[id] : nullptr;
+	}
+	Overlay* GetOverlay(std::string_view path)
+	{
+		return GetOverlay(Find(path));
+	}
+
+	void SetWindowState(Id id, int open = -1)
+	{
+		if (id >= windowById.size() || windowById[id] == nullptr)
+			return;
+		Window* window = windowById[id];
+		if (open == -1)
+		{
+			open = !window->open;
+		}
+		window->open = open;
+	}
+	void SetWindowState(std::string_view path, int open = -1)
+	{
+		SetWindowState(Find(path), open);
 	}
 
 	void Render()
@@ -84,10 +246,7 @@ public:
 		ImGui::SetNextWindowPos(ImVec2(ImGui::GetMainViewport()->WorkSize.x - 300.f, 50.f), ImGuiCond_FirstUseEver);
 		ImGui::SetNextWindowSize(ImVec2(250.f, 150.f), ImGuiCond_FirstUseEver);
 		ImGui::Begin("Windows Controller");
-		for (auto& window : windows)
-		{
-			ImGui::Checkbox(window->path.c_str(), &window->open);
-		}
+		RenderMenu(0);
 		ImGui::End();
 		for (auto& window : windows)
 		{
@@ -104,5 +263,6 @@ public:
 };
 
 #define RegisterWindow(path, state) void path(bool* opened); Content::Window path##Window(#path, path, state); void path(bool* opened)
+// Registers the window under a '/' separated menu, e.g. RegisterWindowIn("Monitor", LoggerView, true) shows up as Monitor/LoggerView
+#define RegisterWindowIn(menu, path, state) void path(bool* opened); Content::Window path##Window(menu "/" #path, path, state); void path(bool* opened)
 #define RegisterOverlay(path) void path(); Content::Overlay path##Overlay(#path, path); void path()
-
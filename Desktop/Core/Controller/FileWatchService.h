@@ -0,0 +1,228 @@
+#pragma once
+
+// Watches files for the rest of the application. Reports from the FileWatcher are collected until no new
+// one arrived for debounceTime (an editor save is often a truncate, several writes and a rename), then each
+// file is read once and the callback only runs for files whose content hash differs from the last read.
+class FileWatchService
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	using ChangedCallback = std::function<void(const fs::path& path, const std::string& content)>;
+
+	class Statistics
+	{
+	public:
+		// Reports from the backend, reports merged into an already pending file, and what the reads found
+		uint64_t events = 0;
+		uint64_t coalesced = 0;
+		uint64_t reads = 0;
+		uint64_t changed = 0;
+		uint64_t unchanged = 0;
+		uint64_t failedReads = 0;
+	};
+
+private:
+	class File
+	{
+	public:
+		// Watch calls for this path, it is unwatched when the last one is released
+		int references = 0;
+		Sha256::Digest hash = {};
+		bool hashed = false;
+	};
+
+	std::unique_ptr<FileWatcher> watcher = nullptr;
+	std::unordered_map<std::string, File> files = {};
+	std::unordered_set<std::string> pending = {};
+	Clock::time_point firstPending = {};
+	size_t sourceId = 0;
+	size_t pollTimer = 0;
+	size_t debounceTimer = 0;
+	ChangedCallback changedCallback = nullptr;
+
+	void Collect()
+	{
+		std::vector<fs::path> reports = {};
+		watcher->Poll(reports);
+		if (reports.empty())
+			return;
+		if (pending.empty())
+			firstPending = Clock::now();
+		for (const fs::path& path : reports)
+		{
+			statistics.events++;
+			if (!pending.insert(path.string()).second)
+				statistics.coalesced++;
+		}
+		// Push the flush back on every report, but not further than maxDelay after the first one
+		EventLoop* loop = SingleInstance<EventLoop>::Get();
+		if (debounceTimer != 0)
+			loop->CancelTimer(debounceTimer);
+		const auto latest = firstPending + maxDelay - Clock::now();
+		const auto delay = std::max(Clock::duration::zero(), std::min<Clock::duration>(debounceTime, latest));
+		debounceTimer = loop->AddTimer(delay, [this]() {
+			debounceTimer = 0;
+			Flush();
+			});
+	}
+
+	void SchedulePoll()
+	{
+		pollTimer = SingleInstance<EventLoop>::Get()->AddTimer(pollInterval, [this]() {
+			Collect();
+			SchedulePoll();
+			});
+	}
+
+	void Flush()
+	{
+		std::unordered_set<std::string> flushing = {};
+		flushing.swap(pending);
+		for (const std::string& name : flushing)
+		{
+			auto it = files.find(name);
+			if (it == files.end())
+				continue;
+			std::string content = "";
+			statistics.reads++;
+			// Missing for a moment while an editor replaces the file, the rename is reported again
+			if (!ReadFile(name, content))
+			{
+				statistics.failedReads++;
+				continue;
+			}
+			const Sha256::Digest hash = Sha256::Hash(content.data(), content.size());
+			if (it->second.hashed && it->second.hash == hash)
+			{
+				statistics.unchanged++;
+				continue;
+			}
+			it->second.hash = hash;
+			it->second.hashed = true;
+			statistics.changed++;
+			if (changedCallback)
+				changedCallback(fs::path(name), content);
+		}
+	}
+
+public:
+	std::chrono::milliseconds debounceTime = std::chrono::milliseconds(100);
+	std::chrono::milliseconds maxDelay = std::chrono::milliseconds(1000);
+	// Only used by the polling backend
+	std::chrono::milliseconds pollInterval = std::chrono::milliseconds(250);
+	Statistics statistics = Statistics();
+
+	// Reads the whole file with one allocation
+	static bool ReadFile(const fs::path& path, std::string& content)
+	{
+		std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+			return false;
+		const std::streamoff size = file.tellg();
+		if (size < 0)
+			return false;
+		content.resize((size_t)size);
+		file.seekg(0);
+		file.read(content.data(), size);
+		content.resize((size_t)file.gcount());
+		return true;
+	}
+
+	// Picks the native backend and registers it with the main event loop, call on the main thread
+	void Start(ChangedCallback callback)
+	{
+		changedCallback = callback;
+		watcher = CreateFileWatcher();
+		EventLoop::NativeHandle handle = {};
+		if (watcher->GetHandle(handle))
+		{
+			sourceId = SingleInstance<EventLoop>::Get()->AddSource(handle, [this]() {
+				Collect();
+				});
+		}
+		else
+		{
+			SchedulePoll();
+		}
+		FORMAT_LOG(Info, "Watching files with %s", watcher->GetName());
+	}
+
+	void Stop()
+	{
+		EventLoop* loop = SingleInstance<EventLoop>::Get();
+		if (sourceId != 0)
+			loop->RemoveSource(sourceId);
+		if (pollTimer != 0)
+			loop->CancelTimer(pollTimer);
+		if (debounceTimer != 0)
+			loop->CancelTimer(debounceTimer);
+		sourceId = pollTimer = debounceTimer = 0;
+		watcher = nullptr;
+		files.clear();
+		pending.clear();
+	}
+
+	// content is what the caller already read, so the first save with identical content is not reported
+	bool Watch(const fs::path& path, const std::string& content)
+	{
+		if (watcher == nullptr || path.empty())
+			return false;
+		const std::string name = FileWatcher::Normalize(path).string();
+		File& file = files[name];
+		if (file.references == 0 && !watcher->Watch(name))
+		{
+			files.erase(name);
+			FORMAT_LOG(Warning, "Failed to watch %s", name.c_str());
+			return false;
+		}
+		file.references++;
+		file.hash = Sha256::Hash(content.data(), content.size());
+		file.hashed = true;
+		return true;
+	}
+
+	// Reads the file now for a manual reload and stores its hash like a flushed report would,
+	// so the next save with the same content is not reported again
+	bool Reload(const fs::path& path, std::string& content)
+	{
+		statistics.reads++;
+		if (!ReadFile(path, content))
+		{
+			statistics.failedReads++;
+			return false;
+		}
+		if (watcher == nullptr)
+			return true;
+		auto it = files.find(FileWatcher::Normalize(path).string());
+		if (it != files.end())
+		{
+			it->second.hash = Sha256::Hash(content.data(), content.size());
+			it->second.hashed = true;
+		}
+		return true;
+	}
+
+	void Unwatch(const fs::path& path)
+	{
+		if (watcher == nullptr || path.empty())
+			return;
+		const std::string name = FileWatcher::Normalize(path).string();
+		auto it = files.find(name);
+		if (it == files.end())
+			return;
+		if (--it->second.references > 0)
+			return;
+		watcher->Unwatch(name);
+		files.erase(it);
+	}
+
+	size_t GetWatchedCount() const
+	{
+		return files.size();
+	}
+
+	const char* GetBackendName() const
+	{
+		return watcher != nullptr ? watcher->GetName() : "None";
+	}
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+// Decides when the main loop renders a frame.
+// Frames are drawn only when something happened (input, resize, a finished async job, a running
+// animation or an explicit RequestRedraw), capped at targetFps, plus a few settle frames so ImGui
+// can finish hover and transition state. With nothing pending the loop falls back to idleFps.
+class FrameScheduler
+{
+public:
+	using Duration = std::chrono::nanoseconds;
+	using TimePoint = std::chrono::steady_clock::time_point;
+
+	// Time source of the scheduler, replaceable so the scheduling logic can run against a manual clock
+	class Clock
+	{
+	public:
+		virtual ~Clock() {}
+		virtual TimePoint Now() = 0;
+	};
+
+	class SteadyClock : public Clock
+	{
+	public:
+		TimePoint Now() override
+		{
+			return std::chrono::steady_clock::now();
+		}
+	};
+
+	enum Reason : uint32_t
+	{
+		None = 0,
+		Input = 1 << 0,
+		Resize = 1 << 1,
+		AsyncJob = 1 << 2,
+		Animation = 1 << 3,
+		Request = 1 << 4,
+		Idle = 1 << 5
+	};
+
+	class Statistics
+	{
+	public:
+		uint64_t framesRendered = 0;
+		uint64_t idleFrames = 0;
+		uint64_t wakeups = 0;
+		uint32_t lastReasons = Reason::None;
+	};
+
+private:
+	SteadyClock steadyClock = SteadyClock();
+	// steadyClock unless another one was given, not owned
+	Clock* clock = nullptr;
+	std::atomic<uint32_t> pending{ Reason::Request };
+	std::atomic<uint32_t> animations{ 0 };
+	std::function<void()> wake = nullptr;
+	TimePoint lastFrame = {};
+	uint32_t settleFrames = 0;
+
+	static Duration Interval(float fps)
+	{
+		return std::chrono::duration_cast<Duration>(std::chrono::duration<double>(1.0 / fps));
+	}
+
+	bool IsActive() const
+	{
+		return pending.load() != Reason::None || animations.load() > 0 || settleFrames > 0;
+	}
+
+public:
+	// Present with a sync interval of 1 instead of 0
+	bool vsync = true;
+	// Frame rate cap while something is happening, 0 means uncapped
+	float targetFps = 60.f;
+	// Frame rate while nothing is happening, 0 means never redraw while idle
+	float idleFps = 4.f;
+	// Frames drawn after the last event
+	uint32_t settleFrameCount = 3;
+	Statistics statistics = Statistics();
+
+	FrameScheduler() : clock(&steadyClock) {}
+	FrameScheduler(Clock* clock) : clock(clock) {}
+
+	// Called from any thread after a redraw was requested, so a blocked main loop can wake up
+	void SetWakeCallback(std::function<void()> callback)
+	{
+		wake = callback;
+	}
+
+	// Thread safe
+	void RequestRedraw(Reason reason = Reason::Request)
+	{
+		pending.fetch_or(reason);
+		if (wake)
+			wake();
+	}
+
+	// Keeps the scheduler rendering at targetFps until the matching EndAnimation, thread safe
+	void BeginAnimation()
+	{
+		animations.fetch_add(1);
+		RequestRedraw(Reason::Animation);
+	}
+
+	void EndAnimation()
+	{
+		animations.fetch_sub(1);
+	}
+
+	// Earliest time the next frame may be drawn, TimePoint::max() when the loop can sleep until an event
+	TimePoint NextFrameTime() const
+	{
+		if (IsActive())
+			return targetFps > 0.f ? lastFrame + Interval(targetFps) : lastFrame;
+		if (idleFps > 0.f)
+			return lastFrame + Interval(idleFps);
+		return TimePoint::max();
+	}
+
+	bool ShouldRender()
+	{
+		statistics.wakeups++;
+		return clock->Now() >= NextFrameTime();
+	}
+
+	// Consumes the pending reasons, events arriving while the frame renders schedule the next one
+	void BeginFrame()
+	{
+		const uint32_t reasons = pending.exchange(Reason::None) | (animations.load() > 0 ? Reason::Animation : Reason::None);
+		statistics.lastReasons = reasons;
+		if (reasons != Reason::None)
+		{
+			settleFrames = settleFrameCount;
+		}
+		else if (settleFrames > 0)
+		{
+			settleFrames--;
+		}
+		else
+		{
+			statistics.idleFrames++;
+			statistics.lastReasons = Reason::Idle;
+		}
+		statistics.framesRendered++;
+		lastFrame = clock->Now();
+	}
+
+	// Time to wait from now until NextFrameTime, Duration::max() when there is nothing to wait for
+	Duration TimeUntilNextFrame()
+	{
+		const TimePoint next = NextFrameTime();
+		if (next == TimePoint::max())
+			return Duration::max();
+		const TimePoint now = clock->Now();
+		return next > now ? std::chrono::duration_cast<Duration>(next - now) : Duration::zero();
+	}
+};
\ No newline at end of file
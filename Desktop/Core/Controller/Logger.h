@@ -3,14 +3,20 @@
 #define FORMAT(level) va_list args;\
 va_start(args, format);\
 char buffer[1024];\
-vsprintf_s(buffer, format.c_str(), args);\
+vsnprintf(buffer, sizeof(buffer), format.c_str(), args);\
 va_end(args);\
-LogMessage(line, file, buffer, Log::Level::##level);
+LogMessage(line, file, buffer, Log::Level::level);
+
+#ifdef _WIN32
+#define LOCAL_TIME(ltm, now) localtime_s(&ltm, &now)
+#else
+#define LOCAL_TIME(ltm, now) localtime_r(&now, &ltm)
+#endif
 
 #define TIME(format) char buffer[80];\
 time_t now = time(0);\
 tm ltm = {};\
-localtime_s(&ltm,&now);\
+LOCAL_TIME(ltm, now);\
 strftime(buffer, 80, format, &ltm);\
 std::string bufferString = buffer;
 
@@ -127,4 +133,8 @@ public:
 
 #undef FORMAT
 
-#define FORMAT_LOG(level, format, ...) SingleInstance<Logger>::Get()->Add##level(__LINE__, __FILE__, format, __VA_ARGS__);
\ No newline at end of file
+#ifdef _MSC_VER
+#define FORMAT_LOG(level, format, ...) SingleInstance<Logger>::Get()->Add##level(__LINE__, __FILE__, format, __VA_ARGS__);
+#else
+#define FORMAT_LOG(level, format, ...) SingleInstance<Logger>::Get()->Add##level(__LINE__, __FILE__, format, ##__VA_ARGS__);
+#endif
\ No newline at end of file
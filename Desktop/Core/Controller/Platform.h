@@ -0,0 +1,39 @@
+#pragma once
+
+// Window system the application runs on: Win32 on Windows, headless everywhere else
+class Platform
+{
+protected:
+	std::function<void(int, int)> resizeCallback = nullptr;
+
+public:
+	int width = 0;
+	int height = 0;
+
+	virtual ~Platform() {}
+
+	// Invoked with the new client size whenever the window was resized, 0x0 when it was minimized
+	void SetResizeCallback(std::function<void(int, int)> callback)
+	{
+		resizeCallback = callback;
+	}
+
+	virtual bool Create(const std::string& title, int width, int height) = 0;
+	virtual void Destroy() = 0;
+	// Dispatches every pending event, returns false once the platform asked to quit.
+	// Blocking for events is left to EventLoop, which also wakes on this thread's window messages
+	virtual bool PumpEvents() = 0;
+
+	virtual void ImGuiInit() = 0;
+	virtual void ImGuiNewFrame() = 0;
+	virtual void ImGuiShutdown() = 0;
+
+	virtual void* GetNativeHandle() = 0;
+	virtual void SetSize(int width, int height) = 0;
+	virtual void SetTitle(const std::string& title) = 0;
+	virtual void Minimize() = 0;
+	virtual void Move(int offsetX, int offsetY) = 0;
+	virtual ImVec2 GetPosition() = 0;
+	// Filter uses the "Name\0*.ext\0" pairs format, returns an empty string when cancelled
+	virtual std::string OpenFileDialog(const char* filter, const char* defaultExtension) = 0;
+};
\ No newline at end of file
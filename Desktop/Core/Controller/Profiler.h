@@ -0,0 +1,154 @@
+#pragma once
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Rolling cost statistics for every callback, window and overlay that runs in a frame
+class Profiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	enum class Category
+	{
+		Frame,
+		Callback,
+		Window,
+		Overlay,
+		None
+	};
+
+	class Item
+	{
+	public:
+		static constexpr size_t SampleCount = 240;
+		std::string name = "";
+		Category category = Category::None;
+		float samples[SampleCount] = {};
+		size_t sampleIndex = 0;
+		size_t sampleCount = 0;
+		// Statistics in milliseconds, refreshed by UpdateStatistics
+		float mean = 0.f;
+		float p95 = 0.f;
+		float max = 0.f;
+
+		Item() {}
+		Item(std::string name, Category category) : name(name), category(category) {}
+
+		void AddSample(float milliseconds)
+		{
+			samples[sampleIndex] = milliseconds;
+			sampleIndex = (sampleIndex + 1) % SampleCount;
+			if (sampleCount < SampleCount)
+				sampleCount++;
+		}
+
+		void UpdateStatistics()
+		{
+			if (sampleCount == 0)
+			{
+				mean = p95 = max = 0.f;
+				return;
+			}
+			float sorted[SampleCount];
+			float sum = 0.f;
+			max = 0.f;
+			for (size_t i = 0; i < sampleCount; i++)
+			{
+				sorted[i] = samples[i];
+				sum += samples[i];
+				max = std::max(max, samples[i]);
+			}
+			mean = sum / sampleCount;
+			size_t rank = (sampleCount * 95) / 100;
+			if (rank >= sampleCount)
+				rank = sampleCount - 1;
+			std::nth_element(sorted, sorted + rank, sorted + sampleCount);
+			p95 = sorted[rank];
+		}
+
+		static const char* CategoryToString(Category category)
+		{
+			switch (category)
+			{
+			case Category::Frame:
+				return "Frame";
+			case Category::Callback:
+				return "Callback";
+			case Category::Window:
+				return "Window";
+			case Category::Overlay:
+				return "Overlay";
+			default:
+				return "None";
+			}
+		}
+	};
+
+	// Times the enclosing block and adds it to the item on destruction
+	class Scope
+	{
+	private:
+		Item* item = nullptr;
+		Clock::time_point start = {};
+	public:
+		Scope(Item* item) : item(SingleInstance<Profiler>::Get()->enabled ? item : nullptr)
+		{
+			if (this->item != nullptr)
+				start = Clock::now();
+		}
+
+		~Scope()
+		{
+			if (item != nullptr)
+				item->AddSample(std::chrono::duration<float, std::milli>(Clock::now() - start).count());
+		}
+	};
+
+private:
+	// Items are node based, so the pointers handed out stay valid while new items are added. Callbacks are added
+	// from pool and compile threads too, the map is only touched under the lock.
+	std::unordered_map<std::string, Item> items = {};
+	mutable std::mutex mutex;
+
+public:
+	bool enabled = true;
+	// Share of the frame above which a window or overlay is flagged in the frame budget
+	float budgetShare = 0.25f;
+
+	Item* GetItem(const std::string& name, Category category)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = items.find(name);
+		if (it == items.end())
+			it = items.emplace(name, Item(name, category)).first;
+		return &it->second;
+	}
+
+	Item* GetFrame()
+	{
+		return GetItem("Frame", Category::Frame);
+	}
+
+	// Every item at the time of the call, the pointers stay valid
+	std::vector<Item*> GetItems()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<Item*> snapshot = {};
+		snapshot.reserve(items.size());
+		for (auto& item : items)
+			snapshot.push_back(&item.second);
+		return snapshot;
+	}
+
+	void UpdateStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& item : items)
+		{
+			item.second.UpdateStatistics();
+		}
+	}
+};
\ No newline at end of file
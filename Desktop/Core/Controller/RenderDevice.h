@@ -0,0 +1,35 @@
+#pragma once
+
+// Graphics API the application renders with: Direct3D 11 on Windows, a recording device when headless
+class RenderDevice
+{
+public:
+	// Opaque pixel shader object owned by the device
+	using ShaderHandle = void*;
+
+	virtual ~RenderDevice() {}
+
+	virtual bool Create(Platform* platform, int width, int height) = 0;
+	virtual void Destroy() = 0;
+	virtual bool Resize(int width, int height) = 0;
+	// Binds and clears the back buffer
+	virtual void BeginFrame(const float clearColor[4]) = 0;
+	// False when nothing of the window is visible, e.g. covered or on a locked screen
+	virtual bool Present(bool vsync) = 0;
+	// Whether a Present would still be invisible, checked without presenting
+	virtual bool IsOccluded() = 0;
+
+	virtual void ImGuiInit() = 0;
+	virtual void ImGuiNewFrame() = 0;
+	virtual void ImGuiRenderDrawData(ImDrawData* drawData) = 0;
+	virtual void ImGuiShutdown() = 0;
+
+	// Creates a texture from tightly packed RGBA8 pixels, nullptr and an error on failure
+	virtual ImTextureID CreateTexture(const unsigned char* rgba, int width, int height, std::string& error) = 0;
+	virtual void ReleaseTexture(ImTextureID texture) = 0;
+	// Creates a pixel shader from compiled bytecode, nullptr and an error on failure
+	virtual ShaderHandle CreatePixelShader(const void* bytecode, size_t size, std::string& error) = 0;
+	virtual void ReleasePixelShader(ShaderHandle shader) = 0;
+	// Binds the shader, the texture and the wrap sampler for the draw commands that follow
+	virtual void BindPixelShader(ShaderHandle shader, ImTextureID texture) = 0;
+};
\ No newline at end of file
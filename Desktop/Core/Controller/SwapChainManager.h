@@ -0,0 +1,138 @@
+#pragma once
+
+// Owns the back buffer size. Resize events only record the latest size, the device is resized once
+// at the start of a frame after the size stayed the same for settleTime. Frames are skipped while minimized,
+// and while occluded until a test present every occlusionPollTime finds the window visible again.
+class SwapChainManager
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	class Statistics
+	{
+	public:
+		uint64_t events = 0;
+		uint64_t resizes = 0;
+		uint64_t minimizedFrames = 0;
+		uint64_t occlusions = 0;
+		uint64_t occludedFrames = 0;
+		// Milliseconds spent inside RenderDevice::Resize
+		float lastResizeTime = 0.f;
+		float maxResizeTime = 0.f;
+		float totalResizeTime = 0.f;
+	};
+
+private:
+	RenderDevice* device = nullptr;
+	int pendingWidth = 0;
+	int pendingHeight = 0;
+	bool pending = false;
+	Clock::time_point lastEvent = {};
+	size_t settleTimer = 0;
+	size_t occlusionTimer = 0;
+
+public:
+	// Size of the back buffer
+	int width = 0;
+	int height = 0;
+	bool minimized = false;
+	bool occluded = false;
+	// How long the size has to stay unchanged before the buffers are resized
+	std::chrono::milliseconds settleTime = std::chrono::milliseconds(30);
+	// Nothing requests frames for a covered window, it is checked for visibility at this interval
+	std::chrono::milliseconds occlusionPollTime = std::chrono::milliseconds(100);
+	Statistics statistics = Statistics();
+
+	void Create(RenderDevice* device, int width, int height)
+	{
+		this->device = device;
+		this->width = width;
+		this->height = height;
+	}
+
+	// A size of zero means the window was minimized
+	void OnResize(int newWidth, int newHeight)
+	{
+		statistics.events++;
+		if (newWidth <= 0 || newHeight <= 0)
+		{
+			minimized = true;
+			return;
+		}
+		minimized = false;
+		pendingWidth = newWidth;
+		pendingHeight = newHeight;
+		pending = true;
+		lastEvent = Clock::now();
+		SingleInstance<FrameScheduler>::Get()->RequestRedraw(FrameScheduler::Reason::Resize);
+	}
+
+	// A present found the window invisible
+	void OnOccluded()
+	{
+		if (!occluded)
+			statistics.occlusions++;
+		occluded = true;
+	}
+
+	// Applies a settled resize, returns false when nothing should be rendered this frame
+	bool BeginFrame()
+	{
+		if (minimized)
+		{
+			statistics.minimizedFrames++;
+			return false;
+		}
+		if (occluded)
+		{
+			if (device->IsOccluded())
+			{
+				statistics.occludedFrames++;
+				if (occlusionTimer == 0)
+				{
+					occlusionTimer = SingleInstance<EventLoop>::Get()->AddTimer(occlusionPollTime, [this]() {
+						occlusionTimer = 0;
+						SingleInstance<FrameScheduler>::Get()->RequestRedraw(FrameScheduler::Reason::Request);
+						});
+				}
+				return false;
+			}
+			occluded = false;
+		}
+		if (!pending)
+			return true;
+
+		const Clock::duration elapsed = Clock::now() - lastEvent;
+		if (elapsed < settleTime)
+		{
+			// Keep drawing into the old buffers and come back once the size settled
+			if (settleTimer == 0)
+			{
+				settleTimer = SingleInstance<EventLoop>::Get()->AddTimer(settleTime - elapsed, [this]() {
+					settleTimer = 0;
+					SingleInstance<FrameScheduler>::Get()->RequestRedraw(FrameScheduler::Reason::Resize);
+					});
+			}
+			return true;
+		}
+
+		pending = false;
+		if (pendingWidth == width && pendingHeight == height)
+			return true;
+
+		TIMELINE_ZONE("Swap Chain Resize");
+		const Clock::time_point start = Clock::now();
+		if (!device->Resize(pendingWidth, pendingHeight))
+		{
+			FORMAT_LOG(Error, "Failed to resize swap chain to %dx%d", pendingWidth, pendingHeight);
+		}
+		width = pendingWidth;
+		height = pendingHeight;
+		const float time = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+		statistics.resizes++;
+		statistics.lastResizeTime = time;
+		statistics.maxResizeTime = std::max(statistics.maxResizeTime, time);
+		statistics.totalResizeTime += time;
+		return true;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+
+RegisterWindowIn("Monitor", FrameBudget, false)
+{
+	ImGui::SetNextWindowPos(ImVec2(ImGui::GetMainViewport()->WorkSize.x - 780.f, 50.f), ImGuiCond_FirstUseEver);
+	ImGui::SetNextWindowSize(ImVec2(460.f, 300.f), ImGuiCond_FirstUseEver);
+	ImGui::Begin("Frame budget", opened);
+	{
+		Profiler* profiler = SingleInstance<Profiler>::Get();
+		profiler->UpdateStatistics();
+		Profiler::Item* frame = profiler->GetFrame();
+
+		ImGui::Checkbox("Enabled", &profiler->enabled);
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+		float budgetPercent = profiler->budgetShare * 100.f;
+		if (ImGui::SliderFloat("Budget", &budgetPercent, 1.f, 100.f, "%.0f%%"))
+			profiler->budgetShare = budgetPercent / 100.f;
+		ImGui::Text("Frame: mean %.3f ms, p95 %.3f ms, max %.3f ms", frame->mean, frame->p95, frame->max);
+
+		if (ImGui::CollapsingHeader("Scheduler"))
+		{
+			FrameScheduler* scheduler = SingleInstance<FrameScheduler>::Get();
+			ImGui::Checkbox("VSync", &scheduler->vsync);
+			ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+			ImGui::SliderFloat("Target FPS (0 = uncapped)", &scheduler->targetFps, 0.f, 240.f, "%.0f");
+			ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+			ImGui::SliderFloat("Idle FPS (0 = never)", &scheduler->idleFps, 0.f, 30.f, "%.1f");
+			ImGui::Text("Frames: %llu rendered, %llu idle, %llu wakeups", (unsigned long long)scheduler->statistics.framesRendered,
+				(unsigned long long)scheduler->statistics.idleFrames, (unsigned long long)scheduler->statistics.wakeups);
+			const EventLoop::Statistics& loop = SingleInstance<EventLoop>::Get()->statistics;
+			ImGui::Text("Waits: %llu, %llu woken, %llu messages, %llu timeouts", (unsigned long long)loop.waits,
+				(unsigned long long)loop.wakes, (unsigned long long)loop.messages, (unsigned long long)loop.timeouts);
+			ImGui::Text("Wake latency: %.1f us last, %.1f us mean, %.1f us max", loop.lastLatency, loop.meanLatency, loop.maxLatency);
+			SwapChainManager* swapChain = SingleInstance<SwapChainManager>::Get();
+			ImGui::Text("Swap chain: %dx%d, %llu resize events, %llu resizes, %llu minimized frames", swapChain->width, swapChain->height,
+				(unsigned long long)swapChain->statistics.events, (unsigned long long)swapChain->statistics.resizes,
+				(unsigned long long)swapChain->statistics.minimizedFrames);
+			ImGui::Text("Occluded: %llu times, %llu frames skipped%s", (unsigned long long)swapChain->statistics.occlusions,
+				(unsigned long long)swapChain->statistics.occludedFrames, swapChain->occluded ? " (now)" : "");
+			ImGui::Text("Resize cost: %.2f ms last, %.2f ms max, %.2f ms total", swapChain->statistics.lastResizeTime,
+				swapChain->statistics.maxResizeTime, swapChain->statistics.totalResizeTime);
+		}
+		ImGui::Separator();
+
+		static std::vector<Profiler::Item*> rows = {};
+		rows.clear();
+		for (Profiler::Item* item : profiler->GetItems())
+		{
+			if (item->category != Profiler::Category::Frame)
+				rows.push_back(item);
+		}
+
+		ImGuiTableFlags flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersOuter;
+		if (ImGui::BeginTable("Items", 6, flags))
+		{
+			ImGui::TableSetupScrollFreeze(0, 1);
+			ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableSetupColumn("Category");
+			ImGui::TableSetupColumn("Mean", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableSetupColumn("P95", ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableSetupColumn("Max", ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableSetupColumn("Share", ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableHeadersRow();
+
+			ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
+			if (sortSpecs != nullptr && sortSpecs->SpecsCount > 0)
+			{
+				const ImGuiTableColumnSortSpecs spec = sortSpecs->Specs[0];
+				auto less = [&spec](const Profiler::Item* a, const Profiler::Item* b) {
+					switch (spec.ColumnIndex)
+					{
+					case 0:
+						return a->name < b->name;
+					case 1:
+						return a->category < b->category;
+					case 3:
+						return a->p95 < b->p95;
+					case 4:
+						return a->max < b->max;
+					default:
+						// Mean and share sort the same way
+						return a->mean < b->mean;
+					}
+					};
+				std::sort(rows.begin(), rows.end(), [&spec, &less](const Profiler::Item* a, const Profiler::Item* b) {
+					return spec.SortDirection == ImGuiSortDirection_Ascending ? less(a, b) : less(b, a);
+					});
+			}
+
+			for (auto item : rows)
+			{
+				float share = frame->mean > 0.f ? item->mean / frame->mean : 0.f;
+				bool overBudget = (item->category == Profiler::Category::Window || item->category == Profiler::Category::Overlay) && share > profiler->budgetShare;
+				if (overBudget)
+					ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.3f, 0.3f, 1.0f));
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%s%s", overBudget ? "(!) " : "", item->name.c_str());
+				ImGui::TableNextColumn();
+				ImGui::Text("%s", Profiler::Item::CategoryToString(item->category));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", item->mean);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", item->p95);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", item->max);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f%%", share * 100.f);
+				if (overBudget)
+					ImGui::PopStyleColor();
+			}
+			ImGui::EndTable();
+		}
+	}
+	ImGui::End();
+}
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 
-RegisterWindow(LoggerView, true)
+RegisterWindowIn("Monitor", LoggerView, true)
 {
 	ImGui::SetNextWindowPos(ImVec2(ImGui::GetMainViewport()->WorkSize.x - 780.f, ImGui::GetMainViewport()->WorkSize.y - 280.f), ImGuiCond_FirstUseEver);
 	ImGui::SetNextWindowSize(ImVec2(730.f, 230.f), ImGuiCond_FirstUseEver);
@@ -1,5 +1,4 @@
 #pragma once
-#include <d3dcompiler.h>
 
 class ShaderPreviewManager
 {
@@ -8,14 +7,50 @@ public:
 	class Shader
 	{
 	public:
-		ID3D11PixelShader* shader = nullptr;
-		ID3D11SamplerState* sampler = nullptr;
+		// Where the time from an edit to the first frame drawing its result went, in milliseconds
+		class Latency
+		{
+		public:
+			float debounce = 0.f;
+			float queue = 0.f;
+			float compile = 0.f;
+			float apply = 0.f;
+			float total = 0.f;
+		};
+
+		RenderDevice::ShaderHandle shader = nullptr;
 		std::string id = "";
 		std::string source = "";
 		std::string name = "";
 		std::string target = "ps_4_0";
 		fs::path path = "";
 		std::vector<std::string> previewIds = {};
+		// Outcome of the last finished compile, the bound shader stays the last one that succeeded
+		AsyncShaderCompiler::State state = AsyncShaderCompiler::State::Ready;
+		std::shared_ptr<AsyncShaderCompiler::Job> pending = nullptr;
+		std::string lastError = "";
+		float compileTime = 0.f;
+		// Milliseconds the last Apply spent creating the device object
+		float createTime = 0.f;
+		// Static cost of the bound bytecode and its container checksum, hasAnalysis is false when it is not DXBC
+		bool hasAnalysis = false;
+		DxbcContainer::Statistics analysis = DxbcContainer::Statistics();
+		std::string checksum = "";
+		// Why the last compile was started, and the headers it pulled in
+		std::string compileReason = "";
+		std::vector<ShaderCompiler::Include> includes = {};
+		// Axes declared in the source, the variant that is bound, and every variant once built
+		ShaderPermutations permutations = ShaderPermutations();
+		ShaderPermutations::Key variant = 0;
+		std::shared_ptr<ShaderVariantSet> variants = nullptr;
+		// Lexer and parser state of the editor, kept between edits so only the changed region is re-lexed
+		std::shared_ptr<HlslFrontEnd> syntax = nullptr;
+		// Bumped whenever the source or a header changes, results compiled for an older version are never applied
+		uint64_t version = 0;
+		// Latest change not yet on screen, and the timer that compiles it once typing pauses
+		std::chrono::steady_clock::time_point editedAt = {};
+		size_t compileTimer = 0;
+		Latency latency = Latency();
 
 		Shader() : id(Random::GetString(10))
 		{}
@@ -33,78 +68,330 @@ public:
 			return shader != nullptr;
 		}
 
-		bool ComplieShader()
+		AsyncShaderCompiler::State GetState() const
+		{
+			return pending != nullptr ? pending->state.load() : state;
+		}
+
+		// Syntax diagnostics of the current source without compiling, cheap when nothing changed
+		void CheckSyntax()
+		{
+			if (syntax == nullptr)
+				syntax = std::make_shared<HlslFrontEnd>();
+			syntax->Update(source, name);
+		}
+
+		// The request without variant defines
+		ShaderCompiler::Request MakeRequest() const
+		{
+			ShaderCompiler::Request request;
+			request.source = source;
+			request.sourceName = name;
+			request.target = target;
+			request.resolver = SingleInstance<IncludeResolver>::Get();
+			if (!path.empty())
+				request.directory = FileWatcher::Normalize(path).parent_path().string();
+			return request;
+		}
+
+		std::function<void(AsyncShaderCompiler::Job&)> MakeCallback() const
+		{
+			const std::string shaderId = id;
+			// What the job was submitted for, the shader may have moved on when it completes
+			const std::string trigger = compileReason;
+			const ShaderPermutations::Key key = variant;
+			return [shaderId, trigger, key](AsyncShaderCompiler::Job& job) {
+				for (Shader& shader : SingleInstance<ShaderPreviewManager>::Get()->shaders)
+				{
+					if (shader.id == shaderId)
+					{
+						shader.OnCompiled(job, trigger, key);
+						break;
+					}
+				}
+				};
+		}
+
+		// Reads the axes from the source, keeps the selected values of axes that still exist
+		void UpdatePermutations()
+		{
+			ShaderPermutations parsed = ShaderPermutations::Parse(source);
+			ShaderPermutations::Key key = 0;
+			for (const auto& define : permutations.GetDefines(variant))
+				parsed.Select(key, define.first, define.second);
+			permutations = parsed;
+			variant = key;
+		}
+
+		// What was queued or compiling is for inputs that no longer exist
+		void Invalidate()
+		{
+			version++;
+			editedAt = std::chrono::steady_clock::now();
+			SingleInstance<ShaderPreviewManager>::Get()->compileQueue.Cancel(pending);
+			pending = nullptr;
+		}
+
+		// Called by the editor for every change, the compile starts once no edit came for the manager's
+		// debounceTime, with the previous timer pushed back on every keystroke
+		void OnEdited()
+		{
+			Invalidate();
+			ShaderPreviewManager* manager = SingleInstance<ShaderPreviewManager>::Get();
+			manager->editStatistics.edits++;
+			EventLoop* loop = SingleInstance<EventLoop>::Get();
+			if (compileTimer != 0)
+				loop->CancelTimer(compileTimer);
+			const std::string shaderId = id;
+			compileTimer = loop->AddTimer(std::chrono::milliseconds(manager->debounceTime), [shaderId]() {
+				Shader* shader = SingleInstance<ShaderPreviewManager>::Get()->FindShader(shaderId);
+				if (shader == nullptr)
+					return;
+				shader->compileTimer = 0;
+				shader->ComplieShader("Edited");
+				});
+		}
+
+		// Queues the compile of the selected variant on the thread pool, a newer request supersedes one still in flight
+		bool ComplieShader(const std::string& reason = "Manual")
 		{
 			if (source.size() <= 0)
 			{
 				FORMAT_LOG(Warning, "[%s](id:%s) Shader source is empty!", name.c_str(), id.c_str());
 				return false;
 			}
-			if (shader != nullptr)
+			if (compileTimer != 0)
 			{
-				shader->Release();
-				shader = nullptr;
+				SingleInstance<EventLoop>::Get()->CancelTimer(compileTimer);
+				compileTimer = 0;
 			}
-			if (sampler != nullptr)
+			SingleInstance<ShaderPreviewManager>::Get()->compileQueue.Cancel(pending);
+			UpdatePermutations();
+			// Built for the previous source or headers
+			variants = nullptr;
+			ShaderCompiler::Request request = MakeRequest();
+			request.defines = permutations.GetDefines(variant);
+			compileReason = reason;
+			pending = SingleInstance<ShaderPreviewManager>::Get()->compileQueue.Submit(request, MakeCallback());
+			if (pending == nullptr)
 			{
-				sampler->Release();
-				sampler = nullptr;
+				FORMAT_LOG(Warning, "[%s](id:%s) Failed to compile shader: No compiler backend", name.c_str(), id.c_str());
+				return false;
 			}
-			ID3DBlob* blob = nullptr;
-			ID3DBlob* error = nullptr;
-			HRESULT hr =
-				D3DCompile(source.c_str(), source.size(), nullptr, nullptr, nullptr, "main", target.c_str(), 0, 0, &blob, &error);
-			if (FAILED(hr))
-			{
-				if (error != nullptr)
-				{
-					FORMAT_LOG(Warning, "[%s](id:%s) Failed to compile shader: %s", name.c_str(), id.c_str(), (char*)error->GetBufferPointer());
-					error->Release();
-				}
-				else
-				{
-					FORMAT_LOG(Warning, "[%s](id:%s) Failed to compile shader: Unknown error (%x)", name.c_str(), id.c_str(), hr);
-				}
+			pending->version = version;
+			SingleInstance<ShaderPreviewManager>::Get()->editStatistics.compiles++;
+			return true;
+		}
+
+		// Compiles every variant in one job, afterwards switching variants needs no compile
+		bool BuildVariants()
+		{
+			if (source.size() <= 0)
 				return false;
+			UpdatePermutations();
+			compileReason = "Build all variants";
+			SingleInstance<ShaderPreviewManager>::Get()->compileQueue.Cancel(pending);
+			pending = SingleInstance<ShaderPreviewManager>::Get()->compileQueue.SubmitVariants(MakeRequest(),
+				std::make_shared<ShaderVariantSet>(permutations), variant, MakeCallback());
+			if (pending != nullptr)
+				pending->version = version;
+			return pending != nullptr;
+		}
+
+		void SelectVariant(ShaderPermutations::Key key)
+		{
+			variant = key;
+			const ShaderCompiler::Result* result = variants != nullptr ? variants->Find(key) : nullptr;
+			if (result == nullptr)
+			{
+				ComplieShader("Variant changed");
+				return;
 			}
-			hr = SingleInstance<Render>::Get()->device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &shader);
-			if (FAILED(hr))
+			// A table lookup, the device object is all that is left to create
+			SingleInstance<ShaderPreviewManager>::Get()->compileQueue.Cancel(pending);
+			pending = nullptr;
+			compileReason = "Variant selected from the built set";
+			SingleInstance<ShaderPreviewManager>::Get()->SetIncludes(*this, result->includes);
+			Apply(*result);
+			StoreInPack(*result);
+			RecordTelemetry(nullptr, *result, compileReason, variant, CompileTelemetry::Outcome::Applied);
+		}
+
+		// What the compile cost from the queue to the device object or to where it was dropped, job is nullptr for
+		// results taken from the built variants
+		void RecordTelemetry(const AsyncShaderCompiler::Job* job, const ShaderCompiler::Result& result, const std::string& trigger,
+			ShaderPermutations::Key key, CompileTelemetry::Outcome outcome) const
+		{
+			auto Milliseconds = [](auto duration) { return std::chrono::duration<float, std::milli>(duration).count(); };
+			const auto now = std::chrono::steady_clock::now();
+			const bool applied = outcome == CompileTelemetry::Outcome::Applied;
+			CompileTelemetry::Record record;
+			record.shaderId = id;
+			record.shader = name;
+			record.trigger = trigger;
+			record.target = job != nullptr ? job->request.target : target;
+			record.variant = key;
+			record.outcome = outcome;
+			record.preprocess = result.preprocessTime;
+			// A cached result carries the time of its original compile
+			record.compile = result.cached ? 0.f : result.compileTime;
+			if (job != nullptr && job->variants != nullptr)
 			{
-				FORMAT_LOG(Warning, "[%s](id:%s) Failed to create shader: %x", name.c_str(), id.c_str(), hr);
-				blob->Release();
-				return false;
+				record.preprocess = job->variants->statistics.preprocessTime;
+				record.compile = job->variants->statistics.compileTime;
 			}
-			blob->Release();
-			D3D11_SAMPLER_DESC samplerDesc = {};
-			samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-			samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-			samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-			samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-			samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-			samplerDesc.MinLOD = 0;
-			samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
-			hr = SingleInstance<Render>::Get()->device->CreateSamplerState(&samplerDesc, &sampler);
-			if (FAILED(hr))
-			{
-				FORMAT_LOG(Warning, "[%s](id:%s) Failed to create sampler: %x", name.c_str(), id.c_str(), hr);
-				return false;
+			record.create = applied ? createTime : 0.f;
+			record.bytecodeSize = result.bytecode.size();
+			record.cacheTier = result.cacheTier;
+			record.success = applied ? state == AsyncShaderCompiler::State::Ready : result.success;
+			if (job != nullptr)
+			{
+				// A job cancelled before it ran waited in the queue until it was drained
+				const bool ran = job->started != std::chrono::steady_clock::time_point();
+				record.queue = Milliseconds((ran ? job->started : now) - job->submitted);
+				record.total = Milliseconds(now - job->submitted);
+			}
+			else
+			{
+				record.total = createTime;
+			}
+			SingleInstance<CompileTelemetry>::Get()->Add(record, job != nullptr ? job->submitted : now);
+		}
+
+		// Runs on the main thread once the job is drained, device objects are only created here
+		void OnCompiled(AsyncShaderCompiler::Job& job, const std::string& trigger, ShaderPermutations::Key key)
+		{
+			if (job.state == AsyncShaderCompiler::State::Cancelled)
+			{
+				RecordTelemetry(&job, job.result, trigger, key, CompileTelemetry::Outcome::Cancelled);
+				return;
+			}
+			// Superseded by a later compile, or the source changed since it was submitted
+			if (pending.get() != &job || job.version != version)
+			{
+				RecordTelemetry(&job, job.result, trigger, key, CompileTelemetry::Outcome::Superseded);
+				return;
+			}
+			pending = nullptr;
+			if (job.variants != nullptr)
+			{
+				variants = job.variants;
+				const ShaderVariantSet::Statistics& built = variants->statistics;
+				FORMAT_LOG(Info, "[%s](id:%s) Built %llu variants, %llu unique (%llu cached), %llu failed in %.1f ms", name.c_str(), id.c_str(),
+					(unsigned long long)built.variants, (unsigned long long)built.unique, (unsigned long long)built.cached, (unsigned long long)built.failed,
+					built.preprocessTime + built.compileTime);
+			}
+			// Failed compiles still report what they opened, fixing a broken header has to trigger a recompile
+			SingleInstance<ShaderPreviewManager>::Get()->SetIncludes(*this, job.result.includes);
+			Apply(job.result);
+			StoreInPack(job.result);
+			RecordTelemetry(&job, job.result, trigger, key, CompileTelemetry::Outcome::Applied);
+			if (state == AsyncShaderCompiler::State::Ready && editedAt != std::chrono::steady_clock::time_point())
+			{
+				// Applied while building a frame, that frame is the first to draw it
+				const auto now = std::chrono::steady_clock::now();
+				auto Milliseconds = [](auto duration) { return std::chrono::duration<float, std::milli>(duration).count(); };
+				latency.debounce = Milliseconds(job.submitted - editedAt);
+				latency.queue = Milliseconds(job.started - job.submitted);
+				latency.compile = Milliseconds(job.finished - job.started);
+				latency.apply = Milliseconds(now - job.finished);
+				latency.total = Milliseconds(now - editedAt);
+				SingleInstance<ShaderPreviewManager>::Get()->editStatistics.Add(latency.total);
+			}
+			editedAt = {};
+		}
+
+		// Creates the device object of a finished compile and binds it in place of the previous one
+		void Apply(const ShaderCompiler::Result& result)
+		{
+			compileTime = result.compileTime;
+			createTime = 0.f;
+			if (!result.success)
+			{
+				state = AsyncShaderCompiler::State::Failed;
+				lastError = result.log;
+				FORMAT_LOG(Warning, "[%s](id:%s) Failed to compile shader: %s", name.c_str(), id.c_str(), result.log.c_str());
+				return;
+			}
+			std::string message = "";
+			const auto start = std::chrono::steady_clock::now();
+			RenderDevice::ShaderHandle created = CreateShader(result.bytecode.data(), result.bytecode.size(), message);
+			createTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (created == nullptr)
+			{
+				state = AsyncShaderCompiler::State::Failed;
+				lastError = message;
+				FORMAT_LOG(Warning, "[%s](id:%s) %s", name.c_str(), id.c_str(), message.c_str());
+				return;
+			}
+			// Swap only now, previews kept drawing with the previous shader during the compile
+			if (shader != nullptr)
+				SingleInstance<ShaderPreviewManager>::Get()->ReleaseShader(shader);
+			shader = created;
+			state = AsyncShaderCompiler::State::Ready;
+			lastError = "";
+			if (result.cached)
+			{
+				FORMAT_LOG(Info, "[%s](id:%s) Shader loaded from cache, saved %.2f ms and %u bytes of compiling!", name.c_str(), id.c_str(), result.compileTime, (unsigned)result.bytecode.size());
 			}
-			FORMAT_LOG(Info, "[%s](id:%s) Shader compiled successfully!", name.c_str(), id.c_str());
+			else
+			{
+				FORMAT_LOG(Info, "[%s](id:%s) Shader compiled successfully in %.2f ms!", name.c_str(), id.c_str(), result.compileTime);
+			}
+		}
+
+		// Analyzes the bytecode and gets its device object, shared with every other shader whose bytecode has the
+		// same checksum
+		RenderDevice::ShaderHandle CreateShader(const uint8_t* data, size_t size, std::string& message)
+		{
+			DxbcContainer container;
+			std::string error = "";
+			const bool parsed = container.Parse(data, size, error);
+			RenderDevice::ShaderHandle created = SingleInstance<ShaderPreviewManager>::Get()->AcquireShader(data, size, container, message);
+			if (created == nullptr)
+				return nullptr;
+			hasAnalysis = parsed && container.hasProgram;
+			analysis = container.statistics;
+			checksum = container.checksumValid ? DxbcContainer::ToHex(container.checksum) : "";
+			return created;
+		}
+
+		// Kept for LoadFromPack in the next session, nothing is written when the pack already has it
+		void StoreInPack(const ShaderCompiler::Result& result) const
+		{
+			if (result.success && SingleInstance<ShaderPreviewManager>::Get()->packEnabled)
+				SingleInstance<ShaderPack>::Get()->Store(ShaderPack::MakeKey(MakeRequest()), variant, result.bytecode);
+		}
+
+		// Binds what an earlier session stored for this source and variant without compiling, the device object is
+		// created from the mapped file. A compile should follow, headers may have changed since.
+		bool LoadFromPack()
+		{
+			UpdatePermutations();
+			RenderDevice::ShaderHandle created = nullptr;
+			std::string message = "";
+			SingleInstance<ShaderPack>::Get()->Read(ShaderPack::MakeKey(MakeRequest()), variant, [&](const uint8_t* data, size_t size) {
+				created = CreateShader(data, size, message);
+				});
+			if (created == nullptr)
+				return false;
+			if (shader != nullptr)
+				SingleInstance<ShaderPreviewManager>::Get()->ReleaseShader(shader);
+			shader = created;
+			state = AsyncShaderCompiler::State::Ready;
+			lastError = "";
+			compileReason = "Loaded from the shader pack";
 			return true;
 		}
 
 		// Process texture
-		ID3D11ShaderResourceView* ProcessTexture(ID3D11ShaderResourceView* texture)
+		ImTextureID ProcessTexture(ImTextureID texture)
 		{
 			if (shader == nullptr || texture == nullptr)
 				return nullptr;
 
-			// Apply shader
-			SingleInstance<Render>::Get()->context->PSSetShader(shader, nullptr, 0);
-
-			// Set texture and sampler
-			SingleInstance<Render>::Get()->context->PSSetShaderResources(0, 1, &texture);
-			SingleInstance<Render>::Get()->context->PSSetSamplers(0, 1, &sampler);
+			// Apply shader with the texture and sampler
+			SingleInstance<Render>::Get()->device->BindPixelShader(shader, texture);
 
 			return texture;
 		}
@@ -126,14 +413,16 @@ public:
 			}
 			if (shader != nullptr)
 			{
-				shader->Release();
+				manager->ReleaseShader(shader);
 				shader = nullptr;
 			}
-			if (sampler != nullptr)
-			{
-				sampler->Release();
-				sampler = nullptr;
-			}
+			if (compileTimer != 0)
+				SingleInstance<EventLoop>::Get()->CancelTimer(compileTimer);
+			compileTimer = 0;
+			manager->compileQueue.Cancel(pending);
+			pending = nullptr;
+			SingleInstance<FileWatchService>::Get()->Unwatch(path);
+			SingleInstance<ShaderPreviewManager>::Get()->SetIncludes(*this, {});
 		}
 
 		bool operator==(const Shader& shader) const
@@ -150,7 +439,7 @@ public:
 			Fit,
 			Tile
 		};
-		ID3D11ShaderResourceView* texture = nullptr;
+		ImTextureID texture = nullptr;
 		std::string shaderId = "";
 		std::string id = "";
 		std::string name = "";
@@ -159,6 +448,9 @@ public:
 		int height = 0;
 		bool opened = true;
 		DisplayMode displayMode = DisplayMode::Fit;
+		// Last result of RenderOnCpu
+		ImTextureID cpuTexture = nullptr;
+		float cpuRenderTime = 0.f;
 
 		Preview() : id(Random::GetString(10))
 		{}
@@ -190,51 +482,14 @@ public:
 				FORMAT_LOG(Warning, "[%s](id:%s) Failed to load image", name.c_str(), id.c_str());
 				return false;
 			}
-			D3D11_TEXTURE2D_DESC desc;
-			ZeroMemory(&desc, sizeof(desc));
-			desc.Width = width;
-			desc.Height = height;
-			desc.MipLevels = 1;
-			desc.ArraySize = 1;
-			desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-			desc.SampleDesc.Count = 1;
-			desc.Usage = D3D11_USAGE_DEFAULT;
-			desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-			desc.CPUAccessFlags = 0;
-
-			ID3D11Texture2D* texture2d = NULL;
-			D3D11_SUBRESOURCE_DATA subResource;
-			subResource.pSysMem = data;
-			subResource.SysMemPitch = desc.Width * 4;
-			subResource.SysMemSlicePitch = 0;
-			HRESULT hr = SingleInstance<Render>::Get()->device->CreateTexture2D(&desc, &subResource, &texture2d);
-			if (FAILED(hr))
-			{
-				FORMAT_LOG(Warning, "[%s](id:%s) Failed to create texture: %x", name.c_str(), id.c_str(), hr);
-				stbi_image_free(data);
-				return false;
-			}
-
-			// Create shader resource view
-			D3D11_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc;
-			ZeroMemory(&shaderResourceViewDesc, sizeof(shaderResourceViewDesc));
-			shaderResourceViewDesc.Format = desc.Format;
-			shaderResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-			shaderResourceViewDesc.Texture2D.MipLevels = desc.MipLevels;
-			shaderResourceViewDesc.Texture2D.MostDetailedMip = 0;
-			hr = SingleInstance<Render>::Get()->device->CreateShaderResourceView(texture2d, &shaderResourceViewDesc, &texture);
-			if (FAILED(hr))
+			std::string error = "";
+			texture = SingleInstance<Render>::Get()->device->CreateTexture(data, width, height, error);
+			stbi_image_free(data);
+			if (texture == nullptr)
 			{
-				FORMAT_LOG(Warning, "[%s](id:%s) Failed to create shader resource view: %x", name.c_str(), id.c_str(), hr);
-				texture2d->Release();
-				stbi_image_free(data);
+				FORMAT_LOG(Warning, "[%s](id:%s) %s", name.c_str(), id.c_str(), error.c_str());
 				return false;
 			}
-
-			// Release texture
-			texture2d->Release();
-
-			stbi_image_free(data);
 			return texture != nullptr;
 		}
 
@@ -242,9 +497,72 @@ public:
 		{
 			if (texture != nullptr)
 			{
-				texture->Release();
+				SingleInstance<Render>::Get()->device->ReleaseTexture(texture);
 				texture = nullptr;
 			}
+			if (cpuTexture != nullptr)
+			{
+				SingleInstance<Render>::Get()->device->ReleaseTexture(cpuTexture);
+				cpuTexture = nullptr;
+			}
+		}
+
+		// Shades the image with the applied shader and its selected variant on the CPU, as the preview window
+		// draws it: white vertex color and uv across the image once
+		bool RenderOnCpu(std::vector<unsigned char>& rgba, int& imageWidth, int& imageHeight, std::string& error)
+		{
+			const Shader shader = SingleInstance<ShaderPreviewManager>::Get()->GetShader(shaderId);
+			if (!shader.IsSource())
+			{
+				error = "No shader applied";
+				return false;
+			}
+			unsigned char* data = stbi_load(path.string().c_str(), &imageWidth, &imageHeight, NULL, 4);
+			if (data == NULL)
+			{
+				error = "Failed to load image";
+				return false;
+			}
+			ShaderCompiler::Request request = shader.MakeRequest();
+			request.defines = shader.permutations.GetDefines(shader.variant);
+			ShaderInterpreter<> interpreter;
+			bool result = interpreter.Compile(request, error);
+			if (result)
+			{
+				ShaderInterpreter<>::Texture image;
+				image.rgba = data;
+				image.width = imageWidth;
+				image.height = imageHeight;
+				const float white[4] = { 1.f, 1.f, 1.f, 1.f };
+				rgba.resize((size_t)imageWidth * imageHeight * 4);
+				result = interpreter.Render(SingleInstance<ThreadPool>::Get(), { image }, rgba.data(), imageWidth, imageHeight, white, error);
+				cpuRenderTime = interpreter.statistics.renderTime;
+			}
+			stbi_image_free(data);
+			return result;
+		}
+
+		// Renders on the CPU and uploads the result for showing next to the GPU preview
+		bool RenderOnCpu()
+		{
+			std::vector<unsigned char> rgba;
+			int imageWidth = 0, imageHeight = 0;
+			std::string error = "";
+			if (!RenderOnCpu(rgba, imageWidth, imageHeight, error))
+			{
+				FORMAT_LOG(Warning, "[%s](id:%s) CPU render failed: %s", name.c_str(), id.c_str(), error.c_str());
+				return false;
+			}
+			if (cpuTexture != nullptr)
+				SingleInstance<Render>::Get()->device->ReleaseTexture(cpuTexture);
+			cpuTexture = SingleInstance<Render>::Get()->device->CreateTexture(rgba.data(), imageWidth, imageHeight, error);
+			if (cpuTexture == nullptr)
+			{
+				FORMAT_LOG(Warning, "[%s](id:%s) %s", name.c_str(), id.c_str(), error.c_str());
+				return false;
+			}
+			FORMAT_LOG(Info, "[%s](id:%s) Rendered %dx%d on the CPU in %.1f ms", name.c_str(), id.c_str(), imageWidth, imageHeight, cpuRenderTime);
+			return true;
 		}
 
 		bool operator==(const Preview& view) const
@@ -253,9 +571,62 @@ public:
 		}
 	};
 
+	// Edits made in the source editor and what became of them
+	class EditStatistics
+	{
+	public:
+		uint64_t edits = 0;
+		uint64_t compiles = 0;
+		// Versions that reached the screen, and the time from their edit until then in milliseconds
+		uint64_t applied = 0;
+		float lastLatency = 0.f;
+		float meanLatency = 0.f;
+		float maxLatency = 0.f;
+
+		void Add(float latency)
+		{
+			applied++;
+			lastLatency = latency;
+			meanLatency += (latency - meanLatency) / applied;
+			maxLatency = std::max(maxLatency, latency);
+		}
+	};
+
+	// What RestoreSession brought back
+	class SessionStatistics
+	{
+	public:
+		uint64_t shaders = 0;
+		uint64_t previews = 0;
+		// Shaders bound from the pack before their compile was even queued
+		uint64_t packed = 0;
+		float restoreTime = 0.f;
+	};
+
 	std::vector<Preview> previews = {};
 	std::vector<Shader> shaders = {};
 	Preview background = Preview();
+	ShaderCompiler* compiler = nullptr;
+	AsyncShaderCompiler compileQueue = AsyncShaderCompiler();
+	// Milliseconds without an edit before the editor's source is compiled
+	int debounceTime = 150;
+	EditStatistics editStatistics = EditStatistics();
+	// Where the session and the shader pack are kept between runs, empty keeps neither
+	fs::path sessionDirectory = "";
+	bool packEnabled = true;
+	SessionStatistics sessionStatistics = SessionStatistics();
+	// One device object per bytecode checksum, shared by the shaders that compiled to the same blob
+	class SharedShader
+	{
+	public:
+		RenderDevice::ShaderHandle shader = nullptr;
+		uint32_t references = 0;
+	};
+	std::unordered_map<std::string, SharedShader> sharedShaders = {};
+	// Device objects reused instead of created
+	uint64_t sharedHits = 0;
+	// Header path -> ids of the shaders that include it directly or through other headers
+	std::unordered_map<std::string, std::unordered_set<std::string>> dependents = {};
 
 	void AddPreview(Preview view)
 	{
@@ -272,13 +643,534 @@ public:
 		return Shader();
 	}
 
+	// Only valid until shaders changes
+	Shader* FindShader(const std::string& id)
+	{
+		for (auto& shader : shaders)
+		{
+			if (shader.id == id)
+				return &shader;
+		}
+		return nullptr;
+	}
+
+	// Containers without a valid checksum always get their own device object
+	RenderDevice::ShaderHandle AcquireShader(const uint8_t* data, size_t size, const DxbcContainer& container, std::string& error)
+	{
+		RenderDevice* device = SingleInstance<Render>::Get()->device;
+		if (!container.checksumValid)
+			return device->CreatePixelShader(data, size, error);
+		const std::string key = DxbcContainer::ToHex(container.checksum);
+		auto it = sharedShaders.find(key);
+		if (it != sharedShaders.end())
+		{
+			it->second.references++;
+			sharedHits++;
+			return it->second.shader;
+		}
+		RenderDevice::ShaderHandle created = device->CreatePixelShader(data, size, error);
+		if (created != nullptr)
+		{
+			SharedShader& shared = sharedShaders[key];
+			shared.shader = created;
+			shared.references = 1;
+		}
+		return created;
+	}
+
+	void ReleaseShader(RenderDevice::ShaderHandle shader)
+	{
+		for (auto it = sharedShaders.begin(); it != sharedShaders.end(); ++it)
+		{
+			if (it->second.shader != shader)
+				continue;
+			if (--it->second.references > 0)
+				return;
+			sharedShaders.erase(it);
+			break;
+		}
+		SingleInstance<Render>::Get()->device->ReleasePixelShader(shader);
+	}
+
 	void SetBackground(Preview view)
 	{
 		background = view;
 	}
+
+	// Tabs, newlines and backslashes escaped, so a field never spans the separators of the session file
+	static std::string EscapeField(const std::string& text)
+	{
+		std::string escaped = "";
+		for (char c : text)
+		{
+			if (c == '\\')
+				escaped += "\\\\";
+			else if (c == '\t')
+				escaped += "\\t";
+			else if (c == '\n')
+				escaped += "\\n";
+			else if (c == '\r')
+				escaped += "\\r";
+			else
+				escaped += c;
+		}
+		return escaped;
+	}
+
+	static std::vector<std::string> SplitFields(const std::string& line)
+	{
+		std::vector<std::string> fields = { "" };
+		for (size_t i = 0; i < line.size(); i++)
+		{
+			if (line[i] == '\t')
+				fields.push_back("");
+			else if (line[i] != '\\' || i + 1 >= line.size())
+				fields.back() += line[i];
+			else
+			{
+				const char c = line[++i];
+				fields.back() += c == 't' ? '\t' : c == 'n' ? '\n' : c == 'r' ? '\r' : c;
+			}
+		}
+		return fields;
+	}
+
+	// One line per shader and preview. Sources are kept as they are in the editor, saved to their file or not.
+	bool SaveSession(std::string& error) const
+	{
+		if (sessionDirectory.empty())
+		{
+			error = "No session directory";
+			return false;
+		}
+		std::error_code failure;
+		fs::create_directories(sessionDirectory, failure);
+		const fs::path temporary = sessionDirectory / "session.txt.tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file << "NaShaderCompiler session 1\n";
+			for (const Shader& shader : shaders)
+			{
+				file << "shader\t" << EscapeField(shader.id) << "\t" << EscapeField(shader.name) << "\t" << EscapeField(shader.target) << "\t"
+					<< EscapeField(shader.path.string()) << "\t" << shader.variant << "\t" << (shader.IsComplied() ? 1 : 0) << "\t"
+					<< EscapeField(shader.source) << "\n";
+			}
+			for (const Preview& preview : previews)
+			{
+				file << "preview\t" << EscapeField(preview.id) << "\t" << EscapeField(preview.name) << "\t" << EscapeField(preview.path.string()) << "\t"
+					<< EscapeField(preview.shaderId) << "\t" << (int)preview.displayMode << "\t" << (preview.opened ? 1 : 0) << "\n";
+			}
+			file << "background\t" << EscapeField(background.path.string()) << "\t" << EscapeField(background.shaderId) << "\n";
+			if (!file.good())
+			{
+				error = "Cannot write " + temporary.string();
+				return false;
+			}
+		}
+		fs::rename(temporary, sessionDirectory / "session.txt", failure);
+		if (failure)
+		{
+			error = "Cannot replace " + (sessionDirectory / "session.txt").string();
+			return false;
+		}
+		return true;
+	}
+
+	// Shaders that were compiled when the session was saved show up bound to the bytecode the pack kept for them,
+	// then compile again in the background
+	bool RestoreSession(std::string& error)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		std::ifstream file(sessionDirectory / "session.txt", std::ios::binary);
+		if (sessionDirectory.empty() || !file)
+		{
+			error = "No session saved";
+			return false;
+		}
+		std::string line = "";
+		if (!std::getline(file, line) || line != "NaShaderCompiler session 1")
+		{
+			error = "Unknown session format";
+			return false;
+		}
+		std::vector<std::string> compiled = {};
+		while (std::getline(file, line))
+		{
+			const std::vector<std::string> fields = SplitFields(line);
+			if (fields[0] == "shader" && fields.size() == 8)
+			{
+				Shader shader(fields[7], fields[2], fields[4]);
+				shader.id = fields[1];
+				shader.target = fields[3];
+				shader.permutations = ShaderPermutations::Parse(shader.source);
+				shader.variant = strtoull(fields[5].c_str(), nullptr, 10);
+				if (shader.variant >= shader.permutations.GetVariantCount())
+					shader.variant = 0;
+				if (!shader.path.empty())
+					SingleInstance<FileWatchService>::Get()->Watch(shader.path, shader.source);
+				if (fields[6] == "1")
+					compiled.push_back(shader.id);
+				shaders.push_back(shader);
+				sessionStatistics.shaders++;
+			}
+			else if (fields[0] == "preview" && fields.size() == 7)
+			{
+				Preview preview;
+				preview.id = fields[1];
+				preview.name = fields[2];
+				preview.path = fields[3];
+				preview.displayMode = (Preview::DisplayMode)atoi(fields[5].c_str());
+				preview.opened = fields[6] == "1";
+				if (!preview.path.empty())
+					preview.LoadImage();
+				previews.push_back(preview);
+				if (!fields[4].empty())
+					previews.back().ApplyShader(fields[4]);
+				sessionStatistics.previews++;
+			}
+			else if (fields[0] == "background" && fields.size() == 3)
+			{
+				background.path = fields[1];
+				if (!background.path.empty())
+					background.LoadImage();
+				if (!fields[2].empty())
+					background.ApplyShader(fields[2]);
+			}
+		}
+		for (const std::string& id : compiled)
+		{
+			Shader* shader = FindShader(id);
+			if (shader == nullptr)
+				continue;
+			if (packEnabled && shader->LoadFromPack())
+				sessionStatistics.packed++;
+			shader->ComplieShader("Session restored");
+		}
+		sessionStatistics.restoreTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		FORMAT_LOG(Info, "Restored %llu shaders (%llu from the shader pack) and %llu previews in %.1f ms", (unsigned long long)sessionStatistics.shaders,
+			(unsigned long long)sessionStatistics.packed, (unsigned long long)sessionStatistics.previews, sessionStatistics.restoreTime);
+		return true;
+	}
+
+	// Hands finished compiles to their shaders, call on the main thread
+	void Update()
+	{
+		compileQueue.Drain();
+	}
+
+	// Replaces the headers recorded for shader, headers are watched while any shader depends on them
+	void SetIncludes(Shader& shader, const std::vector<ShaderCompiler::Include>& includes)
+	{
+		std::unordered_set<std::string> previous = {}, current = {};
+		for (const ShaderCompiler::Include& include : shader.includes)
+			previous.insert(include.path);
+		for (const ShaderCompiler::Include& include : includes)
+			current.insert(include.path);
+		shader.includes = includes;
+		for (const std::string& path : previous)
+		{
+			if (current.count(path) > 0)
+				continue;
+			auto it = dependents.find(path);
+			if (it == dependents.end())
+				continue;
+			it->second.erase(shader.id);
+			if (it->second.empty())
+			{
+				dependents.erase(it);
+				SingleInstance<FileWatchService>::Get()->Unwatch(path);
+				// Nobody sees edits to it any more, the next include reads it again
+				SingleInstance<IncludeResolver>::Get()->Invalidate(path);
+			}
+		}
+		for (const std::string& path : current)
+		{
+			std::unordered_set<std::string>& ids = dependents[path];
+			if (ids.empty())
+			{
+				// Seeded with what the compile saw, so an edit made meanwhile still counts as a change
+				IncludeResolver::Content content = SingleInstance<IncludeResolver>::Get()->Find(path);
+				std::string text = "";
+				if (content != nullptr)
+					text = *content;
+				else
+					FileWatchService::ReadFile(path, text);
+				SingleInstance<FileWatchService>::Get()->Watch(path, text);
+			}
+			ids.insert(shader.id);
+		}
+	}
+
+	// A watched file was saved with new content, recompile the shaders loaded from it and the ones including it
+	void OnFileChanged(const fs::path& path, const std::string& content)
+	{
+		const std::string name = path.string();
+		SingleInstance<IncludeResolver>::Get()->Update(name, content);
+		std::unordered_set<std::string> recompiled = {};
+		for (Shader& shader : shaders)
+		{
+			if (shader.path.empty() || FileWatcher::Normalize(shader.path) != path || shader.source == content)
+				continue;
+			shader.source = content;
+			shader.Invalidate();
+			FORMAT_LOG(Info, "[%s](id:%s) Source changed on disk, recompiling", shader.name.c_str(), shader.id.c_str());
+			shader.ComplieShader("Source changed on disk");
+			recompiled.insert(shader.id);
+		}
+		auto it = dependents.find(name);
+		if (it == dependents.end())
+			return;
+		const std::string reason = "Include changed: " + path.filename().string();
+		for (Shader& shader : shaders)
+		{
+			if (it->second.count(shader.id) == 0 || recompiled.count(shader.id) > 0)
+				continue;
+			FORMAT_LOG(Info, "[%s](id:%s) %s, recompiling", shader.name.c_str(), shader.id.c_str(), reason.c_str());
+			shader.Invalidate();
+			shader.ComplieShader(reason);
+		}
+	}
+
+	// Reload button, handled like a save reported by the watcher so the shader, the ones sharing its file
+	// and the ones including it are invalidated and recompiled if the content differs
+	bool ReloadShader(Shader& shader)
+	{
+		std::string content = "";
+		if (!SingleInstance<FileWatchService>::Get()->Reload(shader.path, content))
+			return false;
+		OnFileChanged(FileWatcher::Normalize(shader.path), content);
+		return true;
+	}
 };
 
-RegisterWindow(ShaderManager, true)
+// Include graph of one shader as a tree, every node lists the files it includes
+static void ShowIncludes(const std::vector<ShaderCompiler::Include>& includes, const std::string& parent, int depth)
+{
+	for (const ShaderCompiler::Include& include : includes)
+	{
+		if (include.parent != parent)
+			continue;
+		const std::string name = fs::path(include.path).filename().string();
+		bool leaf = depth >= 32;
+		if (!leaf)
+		{
+			leaf = true;
+			for (const ShaderCompiler::Include& child : includes)
+			{
+				if (child.parent == include.path)
+				{
+					leaf = false;
+					break;
+				}
+			}
+		}
+		ImGui::PushID(include.path.c_str());
+		if (leaf)
+		{
+			ImGui::BulletText("%s", name.c_str());
+		}
+		else if (ImGui::TreeNode("##include", "%s", name.c_str()))
+		{
+			ShowIncludes(includes, include.path, depth + 1);
+			ImGui::TreePop();
+		}
+		if (ImGui::IsItemHovered())
+		{
+			ImGui::SetTooltip("%s", include.path.c_str());
+		}
+		ImGui::PopID();
+	}
+}
+
+// Compile records of every shader: counts per cache tier, a histogram over all of them, a sparkline per shader
+// and the latest compiles
+static void ShowCompileTelemetry()
+{
+	ShaderPreviewManager* manager = SingleInstance<ShaderPreviewManager>::Get();
+	CompileTelemetry* telemetry = SingleInstance<CompileTelemetry>::Get();
+	const std::deque<CompileTelemetry::Record>& records = telemetry->GetRecords();
+	static int metric = 0;
+	static const char* metrics[] = { "Total", "Queue", "Preprocess", "Compile", "Create" };
+	auto Value = [](const CompileTelemetry::Record& record) {
+		switch (metric)
+		{
+		case 1:
+			return record.queue;
+		case 2:
+			return record.preprocess;
+		case 3:
+			return record.compile;
+		case 4:
+			return record.create;
+		default:
+			return record.total;
+		}
+		};
+
+	uint64_t tiers[4] = {}, failed = 0, bytes = 0, superseded = 0, cancelled = 0;
+	std::vector<float> values = {};
+	std::unordered_map<std::string, std::vector<const CompileTelemetry::Record*>> byShader = {};
+	for (const CompileTelemetry::Record& record : records)
+	{
+		// Dropped compiles are counted, their times would skew the applied ones
+		if (record.outcome != CompileTelemetry::Outcome::Applied)
+		{
+			(record.outcome == CompileTelemetry::Outcome::Superseded ? superseded : cancelled)++;
+			continue;
+		}
+		tiers[(int)record.cacheTier]++;
+		failed += record.success ? 0 : 1;
+		bytes += record.bytecodeSize;
+		values.push_back(Value(record));
+		byShader[record.shaderId].push_back(&record);
+	}
+	ImGui::AlignTextToFramePadding();
+	ImGui::Text("%u compiles: %llu compiled, %llu memory, %llu disk and %llu remote hits, %llu failed, %.1f KB of bytecode, %llu superseded, %llu cancelled",
+		(unsigned)records.size(), (unsigned long long)tiers[0], (unsigned long long)tiers[1], (unsigned long long)tiers[2], (unsigned long long)tiers[3],
+		(unsigned long long)failed, bytes / 1024.0, (unsigned long long)superseded, (unsigned long long)cancelled);
+	ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+	ImGui::Combo("Metric", &metric, metrics, IM_ARRAYSIZE(metrics));
+	for (const char* format : { "csv", "json" })
+	{
+		ImGui::SameLine();
+		if (ImGui::Button((std::string("Export ") + format).c_str()))
+		{
+			TIME("%d-%m-%Y %H-%M-%S");
+			fs::path path = fs::current_path() / "telemetry";
+			std::error_code error;
+			fs::create_directories(path, error);
+			path /= bufferString + "." + format;
+			if (telemetry->Export(path.string()))
+			{
+				FORMAT_LOG(Info, "Compile telemetry exported to %s", path.string().c_str());
+			}
+			else
+			{
+				FORMAT_LOG(Warning, "Failed to export compile telemetry to %s", path.string().c_str());
+			}
+		}
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Clear"))
+		telemetry->Clear();
+	if (values.empty())
+	{
+		ImGui::TextDisabled("No compiles yet");
+		return;
+	}
+
+	std::vector<float> sorted = values;
+	std::sort(sorted.begin(), sorted.end());
+	float sum = 0.f;
+	for (float value : sorted)
+		sum += value;
+	ImGui::Text("%s: mean %.2f ms, median %.2f ms, p95 %.2f ms, max %.2f ms", metrics[metric], sum / sorted.size(), sorted[sorted.size() / 2],
+		sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)], sorted.back());
+	// Buckets double in width from 1/8 ms, the last one also takes everything beyond
+	constexpr int BucketCount = 16;
+	constexpr float FirstBucket = 0.125f;
+	float buckets[BucketCount] = {};
+	for (float value : values)
+		buckets[value <= FirstBucket ? 0 : std::min(BucketCount - 1, (int)std::ceil(std::log2(value / FirstBucket)))]++;
+	ImGui::PlotHistogram("##histogram", buckets, BucketCount, 0, nullptr, 0.f, FLT_MAX, ImVec2(-FLT_MIN, ImGui::GetTextLineHeight() * 5));
+	if (ImGui::IsItemHovered())
+	{
+		const float x = (ImGui::GetIO().MousePos.x - ImGui::GetItemRectMin().x) / ImGui::GetItemRectSize().x;
+		const int bucket = std::clamp((int)(x * BucketCount), 0, BucketCount - 1);
+		ImGui::SetTooltip("%.3f - %.3f ms: %.0f compiles", bucket == 0 ? 0.f : FirstBucket * (1 << (bucket - 1)), FirstBucket * (1 << bucket), buckets[bucket]);
+	}
+
+	ImGuiTableFlags flags = ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter;
+	if (ImGui::BeginTable("Shaders", 6, flags))
+	{
+		ImGui::TableSetupColumn("Shader");
+		ImGui::TableSetupColumn("Compiles");
+		ImGui::TableSetupColumn("Last");
+		ImGui::TableSetupColumn("Mean (ms)");
+		ImGui::TableSetupColumn("Max (ms)");
+		ImGui::TableSetupColumn("History", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableHeadersRow();
+		for (const auto& shader : manager->shaders)
+		{
+			auto it = byShader.find(shader.id);
+			if (it == byShader.end())
+				continue;
+			const std::vector<const CompileTelemetry::Record*>& history = it->second;
+			std::vector<float> line = {};
+			float total = 0.f, maximum = 0.f;
+			for (const CompileTelemetry::Record* record : history)
+			{
+				total += Value(*record);
+				maximum = std::max(maximum, Value(*record));
+			}
+			// The latest 64, older ones flatten the line
+			for (size_t i = history.size() > 64 ? history.size() - 64 : 0; i < history.size(); i++)
+				line.push_back(Value(*history[i]));
+			const CompileTelemetry::Record& last = *history.back();
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(shader.name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%u", (unsigned)history.size());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f ms, %s", Value(last), CompileTelemetry::GetTierName(last.cacheTier));
+			if (ImGui::IsItemHovered())
+				ImGui::SetTooltip("%s", last.trigger.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", total / history.size());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", maximum);
+			ImGui::TableNextColumn();
+			ImGui::PushID(shader.id.c_str());
+			ImGui::PlotLines("##history", line.data(), (int)line.size(), 0, nullptr, 0.f, FLT_MAX, ImVec2(-FLT_MIN, ImGui::GetTextLineHeight()));
+			ImGui::PopID();
+		}
+		ImGui::EndTable();
+	}
+
+	flags |= ImGuiTableFlags_ScrollY;
+	if (ImGui::BeginTable("Compiles", 10, flags, ImVec2(0.f, ImGui::GetTextLineHeightWithSpacing() * 12)))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		for (const char* column : { "#", "Shader", "Trigger", "Tier", "Queue", "Preprocess", "Compile", "Create", "Total", "Bytes" })
+			ImGui::TableSetupColumn(column);
+		ImGui::TableHeadersRow();
+		ImGuiListClipper clipper;
+		clipper.Begin((int)records.size());
+		while (clipper.Step())
+		{
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+			{
+				// Newest first
+				const CompileTelemetry::Record& record = records[records.size() - 1 - row];
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", (unsigned long long)record.sequence);
+				ImGui::TableNextColumn();
+				if (record.outcome != CompileTelemetry::Outcome::Applied)
+					ImGui::TextDisabled("%s (%s)", record.shader.c_str(), CompileTelemetry::GetOutcomeName(record.outcome));
+				else if (record.success)
+					ImGui::TextUnformatted(record.shader.c_str());
+				else
+					ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "%s (failed)", record.shader.c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(record.trigger.c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(CompileTelemetry::GetTierName(record.cacheTier));
+				for (float value : { record.queue, record.preprocess, record.compile, record.create, record.total })
+				{
+					ImGui::TableNextColumn();
+					ImGui::Text("%.2f", value);
+				}
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", (unsigned long long)record.bytecodeSize);
+			}
+		}
+		ImGui::EndTable();
+	}
+}
+
+RegisterWindowIn("Shader", ShaderManager, true)
 {
 	ShaderPreviewManager* manager = SingleInstance<ShaderPreviewManager>::Get();
 	static std::string destoryShaderId = "";
@@ -318,27 +1210,16 @@ RegisterWindow(ShaderManager, true)
 
 				if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
 				{
-					OPENFILENAMEA ofn;
-					CHAR szFile[MAX_PATH] = { 0 };
-					ZeroMemory(&ofn, sizeof(ofn));
-					ofn.lStructSize = sizeof(ofn);
-					ofn.hwndOwner = SingleInstance<Application>::Get()->GetMainWindow().handl;
-					ofn.lpstrFilter = "Shader Files (*.hlsl)\0*.hlsl\0All Files (*.*)\0*.*\0";
-					ofn.lpstrFile = szFile;
-					ofn.nMaxFile = MAX_PATH;
-					ofn.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST | OFN_HIDEREADONLY;
-					ofn.lpstrDefExt = "hlsl";
-					if (GetOpenFileNameA(&ofn))
+					std::string selected = SingleInstance<Application>::Get()->GetMainWindow().platform->OpenFileDialog("Shader Files (*.hlsl)\0*.hlsl\0All Files (*.*)\0*.*\0", "hlsl");
+					if (!selected.empty())
 					{
-						shader.path = ofn.lpstrFile;
+						shader.path = selected;
 						shader.name = shader.path.filename().string();
-						std::ifstream file(shader.path, std::ios::in);
-						if (!file.is_open())
+						if (!FileWatchService::ReadFile(shader.path, shader.source))
 						{
 							FORMAT_LOG(Warning, "[%s](id:%s) Failed to open shader file", shader.name.c_str(), shader.id.c_str());
 							return;
 						}
-						shader.source = std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 					}
 				}
 
@@ -388,6 +1269,7 @@ RegisterWindow(ShaderManager, true)
 				// vectorԪʱС·ڴ棬֮ǰָʧЧ
 				// ҪԭpreviewѾ˵ַshader°󶨵ַ
 				manager->shaders.push_back(shader);
+				SingleInstance<FileWatchService>::Get()->Watch(shader.path, shader.source);
 				shader = ShaderPreviewManager::Shader();
 
 				ImGui::CloseCurrentPopup();
@@ -400,84 +1282,288 @@ RegisterWindow(ShaderManager, true)
 			}
 			ImGui::EndPopup();
 		}
-		ImGui::Separator();
-		ImGui::BeginChild("Shaders", ImVec2(0, 0), false);
-		for (auto& shader : manager->shaders)
+		ShaderCache::Statistics cache = SingleInstance<ShaderCache>::Get()->GetStatistics();
+		ImGui::AlignTextToFramePadding();
+		ImGui::Text("Cache: %llu hits (%llu memory, %llu disk, %llu remote), %llu misses, saved %.1f KB / %.1f ms",
+			(unsigned long long)(cache.memoryHits + cache.diskHits + cache.remoteHits), (unsigned long long)cache.memoryHits,
+			(unsigned long long)cache.diskHits, (unsigned long long)cache.remoteHits, (unsigned long long)cache.misses, cache.bytesSaved / 1024.0,
+			cache.timeSaved);
+		if (ImGui::IsItemHovered())
 		{
-			ImGui::PushID(shader.id.c_str());
-			ImGui::SeparatorText((shader.name + "(id:" + shader.id + ")").c_str());
-			ImGui::AlignTextToFramePadding();
-			ImGui::Text("Path: %s", shader.path.string().c_str());
-			ImGui::AlignTextToFramePadding();
-			ImGui::Text("Target:");
-			ImGui::SameLine();
-			if (ImGui::BeginCombo("##target", shader.target.c_str()))
-			{
-				if (ImGui::Selectable("ps_4_0", shader.target == "ps_4_0"))
-				{
-					shader.target = "ps_4_0";
-				}
-				if (ImGui::Selectable("ps_5_0", shader.target == "ps_5_0"))
-				{
-					shader.target = "ps_5_0";
-				}
-				ImGui::EndCombo();
-			}
-			ImGui::AlignTextToFramePadding();
-			ImGui::Text("Source: %s", shader.IsSource() ? "Has" : "No");
-			ImGui::SameLine();
-			if (ImGui::Button("Reload"))
+			ImGui::BeginTooltip();
+			ImGui::Text("Memory: %.1f KB, disk: %.1f KB", cache.memoryBytes / 1024.0, cache.diskBytes / 1024.0);
+			ImGui::Text("Stores: %llu, evicted: %llu memory, %llu disk, corrupt files: %llu", (unsigned long long)cache.stores,
+				(unsigned long long)cache.memoryEvictions, (unsigned long long)cache.diskEvictions, (unsigned long long)cache.corrupt);
+			RemoteCache* remote = SingleInstance<ShaderCache>::Get()->remote;
+			if (remote != nullptr)
 			{
-				if (shader.path.string().size() > 0)
-				{
-					std::ifstream file(shader.path, std::ios::in);
-					if (!file.is_open())
-					{
-						FORMAT_LOG(Warning, "[%s](id:%s) Failed to open shader file", shader.name.c_str(), shader.id.c_str());
-						ImGui::PopID();
-						continue;
-					}
-					shader.source = std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-				}
+				const RemoteCache::Statistics shared = remote->GetStatistics();
+				ImGui::Text("Remote %s:%u%s: %llu hits, %llu misses, %llu uploaded (%.1f KB, %.1f KB before compression), %llu errors",
+					remote->host.c_str(), (unsigned)remote->port, remote->IsAvailable() ? "" : " (unreachable)", (unsigned long long)shared.hits,
+					(unsigned long long)shared.misses, (unsigned long long)shared.uploads, shared.bytesUploaded / 1024.0, shared.bytesUncompressed / 1024.0,
+					(unsigned long long)shared.errors);
 			}
+			ImGui::EndTooltip();
+		}
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Clear"))
+		{
+			SingleInstance<ShaderCache>::Get()->Clear();
+			FORMAT_LOG(Info, "Shader cache cleared");
+		}
+		if (!manager->sessionDirectory.empty())
+		{
+			const ShaderPack::Statistics pack = SingleInstance<ShaderPack>::Get()->GetStatistics();
 			ImGui::AlignTextToFramePadding();
-			ImGui::Text("Compiled: %s", shader.IsComplied() ? "Yes" : "No");
-			ImGui::SameLine();
-			if (ImGui::Button("Destroy"))
-			{
-				destoryShaderId = shader.id;
-			}
-			ImGui::SameLine();
-			if (ImGui::Button("(Re-)Complie"))
+			ImGui::Text("Pack: %llu entries, %.1f KB (%.1f KB superseded), %llu read, %llu misses, opened in %.2f ms",
+				(unsigned long long)pack.entries, pack.fileBytes / 1024.0, pack.deadBytes / 1024.0, (unsigned long long)pack.reads,
+				(unsigned long long)pack.misses, pack.openTime);
+			if (ImGui::IsItemHovered())
 			{
-				shader.ComplieShader();
+				ImGui::BeginTooltip();
+				ImGui::Text("Restored %llu shaders, %llu bound from the pack, in %.1f ms", (unsigned long long)manager->sessionStatistics.shaders,
+					(unsigned long long)manager->sessionStatistics.packed, manager->sessionStatistics.restoreTime);
+				ImGui::Text("Appended: %llu (%llu since the last of %llu compactions), corrupt: %llu", (unsigned long long)pack.appends,
+					(unsigned long long)pack.records, (unsigned long long)pack.compactions, (unsigned long long)pack.corrupt);
+				ImGui::EndTooltip();
 			}
-			if (ImGui::Button("Compile with reloading souce") && shader.source.size() > 0)
+		}
+		const ShaderPreviewManager::EditStatistics& edits = manager->editStatistics;
+		const AsyncShaderCompiler::Statistics& queue = manager->compileQueue.statistics;
+		ImGui::AlignTextToFramePadding();
+		ImGui::Text("Edits: %llu, %llu compiles (%llu cancelled, %llu discarded), edit to pixels %.1f ms (mean %.1f, max %.1f)",
+			(unsigned long long)edits.edits, (unsigned long long)edits.compiles, (unsigned long long)queue.cancelled, (unsigned long long)queue.discarded,
+			edits.lastLatency, edits.meanLatency, edits.maxLatency);
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+		ImGui::SliderInt("Debounce (ms)", &manager->debounceTime, 0, 1000);
+		const FileWatchService* watch = SingleInstance<FileWatchService>::Get();
+		ImGui::Text("Watching %u files (%s): %llu changes recompiled, %llu saves without changes skipped", (unsigned)watch->GetWatchedCount(),
+			watch->GetBackendName(), (unsigned long long)watch->statistics.changed, (unsigned long long)watch->statistics.unchanged);
+		size_t bound = 0;
+		for (const auto& shader : manager->shaders)
+			bound += shader.shader != nullptr ? 1 : 0;
+		ImGui::Text("Device shaders: %u distinct bytecodes for %u compiled shaders, %llu reused instead of created",
+			(unsigned)manager->sharedShaders.size(), (unsigned)bound, (unsigned long long)manager->sharedHits);
+		ImGui::Separator();
+		if (ImGui::BeginTabBar("##views"))
+		{
+			if (ImGui::BeginTabItem("Shaders"))
 			{
-				if (shader.path.string().size() > 0)
+				ImGui::BeginChild("Shaders", ImVec2(0, 0), false);
+				for (auto& shader : manager->shaders)
 				{
-					std::ifstream file(shader.path, std::ios::in);
-					if (!file.is_open())
+					ImGui::PushID(shader.id.c_str());
+					ImGui::SeparatorText((shader.name + "(id:" + shader.id + ")").c_str());
+					ImGui::AlignTextToFramePadding();
+					ImGui::Text("Path: %s", shader.path.string().c_str());
+					ImGui::AlignTextToFramePadding();
+					ImGui::Text("Target:");
+					ImGui::SameLine();
+					if (ImGui::BeginCombo("##target", shader.target.c_str()))
+					{
+						if (ImGui::Selectable("ps_4_0", shader.target == "ps_4_0"))
+						{
+							shader.target = "ps_4_0";
+						}
+						if (ImGui::Selectable("ps_5_0", shader.target == "ps_5_0"))
+						{
+							shader.target = "ps_5_0";
+						}
+						ImGui::EndCombo();
+					}
+					ImGui::AlignTextToFramePadding();
+					ImGui::Text("Source: %s", shader.IsSource() ? "Has" : "No");
+					ImGui::SameLine();
+					if (ImGui::Button("Reload"))
+					{
+						if (shader.path.string().size() > 0 && !manager->ReloadShader(shader))
+						{
+							FORMAT_LOG(Warning, "[%s](id:%s) Failed to open shader file", shader.name.c_str(), shader.id.c_str());
+							ImGui::PopID();
+							continue;
+						}
+					}
+					if (shader.hasAnalysis)
 					{
-						FORMAT_LOG(Warning, "[%s](id:%s) Failed to open shader file", shader.name.c_str(), shader.id.c_str());
+						const DxbcContainer::Statistics& cost = shader.analysis;
+						ImGui::AlignTextToFramePadding();
+						ImGui::Text("Cost: %u instructions (%u ALU, %u texture, %u flow control), %u temps, checksum %.8s", cost.instructions,
+							cost.alu, cost.texture, cost.flowControl, cost.temps + cost.indexableTemps, shader.checksum.empty() ? "invalid" : shader.checksum.c_str());
+						if (ImGui::IsItemHovered())
+						{
+							ImGui::BeginTooltip();
+							ImGui::Text("Shader model %u.%u, %u other instructions, %u declarations", cost.major, cost.minor, cost.other, cost.declarations);
+							ImGui::Text("%u temps, %u indexable temps, %u resources, %u samplers, %u constant buffers, %u UAVs", cost.temps,
+								cost.indexableTemps, cost.resources, cost.samplers, cost.constantBuffers, cost.unorderedAccessViews);
+							ImGui::Text("Checksum: %s", shader.checksum.empty() ? "invalid" : shader.checksum.c_str());
+							ImGui::EndTooltip();
+						}
+						auto shared = manager->sharedShaders.find(shader.checksum);
+						if (shared != manager->sharedShaders.end() && shared->second.references > 1)
+						{
+							ImGui::SameLine();
+							ImGui::TextDisabled("(same bytecode as %u other shaders)", shared->second.references - 1);
+						}
+					}
+					ImGui::AlignTextToFramePadding();
+					switch (shader.GetState())
+					{
+					case AsyncShaderCompiler::State::Queued:
+						ImGui::Text("Compiled: %s, queued...", shader.IsComplied() ? "Yes" : "No");
+						break;
+					case AsyncShaderCompiler::State::Compiling:
+						ImGui::Text("Compiled: %s, compiling...", shader.IsComplied() ? "Yes" : "No");
+						break;
+					case AsyncShaderCompiler::State::Failed:
+						ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "Compiled: %s, last compile failed", shader.IsComplied() ? "Yes" : "No");
+						if (ImGui::IsItemHovered())
+						{
+							ImGui::SetTooltip("%s", shader.lastError.c_str());
+						}
+						break;
+					default:
+						if (shader.IsComplied())
+						{
+							ImGui::Text("Compiled: Yes (%.2f ms)", shader.compileTime);
+						}
+						else
+						{
+							ImGui::Text("Compiled: No");
+						}
+						break;
+					}
+					ImGui::SameLine();
+					if (ImGui::Button("Destroy"))
+					{
+						destoryShaderId = shader.id;
+					}
+					ImGui::SameLine();
+					if (ImGui::Button("(Re-)Complie"))
+					{
+						shader.ComplieShader();
+					}
+					if (ImGui::Button("Compile with reloading souce") && shader.source.size() > 0)
+					{
+						const uint64_t version = shader.version;
+						if (shader.path.string().size() > 0 && !manager->ReloadShader(shader))
+						{
+							FORMAT_LOG(Warning, "[%s](id:%s) Failed to open shader file", shader.name.c_str(), shader.id.c_str());
+							ImGui::PopID();
+							continue;
+						}
+						// A changed file was already recompiled by the reload
+						if (shader.version == version)
+							shader.ComplieShader();
+					}
+
+					ImGui::SameLine();
+					if (ImGui::Button("Delete"))
+					{
+						destoryShaderId = shader.id;
 						ImGui::PopID();
 						continue;
 					}
-					shader.source = std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+					if (!shader.compileReason.empty())
+					{
+						ImGui::Text("Last compile: %s", shader.compileReason.c_str());
+					}
+					if (!shader.permutations.IsEmpty())
+					{
+						ImGui::AlignTextToFramePadding();
+						ImGui::Text("Variants: %llu", (unsigned long long)shader.permutations.GetVariantCount());
+						if (shader.variants != nullptr)
+						{
+							ImGui::SameLine();
+							ImGui::Text("(built: %llu unique, %llu failed, %.1f ms)", (unsigned long long)shader.variants->statistics.unique,
+								(unsigned long long)shader.variants->statistics.failed, shader.variants->statistics.preprocessTime + shader.variants->statistics.compileTime);
+						}
+						ImGui::SameLine();
+						if (ImGui::Button("Build all variants"))
+						{
+							shader.BuildVariants();
+						}
+						std::vector<size_t> choices = shader.permutations.Decode(shader.variant);
+						for (size_t i = 0; i < shader.permutations.axes.size(); i++)
+						{
+							const ShaderPermutations::Axis& axis = shader.permutations.axes[i];
+							ImGui::SetNextItemWidth(120.f);
+							if (ImGui::BeginCombo(axis.name.c_str(), axis.values[choices[i]].c_str()))
+							{
+								for (size_t j = 0; j < axis.values.size(); j++)
+								{
+									if (ImGui::Selectable(axis.values[j].c_str(), j == choices[i]) && j != choices[i])
+									{
+										choices[i] = j;
+										shader.SelectVariant(shader.permutations.MakeKey(choices));
+									}
+								}
+								ImGui::EndCombo();
+							}
+							if (i + 1 < shader.permutations.axes.size() && (i + 1) % 3 != 0)
+							{
+								ImGui::SameLine();
+							}
+						}
+					}
+					if (!shader.includes.empty() && ImGui::TreeNode("Includes", "Includes (%u)", (unsigned)shader.includes.size()))
+					{
+						ShowIncludes(shader.includes, "", 0);
+						ImGui::TreePop();
+					}
+					if (shader.IsSource() && ImGui::TreeNode("Source"))
+					{
+						if (ImGui::InputTextMultiline("##source", &shader.source, ImVec2(-FLT_MIN, ImGui::GetTextLineHeight() * 16), ImGuiInputTextFlags_AllowTabInput))
+						{
+							shader.OnEdited();
+						}
+						shader.CheckSyntax();
+						const HlslFrontEnd& syntax = *shader.syntax;
+						ImGui::Text("Syntax: %u errors, %u tokens (%llu re-lexed), %u nodes, lex %.1f us, parse %.1f us", (unsigned)syntax.diagnostics.size(),
+							(unsigned)syntax.lexer.tokens.size(), (unsigned long long)syntax.lexer.statistics.lexed, (unsigned)syntax.GetNodeCount(),
+							syntax.lexTime, syntax.parseTime);
+						for (const auto& diagnostic : syntax.diagnostics)
+						{
+							ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "%d:%d: error %s: %s", diagnostic.line, diagnostic.column,
+								diagnostic.code.c_str(), diagnostic.message.c_str());
+						}
+						if (ImGui::Button("Compile"))
+						{
+							shader.ComplieShader("Edited");
+						}
+						ImGui::SameLine();
+						if (shader.compileTimer != 0)
+						{
+							ImGui::Text("Version %llu, compiles when typing pauses for %d ms", (unsigned long long)shader.version, manager->debounceTime);
+						}
+						else if (shader.editedAt != std::chrono::steady_clock::time_point())
+						{
+							ImGui::Text("Version %llu, compiling for %.0f ms", (unsigned long long)shader.version,
+								std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - shader.editedAt).count());
+						}
+						else
+						{
+							ImGui::Text("Version %llu on screen", (unsigned long long)shader.version);
+						}
+						if (shader.latency.total > 0.f)
+						{
+							ImGui::Text("Edit to pixels: %.1f ms (debounce %.1f, queued %.1f, compile %.1f, apply %.1f)", shader.latency.total,
+								shader.latency.debounce, shader.latency.queue, shader.latency.compile, shader.latency.apply);
+						}
+						ImGui::TreePop();
+					}
+					ImGui::PopID();
 				}
-				shader.ComplieShader();
+				ImGui::EndChild();
+				ImGui::EndTabItem();
 			}
-
-			ImGui::SameLine();
-			if (ImGui::Button("Delete"))
+			if (ImGui::BeginTabItem("Telemetry"))
 			{
-				destoryShaderId = shader.id;
-				ImGui::PopID();
-				continue;
+				ShowCompileTelemetry();
+				ImGui::EndTabItem();
 			}
-			ImGui::PopID();
+			ImGui::EndTabBar();
 		}
-		ImGui::EndChild();
 		if (destoryShaderId.size() > 0)
 		{
 			ImGui::OpenPopup("Destory Shader");
@@ -523,7 +1609,7 @@ RegisterWindow(ShaderManager, true)
 	ImGui::End();
 }
 
-RegisterWindow(PreviewManager, true)
+RegisterWindowIn("Shader", PreviewManager, true)
 {
 	ShaderPreviewManager* manager = SingleInstance<ShaderPreviewManager>::Get();
 	ImGui::SetNextWindowPos(ImVec2(50.f, 320.f), ImGuiCond_FirstUseEver);
@@ -562,19 +1648,10 @@ RegisterWindow(PreviewManager, true)
 
 				if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
 				{
-					OPENFILENAMEA ofn;
-					CHAR szFile[MAX_PATH] = { 0 };
-					ZeroMemory(&ofn, sizeof(ofn));
-					ofn.lStructSize = sizeof(ofn);
-					ofn.hwndOwner = SingleInstance<Application>::Get()->GetMainWindow().handl;
-					ofn.lpstrFilter = "Image Files (*.png, *.jpg)\0*.png;*.jpg\0All Files (*.*)\0*.*\0";
-					ofn.lpstrFile = szFile;
-					ofn.nMaxFile = MAX_PATH;
-					ofn.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST | OFN_HIDEREADONLY;
-					ofn.lpstrDefExt = "png";
-					if (GetOpenFileNameA(&ofn))
+					std::string selected = SingleInstance<Application>::Get()->GetMainWindow().platform->OpenFileDialog("Image Files (*.png, *.jpg)\0*.png;*.jpg\0All Files (*.*)\0*.*\0", "png");
+					if (!selected.empty())
 					{
-						preview.path = ofn.lpstrFile;
+						preview.path = selected;
 						preview.name = preview.path.filename().string();
 						preview.RealeaseImage();
 						preview.LoadImage();
@@ -635,19 +1712,10 @@ RegisterWindow(PreviewManager, true)
 				ImGui::EndTooltip();
 				if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
 				{
-					OPENFILENAMEA ofn;
-					CHAR szFile[MAX_PATH] = { 0 };
-					ZeroMemory(&ofn, sizeof(ofn));
-					ofn.lStructSize = sizeof(ofn);
-					ofn.hwndOwner = SingleInstance<Application>::Get()->GetMainWindow().handl;
-					ofn.lpstrFilter = "Image Files (*.png, *.jpg)\0*.png;*.jpg\0All Files (*.*)\0*.*\0";
-					ofn.lpstrFile = szFile;
-					ofn.nMaxFile = MAX_PATH;
-					ofn.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST | OFN_HIDEREADONLY;
-					ofn.lpstrDefExt = "png";
-					if (GetOpenFileNameA(&ofn))
+					std::string selected = SingleInstance<Application>::Get()->GetMainWindow().platform->OpenFileDialog("Image Files (*.png, *.jpg)\0*.png;*.jpg\0All Files (*.*)\0*.*\0", "png");
+					if (!selected.empty())
 					{
-						view.path = ofn.lpstrFile;
+						view.path = selected;
 						view.RealeaseImage();
 						view.LoadImage();
 					}
@@ -708,6 +1776,15 @@ RegisterWindow(PreviewManager, true)
 				}
 				ImGui::EndCombo();
 			}
+			if (view.IsApplyShader() && ImGui::Button("Render on CPU"))
+			{
+				view.RenderOnCpu();
+			}
+			if (view.cpuTexture != nullptr && view.width > 0)
+			{
+				ImGui::Text("CPU render: %.1f ms, %.1f MP/s", view.cpuRenderTime, view.width * view.height / 1000.f / std::max(view.cpuRenderTime, 0.001f));
+				ImGui::Image(view.cpuTexture, ImVec2(160.f, 160.f * view.height / view.width));
+			}
 			if (ImGui::Button("Delete"))
 			{
 				manager->previews.erase(std::find(manager->previews.begin(), manager->previews.end(), view));
@@ -721,7 +1798,7 @@ RegisterWindow(PreviewManager, true)
 	ImGui::End();
 }
 
-RegisterWindow(BackgroundManager, true)
+RegisterWindowIn("Shader", BackgroundManager, true)
 {
 	ImGui::SetNextWindowPos(ImVec2(50.f, 680.f), ImGuiCond_FirstUseEver);
 	ImGui::SetNextWindowSize(ImVec2(350.f, 220.f), ImGuiCond_FirstUseEver);
@@ -738,19 +1815,10 @@ RegisterWindow(BackgroundManager, true)
 			ImGui::EndTooltip();
 			if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
 			{
-				OPENFILENAMEA ofn;
-				CHAR szFile[MAX_PATH] = { 0 };
-				ZeroMemory(&ofn, sizeof(ofn));
-				ofn.lStructSize = sizeof(ofn);
-				ofn.hwndOwner = SingleInstance<Application>::Get()->GetMainWindow().handl;
-				ofn.lpstrFilter = "Image Files (*.png, *.jpg)\0*.png;*.jpg\0All Files (*.*)\0*.*\0";
-				ofn.lpstrFile = szFile;
-				ofn.nMaxFile = MAX_PATH;
-				ofn.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST | OFN_HIDEREADONLY;
-				ofn.lpstrDefExt = "png";
-				if (GetOpenFileNameA(&ofn))
+				std::string selected = SingleInstance<Application>::Get()->GetMainWindow().platform->OpenFileDialog("Image Files (*.png, *.jpg)\0*.png;*.jpg\0All Files (*.*)\0*.*\0", "png");
+				if (!selected.empty())
 				{
-					manager->background.path = ofn.lpstrFile;
+					manager->background.path = selected;
 					manager->background.RealeaseImage();
 					manager->background.LoadImage();
 				}
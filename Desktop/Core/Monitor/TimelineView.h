@@ -0,0 +1,117 @@
+#pragma once
+
+RegisterWindowIn("Monitor", TimelineView, false)
+{
+	ImGui::SetNextWindowPos(ImVec2(450.f, ImGui::GetMainViewport()->WorkSize.y - 380.f), ImGuiCond_FirstUseEver);
+	ImGui::SetNextWindowSize(ImVec2(900.f, 330.f), ImGuiCond_FirstUseEver);
+	ImGui::Begin("Timeline", opened);
+	{
+		Timeline* timeline = SingleInstance<Timeline>::Get();
+		static int frameCount = 5;
+		static bool paused = false;
+		static int64_t from = 0;
+		static int64_t to = 0;
+		static std::vector<std::pair<Timeline::ThreadBuffer*, std::vector<Timeline::Event>>> threads = {};
+
+		bool enabled = Timeline::IsEnabled();
+		if (ImGui::Checkbox("Record", &enabled))
+			Timeline::SetEnabled(enabled);
+		ImGui::SameLine();
+		ImGui::Checkbox("Pause", &paused);
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+		ImGui::SliderInt("Frames", &frameCount, 1, 60);
+		ImGui::SameLine();
+		if (ImGui::Button("Export Chrome trace"))
+		{
+			TIME("%d-%m-%Y %H-%M-%S");
+			fs::path path = fs::current_path() / "traces";
+			fs::create_directories(path);
+			path /= bufferString + ".json";
+			if (timeline->ExportChromeTrace(path.string()))
+			{
+				FORMAT_LOG(Info, "Timeline exported to %s", path.string().c_str());
+			}
+			else
+			{
+				FORMAT_LOG(Warning, "Failed to export timeline to %s", path.string().c_str());
+			}
+		}
+
+		if (!paused)
+		{
+			to = Timeline::Now();
+			from = timeline->GetFrameStart(frameCount - 1);
+			if (from < 0)
+				from = to - 100000000;
+			auto buffers = timeline->GetThreadBuffers();
+			threads.resize(buffers.size());
+			for (size_t i = 0; i < buffers.size(); i++)
+			{
+				threads[i].first = buffers[i];
+				threads[i].second.clear();
+				buffers[i]->Collect(from, threads[i].second);
+			}
+		}
+		ImGui::Text("%.3f ms over %d frame(s)", (to - from) / 1000000.0, frameCount);
+		ImGui::Separator();
+
+		ImGui::BeginChild("Graph", ImVec2(0, 0), false);
+		{
+			ImDrawList* drawList = ImGui::GetWindowDrawList();
+			const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+			const float width = ImGui::GetContentRegionAvail().x;
+			const double scale = to > from ? width / (double)(to - from) : 0.0;
+			const ImVec2 mouse = ImGui::GetIO().MousePos;
+			const Timeline::Event* hovered = nullptr;
+
+			for (auto& thread : threads)
+			{
+				if (thread.second.empty())
+					continue;
+				ImGui::TextDisabled("%s", thread.first->threadName.c_str());
+				uint32_t maxDepth = 0;
+				for (auto& event : thread.second)
+					maxDepth = std::max(maxDepth, event.depth);
+				const ImVec2 origin = ImGui::GetCursorScreenPos();
+				ImGui::Dummy(ImVec2(width, rowHeight * (maxDepth + 1)));
+
+				// Frame boundaries
+				for (int i = 0; i < frameCount; i++)
+				{
+					int64_t start = timeline->GetFrameStart(i);
+					if (start < from)
+						break;
+					float x = origin.x + (float)((start - from) * scale);
+					drawList->AddLine(ImVec2(x, origin.y), ImVec2(x, origin.y + rowHeight * (maxDepth + 1)), IM_COL32(255, 255, 255, 60));
+				}
+
+				for (auto& event : thread.second)
+				{
+					float x0 = origin.x + (float)((std::max(event.begin, from) - from) * scale);
+					float x1 = std::max(x0 + 1.f, origin.x + (float)((event.end - from) * scale));
+					float y0 = origin.y + event.depth * rowHeight;
+					float y1 = y0 + rowHeight - 1.f;
+					// Same zone, same color
+					float hue = (float)(((uintptr_t)event.name * 2654435761u) % 1000) / 1000.f;
+					drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), ImColor::HSV(hue, 0.5f, 0.7f));
+					if (x1 - x0 > ImGui::CalcTextSize(event.name).x + 4.f)
+					{
+						drawList->AddText(ImVec2(x0 + 2.f, y0), IM_COL32(255, 255, 255, 255), event.name);
+					}
+					if (mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y1)
+						hovered = &event;
+				}
+			}
+			if (hovered != nullptr && ImGui::IsWindowHovered())
+			{
+				ImGui::BeginTooltip();
+				ImGui::Text("%s", hovered->name);
+				ImGui::Text("Duration: %.3f ms", (hovered->end - hovered->begin) / 1000000.0);
+				ImGui::EndTooltip();
+			}
+		}
+		ImGui::EndChild();
+	}
+	ImGui::End();
+}
\ No newline at end of file
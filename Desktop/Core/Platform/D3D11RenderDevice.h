@@ -0,0 +1,207 @@
+#pragma once
+#include <d3d11.h>
+
+class D3D11RenderDevice : public RenderDevice
+{
+private:
+	static std::string FormatError(const char* what, HRESULT hr)
+	{
+		char buffer[128];
+		snprintf(buffer, sizeof(buffer), "%s: %lx", what, (unsigned long)hr);
+		return buffer;
+	}
+
+public:
+	ID3D11Device* device = NULL;
+	ID3D11DeviceContext* context = NULL;
+	IDXGISwapChain* swapChain = NULL;
+	ID3D11RenderTargetView* renderTargetView = NULL;
+	// Wrap sampler shared by every preview shader
+	ID3D11SamplerState* sampler = NULL;
+
+	void CreateRenderTargetView()
+	{
+		ID3D11Texture2D* backBuffer;
+		swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&backBuffer);
+		device->CreateRenderTargetView(backBuffer, NULL, &renderTargetView);
+		backBuffer->Release();
+	}
+
+	bool Create(Platform* platform, int width, int height) override
+	{
+		// Create device and context
+		D3D_FEATURE_LEVEL featureLevel = D3D_FEATURE_LEVEL_11_0;
+		D3D11CreateDevice(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, 0, &featureLevel, 1, D3D11_SDK_VERSION, &device, NULL, &context);
+
+		// Create swap chain
+		DXGI_SWAP_CHAIN_DESC swapChainDesc;
+		ZeroMemory(&swapChainDesc, sizeof(swapChainDesc));
+		swapChainDesc.BufferCount = 1;
+		swapChainDesc.BufferDesc.Width = width;
+		swapChainDesc.BufferDesc.Height = height;
+		swapChainDesc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		swapChainDesc.BufferDesc.RefreshRate.Numerator = 60;
+		swapChainDesc.BufferDesc.RefreshRate.Denominator = 1;
+		swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+		swapChainDesc.OutputWindow = (HWND)platform->GetNativeHandle();
+		swapChainDesc.SampleDesc.Count = 1;
+		swapChainDesc.SampleDesc.Quality = 0;
+		swapChainDesc.Windowed = TRUE;
+		HRESULT hr = D3D11CreateDeviceAndSwapChain(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, 0, &featureLevel, 1, D3D11_SDK_VERSION, &swapChainDesc, &swapChain, &device, NULL, &context);
+		if (FAILED(hr))
+		{
+			FORMAT_LOG(Error, "Failed to create device and swap chain: %x", hr);
+			return false;
+		}
+
+		// Create render target view
+		CreateRenderTargetView();
+
+		D3D11_SAMPLER_DESC samplerDesc = {};
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+		samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+		samplerDesc.MinLOD = 0;
+		samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+		hr = device->CreateSamplerState(&samplerDesc, &sampler);
+		if (FAILED(hr))
+		{
+			FORMAT_LOG(Error, "Failed to create sampler: %x", hr);
+			return false;
+		}
+		return true;
+	}
+
+	void Destroy() override
+	{
+		// Release the COM Objects we created
+		sampler->Release();
+		renderTargetView->Release();
+		swapChain->Release();
+		context->Release();
+		device->Release();
+	}
+
+	bool Resize(int width, int height) override
+	{
+		renderTargetView->Release();
+		HRESULT hr = swapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0);
+		CreateRenderTargetView();
+		return SUCCEEDED(hr);
+	}
+
+	void BeginFrame(const float clearColor[4]) override
+	{
+		context->OMSetRenderTargets(1, &renderTargetView, nullptr);
+		context->ClearRenderTargetView(renderTargetView, clearColor);
+	}
+
+	bool Present(bool vsync) override
+	{
+		return swapChain->Present(vsync ? 1 : 0, 0) != DXGI_STATUS_OCCLUDED;
+	}
+
+	bool IsOccluded() override
+	{
+		return swapChain->Present(0, DXGI_PRESENT_TEST) == DXGI_STATUS_OCCLUDED;
+	}
+
+	void ImGuiInit() override
+	{
+		ImGui_ImplDX11_Init(device, context);
+	}
+
+	void ImGuiNewFrame() override
+	{
+		ImGui_ImplDX11_NewFrame();
+	}
+
+	void ImGuiRenderDrawData(ImDrawData* drawData) override
+	{
+		ImGui_ImplDX11_RenderDrawData(drawData);
+	}
+
+	void ImGuiShutdown() override
+	{
+		ImGui_ImplDX11_Shutdown();
+	}
+
+	ImTextureID CreateTexture(const unsigned char* rgba, int width, int height, std::string& error) override
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		ZeroMemory(&desc, sizeof(desc));
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = 0;
+
+		ID3D11Texture2D* texture2d = NULL;
+		D3D11_SUBRESOURCE_DATA subResource;
+		subResource.pSysMem = rgba;
+		subResource.SysMemPitch = desc.Width * 4;
+		subResource.SysMemSlicePitch = 0;
+		HRESULT hr = device->CreateTexture2D(&desc, &subResource, &texture2d);
+		if (FAILED(hr))
+		{
+			error = FormatError("Failed to create texture", hr);
+			return nullptr;
+		}
+
+		// Create shader resource view
+		ID3D11ShaderResourceView* texture = nullptr;
+		D3D11_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc;
+		ZeroMemory(&shaderResourceViewDesc, sizeof(shaderResourceViewDesc));
+		shaderResourceViewDesc.Format = desc.Format;
+		shaderResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		shaderResourceViewDesc.Texture2D.MipLevels = desc.MipLevels;
+		shaderResourceViewDesc.Texture2D.MostDetailedMip = 0;
+		hr = device->CreateShaderResourceView(texture2d, &shaderResourceViewDesc, &texture);
+		// Release texture, the view keeps it alive
+		texture2d->Release();
+		if (FAILED(hr))
+		{
+			error = FormatError("Failed to create shader resource view", hr);
+			return nullptr;
+		}
+		return (ImTextureID)texture;
+	}
+
+	void ReleaseTexture(ImTextureID texture) override
+	{
+		if (texture != nullptr)
+			((ID3D11ShaderResourceView*)texture)->Release();
+	}
+
+	ShaderHandle CreatePixelShader(const void* bytecode, size_t size, std::string& error) override
+	{
+		ID3D11PixelShader* shader = nullptr;
+		HRESULT hr = device->CreatePixelShader(bytecode, size, nullptr, &shader);
+		if (FAILED(hr))
+		{
+			error = FormatError("Failed to create shader", hr);
+			return nullptr;
+		}
+		return shader;
+	}
+
+	void ReleasePixelShader(ShaderHandle shader) override
+	{
+		if (shader != nullptr)
+			((ID3D11PixelShader*)shader)->Release();
+	}
+
+	void BindPixelShader(ShaderHandle shader, ImTextureID texture) override
+	{
+		ID3D11ShaderResourceView* view = (ID3D11ShaderResourceView*)texture;
+		context->PSSetShader((ID3D11PixelShader*)shader, nullptr, 0);
+		context->PSSetShaderResources(0, 1, &view);
+		context->PSSetSamplers(0, 1, &sampler);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,253 @@
+#pragma once
+#include <algorithm>
+
+// Platform without a window: ImGui runs on a synthetic display and input comes from a script,
+// so frame cost, allocations and async pipelines can be measured on machines without a display
+class HeadlessPlatform : public Platform
+{
+public:
+	class InputEvent
+	{
+	public:
+		enum class Type
+		{
+			MousePosition,
+			MouseButton,
+			MouseWheel,
+			Key,
+			Text,
+			Resize,
+			Quit,
+			None
+		};
+		uint64_t frame = 0;
+		Type type = Type::None;
+		float x = 0.f;
+		float y = 0.f;
+		int code = 0;
+		bool down = false;
+		std::string text = "";
+	};
+
+	// ImGui allocations since start, read by the headless render device once per frame
+	inline static std::atomic<uint64_t> allocations{ 0 };
+
+private:
+	std::vector<InputEvent> script = {};
+	size_t scriptIndex = 0;
+	std::atomic<bool> quit{ false };
+
+	static void* Allocate(size_t size, void*)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		return malloc(size);
+	}
+
+	static void Free(void* pointer, void*)
+	{
+		free(pointer);
+	}
+
+	void Apply(const InputEvent& event)
+	{
+		ImGuiIO& io = ImGui::GetIO();
+		switch (event.type)
+		{
+		case InputEvent::Type::MousePosition:
+			io.AddMousePosEvent(event.x, event.y);
+			break;
+		case InputEvent::Type::MouseButton:
+			io.AddMouseButtonEvent(event.code, event.down);
+			break;
+		case InputEvent::Type::MouseWheel:
+			io.AddMouseWheelEvent(event.x, event.y);
+			break;
+		case InputEvent::Type::Key:
+			io.AddKeyEvent((ImGuiKey)event.code, event.down);
+			break;
+		case InputEvent::Type::Text:
+			io.AddInputCharactersUTF8(event.text.c_str());
+			break;
+		case InputEvent::Type::Resize:
+			// "resize 0 0" minimizes, the last size is kept like a real window would
+			if (event.x > 0 && event.y > 0)
+			{
+				width = (int)event.x;
+				height = (int)event.y;
+			}
+			if (resizeCallback)
+				resizeCallback((int)event.x, (int)event.y);
+			break;
+		case InputEvent::Type::Quit:
+			quit = true;
+			break;
+		default:
+			break;
+		}
+	}
+
+public:
+	// Loop iterations so far, script events are keyed on it so minimized stretches still advance
+	uint64_t frame = 0;
+	// Quit after this many frames, 0 runs until the script quits
+	uint64_t maxFrames = 0;
+	// Request a frame on every pump so frames run back to back
+	bool continuous = true;
+	// Simulated time step handed to ImGui
+	float deltaTime = 1.f / 60.f;
+	// Returned by OpenFileDialog
+	std::string fileDialogResult = "";
+
+	void AddInput(const InputEvent& event)
+	{
+		script.push_back(event);
+		std::stable_sort(script.begin() + scriptIndex, script.end(), [](const InputEvent& a, const InputEvent& b) { return a.frame < b.frame; });
+	}
+
+	// One event per line: "<frame> mouse <x> <y>", "<frame> button <index> <down|up>", "<frame> wheel <x> <y>",
+	// "<frame> key <ImGuiKey> <down|up>", "<frame> text <characters>", "<frame> resize <width> <height>" (0 0 minimizes), "<frame> quit"
+	bool LoadScript(const fs::path& path)
+	{
+		std::ifstream file(path, std::ios::in);
+		if (!file.is_open())
+			return false;
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream stream(line);
+			InputEvent event;
+			std::string type, state;
+			if (!(stream >> event.frame >> type))
+				continue;
+			if (type == "mouse")
+			{
+				event.type = InputEvent::Type::MousePosition;
+				stream >> event.x >> event.y;
+			}
+			else if (type == "button" || type == "key")
+			{
+				event.type = type == "button" ? InputEvent::Type::MouseButton : InputEvent::Type::Key;
+				stream >> event.code >> state;
+				event.down = state == "down";
+			}
+			else if (type == "wheel")
+			{
+				event.type = InputEvent::Type::MouseWheel;
+				stream >> event.x >> event.y;
+			}
+			else if (type == "text")
+			{
+				event.type = InputEvent::Type::Text;
+				stream >> std::ws;
+				std::getline(stream, event.text);
+			}
+			else if (type == "resize")
+			{
+				event.type = InputEvent::Type::Resize;
+				stream >> event.x >> event.y;
+			}
+			else if (type == "quit")
+			{
+				event.type = InputEvent::Type::Quit;
+			}
+			else
+			{
+				continue;
+			}
+			AddInput(event);
+		}
+		return true;
+	}
+
+	bool Create(const std::string&, int width, int height) override
+	{
+		this->width = width;
+		this->height = height;
+		// Installed before the ImGui context exists so every ImGui allocation is counted
+		ImGui::SetAllocatorFunctions(Allocate, Free);
+		return true;
+	}
+
+	void Destroy() override
+	{
+	}
+
+	bool PumpEvents() override
+	{
+		bool input = false;
+		while (scriptIndex < script.size() && script[scriptIndex].frame <= frame)
+		{
+			Apply(script[scriptIndex++]);
+			input = true;
+		}
+		if (input)
+			SingleInstance<FrameScheduler>::Get()->RequestRedraw(FrameScheduler::Reason::Input);
+		else if (continuous)
+			SingleInstance<FrameScheduler>::Get()->RequestRedraw(FrameScheduler::Reason::Request);
+		if (maxFrames > 0 && frame >= maxFrames)
+			quit = true;
+		frame++;
+		return !quit;
+	}
+
+	// Thread safe, ends the loop at its next iteration
+	void Quit()
+	{
+		quit = true;
+		SingleInstance<EventLoop>::Get()->Wake();
+	}
+
+	void ImGuiInit() override
+	{
+		ImGuiIO& io = ImGui::GetIO();
+		io.BackendPlatformName = "Headless";
+		io.IniFilename = nullptr;
+		io.DisplaySize = ImVec2((float)width, (float)height);
+	}
+
+	void ImGuiNewFrame() override
+	{
+		ImGuiIO& io = ImGui::GetIO();
+		io.DisplaySize = ImVec2((float)width, (float)height);
+		io.DeltaTime = deltaTime;
+	}
+
+	void ImGuiShutdown() override
+	{
+	}
+
+	void* GetNativeHandle() override
+	{
+		return nullptr;
+	}
+
+	void SetSize(int width, int height) override
+	{
+		this->width = width;
+		this->height = height;
+		if (resizeCallback)
+			resizeCallback(width, height);
+	}
+
+	void SetTitle(const std::string&) override
+	{
+	}
+
+	void Minimize() override
+	{
+	}
+
+	void Move(int, int) override
+	{
+	}
+
+	ImVec2 GetPosition() override
+	{
+		return ImVec2(0, 0);
+	}
+
+	std::string OpenFileDialog(const char*, const char*) override
+	{
+		return fileDialogResult;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,192 @@
+#pragma once
+
+// Render device without a GPU: records what ImGui submits each frame and keeps textures and
+// shaders as plain memory, so the draw data can be inspected and measured
+class HeadlessRenderDevice : public RenderDevice
+{
+public:
+	class Texture
+	{
+	public:
+		int width = 0;
+		int height = 0;
+		std::vector<unsigned char> rgba = {};
+	};
+
+	class Shader
+	{
+	public:
+		std::vector<uint8_t> bytecode = {};
+	};
+
+	class FrameRecord
+	{
+	public:
+		uint64_t frame = 0;
+		int commandLists = 0;
+		int vertices = 0;
+		int indices = 0;
+		int drawCommands = 0;
+		int userCallbacks = 0;
+		int shaderBinds = 0;
+		uint64_t allocations = 0;
+	};
+
+	// Copy of one ImDrawList as it was submitted
+	class DrawList
+	{
+	public:
+		std::vector<ImDrawCmd> commands = {};
+		std::vector<ImDrawVert> vertices = {};
+		std::vector<ImDrawIdx> indices = {};
+	};
+
+private:
+	int shaderBinds = 0;
+	uint64_t lastAllocations = 0;
+	Texture fontTexture = Texture();
+
+public:
+	int width = 0;
+	int height = 0;
+	uint64_t presents = 0;
+	uint64_t resizes = 0;
+	// Presents report the window covered while set
+	bool occluded = false;
+	// Keep a full copy of the last frame's draw lists
+	bool recordDrawLists = true;
+	std::vector<FrameRecord> frames = {};
+	std::vector<DrawList> lastDrawLists = {};
+
+	bool Create(Platform*, int width, int height) override
+	{
+		this->width = width;
+		this->height = height;
+		return true;
+	}
+
+	void Destroy() override
+	{
+	}
+
+	bool Resize(int width, int height) override
+	{
+		this->width = width;
+		this->height = height;
+		resizes++;
+		return true;
+	}
+
+	void BeginFrame(const float[4]) override
+	{
+	}
+
+	bool Present(bool) override
+	{
+		presents++;
+		return !occluded;
+	}
+
+	bool IsOccluded() override
+	{
+		return occluded;
+	}
+
+	void ImGuiInit() override
+	{
+		ImGuiIO& io = ImGui::GetIO();
+		io.BackendRendererName = "Headless";
+		io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+	}
+
+	void ImGuiNewFrame() override
+	{
+		ImGuiIO& io = ImGui::GetIO();
+		if (!io.Fonts->IsBuilt())
+		{
+			unsigned char* pixels = nullptr;
+			io.Fonts->GetTexDataAsRGBA32(&pixels, &fontTexture.width, &fontTexture.height);
+			io.Fonts->SetTexID((ImTextureID)&fontTexture);
+		}
+	}
+
+	void ImGuiRenderDrawData(ImDrawData* drawData) override
+	{
+		FrameRecord record;
+		record.frame = frames.size();
+		record.commandLists = drawData->CmdListsCount;
+		record.vertices = drawData->TotalVtxCount;
+		record.indices = drawData->TotalIdxCount;
+		if (recordDrawLists)
+			lastDrawLists.resize(drawData->CmdListsCount);
+		shaderBinds = 0;
+		for (int i = 0; i < drawData->CmdListsCount; i++)
+		{
+			const ImDrawList* list = drawData->CmdLists[i];
+			for (const ImDrawCmd& command : list->CmdBuffer)
+			{
+				if (command.UserCallback == nullptr)
+				{
+					record.drawCommands++;
+				}
+				else if (command.UserCallback != ImDrawCallback_ResetRenderState)
+				{
+					// Run the callbacks the way a real backend would, e.g. preview shader binding
+					command.UserCallback(list, &command);
+					record.userCallbacks++;
+				}
+			}
+			if (recordDrawLists)
+			{
+				lastDrawLists[i].commands.assign(list->CmdBuffer.begin(), list->CmdBuffer.end());
+				lastDrawLists[i].vertices.assign(list->VtxBuffer.begin(), list->VtxBuffer.end());
+				lastDrawLists[i].indices.assign(list->IdxBuffer.begin(), list->IdxBuffer.end());
+			}
+		}
+		record.shaderBinds = shaderBinds;
+		const uint64_t allocations = HeadlessPlatform::allocations.load(std::memory_order_relaxed);
+		record.allocations = allocations - lastAllocations;
+		lastAllocations = allocations;
+		frames.push_back(record);
+	}
+
+	void ImGuiShutdown() override
+	{
+	}
+
+	ImTextureID CreateTexture(const unsigned char* rgba, int width, int height, std::string&) override
+	{
+		Texture* texture = new Texture();
+		texture->width = width;
+		texture->height = height;
+		texture->rgba.assign(rgba, rgba + (size_t)width * height * 4);
+		return (ImTextureID)texture;
+	}
+
+	void ReleaseTexture(ImTextureID texture) override
+	{
+		delete (Texture*)texture;
+	}
+
+	ShaderHandle CreatePixelShader(const void* bytecode, size_t size, std::string& error) override
+	{
+		if (bytecode == nullptr || size == 0)
+		{
+			error = "Empty bytecode";
+			return nullptr;
+		}
+		Shader* shader = new Shader();
+		shader->bytecode.assign((const uint8_t*)bytecode, (const uint8_t*)bytecode + size);
+		return shader;
+	}
+
+	void ReleasePixelShader(ShaderHandle shader) override
+	{
+		delete (Shader*)shader;
+	}
+
+	void BindPixelShader(ShaderHandle, ImTextureID) override
+	{
+		shaderBinds++;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,227 @@
+#pragma once
+
+extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+class Win32Platform : public Platform
+{
+private:
+	inline static Win32Platform* instance = nullptr;
+	bool quit = false;
+
+	// Input and window state changes need a frame. WM_NULL, timers, paint bookkeeping and the rest of the
+	// housekeeping traffic do not, they would keep an idle window redrawing.
+	static bool IsRedrawMessage(UINT msg)
+	{
+		if ((msg >= WM_MOUSEFIRST && msg <= WM_MOUSELAST) || (msg >= WM_KEYFIRST && msg <= WM_KEYLAST))
+			return true;
+		switch (msg)
+		{
+		case WM_NCMOUSEMOVE:
+		case WM_MOUSELEAVE:
+		case WM_NCMOUSELEAVE:
+		case WM_INPUT:
+		case WM_TOUCH:
+		case WM_IME_STARTCOMPOSITION:
+		case WM_IME_COMPOSITION:
+		case WM_IME_ENDCOMPOSITION:
+		case WM_ACTIVATE:
+		case WM_SETFOCUS:
+		case WM_KILLFOCUS:
+		case WM_SHOWWINDOW:
+		case WM_MOVE:
+		case WM_EXITSIZEMOVE:
+		case WM_DPICHANGED:
+		case WM_DISPLAYCHANGE:
+		case WM_SETTINGCHANGE:
+		case WM_DEVICECHANGE:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	static LRESULT WINAPI WindowsProcess(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
+	{
+		// Checked here rather than in PumpEvents, sent messages such as WM_ACTIVATE never reach the queue
+		if (IsRedrawMessage(msg))
+			SingleInstance<FrameScheduler>::Get()->RequestRedraw(FrameScheduler::Reason::Input);
+		if (ImGui_ImplWin32_WndProcHandler(hWnd, msg, wParam, lParam))
+			return true;
+		switch (msg)
+		{
+		case WM_SIZE:
+			if (wParam == SIZE_MINIMIZED)
+			{
+				if (instance != nullptr && instance->resizeCallback)
+					instance->resizeCallback(0, 0);
+				return 0;
+			}
+			if (instance != nullptr)
+			{
+				instance->width = (UINT)LOWORD(lParam);
+				instance->height = (UINT)HIWORD(lParam);
+				if (instance->resizeCallback)
+					instance->resizeCallback(instance->width, instance->height);
+			}
+			return 0;
+		case WM_SYSCOMMAND:
+			if ((wParam & 0xfff0) == SC_KEYMENU) // Disable ALT application menu
+				return 0;
+			break;
+		case WM_DESTROY:
+			::PostQuitMessage(0);
+			return 0;
+		}
+		return ::DefWindowProcW(hWnd, msg, wParam, lParam);
+	}
+
+public:
+	HWND handl = NULL;
+
+	Win32Platform()
+	{
+		instance = this;
+	}
+
+	bool Create(const std::string& title, int width, int height) override
+	{
+		this->width = width;
+		this->height = height;
+		// Register window class
+		WNDCLASSEX wc = { 0 };
+		wc.cbSize = sizeof(WNDCLASSEXA);
+		wc.style = CS_HREDRAW | CS_VREDRAW;
+		wc.lpfnWndProc = WindowsProcess;
+		wc.hInstance = GetModuleHandle(NULL);
+		wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+		wc.lpszClassName = L"NaShaderCompiler";
+		if (!RegisterClassEx(&wc))
+		{
+			MessageBoxA(NULL, "Failed to register window class", "Error", MB_OK | MB_ICONERROR);
+			return false;
+		}
+		// Create window
+		std::wstring wideTitle = std::wstring(title.begin(), title.end());
+		handl = CreateWindow(L"NaShaderCompiler", wideTitle.c_str(), WS_OVERLAPPEDWINDOW, 100, 100, width, height, NULL, NULL, GetModuleHandle(NULL), NULL);
+
+		if (handl == NULL)
+		{
+			MessageBoxA(NULL, "Failed to create window", "Error", MB_OK | MB_ICONERROR);
+			return false;
+		}
+
+		// Show window
+		ShowWindow(handl, SW_SHOWDEFAULT);
+		UpdateWindow(handl);
+		return true;
+	}
+
+	void Destroy() override
+	{
+		if (handl != NULL)
+		{
+			DestroyWindow(handl);
+			handl = NULL;
+		}
+	}
+
+	bool PumpEvents() override
+	{
+		MSG msg;
+		while (::PeekMessage(&msg, nullptr, 0U, 0U, PM_REMOVE))
+		{
+			::TranslateMessage(&msg);
+			::DispatchMessage(&msg);
+			if (msg.message == WM_QUIT)
+				quit = true;
+		}
+		return !quit;
+	}
+
+	void ImGuiInit() override
+	{
+		//ImGui::GetIO().Fonts->AddFontFromFileTTF("C:\\Windows\\Fonts\\CascadiaCode.ttf", 16.f);
+		ImGui::GetIO().Fonts->AddFontFromFileTTF("C:\\Windows\\Fonts\\msyh.ttc", 16.f);
+		ImGui_ImplWin32_Init(handl);
+	}
+
+	void ImGuiNewFrame() override
+	{
+		ImGui_ImplWin32_NewFrame();
+	}
+
+	void ImGuiShutdown() override
+	{
+		ImGui_ImplWin32_Shutdown();
+	}
+
+	void* GetNativeHandle() override
+	{
+		return handl;
+	}
+
+	void SetSize(int width, int height) override
+	{
+		if (handl != NULL)
+		{
+			RECT rect;
+			GetWindowRect(handl, &rect);
+			MoveWindow(handl, rect.left, rect.top, width, height, true);
+		}
+	}
+
+	void SetTitle(const std::string& title) override
+	{
+		if (handl != NULL)
+		{
+			SetWindowTextA(handl, title.c_str());
+		}
+	}
+
+	void Minimize() override
+	{
+		ShowWindow(handl, SW_MINIMIZE);
+	}
+
+	void Move(int offsetX, int offsetY) override
+	{
+		if (handl != NULL)
+		{
+			RECT rect;
+			GetWindowRect(handl, &rect);
+			MoveWindow(handl, rect.left + offsetX, rect.top + offsetY, rect.right - rect.left, rect.bottom - rect.top, true);
+		}
+	}
+
+	ImVec2 GetPosition() override
+	{
+		ImVec2 position = ImVec2(0, 0);
+		if (handl != NULL)
+		{
+			RECT rect;
+			GetWindowRect(handl, &rect);
+			position.x = (float)rect.left;
+			position.y = (float)rect.top;
+		}
+		return position;
+	}
+
+	std::string OpenFileDialog(const char* filter, const char* defaultExtension) override
+	{
+		OPENFILENAMEA ofn;
+		CHAR szFile[MAX_PATH] = { 0 };
+		ZeroMemory(&ofn, sizeof(ofn));
+		ofn.lStructSize = sizeof(ofn);
+		ofn.hwndOwner = handl;
+		ofn.lpstrFilter = filter;
+		ofn.lpstrFile = szFile;
+		ofn.nMaxFile = MAX_PATH;
+		ofn.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST | OFN_HIDEREADONLY;
+		ofn.lpstrDefExt = defaultExtension;
+		if (GetOpenFileNameA(&ofn))
+		{
+			return ofn.lpstrFile;
+		}
+		return "";
+	}
+};
\ No newline at end of file
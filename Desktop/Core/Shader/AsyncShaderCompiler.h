@@ -0,0 +1,190 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "../../Dependence/ThreadPool.h"
+#include "ShaderVariantSet.h"
+
+// Runs compiles through ShaderCache on a ThreadPool. Finished jobs wait in a completion queue until the
+// owning thread calls Drain, so callbacks (and device object creation) happen where the caller wants them.
+// A cancelled job skips its compile if it has not started, a running compile cannot be stopped, but its
+// result is dropped at Drain. The callback still runs, with state Cancelled, so the submitter can account for it.
+class AsyncShaderCompiler
+{
+public:
+	enum class State
+	{
+		Queued,
+		Compiling,
+		Ready,
+		Failed,
+		Cancelled
+	};
+
+	class Job
+	{
+	public:
+		uint64_t id = 0;
+		std::atomic<State> state{ State::Queued };
+		ShaderCompiler::Request request = ShaderCompiler::Request();
+		ShaderCompiler::Result result = ShaderCompiler::Result();
+		std::chrono::steady_clock::time_point submitted = {};
+		// Around the compile on the worker, started stays empty for a job cancelled before it ran
+		std::chrono::steady_clock::time_point started = {};
+		std::chrono::steady_clock::time_point finished = {};
+		std::atomic<bool> cancelled{ false };
+		// Left to the submitter, which compares it with what is current once the job completes
+		uint64_t version = 0;
+		// Set for jobs building every variant, result is then the one of variant
+		std::shared_ptr<ShaderVariantSet> variants = nullptr;
+		ShaderPermutations::Key variant = 0;
+		// Runs on the thread calling Drain
+		std::function<void(Job&)> completed = nullptr;
+	};
+
+	class Statistics
+	{
+	public:
+		uint64_t submitted = 0;
+		uint64_t completed = 0;
+		uint64_t failed = 0;
+		// Cancelled before they ran, and cancelled while compiling so the result was thrown away
+		uint64_t cancelled = 0;
+		uint64_t discarded = 0;
+		// Milliseconds from Submit until the job was drained
+		float lastLatency = 0.f;
+		float maxLatency = 0.f;
+	};
+
+private:
+	std::mutex mutex = {};
+	std::vector<std::shared_ptr<Job>> finished = {};
+	std::atomic<uint64_t> nextId{ 1 };
+	std::atomic<uint32_t> inFlight{ 0 };
+
+public:
+	ThreadPool* pool = nullptr;
+	ShaderCompiler* compiler = nullptr;
+	ShaderCache* cache = nullptr;
+	Statistics statistics = Statistics();
+
+	AsyncShaderCompiler() {}
+	AsyncShaderCompiler(ThreadPool* pool, ShaderCompiler* compiler, ShaderCache* cache) : pool(pool), compiler(compiler), cache(cache) {}
+	AsyncShaderCompiler(const AsyncShaderCompiler&) = delete;
+	AsyncShaderCompiler& operator=(const AsyncShaderCompiler&) = delete;
+
+private:
+	std::shared_ptr<Job> Enqueue(std::shared_ptr<Job> job)
+	{
+		job->id = nextId.fetch_add(1);
+		job->submitted = std::chrono::steady_clock::now();
+		statistics.submitted++;
+		inFlight.fetch_add(1);
+		pool->AddTask([this, job]() {
+			if (job->cancelled)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				finished.push_back(job);
+				return;
+			}
+			job->state = State::Compiling;
+			job->started = std::chrono::steady_clock::now();
+			if (job->variants != nullptr)
+			{
+				TIMELINE_ZONE("Shader Variants");
+				std::string error = "";
+				if (!job->variants->Build(pool, compiler, cache, job->request, error))
+					job->result.log = error;
+				else if (job->variants->Find(job->variant) != nullptr)
+					job->result = *job->variants->Find(job->variant);
+			}
+			else
+			{
+				TIMELINE_ZONE("Shader Compile");
+				job->result = cache != nullptr ? cache->Compile(compiler, job->request) : compiler->Compile(job->request);
+			}
+			job->finished = std::chrono::steady_clock::now();
+			std::lock_guard<std::mutex> lock(mutex);
+			finished.push_back(job);
+			});
+		return job;
+	}
+
+public:
+	// The returned job can be polled for its state, nullptr when no compiler or pool is set
+	std::shared_ptr<Job> Submit(const ShaderCompiler::Request& request, std::function<void(Job&)> completed)
+	{
+		if (compiler == nullptr || pool == nullptr)
+			return nullptr;
+		std::shared_ptr<Job> job = std::make_shared<Job>();
+		job->request = request;
+		job->completed = completed;
+		return Enqueue(job);
+	}
+
+	// Builds every variant of variants from request in one job, the job's result is the one of variant
+	std::shared_ptr<Job> SubmitVariants(const ShaderCompiler::Request& request, std::shared_ptr<ShaderVariantSet> variants,
+		ShaderPermutations::Key variant, std::function<void(Job&)> completed)
+	{
+		if (compiler == nullptr || pool == nullptr || variants == nullptr)
+			return nullptr;
+		std::shared_ptr<Job> job = std::make_shared<Job>();
+		job->request = request;
+		job->variants = variants;
+		job->variant = variant;
+		job->completed = completed;
+		return Enqueue(job);
+	}
+
+	// The job's callback runs with state Cancelled, thread safe
+	void Cancel(const std::shared_ptr<Job>& job)
+	{
+		if (job != nullptr)
+			job->cancelled = true;
+	}
+
+	// Runs the callbacks of every finished job, returns how many left the queue, cancelled ones included
+	size_t Drain()
+	{
+		std::vector<std::shared_ptr<Job>> jobs = {};
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (finished.empty())
+				return 0;
+			jobs.swap(finished);
+		}
+		const auto now = std::chrono::steady_clock::now();
+		for (const std::shared_ptr<Job>& pointer : jobs)
+		{
+			Job& job = *pointer;
+			inFlight.fetch_sub(1);
+			if (job.cancelled)
+			{
+				job.state = State::Cancelled;
+				(job.started == std::chrono::steady_clock::time_point() ? statistics.cancelled : statistics.discarded)++;
+				if (job.completed)
+					job.completed(job);
+				continue;
+			}
+			job.state = job.result.success ? State::Ready : State::Failed;
+			statistics.completed++;
+			if (!job.result.success)
+				statistics.failed++;
+			statistics.lastLatency = std::chrono::duration<float, std::milli>(now - job.submitted).count();
+			statistics.maxLatency = std::max(statistics.maxLatency, statistics.lastLatency);
+			if (job.completed)
+				job.completed(job);
+		}
+		return jobs.size();
+	}
+
+	// Jobs submitted but not drained yet, thread safe
+	uint32_t InFlight() const
+	{
+		return inFlight.load();
+	}
+};
\ No newline at end of file
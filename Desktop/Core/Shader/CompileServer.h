@@ -0,0 +1,149 @@
+#pragma once
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "../../Dependence/ConnectionServer.h"
+#include "../../Dependence/LocalSocket.h"
+#include "CompilerProtocol.h"
+
+// Serves compiles to the other processes of this machine over a LocalListener, so preview instances and batch
+// jobs share one cache and one set of compiler workers. A request identical to one being compiled waits for that
+// compile instead of starting its own. Each connection is served on its own thread, how many compiles run at
+// once is up to the compiler.
+class CompileServer
+{
+public:
+	class Statistics
+	{
+	public:
+		uint64_t connections = 0;
+		uint64_t requests = 0;
+		uint64_t hits = 0;
+		uint64_t compiles = 0;
+		// Requests that waited for an identical one already compiling
+		uint64_t deduplicated = 0;
+	};
+
+private:
+	// A client stalling in the middle of a frame is dropped after this long
+	static constexpr uint32_t FrameTimeout = 30000;
+
+	class Flight
+	{
+	public:
+		bool done = false;
+		ShaderCompiler::Result result = ShaderCompiler::Result();
+	};
+
+	ShaderCompiler* compiler = nullptr;
+	ShaderCache* cache = nullptr;
+	ConnectionServer<LocalListener, LocalConnection> connections;
+	std::mutex mutex;
+	std::condition_variable landed;
+	std::unordered_map<std::string, std::shared_ptr<Flight>> flights = {};
+	Statistics statistics = Statistics();
+
+	void Serve(LocalConnection& connection)
+	{
+		auto read = [&](void* data, size_t size, bool frameStart) {
+			uint8_t* bytes = (uint8_t*)data;
+			if (frameStart)
+			{
+				// One byte at a time while idle, a timeout then never drops part of a frame
+				LocalConnection::Status status = LocalConnection::Status::Timeout;
+				while (status == LocalConnection::Status::Timeout && !connections.IsStopping())
+					status = connection.Read(bytes, 1, connections.PollInterval);
+				if (status != LocalConnection::Status::Ok)
+					return false;
+				bytes++;
+				size--;
+			}
+			return connection.Read(bytes, size, FrameTimeout) == LocalConnection::Status::Ok;
+			};
+		auto write = [&](const void* data, size_t size) { return connection.Write(data, size); };
+		CompilerProtocol::Serve([this](const ShaderCompiler::Request& request) { return Compile(request); }, read, write);
+	}
+
+public:
+	CompileServer(ShaderCompiler* compiler, ShaderCache* cache) : compiler(compiler), cache(cache) {}
+
+	~CompileServer()
+	{
+		Stop();
+	}
+
+	bool Start(const std::string& name, std::string& error)
+	{
+		if (!connections.listener.Listen(name, error))
+			return false;
+		connections.Start([this](LocalConnection& connection) { Serve(connection); });
+		return true;
+	}
+
+	// Waits for the compiles in progress, idle connections are closed
+	void Stop()
+	{
+		connections.Stop();
+	}
+
+	// Answers from the cache, from an identical compile in flight, or compiles and stores. Thread safe.
+	ShaderCompiler::Result Compile(const ShaderCompiler::Request& request)
+	{
+		std::string preprocessed = "", log = "";
+		std::vector<ShaderCompiler::Include> includes = {};
+		if (!compiler->Preprocess(request, preprocessed, log, includes))
+		{
+			// Fails again in the compiler, which reports it properly
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				statistics.requests++;
+				statistics.compiles++;
+			}
+			return compiler->Compile(request);
+		}
+		const ShaderCache::Key key = ShaderCache::MakeKey(compiler, request, preprocessed);
+		const std::string name = Sha256::ToHex(key);
+		std::shared_ptr<Flight> flight = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			statistics.requests++;
+			auto it = flights.find(name);
+			if (it != flights.end())
+			{
+				flight = it->second;
+				statistics.deduplicated++;
+				landed.wait(lock, [&flight]() { return flight->done; });
+				ShaderCompiler::Result result = flight->result;
+				result.cached = true;
+				return result;
+			}
+			flight = std::make_shared<Flight>();
+			flights[name] = flight;
+		}
+		// Only the first of identical requests gets here, so the lookup cannot race with its own store
+		ShaderCompiler::Result result;
+		const bool hit = cache->Lookup(key, result);
+		if (!hit)
+		{
+			result = compiler->Compile(request);
+			cache->Store(key, result);
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		(hit ? statistics.hits : statistics.compiles)++;
+		flight->result = result;
+		flight->done = true;
+		flights.erase(name);
+		landed.notify_all();
+		return result;
+	}
+
+	Statistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Statistics result = statistics;
+		result.connections = connections.GetConnections();
+		return result;
+	}
+};
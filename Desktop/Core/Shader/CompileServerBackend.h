@@ -0,0 +1,142 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../../Dependence/LocalSocket.h"
+#include "CompilerProtocol.h"
+
+// Sends compiles to the CompileServer of this machine (the batch compiler started with --serve). Sources are
+// preprocessed here like fallback would, the server only sees self contained source. Without a server, or when
+// it fails to answer, the compile runs on fallback, and connecting is tried again only after retryInterval, so
+// tools work the same whether a server runs or not.
+class CompileServerBackend : public ShaderCompiler
+{
+public:
+	class Statistics
+	{
+	public:
+		uint64_t served = 0;
+		// Answered by the server's cache or by an identical compile of another client
+		uint64_t shared = 0;
+		uint64_t fallbacks = 0;
+	};
+
+	std::string name = "";
+	ShaderCompiler* fallback = nullptr;
+	// Milliseconds to wait for the server's answer to one compile
+	uint32_t timeout = 60000;
+	uint32_t retryInterval = 5000;
+
+private:
+	std::mutex mutex;
+	// Connections not in use, one per compile running at once
+	std::vector<std::unique_ptr<LocalConnection>> idle = {};
+	std::chrono::steady_clock::time_point retryAt = {};
+	Statistics statistics = Statistics();
+	// Preprocesses when there is no fallback
+	ShaderPreprocessor preprocessor = ShaderPreprocessor();
+
+	std::unique_ptr<LocalConnection> Acquire()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!idle.empty())
+			{
+				std::unique_ptr<LocalConnection> connection = std::move(idle.back());
+				idle.pop_back();
+				return connection;
+			}
+			if (std::chrono::steady_clock::now() < retryAt)
+				return nullptr;
+		}
+		std::unique_ptr<LocalConnection> connection = std::make_unique<LocalConnection>();
+		std::string error = "";
+		if (connection->Connect(name, timeout, error))
+			return connection;
+		std::lock_guard<std::mutex> lock(mutex);
+		retryAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(retryInterval);
+		return nullptr;
+	}
+
+	bool Exchange(LocalConnection& connection, const Request& request, const std::string& source, Result& result)
+	{
+		CompilerProtocol::Writer writer;
+		writer.Begin(CompilerProtocol::FrameType::Requests);
+		writer.U32(1);
+		CompilerProtocol::WriteRequest(writer, request, source);
+		writer.Finish();
+		if (!connection.Write(writer.data.data(), writer.data.size()))
+			return false;
+		uint8_t header[CompilerProtocol::HeaderSize];
+		CompilerProtocol::FrameType type = CompilerProtocol::FrameType::Result;
+		uint32_t size = 0;
+		if (connection.Read(header, sizeof(header), timeout) != LocalConnection::Status::Ok || !CompilerProtocol::ParseHeader(header, type, size)
+			|| type != CompilerProtocol::FrameType::Result)
+			return false;
+		std::vector<uint8_t> payload(size);
+		if (connection.Read(payload.data(), size, timeout) != LocalConnection::Status::Ok)
+			return false;
+		CompilerProtocol::Reader reader(payload.data(), payload.size());
+		return CompilerProtocol::ReadResult(reader, result) == 0 && !reader.failed;
+	}
+
+protected:
+	void CompileSource(const Request& request, Result& result) override
+	{
+		std::string source = "";
+		if (!Preprocess(request, source, result.log, result.includes))
+			return;
+		std::unique_ptr<LocalConnection> connection = Acquire();
+		if (connection != nullptr && Exchange(*connection, request, source, result))
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			statistics.served++;
+			statistics.shared += result.cached ? 1 : 0;
+			idle.push_back(std::move(connection));
+			return;
+		}
+		// A connection that failed mid-compile is dropped, the server may be gone
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			statistics.fallbacks++;
+			if (connection != nullptr)
+				retryAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(retryInterval);
+		}
+		if (fallback == nullptr)
+		{
+			result = Result();
+			result.log = (request.sourceName.empty() ? "Source" : request.sourceName) + "(1,1): error X0000: compile server " + name + " is not available\n";
+			return;
+		}
+		result = fallback->Compile(request);
+	}
+
+public:
+	CompileServerBackend(const std::string& name, ShaderCompiler* fallback) : name(name), fallback(fallback) {}
+
+	// Named like the backend it stands in for, it compiles the same way and shares its cache keys
+	const char* GetName() const override
+	{
+		return fallback != nullptr ? fallback->GetName() : "Compile server";
+	}
+
+	bool ExpandsDefines() const override
+	{
+		return fallback != nullptr ? fallback->ExpandsDefines() : true;
+	}
+
+	bool Preprocess(const Request& request, std::string& output, std::string& log, std::vector<Include>& includes) override
+	{
+		if (fallback != nullptr)
+			return fallback->Preprocess(request, output, log, includes);
+		return preprocessor.Run(request, output, log, includes);
+	}
+
+	Statistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return statistics;
+	}
+};
@@ -0,0 +1,186 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <string>
+#include "ShaderCompiler.h"
+#include "ShaderPermutations.h"
+
+// One record per compile submitted for a shader, from the queue to the device object or to where it was dropped.
+// Kept in memory for the Shader Manager's telemetry tab and exported as CSV or JSON, so runs of different versions
+// can be compared. Only touched on the main thread.
+class CompileTelemetry
+{
+public:
+	enum class Outcome
+	{
+		// The result reached the shader
+		Applied,
+		// Finished after a later compile or edit of the shader had replaced it
+		Superseded,
+		// Cancelled before it ran, or while compiling and its result was thrown away
+		Cancelled
+	};
+
+	class Record
+	{
+	public:
+		uint64_t sequence = 0;
+		// Milliseconds from the first record to the submit of this compile
+		double time = 0.0;
+		std::string shaderId = "";
+		std::string shader = "";
+		// Why the compile started: manual, edited, file or include changed, variant
+		std::string trigger = "";
+		std::string target = "";
+		ShaderPermutations::Key variant = 0;
+		// Milliseconds waiting for a worker, preprocessing, in the compiler, creating the device object, and from
+		// submit until the result was applied or dropped
+		float queue = 0.f;
+		float preprocess = 0.f;
+		float compile = 0.f;
+		float create = 0.f;
+		float total = 0.f;
+		uint64_t bytecodeSize = 0;
+		ShaderCompiler::CacheTier cacheTier = ShaderCompiler::CacheTier::None;
+		bool success = false;
+		Outcome outcome = Outcome::Applied;
+	};
+
+	// Oldest records are dropped past this
+	size_t capacity = 8192;
+
+private:
+	std::deque<Record> records = {};
+	uint64_t nextSequence = 1;
+	std::chrono::steady_clock::time_point start = {};
+
+	static std::string CsvField(const std::string& text)
+	{
+		if (text.find_first_of(",\"\r\n") == std::string::npos)
+			return text;
+		std::string quoted = "\"";
+		for (char c : text)
+			quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+		return quoted + "\"";
+	}
+
+	static std::string JsonString(const std::string& text)
+	{
+		std::string escaped = "\"";
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+			{
+				escaped += '\\';
+				escaped += c;
+			}
+			else if ((unsigned char)c < 0x20)
+			{
+				char code[8];
+				snprintf(code, sizeof(code), "\\u%04x", (unsigned)c);
+				escaped += code;
+			}
+			else
+			{
+				escaped += c;
+			}
+		}
+		return escaped + "\"";
+	}
+
+public:
+	static const char* GetTierName(ShaderCompiler::CacheTier tier)
+	{
+		switch (tier)
+		{
+		case ShaderCompiler::CacheTier::Memory:
+			return "memory";
+		case ShaderCompiler::CacheTier::Disk:
+			return "disk";
+		case ShaderCompiler::CacheTier::Remote:
+			return "remote";
+		default:
+			return "compiler";
+		}
+	}
+
+	static const char* GetOutcomeName(Outcome outcome)
+	{
+		switch (outcome)
+		{
+		case Outcome::Superseded:
+			return "superseded";
+		case Outcome::Cancelled:
+			return "cancelled";
+		default:
+			return "applied";
+		}
+	}
+
+	// submitted is when the compile was queued, time is taken relative to the first record
+	void Add(Record record, std::chrono::steady_clock::time_point submitted)
+	{
+		if (nextSequence == 1)
+			start = submitted;
+		record.sequence = nextSequence++;
+		record.time = std::chrono::duration<double, std::milli>(submitted - start).count();
+		records.push_back(record);
+		while (records.size() > capacity)
+			records.pop_front();
+	}
+
+	const std::deque<Record>& GetRecords() const
+	{
+		return records;
+	}
+
+	void Clear()
+	{
+		records.clear();
+	}
+
+	bool ExportCsv(const std::string& path) const
+	{
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+		file << "sequence,time_ms,shader_id,shader,trigger,target,variant,queue_ms,preprocess_ms,compile_ms,create_ms,total_ms,bytecode_bytes,cache_tier,success,outcome\n";
+		for (const Record& record : records)
+		{
+			file << record.sequence << "," << record.time << "," << CsvField(record.shaderId) << "," << CsvField(record.shader) << ","
+				<< CsvField(record.trigger) << "," << CsvField(record.target) << "," << record.variant << "," << record.queue << ","
+				<< record.preprocess << "," << record.compile << "," << record.create << "," << record.total << "," << record.bytecodeSize << ","
+				<< GetTierName(record.cacheTier) << "," << (record.success ? 1 : 0) << "," << GetOutcomeName(record.outcome) << "\n";
+		}
+		return file.good();
+	}
+
+	bool ExportJson(const std::string& path) const
+	{
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+		file << "{\"version\":1,\"compiles\":[";
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			const Record& record = records[i];
+			file << (i == 0 ? "" : ",") << "\n{\"sequence\":" << record.sequence << ",\"time\":" << record.time << ",\"shaderId\":" << JsonString(record.shaderId)
+				<< ",\"shader\":" << JsonString(record.shader) << ",\"trigger\":" << JsonString(record.trigger) << ",\"target\":" << JsonString(record.target)
+				<< ",\"variant\":" << record.variant << ",\"queue\":" << record.queue << ",\"preprocess\":" << record.preprocess << ",\"compile\":"
+				<< record.compile << ",\"create\":" << record.create << ",\"total\":" << record.total << ",\"bytecodeSize\":" << record.bytecodeSize
+				<< ",\"cacheTier\":\"" << GetTierName(record.cacheTier) << "\",\"success\":" << (record.success ? "true" : "false")
+				<< ",\"outcome\":\"" << GetOutcomeName(record.outcome) << "\"}";
+		}
+		file << "\n]}\n";
+		return file.good();
+	}
+
+	// Picks the format from the extension, .json or anything else for CSV
+	bool Export(const std::string& path) const
+	{
+		const size_t dot = path.rfind('.');
+		return dot != std::string::npos && path.substr(dot) == ".json" ? ExportJson(path) : ExportCsv(path);
+	}
+};
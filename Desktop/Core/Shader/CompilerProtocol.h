@@ -0,0 +1,228 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Framing between the app and compiler worker processes or a compile server. A frame is a 12 byte header of magic, type and payload
+// size, then the payload: integers little endian, strings and byte arrays prefixed with their size. The app sends
+// one Requests frame with a batch of jobs and the worker answers with one Result frame per job as soon as it is
+// done, so a job that hangs or crashes the worker can be told apart from the ones finished before it.
+class CompilerProtocol
+{
+public:
+	static constexpr uint32_t Magic = 0x5743534e; // "NSCW"
+	static constexpr uint32_t HeaderSize = 12;
+	// Anything larger is taken as a corrupt stream
+	static constexpr uint32_t MaxFrameSize = 256u << 20;
+
+	enum class FrameType : uint32_t
+	{
+		Requests = 1,
+		Result = 2
+	};
+
+	class Writer
+	{
+	public:
+		std::vector<uint8_t> data = {};
+
+		void U32(uint32_t value)
+		{
+			uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+			data.insert(data.end(), bytes, bytes + 4);
+		}
+
+		void F32(float value)
+		{
+			uint32_t bits = 0;
+			memcpy(&bits, &value, 4);
+			U32(bits);
+		}
+
+		void Bytes(const void* bytes, size_t size)
+		{
+			U32((uint32_t)size);
+			data.insert(data.end(), (const uint8_t*)bytes, (const uint8_t*)bytes + size);
+		}
+
+		void String(const std::string& text)
+		{
+			Bytes(text.data(), text.size());
+		}
+
+		// Starts a frame, Finish fills in its size
+		void Begin(FrameType type)
+		{
+			data.clear();
+			U32(Magic);
+			U32((uint32_t)type);
+			U32(0);
+		}
+
+		void Finish()
+		{
+			const uint32_t size = (uint32_t)(data.size() - HeaderSize);
+			for (int i = 0; i < 4; i++)
+				data[8 + i] = (uint8_t)(size >> (i * 8));
+		}
+	};
+
+	// Reads past the end fail once and then return zeros, check failed at the end
+	class Reader
+	{
+	public:
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		size_t position = 0;
+		bool failed = false;
+
+		Reader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+		uint32_t U32()
+		{
+			if (failed || size - position < 4)
+			{
+				failed = true;
+				return 0;
+			}
+			const uint8_t* bytes = data + position;
+			position += 4;
+			return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+		}
+
+		float F32()
+		{
+			const uint32_t bits = U32();
+			float value = 0.f;
+			memcpy(&value, &bits, 4);
+			return value;
+		}
+
+		const uint8_t* Bytes(size_t& length)
+		{
+			length = U32();
+			if (failed || size - position < length)
+			{
+				failed = true;
+				length = 0;
+				return nullptr;
+			}
+			const uint8_t* bytes = data + position;
+			position += length;
+			return bytes;
+		}
+
+		std::string String()
+		{
+			size_t length = 0;
+			const uint8_t* bytes = Bytes(length);
+			return std::string((const char*)bytes, length);
+		}
+	};
+
+	static bool ParseHeader(const uint8_t* header, FrameType& type, uint32_t& size)
+	{
+		Reader reader(header, HeaderSize);
+		const uint32_t magic = reader.U32();
+		type = (FrameType)reader.U32();
+		size = reader.U32();
+		return magic == Magic && size <= MaxFrameSize && (type == FrameType::Requests || type == FrameType::Result);
+	}
+
+	// The resolver does not cross the process boundary, source must already have its includes inlined
+	static void WriteRequest(Writer& writer, const ShaderCompiler::Request& request, const std::string& source)
+	{
+		writer.String(source);
+		writer.String(request.sourceName);
+		writer.String(request.entry);
+		writer.String(request.target);
+		writer.U32((uint32_t)request.defines.size());
+		for (const auto& define : request.defines)
+		{
+			writer.String(define.first);
+			writer.String(define.second);
+		}
+		writer.U32(request.flags);
+	}
+
+	static void ReadRequest(Reader& reader, ShaderCompiler::Request& request)
+	{
+		request.source = reader.String();
+		request.sourceName = reader.String();
+		request.entry = reader.String();
+		request.target = reader.String();
+		const uint32_t defines = reader.U32();
+		for (uint32_t i = 0; i < defines && !reader.failed; i++)
+		{
+			std::string name = reader.String();
+			request.defines.push_back({ name, reader.String() });
+		}
+		request.flags = reader.U32();
+	}
+
+	// Diagnostics are parsed again from the log on the app side, includes are known there already
+	static void WriteResult(Writer& writer, uint32_t index, const ShaderCompiler::Result& result)
+	{
+		writer.U32(index);
+		writer.U32((result.success ? 1 : 0) | (result.cached ? 2 : 0));
+		writer.F32(result.compileTime);
+		writer.Bytes(result.bytecode.data(), result.bytecode.size());
+		writer.String(result.log);
+	}
+
+	static uint32_t ReadResult(Reader& reader, ShaderCompiler::Result& result)
+	{
+		const uint32_t index = reader.U32();
+		const uint32_t flags = reader.U32();
+		result.success = (flags & 1) != 0;
+		result.cached = (flags & 2) != 0;
+		result.compileTime = reader.F32();
+		size_t size = 0;
+		const uint8_t* bytecode = reader.Bytes(size);
+		result.bytecode.assign(bytecode, bytecode + size);
+		result.log = reader.String();
+		return index;
+	}
+
+	// Answers Requests frames read through read until the stream ends, 0 on a clean end and 1 on a broken stream.
+	// read is told when it waits for the header of the next frame, which may take as long as the client likes.
+	static int Serve(const std::function<ShaderCompiler::Result(const ShaderCompiler::Request&)>& compile, const std::function<bool(void*, size_t, bool)>& read,
+		const std::function<bool(const void*, size_t)>& write)
+	{
+		uint8_t header[HeaderSize];
+		std::vector<uint8_t> payload = {};
+		Writer writer;
+		while (read(header, HeaderSize, true))
+		{
+			FrameType type = FrameType::Requests;
+			uint32_t size = 0;
+			if (!ParseHeader(header, type, size) || type != FrameType::Requests)
+				return 1;
+			payload.resize(size);
+			if (!read(payload.data(), size, false))
+				return 1;
+			Reader reader(payload.data(), payload.size());
+			// A request takes at least 24 bytes, its four string sizes, the define count and the flags
+			const uint32_t count = reader.U32();
+			if (reader.failed || count > size / 24)
+				return 1;
+			std::vector<ShaderCompiler::Request> requests(count);
+			for (ShaderCompiler::Request& request : requests)
+				ReadRequest(reader, request);
+			if (reader.failed)
+				return 1;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const ShaderCompiler::Result result = compile(requests[i]);
+				writer.Begin(FrameType::Result);
+				WriteResult(writer, i, result);
+				writer.Finish();
+				if (!write(writer.data.data(), writer.data.size()))
+					return 1;
+			}
+		}
+		return 0;
+	}
+};
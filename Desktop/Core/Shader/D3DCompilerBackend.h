@@ -0,0 +1,142 @@
+#pragma once
+#include <filesystem>
+#include <unordered_map>
+#include <d3dcompiler.h>
+#pragma comment(lib, "d3dcompiler.lib")
+
+// Answers the #include requests of one D3DCompile or D3DPreprocess call from an IncludeResolver
+// and records every file opened. Contents stay alive until the handler is destroyed.
+class D3DIncludeHandler : public ID3DInclude
+{
+private:
+	const ShaderCompiler::Request& request;
+	std::vector<ShaderCompiler::Include>& includes;
+	// Data handed to the compiler -> path of that file, nested includes name their parent by its data
+	std::unordered_map<const void*, std::string> opened = {};
+	std::vector<IncludeResolver::Content> contents = {};
+
+public:
+	D3DIncludeHandler(const ShaderCompiler::Request& request, std::vector<ShaderCompiler::Include>& includes) : request(request), includes(includes) {}
+
+	HRESULT STDMETHODCALLTYPE Open(D3D_INCLUDE_TYPE type, LPCSTR fileName, LPCVOID parentData, LPCVOID* data, UINT* bytes) override
+	{
+		auto parent = opened.find(parentData);
+		const std::string parentPath = parent != opened.end() ? parent->second : "";
+		const std::string directory = parentPath.empty() ? request.directory : std::filesystem::path(parentPath).parent_path().string();
+		std::string path = "";
+		IncludeResolver::Content content = nullptr;
+		if (request.resolver == nullptr || !request.resolver->Open(fileName, type == D3D_INCLUDE_SYSTEM, directory, path, content))
+			return E_FAIL;
+		ShaderCompiler::AddInclude(includes, path, parentPath);
+		opened[content->data()] = path;
+		contents.push_back(content);
+		*data = content->data();
+		*bytes = (UINT)content->size();
+		return S_OK;
+	}
+
+	// The same header may be open more than once, everything is released with the handler
+	HRESULT STDMETHODCALLTYPE Close(LPCVOID data) override
+	{
+		return S_OK;
+	}
+};
+
+// D3DCompile from d3dcompiler_47, safe to call from several threads at once
+class D3DCompilerBackend : public ShaderCompiler
+{
+protected:
+	static UINT TranslateFlags(uint32_t flags)
+	{
+		UINT result = 0;
+		if (flags & Flags::Debug)
+			result |= D3DCOMPILE_DEBUG;
+		if (flags & Flags::SkipOptimization)
+			result |= D3DCOMPILE_SKIP_OPTIMIZATION;
+		if (flags & Flags::OptimizationLevel3)
+			result |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
+		if (flags & Flags::WarningsAreErrors)
+			result |= D3DCOMPILE_WARNINGS_ARE_ERRORS;
+		if (flags & Flags::PackMatrixRowMajor)
+			result |= D3DCOMPILE_PACK_MATRIX_ROW_MAJOR;
+		return result;
+	}
+
+	static std::vector<D3D_SHADER_MACRO> TranslateDefines(const Request& request)
+	{
+		std::vector<D3D_SHADER_MACRO> macros = {};
+		for (const auto& define : request.defines)
+			macros.push_back({ define.first.c_str(), define.second.c_str() });
+		macros.push_back({ nullptr, nullptr });
+		return macros;
+	}
+
+	static std::string ReadBlob(ID3DBlob* blob)
+	{
+		const char* text = (const char*)blob->GetBufferPointer();
+		return std::string(text, strnlen(text, blob->GetBufferSize()));
+	}
+
+	void CompileSource(const Request& request, Result& result) override
+	{
+		std::vector<D3D_SHADER_MACRO> macros = TranslateDefines(request);
+		D3DIncludeHandler handler(request, result.includes);
+
+		ID3DBlob* blob = nullptr;
+		ID3DBlob* error = nullptr;
+		HRESULT hr = D3DCompile(request.source.c_str(), request.source.size(), request.sourceName.empty() ? nullptr : request.sourceName.c_str(),
+			macros.data(), &handler, request.entry.c_str(), request.target.c_str(), TranslateFlags(request.flags), 0, &blob, &error);
+		if (error != nullptr)
+		{
+			result.log = ReadBlob(error);
+			error->Release();
+		}
+		if (FAILED(hr))
+		{
+			if (result.log.empty())
+			{
+				char buffer[64];
+				snprintf(buffer, sizeof(buffer), "Unknown error (%lx)", (unsigned long)hr);
+				result.log = buffer;
+			}
+			if (blob != nullptr)
+				blob->Release();
+			return;
+		}
+		const uint8_t* data = (const uint8_t*)blob->GetBufferPointer();
+		result.bytecode.assign(data, data + blob->GetBufferSize());
+		blob->Release();
+		result.success = true;
+	}
+
+public:
+	const char* GetName() const override
+	{
+		return "D3DCompile";
+	}
+
+	bool ExpandsDefines() const override
+	{
+		return true;
+	}
+
+	bool Preprocess(const Request& request, std::string& output, std::string& log, std::vector<Include>& includes) override
+	{
+		std::vector<D3D_SHADER_MACRO> macros = TranslateDefines(request);
+		D3DIncludeHandler handler(request, includes);
+		ID3DBlob* blob = nullptr;
+		ID3DBlob* error = nullptr;
+		HRESULT hr = D3DPreprocess(request.source.c_str(), request.source.size(), request.sourceName.empty() ? nullptr : request.sourceName.c_str(),
+			macros.data(), &handler, &blob, &error);
+		if (error != nullptr)
+		{
+			log = ReadBlob(error);
+			error->Release();
+		}
+		if (FAILED(hr) || blob == nullptr)
+			return false;
+		output = ReadBlob(blob);
+		blob->Release();
+		return true;
+	}
+};
\ No newline at end of file
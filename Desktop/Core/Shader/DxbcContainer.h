@@ -0,0 +1,445 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Reader for the DXBC container D3DCompile produces, without the Windows reflection API: the header with its
+// checksum, the chunk table, input and output signatures, and the SM4/SM5 token stream of SHDR or SHEX.
+// Parse only keeps pointers into the bytes it was given, they have to outlive it. Instructions are counted by
+// class from their opcodes, operands are not decoded beyond what the declarations need.
+class DxbcContainer
+{
+public:
+	using Checksum = std::array<uint8_t, 16>;
+
+	static constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)(uint8_t)a | (uint32_t)(uint8_t)b << 8 | (uint32_t)(uint8_t)c << 16 | (uint32_t)(uint8_t)d << 24;
+	}
+
+	// "DXBC"
+	static constexpr uint32_t Magic = 0x43425844;
+
+	class Chunk
+	{
+	public:
+		uint32_t fourcc = 0;
+		const uint8_t* data = nullptr;
+		uint32_t size = 0;
+
+		std::string GetName() const
+		{
+			return std::string((const char*)&fourcc, 4);
+		}
+	};
+
+	class SignatureElement
+	{
+	public:
+		std::string semantic = "";
+		uint32_t semanticIndex = 0;
+		// D3D_NAME and D3D_REGISTER_COMPONENT_TYPE values
+		uint32_t systemValue = 0;
+		uint32_t componentType = 0;
+		uint32_t registerIndex = 0;
+		uint8_t mask = 0;
+		uint8_t readWriteMask = 0;
+	};
+
+	enum class ProgramType
+	{
+		Pixel,
+		Vertex,
+		Geometry,
+		Hull,
+		Domain,
+		Compute
+	};
+
+	enum class InstructionClass
+	{
+		Alu,
+		Texture,
+		FlowControl,
+		// Stores, atomics, barriers, emits and nops
+		Other,
+		Declaration
+	};
+
+	class Statistics
+	{
+	public:
+		ProgramType programType = ProgramType::Pixel;
+		uint32_t major = 0;
+		uint32_t minor = 0;
+		// Executed instructions, declarations and embedded data excluded
+		uint32_t instructions = 0;
+		uint32_t alu = 0;
+		// Texture samples, loads and resource queries
+		uint32_t texture = 0;
+		uint32_t flowControl = 0;
+		uint32_t other = 0;
+		uint32_t declarations = 0;
+		uint32_t temps = 0;
+		uint32_t indexableTemps = 0;
+		uint32_t resources = 0;
+		uint32_t samplers = 0;
+		uint32_t constantBuffers = 0;
+		uint32_t unorderedAccessViews = 0;
+	};
+
+	Checksum checksum = {};
+	// Whether the checksum in the header matches the content
+	bool checksumValid = false;
+	std::vector<Chunk> chunks = {};
+	std::vector<SignatureElement> inputs = {};
+	std::vector<SignatureElement> outputs = {};
+	// Only filled when the container has a token stream
+	bool hasProgram = false;
+	Statistics statistics = Statistics();
+
+private:
+	static constexpr uint32_t HeaderSize = 32;
+	static constexpr uint32_t CustomDataOpcode = 53;
+
+	static uint32_t Read32(const uint8_t* data)
+	{
+		uint32_t value = 0;
+		memcpy(&value, data, 4);
+		return value;
+	}
+
+	static uint32_t Rotate(uint32_t value, int count)
+	{
+		return (value << count) | (value >> (32 - count));
+	}
+
+	// One MD5 block
+	static void Transform(uint32_t state[4], const uint8_t block[64])
+	{
+		static const uint32_t k[64] = {
+			0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+			0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+			0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+			0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+			0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+			0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+			0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+			0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+		};
+		static const int shifts[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+		uint32_t words[16];
+		for (int i = 0; i < 16; i++)
+			words[i] = Read32(block + i * 4);
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+		for (int i = 0; i < 64; i++)
+		{
+			uint32_t f = 0;
+			int g = 0;
+			if (i < 16)
+			{
+				f = (b & c) | (~b & d);
+				g = i;
+			}
+			else if (i < 32)
+			{
+				f = (d & b) | (~d & c);
+				g = (5 * i + 1) % 16;
+			}
+			else if (i < 48)
+			{
+				f = b ^ c ^ d;
+				g = (3 * i + 5) % 16;
+			}
+			else
+			{
+				f = c ^ (b | ~d);
+				g = (7 * i) % 16;
+			}
+			const uint32_t next = d;
+			d = c;
+			c = b;
+			b = b + Rotate(a + f + k[i] + words[g], shifts[(i / 16) * 4 + i % 4]);
+			a = next;
+		}
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+	}
+
+	static InstructionClass Classify(uint32_t opcode)
+	{
+		switch (opcode)
+		{
+		// break, breakc, call, callc, case, continue, continuec, default, discard, else, endif, endloop, endswitch,
+		// if, label, loop, ret, retc, switch, interface call, abort, debug break
+		case 2: case 3: case 4: case 5: case 6: case 7: case 8: case 10: case 13: case 18: case 21: case 22: case 23:
+		case 31: case 44: case 48: case 62: case 63: case 76: case 120: case 208: case 209:
+			return InstructionClass::FlowControl;
+		// ld, ld_ms, resinfo, sample variants, lod, gather4, sampleinfo, samplepos, bufinfo, gather4 variants,
+		// typed, raw and structured loads
+		case 45: case 46: case 61: case 69: case 70: case 71: case 72: case 73: case 74: case 108: case 109: case 110:
+		case 111: case 121: case 126: case 127: case 128: case 163: case 165: case 167:
+			return InstructionClass::Texture;
+		// cut, emit, emitthencut, nop, stream variants, stores, atomics, sync
+		case 9: case 19: case 20: case 58: case 117: case 118: case 119: case 164: case 166: case 168: case 191:
+			return InstructionClass::Other;
+		default:
+			break;
+		}
+		if ((opcode >= 88 && opcode <= 107) || (opcode >= 113 && opcode <= 116) || (opcode >= 143 && opcode <= 162) || opcode == 207)
+			return InstructionClass::Declaration;
+		if (opcode >= 169 && opcode <= 190)
+			return InstructionClass::Other;
+		return InstructionClass::Alu;
+	}
+
+	bool ParseSignature(const Chunk& chunk, std::vector<SignatureElement>& elements, std::string& error)
+	{
+		// ISGN and OSGN elements are 24 bytes, OSG5 puts a stream index first, ISG1 and OSG1 also add a precision
+		const bool stream = chunk.fourcc == MakeFourCC('O', 'S', 'G', '5') || chunk.fourcc == MakeFourCC('I', 'S', 'G', '1')
+			|| chunk.fourcc == MakeFourCC('O', 'S', 'G', '1');
+		const uint32_t elementSize = chunk.fourcc == MakeFourCC('O', 'S', 'G', '5') ? 28 : stream ? 32 : 24;
+		if (chunk.size < 8)
+		{
+			error = chunk.GetName() + " chunk is truncated";
+			return false;
+		}
+		const uint32_t count = Read32(chunk.data);
+		const uint32_t offset = Read32(chunk.data + 4);
+		if (offset > chunk.size || count > (chunk.size - offset) / elementSize)
+		{
+			error = chunk.GetName() + " chunk is truncated";
+			return false;
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint8_t* element = chunk.data + offset + i * elementSize + (stream ? 4 : 0);
+			SignatureElement parsed;
+			const uint32_t name = Read32(element);
+			parsed.semanticIndex = Read32(element + 4);
+			parsed.systemValue = Read32(element + 8);
+			parsed.componentType = Read32(element + 12);
+			parsed.registerIndex = Read32(element + 16);
+			parsed.mask = element[20];
+			parsed.readWriteMask = element[21];
+			if (name >= chunk.size)
+			{
+				error = chunk.GetName() + " semantic name is outside the chunk";
+				return false;
+			}
+			const char* text = (const char*)chunk.data + name;
+			parsed.semantic.assign(text, strnlen(text, chunk.size - name));
+			elements.push_back(parsed);
+		}
+		return true;
+	}
+
+	bool ParseProgram(const Chunk& chunk, std::string& error)
+	{
+		if (chunk.size < 8)
+		{
+			error = "Token stream is truncated";
+			return false;
+		}
+		const uint32_t version = Read32(chunk.data);
+		const uint32_t length = Read32(chunk.data + 4);
+		if (length < 2 || length > chunk.size / 4)
+		{
+			error = "Token stream length does not fit its chunk";
+			return false;
+		}
+		statistics.programType = (ProgramType)(version >> 16);
+		statistics.major = (version >> 4) & 0xf;
+		statistics.minor = version & 0xf;
+		for (uint32_t position = 2; position < length;)
+		{
+			const uint8_t* tokens = chunk.data + position * 4;
+			const uint32_t opcode = Read32(tokens) & 0x7ff;
+			uint32_t size = (Read32(tokens) >> 24) & 0x7f;
+			// Embedded data such as immediate constant buffers carries its length in the next token
+			if (opcode == CustomDataOpcode)
+				size = position + 1 < length ? Read32(tokens + 4) : 0;
+			if (size == 0 || size > length - position)
+			{
+				error = "Malformed instruction at token " + std::to_string(position);
+				return false;
+			}
+			position += size;
+			if (opcode == CustomDataOpcode)
+				continue;
+			switch (Classify(opcode))
+			{
+			case InstructionClass::Alu:
+				statistics.alu++;
+				break;
+			case InstructionClass::Texture:
+				statistics.texture++;
+				break;
+			case InstructionClass::FlowControl:
+				statistics.flowControl++;
+				break;
+			case InstructionClass::Other:
+				statistics.other++;
+				break;
+			case InstructionClass::Declaration:
+				statistics.declarations++;
+				// dcl_temps count, dcl_indexable_temp register count components
+				if (opcode == 104 && size >= 2)
+					statistics.temps += Read32(tokens + 4);
+				else if (opcode == 105 && size >= 3)
+					statistics.indexableTemps += Read32(tokens + 8);
+				else if (opcode == 88 || opcode == 161 || opcode == 162)
+					statistics.resources++;
+				else if (opcode == 89)
+					statistics.constantBuffers++;
+				else if (opcode == 90)
+					statistics.samplers++;
+				else if (opcode >= 156 && opcode <= 158)
+					statistics.unorderedAccessViews++;
+				continue;
+			}
+			statistics.instructions++;
+		}
+		hasProgram = true;
+		return true;
+	}
+
+public:
+	// The modified MD5 D3D signs containers with, over everything after the checksum field
+	static Checksum ComputeChecksum(const uint8_t* data, size_t size)
+	{
+		uint32_t state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+		const uint8_t* content = data + 20;
+		const uint32_t length = (uint32_t)(size - 20);
+		const uint32_t bits = length * 8;
+		const uint32_t full = length & ~63u;
+		for (uint32_t offset = 0; offset < full; offset += 64)
+			Transform(state, content + offset);
+		// Unlike MD5 the bit count goes first in the last block, and a second count derived from it last
+		const uint32_t rest = length - full;
+		uint8_t block[64] = {};
+		const uint32_t tail = (bits >> 2) | 1;
+		if (rest >= 56)
+		{
+			memcpy(block, content + full, rest);
+			block[rest] = 0x80;
+			Transform(state, block);
+			memset(block, 0, sizeof(block));
+			memcpy(block, &bits, 4);
+		}
+		else
+		{
+			memcpy(block, &bits, 4);
+			memcpy(block + 4, content + full, rest);
+			block[4 + rest] = 0x80;
+		}
+		memcpy(block + 60, &tail, 4);
+		Transform(state, block);
+		Checksum checksum;
+		memcpy(checksum.data(), state, 16);
+		return checksum;
+	}
+
+	static std::string ToHex(const Checksum& checksum)
+	{
+		static const char* digits = "0123456789abcdef";
+		std::string hex(32, '0');
+		for (size_t i = 0; i < checksum.size(); i++)
+		{
+			hex[i * 2] = digits[checksum[i] >> 4];
+			hex[i * 2 + 1] = digits[checksum[i] & 15];
+		}
+		return hex;
+	}
+
+	static bool IsContainer(const uint8_t* data, size_t size)
+	{
+		return size >= HeaderSize && Read32(data) == Magic;
+	}
+
+	// Writes a signed container from fourcc and content pairs, in that order
+	static std::vector<uint8_t> Build(const std::vector<std::pair<uint32_t, std::vector<uint8_t>>>& parts)
+	{
+		std::vector<uint8_t> container(HeaderSize + parts.size() * 4, 0);
+		auto Write32 = [&container](size_t offset, uint32_t value) { memcpy(container.data() + offset, &value, 4); };
+		Write32(0, Magic);
+		Write32(20, 1);
+		Write32(28, (uint32_t)parts.size());
+		for (size_t i = 0; i < parts.size(); i++)
+		{
+			Write32(HeaderSize + i * 4, (uint32_t)container.size());
+			const size_t offset = container.size();
+			container.resize(offset + 8 + ((parts[i].second.size() + 3) & ~(size_t)3), 0);
+			Write32(offset, parts[i].first);
+			Write32(offset + 4, (uint32_t)parts[i].second.size());
+			if (!parts[i].second.empty())
+				memcpy(container.data() + offset + 8, parts[i].second.data(), parts[i].second.size());
+		}
+		Write32(24, (uint32_t)container.size());
+		const Checksum checksum = ComputeChecksum(container.data(), container.size());
+		memcpy(container.data() + 4, checksum.data(), checksum.size());
+		return container;
+	}
+
+	bool Parse(const uint8_t* data, size_t size, std::string& error)
+	{
+		*this = DxbcContainer();
+		if (!IsContainer(data, size))
+		{
+			error = "Not a DXBC container";
+			return false;
+		}
+		const uint32_t total = Read32(data + 24);
+		const uint32_t count = Read32(data + 28);
+		if (total > size || total < HeaderSize || count > (total - HeaderSize) / 4)
+		{
+			error = "Container size does not match its header";
+			return false;
+		}
+		memcpy(checksum.data(), data + 4, checksum.size());
+		checksumValid = ComputeChecksum(data, total) == checksum;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint32_t offset = Read32(data + HeaderSize + i * 4);
+			if (offset > total - 8 || Read32(data + offset + 4) > total - offset - 8)
+			{
+				error = "Chunk " + std::to_string(i) + " lies outside the container";
+				return false;
+			}
+			Chunk chunk;
+			chunk.fourcc = Read32(data + offset);
+			chunk.size = Read32(data + offset + 4);
+			chunk.data = data + offset + 8;
+			chunks.push_back(chunk);
+		}
+		for (const Chunk& chunk : chunks)
+		{
+			const std::string name = chunk.GetName();
+			bool parsed = true;
+			if (name == "ISGN" || name == "ISG1")
+				parsed = ParseSignature(chunk, inputs, error);
+			else if (name == "OSGN" || name == "OSG1" || name == "OSG5")
+				parsed = ParseSignature(chunk, outputs, error);
+			else if (name == "SHDR" || name == "SHEX")
+				parsed = ParseProgram(chunk, error);
+			if (!parsed)
+				return false;
+		}
+		return true;
+	}
+
+	const Chunk* Find(uint32_t fourcc) const
+	{
+		for (const Chunk& chunk : chunks)
+		{
+			if (chunk.fourcc == fourcc)
+				return &chunk;
+		}
+		return nullptr;
+	}
+};
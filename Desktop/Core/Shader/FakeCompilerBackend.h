@@ -0,0 +1,220 @@
+#pragma once
+#include <cctype>
+#include <cstring>
+#include <thread>
+
+// Deterministic stand-in for D3DCompile: the same request always yields the same bytecode and
+// diagnostics, and each compile burns a configurable amount of CPU so scheduling, caching and
+// batching can be measured without the Windows compiler. The bytecode is a signed DXBC container
+// whose instruction mix follows the source, so DxbcContainer has something to analyze.
+class FakeCompilerBackend : public ShaderCompiler
+{
+public:
+	// Busy time per compile and per kilobyte of source, in microseconds
+	uint32_t fixedCost = 1000;
+	uint32_t costPerKilobyte = 200;
+	// Shared by all compiles, keeps included files tokenized between them
+	ShaderPreprocessor preprocessor = ShaderPreprocessor();
+
+	static uint64_t Hash(uint64_t hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static uint64_t Hash(uint64_t hash, const std::string& text)
+	{
+		// The terminator keeps "ab"+"c" and "a"+"bc" apart
+		return Hash(hash, text.c_str(), text.size() + 1);
+	}
+
+protected:
+	static bool HasEntry(const std::string& source, const std::string& entry)
+	{
+		size_t position = 0;
+		while ((position = source.find(entry, position)) != std::string::npos)
+		{
+			const bool startsWord = position == 0 || !(isalnum((unsigned char)source[position - 1]) || source[position - 1] == '_');
+			size_t next = position + entry.size();
+			while (next < source.size() && isspace((unsigned char)source[next]))
+				next++;
+			if (startsWord && next < source.size() && source[next] == '(')
+				return true;
+			position += entry.size();
+		}
+		return false;
+	}
+
+	// Whole-word occurrences of a keyword
+	static uint32_t CountWord(const std::string& source, const char* word)
+	{
+		const size_t length = strlen(word);
+		uint32_t count = 0;
+		for (size_t position = source.find(word); position != std::string::npos; position = source.find(word, position + length))
+		{
+			const bool before = position > 0 && (isalnum((unsigned char)source[position - 1]) || source[position - 1] == '_');
+			const bool after = position + length < source.size() && (isalnum((unsigned char)source[position + length]) || source[position + length] == '_');
+			count += before || after ? 0 : 1;
+		}
+		return count;
+	}
+
+	static uint32_t CountText(const std::string& source, const char* text)
+	{
+		uint32_t count = 0;
+		for (size_t position = source.find(text); position != std::string::npos; position = source.find(text, position + 1))
+			count++;
+		return count;
+	}
+
+	// A signature chunk with one element per semantic, names stored after the elements
+	static std::vector<uint8_t> MakeSignature(const std::vector<std::pair<std::string, uint32_t>>& semantics)
+	{
+		std::vector<uint32_t> words = { (uint32_t)semantics.size(), 8 };
+		std::string names = "";
+		for (size_t i = 0; i < semantics.size(); i++)
+		{
+			const uint32_t name = (uint32_t)(8 + semantics.size() * 24 + names.size());
+			// Name, index, system value, float component type, register, xyzw mask
+			words.insert(words.end(), { name, 0, semantics[i].second, 3, (uint32_t)i, 0xf });
+			names += semantics[i].first;
+			names.push_back(0);
+		}
+		std::vector<uint8_t> chunk(words.size() * 4);
+		memcpy(chunk.data(), words.data(), chunk.size());
+		chunk.insert(chunk.end(), names.begin(), names.end());
+		return chunk;
+	}
+
+	// SHDR for shader model 4, SHEX for 5. One sample per texture access, an if and endif per branch or
+	// loop, one ALU op per arithmetic operator and the request hash as an immediate constant buffer
+	static std::vector<uint8_t> MakeProgram(const std::string& source, const std::string& target, uint64_t hash)
+	{
+		static const char* stages = "pvghdc";
+		const uint32_t type = (uint32_t)(strchr(stages, target[0]) - stages);
+		std::vector<uint32_t> tokens = { type << 16 | (uint32_t)(target[3] - '0') << 4 | (uint32_t)(target[5] - '0'), 0 };
+		auto Instruction = [&tokens](uint32_t opcode, std::initializer_list<uint32_t> operands) {
+			tokens.push_back(opcode | (uint32_t)(operands.size() + 1) << 24);
+			tokens.insert(tokens.end(), operands);
+			};
+		const uint32_t samples = CountText(source, ".Sample") + CountText(source, ".Load") + CountText(source, ".Gather");
+		const uint32_t branches = CountWord(source, "if") + CountWord(source, "for") + CountWord(source, "while") + CountWord(source, "switch");
+		uint32_t operators = 1;
+		for (const char c : source)
+			operators += c == '+' || c == '*' || c == '/' || c == '-' ? 1 : 0;
+
+		Instruction(106, {});
+		Instruction(104, { std::min<uint32_t>(1 + operators / 4 + samples, 32) });
+		tokens.insert(tokens.end(), { 53 | 3u << 11, 4, (uint32_t)hash, (uint32_t)(hash >> 32) });
+		for (uint32_t i = 0; i < samples; i++)
+			Instruction(69, { 0, 0, 0, 0 });
+		for (uint32_t i = 0; i < branches; i++)
+		{
+			Instruction(31, { 0 });
+			Instruction(0, { 0, 0, 0 });
+			Instruction(21, {});
+		}
+		for (uint32_t i = 0; i < operators; i++)
+			Instruction(i % 3 == 2 ? 50 : i % 3 == 1 ? 56 : 0, { 0, 0, 0 });
+		Instruction(62, {});
+		tokens[1] = (uint32_t)tokens.size();
+		std::vector<uint8_t> program(tokens.size() * 4);
+		memcpy(program.data(), tokens.data(), program.size());
+		return program;
+	}
+
+	static bool IsTarget(const std::string& target)
+	{
+		static const char* stages[] = { "vs_", "ps_", "gs_", "hs_", "ds_", "cs_" };
+		for (const char* stage : stages)
+		{
+			if (target.rfind(stage, 0) == 0 && target.size() == 6 && isdigit((unsigned char)target[3]) && target[4] == '_' && isdigit((unsigned char)target[5]))
+				return true;
+		}
+		return false;
+	}
+
+	void Spin(uint64_t microseconds) const
+	{
+		const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(microseconds);
+		while (std::chrono::steady_clock::now() < end)
+			std::this_thread::yield();
+	}
+
+	void CompileSource(const Request& request, Result& result) override
+	{
+		std::string source = "";
+		if (!preprocessor.Run(request, source, result.log, result.includes))
+			return;
+		Spin(fixedCost + (uint64_t)costPerKilobyte * source.size() / 1024);
+
+		std::string file = request.sourceName.empty() ? "Source" : request.sourceName;
+		if (!IsTarget(request.target))
+		{
+			result.log = file + "(1,1): error X3502: '" + request.target + "': invalid target\n";
+			return;
+		}
+		if (!HasEntry(source, request.entry))
+		{
+			result.log = file + "(1,1): error X3501: '" + request.entry + "': entrypoint not found\n";
+			return;
+		}
+
+		// Like D3DCompile without debug information, the file names in #line markers do not reach the bytecode
+		std::string code = "";
+		for (size_t line = 0, end = 0; line < source.size(); line = end + 1)
+		{
+			end = std::min(source.find('\n', line), source.size());
+			if (source.compare(line, 6, "#line ") != 0)
+				code.append(source, line, end - line + 1);
+		}
+		uint64_t hash = 14695981039346656037ull;
+		hash = Hash(hash, code);
+		hash = Hash(hash, request.entry);
+		hash = Hash(hash, request.target);
+		for (const auto& define : request.defines)
+		{
+			hash = Hash(hash, define.first);
+			hash = Hash(hash, define.second);
+		}
+		hash = Hash(hash, &request.flags, sizeof(request.flags));
+
+		// Inputs by the semantics the source mentions, system values SV_Position 1 and SV_Target 64
+		std::vector<std::pair<std::string, uint32_t>> inputs = {};
+		if (CountText(source, "SV_POSITION") + CountText(source, "SV_Position") > 0)
+			inputs.push_back({ "SV_POSITION", 1 });
+		if (CountText(source, "COLOR") > 0)
+			inputs.push_back({ "COLOR", 0 });
+		if (CountText(source, "TEXCOORD") > 0)
+			inputs.push_back({ "TEXCOORD", 0 });
+		const bool pixel = request.target[0] == 'p';
+		const uint32_t program = request.target[3] >= '5' ? DxbcContainer::MakeFourCC('S', 'H', 'E', 'X') : DxbcContainer::MakeFourCC('S', 'H', 'D', 'R');
+		result.bytecode = DxbcContainer::Build({
+			{ DxbcContainer::MakeFourCC('I', 'S', 'G', 'N'), MakeSignature(inputs) },
+			{ DxbcContainer::MakeFourCC('O', 'S', 'G', 'N'), MakeSignature({ { pixel ? "SV_Target" : "SV_POSITION", pixel ? 64u : 1u } }) },
+			{ program, MakeProgram(source, request.target, hash) },
+			});
+		result.success = true;
+	}
+
+public:
+	const char* GetName() const override
+	{
+		return "Fake";
+	}
+
+	bool ExpandsDefines() const override
+	{
+		return true;
+	}
+
+	bool Preprocess(const Request& request, std::string& output, std::string& log, std::vector<Include>& includes) override
+	{
+		return preprocessor.Run(request, output, log, includes);
+	}
+};
\ No newline at end of file
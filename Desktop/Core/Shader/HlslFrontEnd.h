@@ -0,0 +1,66 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Syntax check of one shader source for the editor. Update finds the edited range by comparing with the
+// previous text, re-lexes only that region and parses again into the reused arena, which on a typical
+// shader takes well under a millisecond.
+class HlslFrontEnd
+{
+private:
+	// Owns the text the tokens and the tree point into
+	std::string text = "";
+	bool parsed = false;
+	Arena arena = Arena();
+
+public:
+	HlslLexer lexer = HlslLexer();
+	HlslParser::Node* root = nullptr;
+	std::vector<ShaderCompiler::Diagnostic> diagnostics = {};
+	// Microseconds spent by the last Update
+	float lexTime = 0.f;
+	float parseTime = 0.f;
+
+	// false when source did not change since the last call
+	bool Update(const std::string& source, const std::string& file)
+	{
+		if (parsed && source == text)
+			return false;
+		const auto start = std::chrono::steady_clock::now();
+		if (!parsed)
+		{
+			text = source;
+			lexer.Lex(text);
+		}
+		else
+		{
+			const size_t shortest = std::min(text.size(), source.size());
+			const size_t prefix = std::mismatch(text.begin(), text.begin() + shortest, source.begin()).first - text.begin();
+			const size_t suffix = std::mismatch(text.rbegin(), text.rbegin() + (shortest - prefix), source.rbegin()).first - text.rbegin();
+			const size_t removed = text.size() - prefix - suffix;
+			text = source;
+			lexer.Update(text, prefix, removed, text.size() - prefix - suffix);
+		}
+		const auto lexed = std::chrono::steady_clock::now();
+		arena.Reset();
+		diagnostics.clear();
+		root = HlslParser(text, lexer.tokens, arena, diagnostics, file).Parse();
+		const auto end = std::chrono::steady_clock::now();
+		lexTime = std::chrono::duration<float, std::micro>(lexed - start).count();
+		parseTime = std::chrono::duration<float, std::micro>(end - lexed).count();
+		parsed = true;
+		return true;
+	}
+
+	size_t GetNodeCount() const
+	{
+		return arena.GetAllocated() / sizeof(HlslParser::Node);
+	}
+
+	size_t GetArenaBytes() const
+	{
+		return arena.GetReserved();
+	}
+};
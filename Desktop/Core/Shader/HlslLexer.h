@@ -0,0 +1,273 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+// Tokens of HLSL source for the front end, comments dropped and preprocessor lines kept as one token each.
+// Update re-lexes only around an edit: lexing restarts at the last token before it and stops as soon as a
+// new token lines up with an old one past the edit, the old tokens after that are shifted into place.
+class HlslLexer
+{
+public:
+	class Token
+	{
+	public:
+		enum class Kind : uint8_t
+		{
+			Identifier,
+			Number,
+			String,
+			Punctuator,
+			Directive,
+			Unknown,
+			End
+		};
+
+		uint32_t offset = 0;
+		uint32_t length = 0;
+		uint32_t line = 0;
+		uint32_t column = 0;
+		Kind kind = Kind::End;
+	};
+
+	class Statistics
+	{
+	public:
+		uint64_t fullLexes = 0;
+		uint64_t updates = 0;
+		// Of the last Lex or Update
+		uint64_t lexed = 0;
+		uint64_t reused = 0;
+	};
+
+private:
+	class Cursor
+	{
+	public:
+		size_t position = 0;
+		uint32_t line = 1;
+		size_t lineBegin = 0;
+		bool lineStart = true;
+	};
+
+	// Tokens re-lexed by the running Update
+	std::vector<Token> fresh = {};
+
+	static bool IsIdentifierCharacter(char c)
+	{
+		return isalnum((unsigned char)c) || c == '_';
+	}
+
+	// Reads the token at cursor, End once the text is used up
+	static Token Next(std::string_view text, Cursor& cursor)
+	{
+		static const char* punctuators[] = { ">>=", "<<=", "...", "##", "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+			"+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "::" };
+		const char* data = text.data();
+		const size_t size = text.size();
+		size_t& i = cursor.position;
+		while (i < size)
+		{
+			const char c = data[i];
+			const char next = i + 1 < size ? data[i + 1] : 0;
+			if (c == '\n')
+			{
+				cursor.line++;
+				cursor.lineBegin = ++i;
+				cursor.lineStart = true;
+			}
+			else if (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f')
+			{
+				i++;
+			}
+			else if (c == '/' && next == '/')
+			{
+				while (i < size && data[i] != '\n')
+					i++;
+			}
+			else if (c == '/' && next == '*')
+			{
+				for (i += 2; i < size && !(data[i] == '*' && i + 1 < size && data[i + 1] == '/'); i++)
+				{
+					// Unlike cpp a newline in a comment starts a line, so a token is first on its line exactly when
+					// the token before it starts on an earlier line, which Update relies on
+					if (data[i] == '\n')
+					{
+						cursor.line++;
+						cursor.lineBegin = i + 1;
+						cursor.lineStart = true;
+					}
+				}
+				i = i + 2 < size ? i + 2 : size;
+			}
+			else
+			{
+				break;
+			}
+		}
+		Token token;
+		token.offset = (uint32_t)i;
+		token.line = cursor.line;
+		token.column = (uint32_t)(i - cursor.lineBegin + 1);
+		if (i >= size)
+		{
+			token.kind = Token::Kind::End;
+			return token;
+		}
+		const char c = data[i];
+		const char next = i + 1 < size ? data[i + 1] : 0;
+		const size_t start = i;
+		if (c == '#' && cursor.lineStart)
+		{
+			// The whole line with its continuations, the front end does not expand macros
+			token.kind = Token::Kind::Directive;
+			while (i < size && data[i] != '\n')
+			{
+				if (data[i] == '\\' && i + 1 < size && (data[i + 1] == '\n' || (data[i + 1] == '\r' && i + 2 < size && data[i + 2] == '\n')))
+				{
+					i += data[i + 1] == '\n' ? 2 : 3;
+					cursor.line++;
+					cursor.lineBegin = i;
+					continue;
+				}
+				i++;
+			}
+			while (i > start && (data[i - 1] == '\r' || data[i - 1] == ' ' || data[i - 1] == '\t'))
+				i--;
+		}
+		else if (isalpha((unsigned char)c) || c == '_')
+		{
+			token.kind = Token::Kind::Identifier;
+			while (i < size && IsIdentifierCharacter(data[i]))
+				i++;
+		}
+		else if (isdigit((unsigned char)c) || (c == '.' && isdigit((unsigned char)next)))
+		{
+			token.kind = Token::Kind::Number;
+			for (i++; i < size; i++)
+			{
+				if (!IsIdentifierCharacter(data[i]) && data[i] != '.' && !((data[i] == '+' || data[i] == '-') && (data[i - 1] == 'e' || data[i - 1] == 'E')))
+					break;
+			}
+		}
+		else if (c == '"' || c == '\'')
+		{
+			token.kind = Token::Kind::String;
+			for (i++; i < size && data[i] != c && data[i] != '\n'; i++)
+			{
+				if (data[i] == '\\' && i + 1 < size)
+					i++;
+			}
+			if (i < size && data[i] == c)
+				i++;
+		}
+		else
+		{
+			size_t length = 1;
+			for (const char* punctuator : punctuators)
+			{
+				if (punctuator[0] != c || punctuator[1] != next)
+					continue;
+				const size_t candidate = punctuator[2] == 0 ? 2 : i + 2 < size && data[i + 2] == punctuator[2] ? 3 : 0;
+				length = std::max(length, candidate);
+			}
+			token.kind = length == 1 && strchr("+-*/%<>=!&|^~?:;,.()[]{}#", c) == nullptr ? Token::Kind::Unknown : Token::Kind::Punctuator;
+			i += length;
+		}
+		token.length = (uint32_t)(i - start);
+		cursor.lineStart = false;
+		return token;
+	}
+
+public:
+	// Always ends with an End token
+	std::vector<Token> tokens = {};
+	Statistics statistics = Statistics();
+
+	void Lex(std::string_view text)
+	{
+		tokens.clear();
+		Cursor cursor;
+		do
+		{
+			tokens.push_back(Next(text, cursor));
+		} while (tokens.back().kind != Token::Kind::End);
+		statistics.fullLexes++;
+		statistics.lexed = tokens.size();
+		statistics.reused = 0;
+	}
+
+	// text is the source after replacing removed bytes at begin with inserted bytes, tokens still describe the old source
+	void Update(std::string_view text, size_t begin, size_t removed, size_t inserted)
+	{
+		if (tokens.empty())
+		{
+			Lex(text);
+			return;
+		}
+		// The last token that ends before the edit with a gap, an edit right after a token may extend it
+		size_t restart = 0;
+		{
+			size_t low = 0, high = tokens.size();
+			while (low < high)
+			{
+				const size_t middle = (low + high) / 2;
+				if ((size_t)tokens[middle].offset + tokens[middle].length < begin)
+					low = middle + 1;
+				else
+					high = middle;
+			}
+			restart = low > 0 ? low - 1 : 0;
+		}
+		// Old tokens stay in place, the re-lexed ones replace the range [restart, j) once lexing is back in step
+		fresh.clear();
+		Cursor cursor;
+		if (restart > 0)
+		{
+			const Token& from = tokens[restart];
+			cursor.position = from.offset;
+			cursor.line = from.line;
+			cursor.lineBegin = from.offset - (from.column - 1);
+			cursor.lineStart = tokens[restart - 1].line < from.line;
+		}
+		const size_t oldEnd = begin + removed;
+		const int64_t delta = (int64_t)inserted - (int64_t)removed;
+		size_t j = restart;
+		while (true)
+		{
+			const Token token = Next(text, cursor);
+			// Old tokens past the edit, at their shifted offsets
+			while (j < tokens.size() && (tokens[j].offset < oldEnd || (int64_t)tokens[j].offset + delta < (int64_t)token.offset))
+				j++;
+			// Back in step with the old tokens from the start of a line, the rest only moves
+			const Token* previous = !fresh.empty() ? &fresh.back() : restart > 0 ? &tokens[restart - 1] : nullptr;
+			const bool firstOnLine = previous == nullptr || previous->line < token.line;
+			if (token.kind != Token::Kind::End && j < tokens.size() && firstOnLine && tokens[j].column == token.column && tokens[j].kind == token.kind
+				&& tokens[j].length == token.length && (int64_t)tokens[j].offset + delta == (int64_t)token.offset && (j == 0 || tokens[j - 1].line < tokens[j].line))
+			{
+				const int64_t lineDelta = (int64_t)token.line - (int64_t)tokens[j].line;
+				for (size_t k = j; k < tokens.size(); k++)
+				{
+					tokens[k].offset = (uint32_t)((int64_t)tokens[k].offset + delta);
+					tokens[k].line = (uint32_t)((int64_t)tokens[k].line + lineDelta);
+				}
+				statistics.reused = restart + tokens.size() - j;
+				break;
+			}
+			fresh.push_back(token);
+			if (token.kind == Token::Kind::End)
+			{
+				j = tokens.size();
+				statistics.reused = restart;
+				break;
+			}
+		}
+		tokens.erase(tokens.begin() + restart, tokens.begin() + j);
+		tokens.insert(tokens.begin() + restart, fresh.begin(), fresh.end());
+		statistics.updates++;
+		statistics.lexed = fresh.size();
+	}
+};
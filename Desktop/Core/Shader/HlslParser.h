@@ -0,0 +1,1115 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include "../../Dependence/Arena.h"
+#include "HlslLexer.h"
+
+// Recursive-descent parser for the HLSL we write by hand: structs, cbuffers, typedefs, globals and functions
+// with the usual statements and C expressions. Macros are not expanded, a use reads as a name or a call, and
+// preprocessor lines are skipped. Nodes live in the caller's Arena. After an error the parser skips to the
+// next ';' or '}' and goes on, so one mistake gives one diagnostic.
+class HlslParser
+{
+public:
+	using Token = HlslLexer::Token;
+
+	class Node
+	{
+	public:
+		enum class Kind : uint8_t
+		{
+			Root,
+			Struct,
+			CBuffer,
+			Typedef,
+			Function,
+			Parameter,
+			Variable,
+			Type,
+			Attribute,
+			Declaration,
+			Block,
+			ExpressionStatement,
+			If,
+			For,
+			While,
+			DoWhile,
+			Switch,
+			Case,
+			Default,
+			Return,
+			Break,
+			Continue,
+			Discard,
+			Empty,
+			Assign,
+			Binary,
+			Unary,
+			Postfix,
+			Ternary,
+			Call,
+			Index,
+			Member,
+			Cast,
+			Name,
+			Literal,
+			InitializerList
+		};
+
+		enum Modifier : uint32_t
+		{
+			None = 0,
+			In = 1 << 0,
+			Out = 1 << 1,
+			Uniform = 1 << 2,
+			Static = 1 << 3,
+			Const = 1 << 4,
+			RowMajor = 1 << 5,
+			ColumnMajor = 1 << 6,
+			GroupShared = 1 << 7,
+			NoInterpolation = 1 << 8,
+			Linear = 1 << 9,
+			Centroid = 1 << 10,
+			NoPerspective = 1 << 11,
+			Sample = 1 << 12,
+			Precise = 1 << 13,
+			Extern = 1 << 14,
+			Volatile = 1 << 15,
+			Inline = 1 << 16,
+			Shared = 1 << 17
+		};
+
+		Kind kind = Kind::Empty;
+		uint32_t modifiers = Modifier::None;
+		uint32_t line = 0;
+		uint32_t column = 0;
+		// Declared or referenced name, operator of an expression, text of a literal, type or attribute
+		std::string_view name = {};
+		std::string_view semantic = {};
+		// Inside the parentheses of register(...) or packoffset(...)
+		std::string_view binding = {};
+		// Declared type, return type, target of a cast
+		Node* type = nullptr;
+		// Initializer, returned value, operand of unary, postfix, cast and member, callee of a call, case label,
+		// variables declared along with a struct
+		Node* value = nullptr;
+		// Operands of binary and assignment, true and false branch of a ternary, object and index of an index
+		Node* left = nullptr;
+		Node* right = nullptr;
+		Node* condition = nullptr;
+		// Function and loop body, then branch of an if
+		Node* body = nullptr;
+		Node* otherwise = nullptr;
+		// Parts of a for header
+		Node* init = nullptr;
+		Node* step = nullptr;
+		// Array sizes and attributes, each a list through next
+		Node* dimensions = nullptr;
+		Node* attributes = nullptr;
+		// Declarations, members, parameters, statements, arguments, template arguments
+		Node* first = nullptr;
+		Node* last = nullptr;
+		Node* next = nullptr;
+
+		void Append(Node* child)
+		{
+			if (last != nullptr)
+				last->next = child;
+			else
+				first = child;
+			last = child;
+		}
+	};
+
+	// Reported diagnostics stop here, parsing goes on
+	static constexpr size_t MaxDiagnostics = 100;
+	// Deeper statements and expressions are an error instead of a stack overflow, the parser runs on every edit
+	static constexpr size_t MaxNesting = 256;
+
+private:
+	std::string_view text = {};
+	const std::vector<Token>& tokens;
+	Arena& arena;
+	std::vector<ShaderCompiler::Diagnostic>& diagnostics;
+	std::string file = "";
+	size_t position = 0;
+	// Set by an error until Recover, so one mistake is reported once
+	bool recovering = false;
+	// Structs and typedefs declared so far
+	std::unordered_set<std::string_view> typeNames = {};
+	size_t nesting = 0;
+
+	class Nested
+	{
+	private:
+		size_t& nesting;
+	public:
+		Nested(size_t& nesting) : nesting(nesting) { nesting++; }
+		~Nested() { nesting--; }
+	};
+
+	size_t Skip(size_t index) const
+	{
+		while (tokens[index].kind == Token::Kind::Directive)
+			index++;
+		return index;
+	}
+
+	const Token& Peek(size_t ahead = 0) const
+	{
+		size_t index = position;
+		for (size_t i = 0; i < ahead && tokens[index].kind != Token::Kind::End; i++)
+			index = Skip(index + 1);
+		return tokens[index];
+	}
+
+	std::string_view Text(const Token& token) const
+	{
+		return text.substr(token.offset, token.length);
+	}
+
+	bool AtEnd() const
+	{
+		return tokens[position].kind == Token::Kind::End;
+	}
+
+	// Literals only, the length is known at compile time and most tokens fail on it
+	template <size_t N>
+	bool Is(const char (&punctuator)[N], size_t ahead = 0) const
+	{
+		const Token& token = Peek(ahead);
+		return token.kind == Token::Kind::Punctuator && token.length == N - 1 && memcmp(text.data() + token.offset, punctuator, N - 1) == 0;
+	}
+
+	template <size_t N>
+	bool IsWord(const char (&word)[N], size_t ahead = 0) const
+	{
+		const Token& token = Peek(ahead);
+		return token.kind == Token::Kind::Identifier && token.length == N - 1 && memcmp(text.data() + token.offset, word, N - 1) == 0;
+	}
+
+	const Token& Advance()
+	{
+		const Token& token = tokens[position];
+		if (token.kind != Token::Kind::End)
+			position = Skip(position + 1);
+		return token;
+	}
+
+	void Error(const Token& token, const std::string& message)
+	{
+		if (recovering)
+			return;
+		recovering = true;
+		if (diagnostics.size() >= MaxDiagnostics)
+			return;
+		ShaderCompiler::Diagnostic diagnostic;
+		diagnostic.file = file;
+		diagnostic.line = (int)token.line;
+		diagnostic.column = (int)token.column;
+		diagnostic.code = "X3000";
+		diagnostic.message = "syntax error: " + message;
+		diagnostics.push_back(diagnostic);
+	}
+
+	std::nullptr_t Unexpected(const char* expected)
+	{
+		const Token& token = Peek();
+		if (token.kind == Token::Kind::End)
+			Error(token, std::string("unexpected end of file, expected ") + expected);
+		else if (token.kind == Token::Kind::Unknown)
+			Error(token, "unexpected character '" + std::string(Text(token)) + "'");
+		else
+			Error(token, "unexpected token '" + std::string(Text(token)) + "', expected " + expected);
+		return nullptr;
+	}
+
+	std::nullptr_t TooDeep(const char* what)
+	{
+		Error(Peek(), std::string(what) + " nested more than " + std::to_string(MaxNesting) + " levels deep");
+		return nullptr;
+	}
+
+	template <size_t N>
+	bool Expect(const char (&punctuator)[N])
+	{
+		if (Is(punctuator))
+		{
+			Advance();
+			return true;
+		}
+		Unexpected((std::string("'") + punctuator + "'").c_str());
+		return false;
+	}
+
+	// Skips past the next ';' or the '}' closing the current block, whichever ends the broken construct
+	void Recover()
+	{
+		int depth = 0;
+		while (!AtEnd())
+		{
+			if (Is("{"))
+			{
+				depth++;
+			}
+			else if (Is("}"))
+			{
+				if (depth == 0)
+					break;
+				if (--depth == 0)
+				{
+					Advance();
+					break;
+				}
+			}
+			else if (Is(";") && depth == 0)
+			{
+				Advance();
+				break;
+			}
+			Advance();
+		}
+		recovering = false;
+	}
+
+	Node* New(Node::Kind kind, const Token& token)
+	{
+		Node* node = arena.New<Node>();
+		node->kind = kind;
+		node->line = token.line;
+		node->column = token.column;
+		return node;
+	}
+
+	static bool IsBuiltinType(std::string_view name)
+	{
+		// Spelled out once with the vector (float3) and matrix (float4x4) forms, views point into the node based set
+		static const std::unordered_set<std::string> names = []()
+		{
+			static const char* scalars[] = { "bool", "int", "uint", "dword", "half", "float", "double", "min16float", "min10float", "min16int", "min12int",
+				"min16uint", "int16_t", "uint16_t", "int64_t", "uint64_t", "float16_t" };
+			static const char* objects[] = { "void", "vector", "matrix", "string", "sampler", "sampler1D", "sampler2D", "sampler3D", "samplerCUBE",
+				"SamplerState", "SamplerComparisonState", "texture", "Texture", "Texture1D", "Texture1DArray", "Texture2D", "Texture2DArray", "Texture2DMS",
+				"Texture2DMSArray", "Texture3D", "TextureCube", "TextureCubeArray", "RWTexture1D", "RWTexture1DArray", "RWTexture2D", "RWTexture2DArray",
+				"RWTexture3D", "Buffer", "RWBuffer", "StructuredBuffer", "RWStructuredBuffer", "AppendStructuredBuffer", "ConsumeStructuredBuffer",
+				"ByteAddressBuffer", "RWByteAddressBuffer" };
+			std::unordered_set<std::string> names(std::begin(objects), std::end(objects));
+			for (const std::string scalar : scalars)
+			{
+				names.insert(scalar);
+				for (char rows = '1'; rows <= '4'; rows++)
+				{
+					names.insert(scalar + rows);
+					for (char columns = '1'; columns <= '4'; columns++)
+						names.insert(scalar + rows + 'x' + columns);
+				}
+			}
+			return names;
+		}();
+		static const std::unordered_set<std::string_view> views(names.begin(), names.end());
+		return views.count(name) != 0;
+	}
+
+	bool IsTypeName(const Token& token) const
+	{
+		if (token.kind != Token::Kind::Identifier)
+			return false;
+		const std::string_view name = Text(token);
+		return IsBuiltinType(name) || typeNames.count(name) != 0;
+	}
+
+	static uint32_t ModifierOf(std::string_view word)
+	{
+		static const std::pair<const char*, uint32_t> modifiers[] = {
+			{ "in", Node::In }, { "out", Node::Out }, { "inout", Node::In | Node::Out }, { "uniform", Node::Uniform }, { "static", Node::Static },
+			{ "const", Node::Const }, { "row_major", Node::RowMajor }, { "column_major", Node::ColumnMajor }, { "groupshared", Node::GroupShared },
+			{ "nointerpolation", Node::NoInterpolation }, { "linear", Node::Linear }, { "centroid", Node::Centroid }, { "noperspective", Node::NoPerspective },
+			{ "sample", Node::Sample }, { "precise", Node::Precise }, { "extern", Node::Extern }, { "volatile", Node::Volatile }, { "inline", Node::Inline },
+			{ "shared", Node::Shared } };
+		for (const auto& modifier : modifiers)
+		{
+			if (word == modifier.first)
+				return modifier.second;
+		}
+		return Node::None;
+	}
+
+	bool IsModifier(const Token& token) const
+	{
+		return token.kind == Token::Kind::Identifier && ModifierOf(Text(token)) != Node::None;
+	}
+
+	// Modifiers and a type followed by a name, "sample = 1;" stays an expression
+	bool IsDeclarationStart() const
+	{
+		size_t ahead = 0;
+		while (IsModifier(Peek(ahead)))
+			ahead++;
+		if (!IsTypeName(Peek(ahead)))
+			return false;
+		return Peek(ahead + 1).kind == Token::Kind::Identifier || Is("<", ahead + 1);
+	}
+
+	uint32_t Modifiers()
+	{
+		uint32_t modifiers = Node::None;
+		while (IsModifier(Peek()) && (IsTypeName(Peek(1)) || IsModifier(Peek(1))))
+			modifiers |= ModifierOf(Text(Advance()));
+		return modifiers;
+	}
+
+	Node* Type()
+	{
+		const Token& token = Peek();
+		if (!IsTypeName(token))
+			return Unexpected("a type");
+		Node* type = New(Node::Kind::Type, token);
+		type->name = Text(Advance());
+		if (!Is("<"))
+			return type;
+		Advance();
+		while (true)
+		{
+			Node* argument = nullptr;
+			if (Peek().kind == Token::Kind::Number)
+			{
+				argument = New(Node::Kind::Literal, Peek());
+				argument->name = Text(Advance());
+			}
+			else if ((argument = Type()) == nullptr)
+			{
+				return nullptr;
+			}
+			type->Append(argument);
+			if (Is(">"))
+			{
+				Advance();
+				return type;
+			}
+			if (!Expect(","))
+				return nullptr;
+		}
+	}
+
+	// [N][M] after a name
+	bool Dimensions(Node* node)
+	{
+		Node* tail = nullptr;
+		while (Is("["))
+		{
+			const Token& open = Advance();
+			Node* size = nullptr;
+			if (Is("]"))
+				size = New(Node::Kind::Empty, open);
+			else if ((size = Expression()) == nullptr)
+				return false;
+			if (!Expect("]"))
+				return false;
+			if (tail != nullptr)
+				tail->next = size;
+			else
+				node->dimensions = size;
+			tail = size;
+		}
+		return true;
+	}
+
+	// ": SEMANTIC", ": register(t0)" and ": packoffset(c0)" after a declaration
+	bool Annotations(Node* node)
+	{
+		while (Is(":"))
+		{
+			Advance();
+			if (Peek().kind != Token::Kind::Identifier)
+			{
+				Unexpected("a semantic");
+				return false;
+			}
+			const std::string_view word = Text(Advance());
+			if (word != "register" && word != "packoffset")
+			{
+				node->semantic = word;
+				continue;
+			}
+			if (!Expect("("))
+				return false;
+			const size_t begin = Peek().offset;
+			while (!Is(")") && !AtEnd())
+				Advance();
+			node->binding = text.substr(begin, Peek().offset - begin);
+			if (!Expect(")"))
+				return false;
+		}
+		return true;
+	}
+
+	Node* Attributes()
+	{
+		Node* attributes = nullptr;
+		Node* tail = nullptr;
+		while (Is("["))
+		{
+			Advance();
+			if (Peek().kind != Token::Kind::Identifier)
+				return Unexpected("an attribute");
+			Node* attribute = New(Node::Kind::Attribute, Peek());
+			attribute->name = Text(Advance());
+			if (Is("(") && !Arguments(attribute))
+				return nullptr;
+			if (!Expect("]"))
+				return nullptr;
+			if (tail != nullptr)
+				tail->next = attribute;
+			else
+				attributes = attribute;
+			tail = attribute;
+		}
+		return attributes;
+	}
+
+	// "(a, b)" appended to node
+	bool Arguments(Node* node)
+	{
+		Advance();
+		if (Is(")"))
+		{
+			Advance();
+			return true;
+		}
+		while (true)
+		{
+			Node* argument = Assignment();
+			if (argument == nullptr)
+				return false;
+			node->Append(argument);
+			if (Is(")"))
+			{
+				Advance();
+				return true;
+			}
+			if (!Expect(","))
+				return false;
+		}
+	}
+
+	// Declarators after the type, "a[2] : SEMANTIC = value, b", the caller takes the ';'
+	Node* Declarators(const Token& at, uint32_t modifiers, Node* type)
+	{
+		Node* declaration = New(Node::Kind::Declaration, at);
+		declaration->type = type;
+		declaration->modifiers = modifiers;
+		while (true)
+		{
+			if (Peek().kind != Token::Kind::Identifier)
+				return Unexpected("a name");
+			Node* variable = New(Node::Kind::Variable, Peek());
+			variable->name = Text(Advance());
+			variable->type = type;
+			variable->modifiers = modifiers;
+			if (!Dimensions(variable) || !Annotations(variable))
+				return nullptr;
+			if (Is("="))
+			{
+				Advance();
+				variable->value = Is("{") ? InitializerList() : Assignment();
+				if (variable->value == nullptr)
+					return nullptr;
+			}
+			declaration->Append(variable);
+			if (!Is(","))
+				return declaration;
+			Advance();
+		}
+	}
+
+	Node* InitializerList()
+	{
+		Node* list = New(Node::Kind::InitializerList, Advance());
+		while (!Is("}"))
+		{
+			Node* element = Is("{") ? InitializerList() : Assignment();
+			if (element == nullptr)
+				return nullptr;
+			list->Append(element);
+			// A trailing comma is allowed
+			if (!Is(","))
+				break;
+			Advance();
+		}
+		return Expect("}") ? list : nullptr;
+	}
+
+	Node* Struct()
+	{
+		Node* node = New(Node::Kind::Struct, Advance());
+		if (Peek().kind == Token::Kind::Identifier)
+		{
+			node->name = Text(Advance());
+			typeNames.insert(node->name);
+		}
+		if (!Expect("{"))
+			return nullptr;
+		while (!Is("}") && !AtEnd())
+		{
+			const Token& at = Peek();
+			const uint32_t modifiers = Modifiers();
+			Node* type = Type();
+			Node* members = type != nullptr ? Declarators(at, modifiers, type) : nullptr;
+			if (members == nullptr || !Expect(";"))
+			{
+				Recover();
+				continue;
+			}
+			node->Append(members);
+		}
+		return Expect("}") ? node : nullptr;
+	}
+
+	Node* CBuffer()
+	{
+		Node* node = New(Node::Kind::CBuffer, Advance());
+		if (Peek().kind != Token::Kind::Identifier)
+			return Unexpected("a name");
+		node->name = Text(Advance());
+		if (!Annotations(node) || !Expect("{"))
+			return nullptr;
+		while (!Is("}") && !AtEnd())
+		{
+			const Token& at = Peek();
+			const uint32_t modifiers = Modifiers();
+			Node* type = Type();
+			Node* members = type != nullptr ? Declarators(at, modifiers, type) : nullptr;
+			if (members == nullptr || !Expect(";"))
+			{
+				Recover();
+				continue;
+			}
+			node->Append(members);
+		}
+		if (!Expect("}"))
+			return nullptr;
+		if (Is(";"))
+			Advance();
+		return node;
+	}
+
+	Node* Function(const Token& at, uint32_t modifiers, Node* type)
+	{
+		Node* function = New(Node::Kind::Function, at);
+		function->modifiers = modifiers;
+		function->type = type;
+		function->name = Text(Advance());
+		Advance();
+		// "(void)" declares no parameters
+		if (IsWord("void") && Is(")", 1))
+			Advance();
+		while (!Is(")"))
+		{
+			const Token& parameterAt = Peek();
+			Node* parameter = New(Node::Kind::Parameter, parameterAt);
+			parameter->modifiers = Modifiers();
+			if ((parameter->type = Type()) == nullptr)
+				return nullptr;
+			if (Peek().kind == Token::Kind::Identifier)
+				parameter->name = Text(Advance());
+			if (!Dimensions(parameter) || !Annotations(parameter))
+				return nullptr;
+			if (Is("="))
+			{
+				Advance();
+				if ((parameter->value = Assignment()) == nullptr)
+					return nullptr;
+			}
+			function->Append(parameter);
+			if (!Is(")") && !Expect(","))
+				return nullptr;
+		}
+		Advance();
+		if (!Annotations(function))
+			return nullptr;
+		// A prototype
+		if (Is(";"))
+		{
+			Advance();
+			return function;
+		}
+		if (!Is("{"))
+			return Unexpected("'{' or ';'");
+		function->body = Block();
+		return function->body != nullptr ? function : nullptr;
+	}
+
+	Node* TopLevel()
+	{
+		const Token& at = Peek();
+		Node* attributes = Attributes();
+		if (recovering)
+			return nullptr;
+		Node* node = nullptr;
+		if (IsWord("struct"))
+		{
+			node = Struct();
+			if (node == nullptr)
+				return nullptr;
+			// "struct S { ... } s;" also declares a variable
+			if (Peek().kind == Token::Kind::Identifier)
+			{
+				Node* type = New(Node::Kind::Type, at);
+				type->name = node->name;
+				Node* declaration = Declarators(Peek(), Node::None, type);
+				if (declaration == nullptr)
+					return nullptr;
+				node->value = declaration;
+			}
+			if (!Expect(";"))
+				return nullptr;
+		}
+		else if (IsWord("cbuffer") || IsWord("tbuffer"))
+		{
+			node = CBuffer();
+		}
+		else if (IsWord("typedef"))
+		{
+			node = New(Node::Kind::Typedef, Advance());
+			node->modifiers = Modifiers();
+			if ((node->type = Type()) == nullptr)
+				return nullptr;
+			if (Peek().kind != Token::Kind::Identifier)
+				return Unexpected("a name");
+			node->name = Text(Advance());
+			typeNames.insert(node->name);
+			if (!Dimensions(node) || !Expect(";"))
+				return nullptr;
+		}
+		else if (Is(";"))
+		{
+			node = New(Node::Kind::Empty, Advance());
+		}
+		else
+		{
+			const uint32_t modifiers = Modifiers();
+			Node* type = Type();
+			if (type == nullptr)
+				return nullptr;
+			if (Peek().kind != Token::Kind::Identifier)
+				return Unexpected("a name");
+			if (Is("(", 1))
+			{
+				node = Function(Peek(), modifiers, type);
+			}
+			else
+			{
+				node = Declarators(at, modifiers, type);
+				if (node != nullptr && !Expect(";"))
+					return nullptr;
+			}
+		}
+		if (node != nullptr)
+			node->attributes = attributes;
+		return node;
+	}
+
+	Node* Block()
+	{
+		Node* block = New(Node::Kind::Block, Advance());
+		while (!Is("}") && !AtEnd())
+		{
+			const size_t before = position;
+			Node* statement = Statement();
+			if (statement != nullptr)
+			{
+				block->Append(statement);
+				continue;
+			}
+			Recover();
+			if (position == before)
+				Advance();
+		}
+		return Expect("}") ? block : nullptr;
+	}
+
+	// "(expression)" of if, while and switch
+	Node* Parenthesized()
+	{
+		if (!Expect("("))
+			return nullptr;
+		Node* expression = Expression();
+		return expression != nullptr && Expect(")") ? expression : nullptr;
+	}
+
+	Node* Statement()
+	{
+		const Nested nested(nesting);
+		if (nesting > MaxNesting)
+			return TooDeep("statement");
+		Node* attributes = Is("[") ? Attributes() : nullptr;
+		if (recovering)
+			return nullptr;
+		Node* node = SimpleStatement();
+		if (node != nullptr)
+			node->attributes = attributes;
+		return node;
+	}
+
+	Node* SimpleStatement()
+	{
+		const Token& at = Peek();
+		if (Is("{"))
+			return Block();
+		if (Is(";"))
+			return New(Node::Kind::Empty, Advance());
+		if (IsWord("if"))
+		{
+			Node* node = New(Node::Kind::If, Advance());
+			if ((node->condition = Parenthesized()) == nullptr || (node->body = Statement()) == nullptr)
+				return nullptr;
+			if (IsWord("else"))
+			{
+				Advance();
+				if ((node->otherwise = Statement()) == nullptr)
+					return nullptr;
+			}
+			return node;
+		}
+		if (IsWord("for"))
+		{
+			Node* node = New(Node::Kind::For, Advance());
+			if (!Expect("("))
+				return nullptr;
+			if (!Is(";"))
+			{
+				node->init = IsDeclarationStart() ? Declaration() : Expression();
+				if (node->init == nullptr)
+					return nullptr;
+			}
+			if (!Expect(";"))
+				return nullptr;
+			if (!Is(";") && (node->condition = Expression()) == nullptr)
+				return nullptr;
+			if (!Expect(";"))
+				return nullptr;
+			if (!Is(")") && (node->step = Expression()) == nullptr)
+				return nullptr;
+			if (!Expect(")") || (node->body = Statement()) == nullptr)
+				return nullptr;
+			return node;
+		}
+		if (IsWord("while"))
+		{
+			Node* node = New(Node::Kind::While, Advance());
+			if ((node->condition = Parenthesized()) == nullptr || (node->body = Statement()) == nullptr)
+				return nullptr;
+			return node;
+		}
+		if (IsWord("do"))
+		{
+			Node* node = New(Node::Kind::DoWhile, Advance());
+			if ((node->body = Statement()) == nullptr)
+				return nullptr;
+			if (!IsWord("while"))
+				return Unexpected("'while'");
+			Advance();
+			if ((node->condition = Parenthesized()) == nullptr || !Expect(";"))
+				return nullptr;
+			return node;
+		}
+		if (IsWord("switch"))
+		{
+			Node* node = New(Node::Kind::Switch, Advance());
+			if ((node->condition = Parenthesized()) == nullptr || !Expect("{"))
+				return nullptr;
+			Node* label = nullptr;
+			while (!Is("}") && !AtEnd())
+			{
+				if (IsWord("case") || IsWord("default"))
+				{
+					const Node::Kind kind = IsWord("case") ? Node::Kind::Case : Node::Kind::Default;
+					label = New(kind, Advance());
+					if (label->kind == Node::Kind::Case && (label->value = Conditional()) == nullptr)
+						return nullptr;
+					if (!Expect(":"))
+						return nullptr;
+					node->Append(label);
+					continue;
+				}
+				if (label == nullptr)
+					return Unexpected("'case' or 'default'");
+				const size_t before = position;
+				Node* statement = Statement();
+				if (statement != nullptr)
+				{
+					label->Append(statement);
+					continue;
+				}
+				Recover();
+				if (position == before)
+					Advance();
+			}
+			return Expect("}") ? node : nullptr;
+		}
+		if (IsWord("return"))
+		{
+			Node* node = New(Node::Kind::Return, Advance());
+			if (!Is(";") && (node->value = Expression()) == nullptr)
+				return nullptr;
+			return Expect(";") ? node : nullptr;
+		}
+		if (IsWord("break") || IsWord("continue") || IsWord("discard"))
+		{
+			const std::string_view word = Text(at);
+			Node* node = New(word == "break" ? Node::Kind::Break : word == "continue" ? Node::Kind::Continue : Node::Kind::Discard, Advance());
+			return Expect(";") ? node : nullptr;
+		}
+		if (IsDeclarationStart())
+		{
+			Node* node = Declaration();
+			return node != nullptr && Expect(";") ? node : nullptr;
+		}
+		Node* node = New(Node::Kind::ExpressionStatement, at);
+		if ((node->value = Expression()) == nullptr)
+			return nullptr;
+		return Expect(";") ? node : nullptr;
+	}
+
+	Node* Declaration()
+	{
+		const Token& at = Peek();
+		const uint32_t modifiers = Modifiers();
+		Node* type = Type();
+		return type != nullptr ? Declarators(at, modifiers, type) : nullptr;
+	}
+
+	static int Precedence(std::string_view op)
+	{
+		static const std::pair<const char*, int> operators[] = {
+			{ "||", 1 }, { "&&", 2 }, { "|", 3 }, { "^", 4 }, { "&", 5 }, { "==", 6 }, { "!=", 6 }, { "<", 7 }, { ">", 7 }, { "<=", 7 }, { ">=", 7 },
+			{ "<<", 8 }, { ">>", 8 }, { "+", 9 }, { "-", 9 }, { "*", 10 }, { "/", 10 }, { "%", 10 } };
+		for (const auto& entry : operators)
+		{
+			if (op == entry.first)
+				return entry.second;
+		}
+		return 0;
+	}
+
+	static bool IsAssignment(std::string_view op)
+	{
+		return op == "=" || op == "+=" || op == "-=" || op == "*=" || op == "/=" || op == "%=" || op == "<<=" || op == ">>=" || op == "&=" || op == "|=" || op == "^=";
+	}
+
+	// Comma separated
+	Node* Expression()
+	{
+		Node* left = Assignment();
+		while (left != nullptr && Is(","))
+		{
+			Node* node = New(Node::Kind::Binary, Peek());
+			node->name = Text(Advance());
+			node->left = left;
+			if ((node->right = Assignment()) == nullptr)
+				return nullptr;
+			left = node;
+		}
+		return left;
+	}
+
+	Node* Assignment()
+	{
+		Node* left = Conditional();
+		if (left == nullptr || Peek().kind != Token::Kind::Punctuator || !IsAssignment(Text(Peek())))
+			return left;
+		Node* node = New(Node::Kind::Assign, Peek());
+		node->name = Text(Advance());
+		node->left = left;
+		node->right = Assignment();
+		return node->right != nullptr ? node : nullptr;
+	}
+
+	Node* Conditional()
+	{
+		Node* condition = Binary(1);
+		if (condition == nullptr || !Is("?"))
+			return condition;
+		Node* node = New(Node::Kind::Ternary, Advance());
+		node->condition = condition;
+		if ((node->left = Expression()) == nullptr || !Expect(":") || (node->right = Conditional()) == nullptr)
+			return nullptr;
+		return node;
+	}
+
+	Node* Binary(int minimum)
+	{
+		Node* left = Unary();
+		while (left != nullptr && Peek().kind == Token::Kind::Punctuator)
+		{
+			const int precedence = Precedence(Text(Peek()));
+			if (precedence < minimum || precedence == 0)
+				break;
+			Node* node = New(Node::Kind::Binary, Peek());
+			node->name = Text(Advance());
+			node->left = left;
+			if ((node->right = Binary(precedence + 1)) == nullptr)
+				return nullptr;
+			left = node;
+		}
+		return left;
+	}
+
+	// "(type)" followed by an operand, "(float4(...))" is a parenthesized constructor
+	bool IsCast() const
+	{
+		if (!Is("(") || !IsTypeName(Peek(1)))
+			return false;
+		size_t ahead = 2;
+		if (Is("<", ahead))
+		{
+			int depth = 0;
+			for (; Peek(ahead).kind != Token::Kind::End; ahead++)
+			{
+				if (Is("<", ahead))
+					depth++;
+				else if (Is(">", ahead) && --depth == 0)
+					break;
+			}
+			ahead++;
+		}
+		while (Is("[", ahead) && Peek(ahead + 1).kind == Token::Kind::Number && Is("]", ahead + 2))
+			ahead += 3;
+		return Is(")", ahead);
+	}
+
+	// Every nested expression, parenthesized or an operand, passes through here
+	Node* Unary()
+	{
+		const Nested nested(nesting);
+		if (nesting > MaxNesting)
+			return TooDeep("expression");
+		const Token& token = Peek();
+		if (token.kind == Token::Kind::Punctuator)
+		{
+			const std::string_view op = Text(token);
+			if (op == "+" || op == "-" || op == "!" || op == "~" || op == "++" || op == "--")
+			{
+				Node* node = New(Node::Kind::Unary, Advance());
+				node->name = op;
+				node->value = Unary();
+				return node->value != nullptr ? node : nullptr;
+			}
+			if (IsCast())
+			{
+				Node* node = New(Node::Kind::Cast, Advance());
+				if ((node->type = Type()) == nullptr || !Dimensions(node) || !Expect(")"))
+					return nullptr;
+				node->value = Unary();
+				return node->value != nullptr ? node : nullptr;
+			}
+		}
+		return Postfix();
+	}
+
+	Node* Postfix()
+	{
+		Node* node = Primary();
+		while (node != nullptr)
+		{
+			if (Is("("))
+			{
+				Node* call = New(Node::Kind::Call, Peek());
+				call->value = node;
+				if (!Arguments(call))
+					return nullptr;
+				node = call;
+			}
+			else if (Is("["))
+			{
+				Node* index = New(Node::Kind::Index, Advance());
+				index->left = node;
+				if ((index->right = Expression()) == nullptr || !Expect("]"))
+					return nullptr;
+				node = index;
+			}
+			else if (Is("."))
+			{
+				Node* member = New(Node::Kind::Member, Advance());
+				member->value = node;
+				if (Peek().kind != Token::Kind::Identifier)
+					return Unexpected("a member name");
+				member->name = Text(Advance());
+				node = member;
+			}
+			else if (Is("++") || Is("--"))
+			{
+				Node* postfix = New(Node::Kind::Postfix, Peek());
+				postfix->name = Text(Advance());
+				postfix->value = node;
+				node = postfix;
+			}
+			else
+			{
+				break;
+			}
+		}
+		return node;
+	}
+
+	Node* Primary()
+	{
+		const Token& token = Peek();
+		switch (token.kind)
+		{
+		case Token::Kind::Number:
+		case Token::Kind::String:
+		{
+			Node* node = New(Node::Kind::Literal, token);
+			node->name = Text(Advance());
+			return node;
+		}
+		case Token::Kind::Identifier:
+		{
+			const std::string_view word = Text(token);
+			Node* node = New(word == "true" || word == "false" ? Node::Kind::Literal : Node::Kind::Name, token);
+			node->name = Text(Advance());
+			return node;
+		}
+		default:
+			break;
+		}
+		if (Is("("))
+		{
+			Advance();
+			Node* node = Expression();
+			return node != nullptr && Expect(")") ? node : nullptr;
+		}
+		return Unexpected("an expression");
+	}
+
+public:
+	HlslParser(std::string_view text, const std::vector<Token>& tokens, Arena& arena, std::vector<ShaderCompiler::Diagnostic>& diagnostics, const std::string& file)
+		: text(text), tokens(tokens), arena(arena), diagnostics(diagnostics), file(file) {}
+
+	// tokens must end with an End token. Never nullptr, broken declarations are left out.
+	Node* Parse()
+	{
+		position = Skip(0);
+		Node* root = New(Node::Kind::Root, tokens[position]);
+		while (!AtEnd())
+		{
+			const size_t before = position;
+			Node* node = TopLevel();
+			if (node != nullptr)
+			{
+				root->Append(node);
+				continue;
+			}
+			Recover();
+			// A stray '}' at file scope
+			if (position == before || Is("}"))
+				Advance();
+		}
+		return root;
+	}
+};
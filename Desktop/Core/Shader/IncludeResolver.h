@@ -0,0 +1,121 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Finds and reads the files named by #include for every backend. Quoted names are looked up next to the
+// including file first, both forms then in searchPaths. Contents stay cached until Update or Invalidate,
+// so a header shared by many shaders is read once. Thread safe.
+class IncludeResolver
+{
+public:
+	using Content = std::shared_ptr<const std::string>;
+
+	class Statistics
+	{
+	public:
+		uint64_t hits = 0;
+		uint64_t reads = 0;
+		uint64_t failures = 0;
+	};
+
+private:
+	mutable std::mutex mutex = {};
+	std::unordered_map<std::string, Content> files = {};
+	std::vector<std::filesystem::path> searchPaths = {};
+	Statistics statistics = Statistics();
+
+	// Called with the mutex held
+	bool Load(const std::filesystem::path& candidate, std::string& path, Content& content)
+	{
+		std::error_code error;
+		path = std::filesystem::absolute(candidate, error).lexically_normal().string();
+		if (error)
+			return false;
+		auto it = files.find(path);
+		if (it != files.end())
+		{
+			statistics.hits++;
+			content = it->second;
+			return true;
+		}
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		if (!file.is_open())
+			return false;
+		content = std::make_shared<const std::string>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		files[path] = content;
+		statistics.reads++;
+		return true;
+	}
+
+public:
+	void AddSearchPath(const std::filesystem::path& directory)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		searchPaths.push_back(directory);
+	}
+
+	// name as written in the directive, parentDirectory is where the including file lives.
+	// path receives the normalized absolute path, which identifies the file in dependency lists.
+	bool Open(const std::string& name, bool system, const std::string& parentDirectory, std::string& path, Content& content)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const std::filesystem::path file = name;
+		if (file.is_absolute())
+		{
+			if (Load(file, path, content))
+				return true;
+		}
+		else
+		{
+			if (!system && Load(std::filesystem::path(parentDirectory) / file, path, content))
+				return true;
+			for (const std::filesystem::path& directory : searchPaths)
+			{
+				if (Load(directory / file, path, content))
+					return true;
+			}
+		}
+		statistics.failures++;
+		return false;
+	}
+
+	// The cached contents of a resolved path, nullptr when it was not opened or was invalidated since
+	Content Find(const std::string& path) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = files.find(path);
+		return it != files.end() ? it->second : nullptr;
+	}
+
+	// Replaces the cached contents, for callers that already read a changed file
+	void Update(const std::string& path, const std::string& content)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = files.find(path);
+		if (it != files.end())
+			it->second = std::make_shared<const std::string>(content);
+	}
+
+	void Invalidate(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		files.erase(path);
+	}
+
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		files.clear();
+	}
+
+	Statistics GetStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return statistics;
+	}
+};
@@ -0,0 +1,340 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../Dependence/Http.h"
+#include "../../Dependence/Lz.h"
+#include "../../Dependence/Sha256.h"
+
+// Second tier behind ShaderCache, shared by every machine that points at the same cache server (RemoteCacheServer,
+// or the batch compiler started with --serve-cache). Entries are addressed by the hex digest ShaderCache keys them
+// with: GET and PUT /cas/<digest> move one entry, POST /cas/contains asks about many at once. Payloads travel
+// compressed with a checksum of the original, which both ends verify.
+// Uploads run on a background thread that first asks which entries the server lacks, so compiles never wait on
+// them. After a timeout or a failed connect the server is left alone for retryInterval and lookups stay local.
+class RemoteCache
+{
+public:
+	class Statistics
+	{
+	public:
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		// Failed or timed out requests, each one pauses the remote tier for retryInterval
+		uint64_t errors = 0;
+		uint64_t uploads = 0;
+		// Entries the server already had when asked before uploading
+		uint64_t skipped = 0;
+		// Uploads lost because the server could not be reached
+		uint64_t dropped = 0;
+		uint64_t bytesDownloaded = 0;
+		uint64_t bytesUploaded = 0;
+		// Uploaded payloads before compression
+		uint64_t bytesUncompressed = 0;
+	};
+
+	std::string host = "127.0.0.1";
+	uint16_t port = 0;
+	// Milliseconds
+	uint32_t connectTimeout = 300;
+	uint32_t timeout = 2000;
+	uint32_t retryInterval = 10000;
+	size_t uploadBatch = 64;
+
+private:
+	static constexpr uint32_t Magic = 0x5a43534e; // "NSCZ"
+	static constexpr size_t HeaderSize = 4 + 4 + 8 + 32;
+	// Uploads waiting beyond this are dropped, the server is clearly not keeping up
+	static constexpr size_t MaxQueuedUploads = 4096;
+
+	class Connection
+	{
+	public:
+		TcpConnection socket = TcpConnection();
+		// Bytes received past the last response
+		std::string buffer = "";
+	};
+
+	std::mutex mutex;
+	std::vector<std::unique_ptr<Connection>> idle = {};
+	std::chrono::steady_clock::time_point retryAt = {};
+	Statistics statistics = Statistics();
+	std::deque<std::pair<std::string, std::string>> uploads = {};
+	size_t uploading = 0;
+	bool stopping = false;
+	std::condition_variable uploadQueued;
+	std::condition_variable uploadsDone;
+	std::thread uploader = std::thread();
+
+	void Fail()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.errors++;
+		retryAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(retryInterval);
+		idle.clear();
+	}
+
+	bool Exchange(Http::Message& request, Http::Message& response)
+	{
+		request.headers["host"] = host + ":" + std::to_string(port);
+		for (int attempt = 0; attempt < 2; attempt++)
+		{
+			std::unique_ptr<Connection> connection = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (std::chrono::steady_clock::now() < retryAt)
+					return false;
+				if (!idle.empty())
+				{
+					connection = std::move(idle.back());
+					idle.pop_back();
+				}
+			}
+			const bool reused = connection != nullptr;
+			if (!reused)
+			{
+				connection = std::make_unique<Connection>();
+				std::string error = "";
+				if (!connection->socket.Connect(host, port, connectTimeout, error))
+					break;
+			}
+			TcpConnection::Status status = TcpConnection::Status::Closed;
+			if (Http::Write(connection->socket, request, true))
+				status = Http::Read(connection->socket, connection->buffer, response, false, timeout);
+			if (status == TcpConnection::Status::Ok)
+			{
+				if (response.Header("connection") != "close")
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					idle.push_back(std::move(connection));
+				}
+				return true;
+			}
+			// The server may have closed a kept connection while it sat idle, that deserves one fresh try
+			if (!reused || status == TcpConnection::Status::Timeout)
+				break;
+		}
+		Fail();
+		return false;
+	}
+
+	void Uploads()
+	{
+		std::vector<std::pair<std::string, std::string>> batch = {};
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				uploading = 0;
+				uploadsDone.notify_all();
+				uploadQueued.wait(lock, [this]() { return stopping || !uploads.empty(); });
+				if (stopping)
+					return;
+				batch.clear();
+				while (!uploads.empty() && batch.size() < uploadBatch)
+				{
+					batch.push_back(std::move(uploads.front()));
+					uploads.pop_front();
+				}
+				uploading = batch.size();
+			}
+			std::vector<std::string> keys = {};
+			for (const auto& upload : batch)
+				keys.push_back(upload.first);
+			std::vector<bool> present = {};
+			if (!Contains(keys, present))
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				statistics.dropped += batch.size();
+				continue;
+			}
+			for (size_t i = 0; i < batch.size(); i++)
+			{
+				if (present[i])
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					statistics.skipped++;
+				}
+				else if (!Put(batch[i].first, batch[i].second))
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					statistics.dropped += batch.size() - i;
+					break;
+				}
+			}
+		}
+	}
+
+public:
+	RemoteCache() {}
+	RemoteCache(const std::string& host, uint16_t port) : host(host), port(port) {}
+	RemoteCache(const RemoteCache&) = delete;
+	RemoteCache& operator=(const RemoteCache&) = delete;
+
+	// Uploads still queued are dropped, call Flush first to keep them
+	~RemoteCache()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			uploadQueued.notify_all();
+		}
+		if (uploader.joinable())
+			uploader.join();
+	}
+
+	// "host:port", the port is required
+	static bool ParseAddress(const std::string& address, std::string& host, uint16_t& port)
+	{
+		const size_t colon = address.rfind(':');
+		if (colon == std::string::npos || colon == 0 || colon + 1 >= address.size())
+			return false;
+		const int value = atoi(address.c_str() + colon + 1);
+		if (value <= 0 || value > 65535)
+			return false;
+		host = address.substr(0, colon);
+		port = (uint16_t)value;
+		return true;
+	}
+
+	static bool IsKey(const std::string& key)
+	{
+		return key.size() == 64 && key.find_first_not_of("0123456789abcdef") == std::string::npos;
+	}
+
+	// Magic, method (0 stored, 1 Lz), original size, SHA-256 of the original, then the data
+	static std::string Encode(const std::string& payload)
+	{
+		std::vector<uint8_t> compressed = Lz::Compress((const uint8_t*)payload.data(), payload.size());
+		const uint32_t method = compressed.size() < payload.size() ? 1 : 0;
+		const uint64_t size = payload.size();
+		const Sha256::Digest checksum = Sha256::Hash(payload.data(), payload.size());
+		std::string blob = "";
+		blob.append((const char*)&Magic, 4);
+		blob.append((const char*)&method, 4);
+		blob.append((const char*)&size, 8);
+		blob.append((const char*)checksum.data(), checksum.size());
+		if (method == 1)
+			blob.append((const char*)compressed.data(), compressed.size());
+		else
+			blob += payload;
+		return blob;
+	}
+
+	static bool Decode(const std::string& blob, std::string& payload)
+	{
+		uint32_t magic = 0, method = 0;
+		uint64_t size = 0;
+		Sha256::Digest checksum = {};
+		if (blob.size() < HeaderSize)
+			return false;
+		memcpy(&magic, blob.data(), 4);
+		memcpy(&method, blob.data() + 4, 4);
+		memcpy(&size, blob.data() + 8, 8);
+		memcpy(checksum.data(), blob.data() + 16, checksum.size());
+		if (magic != Magic || size > Http::MaxBodySize)
+			return false;
+		if (method == 0)
+		{
+			payload = blob.substr(HeaderSize);
+		}
+		else if (method == 1)
+		{
+			std::vector<uint8_t> output = {};
+			if (!Lz::Decompress((const uint8_t*)blob.data() + HeaderSize, blob.size() - HeaderSize, (size_t)size, output))
+				return false;
+			payload.assign((const char*)output.data(), output.size());
+		}
+		else
+		{
+			return false;
+		}
+		return payload.size() == size && Sha256::Hash(payload.data(), payload.size()) == checksum;
+	}
+
+	// false on a miss and whenever the server cannot answer
+	bool Get(const std::string& key, std::string& payload)
+	{
+		Http::Message request, response;
+		request.method = "GET";
+		request.path = "/cas/" + key;
+		if (!Exchange(request, response))
+			return false;
+		const bool hit = response.status == 200 && Decode(response.body, payload);
+		std::lock_guard<std::mutex> lock(mutex);
+		(hit ? statistics.hits : statistics.misses)++;
+		statistics.bytesDownloaded += response.body.size();
+		return hit;
+	}
+
+	// One round trip for all keys, present[i] tells about keys[i]
+	bool Contains(const std::vector<std::string>& keys, std::vector<bool>& present)
+	{
+		Http::Message request, response;
+		request.method = "POST";
+		request.path = "/cas/contains";
+		for (const std::string& key : keys)
+			request.body += key + "\n";
+		if (!Exchange(request, response) || response.status != 200 || response.body.size() != keys.size() * 2)
+			return false;
+		present.resize(keys.size());
+		for (size_t i = 0; i < keys.size(); i++)
+			present[i] = response.body[i * 2] == '1';
+		return true;
+	}
+
+	bool Put(const std::string& key, const std::string& payload)
+	{
+		Http::Message request, response;
+		request.method = "PUT";
+		request.path = "/cas/" + key;
+		request.headers["content-type"] = "application/x-nsc-blob";
+		request.body = Encode(payload);
+		if (!Exchange(request, response) || (response.status != 201 && response.status != 204))
+			return false;
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.uploads++;
+		statistics.bytesUploaded += request.body.size();
+		statistics.bytesUncompressed += payload.size();
+		return true;
+	}
+
+	// Queues an upload for the background thread
+	void Upload(const std::string& key, const std::string& payload)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopping || uploads.size() >= MaxQueuedUploads)
+		{
+			statistics.dropped++;
+			return;
+		}
+		uploads.push_back({ key, payload });
+		if (!uploader.joinable())
+			uploader = std::thread([this]() { Uploads(); });
+		uploadQueued.notify_one();
+	}
+
+	// Waits until every queued upload was sent or dropped
+	void Flush()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		uploadsDone.wait(lock, [this]() { return stopping || (uploads.empty() && uploading == 0); });
+	}
+
+	bool IsAvailable()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return std::chrono::steady_clock::now() >= retryAt;
+	}
+
+	Statistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return statistics;
+	}
+};
@@ -0,0 +1,213 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "../../Dependence/ConnectionServer.h"
+#include "../../Dependence/TcpSocket.h"
+#include "../../Dependence/Http.h"
+#include "RemoteCache.h"
+
+// The other end of RemoteCache, small enough to run next to the tools on 127.0.0.1 or on a shared machine.
+// Entries are kept as received, one file per digest, written under a temporary name and renamed. Uploads are
+// decoded and checked against their checksum first, so a damaged one is refused instead of served to others.
+// Each connection is served on its own thread.
+class RemoteCacheServer
+{
+public:
+	class Statistics
+	{
+	public:
+		uint64_t connections = 0;
+		uint64_t gets = 0;
+		uint64_t hits = 0;
+		uint64_t puts = 0;
+		// Uploads refused because they did not decode
+		uint64_t rejected = 0;
+		// Digests asked about through /cas/contains
+		uint64_t queried = 0;
+		uint64_t bytesReceived = 0;
+		uint64_t bytesSent = 0;
+	};
+
+	std::filesystem::path directory = "";
+	// Milliseconds a connection may stay silent before it is closed
+	uint32_t idleTimeout = 60000;
+
+private:
+	ConnectionServer<TcpListener, TcpConnection> connections;
+	std::mutex mutex;
+	Statistics statistics = Statistics();
+
+	std::filesystem::path PathFor(const std::string& key) const
+	{
+		return directory / (key + ".nscz");
+	}
+
+	static Http::Message Reply(int status, const std::string& reason, const std::string& body = "")
+	{
+		Http::Message response;
+		response.status = status;
+		response.reason = reason;
+		response.body = body;
+		return response;
+	}
+
+	Http::Message Get(const std::string& key)
+	{
+		std::ifstream file(PathFor(key), std::ios::binary);
+		std::string data = file.is_open() ? std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>()) : "";
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.gets++;
+		if (!file.is_open())
+			return Reply(404, "Not Found");
+		statistics.hits++;
+		statistics.bytesSent += data.size();
+		Http::Message response = Reply(200, "OK", data);
+		response.headers["content-type"] = "application/x-nsc-blob";
+		return response;
+	}
+
+	Http::Message Put(const std::string& key, const std::string& body)
+	{
+		std::string payload = "";
+		if (!RemoteCache::Decode(body, payload))
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			statistics.rejected++;
+			return Reply(400, "Bad Request");
+		}
+		// Unique per thread, two clients may upload the same entry at once
+		std::ostringstream name;
+		name << key << "." << std::this_thread::get_id() << ".tmp";
+		const std::filesystem::path temporary = directory / name.str();
+		bool written = false;
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write(body.data(), body.size());
+			written = file.good();
+		}
+		std::error_code error;
+		if (written)
+			std::filesystem::rename(temporary, PathFor(key), error);
+		if (!written || error)
+		{
+			std::filesystem::remove(temporary, error);
+			return Reply(500, "Internal Server Error");
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.puts++;
+		statistics.bytesReceived += body.size();
+		return Reply(201, "Created");
+	}
+
+	// One digest per line in, one '0' or '1' per line out
+	Http::Message Contains(const std::string& body)
+	{
+		std::string answer = "";
+		std::error_code error;
+		for (size_t begin = 0, end = 0; begin < body.size(); begin = end + 1)
+		{
+			end = body.find('\n', begin);
+			if (end == std::string::npos)
+				end = body.size();
+			const std::string key = body.substr(begin, end - begin);
+			answer += RemoteCache::IsKey(key) && std::filesystem::exists(PathFor(key), error) ? "1\n" : "0\n";
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.queried += answer.size() / 2;
+		return Reply(200, "OK", answer);
+	}
+
+	Http::Message Handle(const Http::Message& request)
+	{
+		if (request.method == "POST" && request.path == "/cas/contains")
+			return Contains(request.body);
+		const std::string prefix = "/cas/";
+		const std::string key = request.path.compare(0, prefix.size(), prefix) == 0 ? request.path.substr(prefix.size()) : "";
+		if (!RemoteCache::IsKey(key))
+			return Reply(404, "Not Found");
+		if (request.method == "GET")
+			return Get(key);
+		if (request.method == "PUT")
+			return Put(key, request.body);
+		return Reply(405, "Method Not Allowed");
+	}
+
+	void Serve(TcpConnection& connection)
+	{
+		std::string buffer = "";
+		auto lastActive = std::chrono::steady_clock::now();
+		while (!connections.IsStopping())
+		{
+			// A timeout keeps what arrived in buffer, the next read carries on with it
+			Http::Message request;
+			const TcpConnection::Status status = Http::Read(connection, buffer, request, true, connections.PollInterval);
+			if (status == TcpConnection::Status::Timeout)
+			{
+				if (std::chrono::steady_clock::now() - lastActive > std::chrono::milliseconds(idleTimeout))
+					break;
+				continue;
+			}
+			if (status != TcpConnection::Status::Ok)
+				break;
+			const bool close = request.Header("connection") == "close";
+			Http::Message response = Handle(request);
+			response.headers["connection"] = close || connections.IsStopping() ? "close" : "keep-alive";
+			if (!Http::Write(connection, response, false) || close)
+				break;
+			lastActive = std::chrono::steady_clock::now();
+		}
+	}
+
+public:
+	RemoteCacheServer(const std::filesystem::path& directory) : directory(directory) {}
+
+	~RemoteCacheServer()
+	{
+		Stop();
+	}
+
+	// Port 0 picks a free one, GetPort tells which
+	bool Start(const std::string& host, uint16_t port, std::string& error)
+	{
+		std::error_code failure;
+		std::filesystem::create_directories(directory, failure);
+		if (!std::filesystem::is_directory(directory, failure))
+		{
+			error = "Cannot create " + directory.string();
+			return false;
+		}
+		// Temporaries left by a crash
+		for (const auto& file : std::filesystem::directory_iterator(directory, failure))
+		{
+			if (file.path().extension() == ".tmp")
+				std::filesystem::remove(file.path(), failure);
+		}
+		if (!connections.listener.Listen(host, port, error))
+			return false;
+		connections.Start([this](TcpConnection& connection) { Serve(connection); });
+		return true;
+	}
+
+	uint16_t GetPort() const
+	{
+		return connections.listener.GetPort();
+	}
+
+	// Waits for the requests in progress, idle connections are closed
+	void Stop()
+	{
+		connections.Stop();
+	}
+
+	Statistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Statistics result = statistics;
+		result.connections = connections.GetConnections();
+		return result;
+	}
+};
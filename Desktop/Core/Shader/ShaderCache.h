@@ -0,0 +1,405 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include "../../Dependence/Sha256.h"
+#include "RemoteCache.h"
+
+// Compile results keyed by a SHA-256 of the backend, preprocessed source, entry, target, flags and the defines
+// the preprocessor left unapplied.
+// A memory LRU sits in front of a directory of files. Files are written under a temporary name and renamed,
+// so readers never see half a file, carry a checksum so damaged ones are dropped, and the least recently
+// used are evicted once the directory grows past diskBudget.
+// With a RemoteCache set, disk misses are asked there and stores are uploaded in the background.
+class ShaderCache
+{
+public:
+	using Key = Sha256::Digest;
+
+	class Statistics
+	{
+	public:
+		uint64_t memoryHits = 0;
+		uint64_t diskHits = 0;
+		uint64_t remoteHits = 0;
+		uint64_t misses = 0;
+		// Compiles that could not be keyed because preprocessing failed
+		uint64_t uncached = 0;
+		uint64_t stores = 0;
+		uint64_t memoryEvictions = 0;
+		uint64_t diskEvictions = 0;
+		uint64_t corrupt = 0;
+		// Bytecode served without compiling, and the compile time that took originally
+		uint64_t bytesSaved = 0;
+		double timeSaved = 0.0;
+		uint64_t memoryBytes = 0;
+		uint64_t diskBytes = 0;
+	};
+
+private:
+	static constexpr uint32_t Magic = 0x3143534e; // "NSC1"
+	static constexpr uint32_t Version = 1;
+	static constexpr size_t HeaderSize = 4 + 4 + 8 + 32;
+
+	class Entry
+	{
+	public:
+		std::string key = "";
+		ShaderCompiler::Result result = ShaderCompiler::Result();
+		size_t size = 0;
+	};
+
+	mutable std::mutex mutex = {};
+	std::list<Entry> entries = {};
+	std::unordered_map<std::string, std::list<Entry>::iterator> index = {};
+	bool scanned = false;
+	Statistics statistics = Statistics();
+
+	static void Write(std::string& out, const void* data, size_t size)
+	{
+		out.append((const char*)data, size);
+	}
+
+	static bool Read(const std::string& in, size_t& position, void* data, size_t size)
+	{
+		if (position + size > in.size())
+			return false;
+		memcpy(data, in.data() + position, size);
+		position += size;
+		return true;
+	}
+
+	static std::string Serialize(const ShaderCompiler::Result& result)
+	{
+		std::string payload = "";
+		const uint32_t logSize = (uint32_t)result.log.size();
+		const uint32_t bytecodeSize = (uint32_t)result.bytecode.size();
+		Write(payload, &result.compileTime, sizeof(result.compileTime));
+		Write(payload, &logSize, sizeof(logSize));
+		Write(payload, result.log.data(), logSize);
+		Write(payload, &bytecodeSize, sizeof(bytecodeSize));
+		Write(payload, result.bytecode.data(), bytecodeSize);
+		return payload;
+	}
+
+	static bool Deserialize(const std::string& payload, ShaderCompiler::Result& result)
+	{
+		size_t position = 0;
+		uint32_t logSize = 0, bytecodeSize = 0;
+		if (!Read(payload, position, &result.compileTime, sizeof(result.compileTime)) || !Read(payload, position, &logSize, sizeof(logSize)))
+			return false;
+		result.log.resize(logSize);
+		if (!Read(payload, position, result.log.data(), logSize) || !Read(payload, position, &bytecodeSize, sizeof(bytecodeSize)))
+			return false;
+		result.bytecode.resize(bytecodeSize);
+		if (!Read(payload, position, result.bytecode.data(), bytecodeSize))
+			return false;
+		return position == payload.size();
+	}
+
+	std::filesystem::path PathFor(const std::string& key) const
+	{
+		return directory / (key + ".bin");
+	}
+
+	// Called with the mutex held
+	void Remember(const std::string& key, const ShaderCompiler::Result& result)
+	{
+		auto it = index.find(key);
+		if (it != index.end())
+		{
+			entries.splice(entries.begin(), entries, it->second);
+			return;
+		}
+		Entry entry;
+		entry.key = key;
+		entry.result = result;
+		entry.size = result.bytecode.size() + result.log.size();
+		entries.push_front(entry);
+		index[key] = entries.begin();
+		statistics.memoryBytes += entry.size;
+		while (statistics.memoryBytes > memoryBudget && entries.size() > 1)
+		{
+			statistics.memoryBytes -= entries.back().size;
+			index.erase(entries.back().key);
+			entries.pop_back();
+			statistics.memoryEvictions++;
+		}
+	}
+
+	// Called with the mutex held, measures the directory once and drops temporaries left by a crash
+	void Scan()
+	{
+		if (scanned)
+			return;
+		scanned = true;
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		statistics.diskBytes = 0;
+		for (const auto& file : std::filesystem::directory_iterator(directory, error))
+		{
+			if (file.path().extension() == ".tmp")
+				std::filesystem::remove(file.path(), error);
+			else if (file.path().extension() == ".bin")
+				statistics.diskBytes += file.file_size(error);
+		}
+	}
+
+	// Called with the mutex held, drops the least recently used files until the directory is at 90% of the budget
+	void EvictDisk()
+	{
+		if (statistics.diskBytes <= diskBudget)
+			return;
+		std::error_code error;
+		std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files = {};
+		for (const auto& file : std::filesystem::directory_iterator(directory, error))
+		{
+			if (file.path().extension() == ".bin")
+				files.push_back({ file.last_write_time(error), file.path() });
+		}
+		std::sort(files.begin(), files.end());
+		for (const auto& file : files)
+		{
+			if (statistics.diskBytes <= diskBudget / 10 * 9)
+				break;
+			const uint64_t size = std::filesystem::file_size(file.second, error);
+			if (std::filesystem::remove(file.second, error))
+			{
+				statistics.diskBytes -= std::min<uint64_t>(size, statistics.diskBytes);
+				statistics.diskEvictions++;
+			}
+		}
+	}
+
+	bool LoadFile(const std::string& key, ShaderCompiler::Result& result)
+	{
+		const std::filesystem::path path = PathFor(key);
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+			return false;
+		std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		file.close();
+
+		size_t position = 0;
+		uint32_t magic = 0, version = 0;
+		uint64_t payloadSize = 0;
+		Key checksum = {};
+		bool valid = Read(data, position, &magic, sizeof(magic)) && Read(data, position, &version, sizeof(version)) &&
+			Read(data, position, &payloadSize, sizeof(payloadSize)) && Read(data, position, checksum.data(), checksum.size()) &&
+			magic == Magic && version == Version && payloadSize == data.size() - HeaderSize;
+		if (valid)
+		{
+			const std::string payload = data.substr(HeaderSize);
+			valid = Sha256::Hash(payload.data(), payload.size()) == checksum && Deserialize(payload, result);
+		}
+		std::error_code error;
+		if (!valid)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (std::filesystem::remove(path, error))
+				statistics.diskBytes -= std::min<uint64_t>(data.size(), statistics.diskBytes);
+			statistics.corrupt++;
+			return false;
+		}
+		// Mark as recently used for eviction
+		std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+		return true;
+	}
+
+	void StoreFile(const std::string& key, const ShaderCompiler::Result& result)
+	{
+		const std::string payload = Serialize(result);
+		const Key checksum = Sha256::Hash(payload.data(), payload.size());
+		const uint64_t payloadSize = payload.size();
+		std::string data = "";
+		Write(data, &Magic, sizeof(Magic));
+		Write(data, &Version, sizeof(Version));
+		Write(data, &payloadSize, sizeof(payloadSize));
+		Write(data, checksum.data(), checksum.size());
+		data += payload;
+
+		// Unique per thread, several workers may store the same key at once
+		std::ostringstream name;
+		name << key << "." << std::this_thread::get_id() << ".tmp";
+		const std::filesystem::path temporary = directory / name.str();
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+				return;
+			file.write(data.data(), data.size());
+			if (!file.good())
+			{
+				file.close();
+				std::error_code error;
+				std::filesystem::remove(temporary, error);
+				return;
+			}
+		}
+		std::error_code error;
+		const std::filesystem::path path = PathFor(key);
+		const bool existed = std::filesystem::exists(path, error);
+		const uint64_t previousSize = existed ? std::filesystem::file_size(path, error) : 0;
+		std::filesystem::rename(temporary, path, error);
+		if (error)
+		{
+			std::filesystem::remove(temporary, error);
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.diskBytes += data.size();
+		statistics.diskBytes -= std::min<uint64_t>(previousSize, statistics.diskBytes);
+		EvictDisk();
+	}
+
+public:
+	std::filesystem::path directory = "";
+	uint64_t memoryBudget = 64ull << 20;
+	uint64_t diskBudget = 256ull << 20;
+	bool diskEnabled = true;
+	// Not owned, nullptr keeps the cache local
+	RemoteCache* remote = nullptr;
+
+	ShaderCache() : directory(std::filesystem::current_path() / "cache" / "shaders") {}
+	ShaderCache(const std::filesystem::path& directory) : directory(directory) {}
+
+	static Key MakeKey(const ShaderCompiler* compiler, const ShaderCompiler::Request& request, const std::string& preprocessed)
+	{
+		Sha256 hash;
+		hash.Update(std::string(compiler->GetName()));
+		hash.Update(preprocessed);
+		hash.Update(request.entry);
+		hash.Update(request.target);
+		const uint64_t defineCount = compiler->ExpandsDefines() ? 0 : request.defines.size();
+		hash.Update(&defineCount, sizeof(defineCount));
+		for (uint64_t i = 0; i < defineCount; i++)
+		{
+			hash.Update(request.defines[i].first);
+			hash.Update(request.defines[i].second);
+		}
+		hash.Update(&request.flags, sizeof(request.flags));
+		return hash.Final();
+	}
+
+	bool Lookup(const Key& key, ShaderCompiler::Result& result)
+	{
+		const std::string name = Sha256::ToHex(key);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = index.find(name);
+			if (it != index.end())
+			{
+				entries.splice(entries.begin(), entries, it->second);
+				result = it->second->result;
+				statistics.memoryHits++;
+				statistics.bytesSaved += result.bytecode.size();
+				statistics.timeSaved += result.compileTime;
+				result.cached = true;
+				result.cacheTier = ShaderCompiler::CacheTier::Memory;
+				return true;
+			}
+			if (diskEnabled)
+				Scan();
+		}
+		bool found = diskEnabled && LoadFile(name, result);
+		bool remoteHit = false;
+		if (!found && remote != nullptr)
+		{
+			std::string payload = "";
+			remoteHit = found = remote->Get(name, payload) && Deserialize(payload, result);
+			// Kept on disk as well, the next lookup stays on this machine
+			if (remoteHit && diskEnabled)
+				StoreFile(name, result);
+		}
+		if (!found)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			statistics.misses++;
+			return false;
+		}
+		result.success = true;
+		result.diagnostics = ShaderCompiler::ParseDiagnostics(result.log);
+		std::lock_guard<std::mutex> lock(mutex);
+		Remember(name, result);
+		(remoteHit ? statistics.remoteHits : statistics.diskHits)++;
+		statistics.bytesSaved += result.bytecode.size();
+		statistics.timeSaved += result.compileTime;
+		result.cached = true;
+		result.cacheTier = remoteHit ? ShaderCompiler::CacheTier::Remote : ShaderCompiler::CacheTier::Disk;
+		return true;
+	}
+
+	// Only successful results are kept, failures have to be reported again
+	void Store(const Key& key, const ShaderCompiler::Result& result)
+	{
+		if (!result.success)
+			return;
+		const std::string name = Sha256::ToHex(key);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			Remember(name, result);
+			statistics.stores++;
+			if (diskEnabled)
+				Scan();
+		}
+		if (diskEnabled)
+			StoreFile(name, result);
+		if (remote != nullptr)
+			remote->Upload(name, Serialize(result));
+	}
+
+	// Preprocesses, then answers from the cache or compiles and stores. Thread safe.
+	ShaderCompiler::Result Compile(ShaderCompiler* compiler, const ShaderCompiler::Request& request)
+	{
+		std::string preprocessed = "", log = "";
+		std::vector<ShaderCompiler::Include> includes = {};
+		const auto start = std::chrono::steady_clock::now();
+		if (!compiler->Preprocess(request, preprocessed, log, includes))
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				statistics.uncached++;
+			}
+			return compiler->Compile(request);
+		}
+		const float preprocessTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		const Key key = MakeKey(compiler, request, preprocessed);
+		ShaderCompiler::Result result;
+		if (Lookup(key, result))
+		{
+			// Not stored, the preprocessor just found them again
+			result.includes = includes;
+			result.preprocessTime = preprocessTime;
+			return result;
+		}
+		result = compiler->Compile(request);
+		Store(key, result);
+		result.preprocessTime = preprocessTime;
+		return result;
+	}
+
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+		index.clear();
+		statistics.memoryBytes = 0;
+		std::error_code error;
+		for (const auto& file : std::filesystem::directory_iterator(directory, error))
+		{
+			if (file.path().extension() == ".bin")
+				std::filesystem::remove(file.path(), error);
+		}
+		statistics.diskBytes = 0;
+	}
+
+	Statistics GetStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return statistics;
+	}
+};
\ No newline at end of file
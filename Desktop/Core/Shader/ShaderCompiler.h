@@ -0,0 +1,276 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "IncludeResolver.h"
+
+// Turns HLSL source into bytecode. Creating device objects from the bytecode is left to RenderDevice,
+// so backends can run on any thread and on machines without a GPU.
+class ShaderCompiler
+{
+public:
+	enum Flags : uint32_t
+	{
+		None = 0,
+		Debug = 1 << 0,
+		SkipOptimization = 1 << 1,
+		OptimizationLevel3 = 1 << 2,
+		WarningsAreErrors = 1 << 3,
+		PackMatrixRowMajor = 1 << 4
+	};
+
+	class Request
+	{
+	public:
+		std::string source = "";
+		// File name reported in diagnostics
+		std::string sourceName = "";
+		std::string entry = "main";
+		std::string target = "ps_4_0";
+		std::vector<std::pair<std::string, std::string>> defines = {};
+		uint32_t flags = Flags::None;
+		// Opens #include files, quoted includes of the source itself are looked up in directory first.
+		// Without a resolver every #include fails.
+		IncludeResolver* resolver = nullptr;
+		std::string directory = "";
+	};
+
+	// One file opened by #include, parent is the path of the including file and empty for the source itself
+	class Include
+	{
+	public:
+		std::string path = "";
+		std::string parent = "";
+	};
+
+	class Diagnostic
+	{
+	public:
+		enum class Severity
+		{
+			Error,
+			Warning,
+			Info
+		};
+		Severity severity = Severity::Error;
+		std::string file = "";
+		int line = 0;
+		int column = 0;
+		std::string code = "";
+		std::string message = "";
+	};
+
+	// Where ShaderCache found a result
+	enum class CacheTier
+	{
+		None,
+		Memory,
+		Disk,
+		Remote
+	};
+
+	class Result
+	{
+	public:
+		bool success = false;
+		std::vector<uint8_t> bytecode = {};
+		// Compiler output as printed, and the same output split per message
+		std::string log = "";
+		std::vector<Diagnostic> diagnostics = {};
+		// Milliseconds spent in the backend, for cached results the time of the original compile
+		float compileTime = 0.f;
+		// Served by ShaderCache instead of the backend, and from which of its tiers
+		bool cached = false;
+		CacheTier cacheTier = CacheTier::None;
+		// Milliseconds ShaderCache spent preprocessing to find the cache key
+		float preprocessTime = 0.f;
+		// Every file the source pulled in, directly or through other includes
+		std::vector<Include> includes = {};
+
+		size_t ErrorCount() const
+		{
+			size_t count = 0;
+			for (const Diagnostic& diagnostic : diagnostics)
+			{
+				if (diagnostic.severity == Diagnostic::Severity::Error)
+					count++;
+			}
+			return count;
+		}
+	};
+
+protected:
+	static constexpr int MaxIncludeDepth = 32;
+
+	// Fills success, bytecode, log and includes
+	virtual void CompileSource(const Request& request, Result& result) = 0;
+
+	static bool ParseInclude(const std::string& line, std::string& name, bool& system)
+	{
+		size_t position = line.find_first_not_of(" \t");
+		if (position == std::string::npos || line[position] != '#')
+			return false;
+		position = line.find_first_not_of(" \t", position + 1);
+		if (position == std::string::npos || line.compare(position, 7, "include") != 0)
+			return false;
+		position = line.find_first_not_of(" \t", position + 7);
+		if (position == std::string::npos || (line[position] != '"' && line[position] != '<'))
+			return false;
+		system = line[position] == '<';
+		const size_t end = line.find(system ? '>' : '"', position + 1);
+		if (end == std::string::npos)
+			return false;
+		name = line.substr(position + 1, end - position - 1);
+		return true;
+	}
+
+	static bool Expand(const Request& request, const std::string& source, const std::string& file, const std::string& path,
+		const std::string& directory, int depth, std::string& output, std::string& log, std::vector<Include>& includes)
+	{
+		int line = 1;
+		for (size_t begin = 0; begin < source.size(); line++)
+		{
+			size_t end = source.find('\n', begin);
+			if (end == std::string::npos)
+				end = source.size();
+			const std::string text = source.substr(begin, end - begin);
+			begin = end + 1;
+			std::string name = "";
+			bool system = false;
+			if (!ParseInclude(text, name, system))
+			{
+				output += text;
+				output += '\n';
+				continue;
+			}
+			if (depth >= MaxIncludeDepth)
+			{
+				log += file + "(" + std::to_string(line) + ",1): error X1504: '" + name + "': include nesting too deep\n";
+				return false;
+			}
+			std::string included = "";
+			IncludeResolver::Content content = nullptr;
+			if (request.resolver == nullptr || !request.resolver->Open(name, system, directory, included, content))
+			{
+				log += file + "(" + std::to_string(line) + ",10): error X1507: failed to open source file: '" + name + "'\n";
+				return false;
+			}
+			AddInclude(includes, included, path);
+			output += "#line 1 \"" + included + "\"\n";
+			if (!Expand(request, *content, included, included, std::filesystem::path(included).parent_path().string(), depth + 1, output, log, includes))
+				return false;
+			output += "#line " + std::to_string(line + 1) + " \"" + file + "\"\n";
+		}
+		return true;
+	}
+
+public:
+	virtual ~ShaderCompiler() {}
+
+	virtual const char* GetName() const = 0;
+
+	// Whether Preprocess already applies the defines, they are then left out of cache keys so variants that
+	// preprocess to the same text share one compile
+	virtual bool ExpandsDefines() const
+	{
+		return false;
+	}
+
+	// Expands includes and macros, the output identifies the compile together with entry, target and flags.
+	// Backends without a preprocessor only inline includes, defines are still part of the cache key.
+	virtual bool Preprocess(const Request& request, std::string& output, std::string& log, std::vector<Include>& includes)
+	{
+		return ExpandIncludes(request, output, log, includes);
+	}
+
+	// Inlines #include directives through request.resolver, with #line markers so diagnostics keep their file and line
+	static bool ExpandIncludes(const Request& request, std::string& output, std::string& log, std::vector<Include>& includes)
+	{
+		output.clear();
+		return Expand(request, request.source, request.sourceName.empty() ? "Source" : request.sourceName, "", request.directory, 0, output, log, includes);
+	}
+
+	static void AddInclude(std::vector<Include>& includes, const std::string& path, const std::string& parent)
+	{
+		for (const Include& include : includes)
+		{
+			if (include.path == path && include.parent == parent)
+				return;
+		}
+		includes.push_back({ path, parent });
+	}
+
+	// Thread safe as long as the backend is
+	Result Compile(const Request& request)
+	{
+		Result result;
+		const auto start = std::chrono::steady_clock::now();
+		CompileSource(request, result);
+		result.compileTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		result.diagnostics = ParseDiagnostics(result.log);
+		if (!result.success && result.ErrorCount() == 0 && !result.log.empty())
+		{
+			Diagnostic diagnostic;
+			diagnostic.file = request.sourceName;
+			diagnostic.message = result.log;
+			result.diagnostics.push_back(diagnostic);
+		}
+		return result;
+	}
+
+	// Splits "file(line,column): error X0000: message" lines, as printed by fxc and D3DCompile
+	static std::vector<Diagnostic> ParseDiagnostics(const std::string& log)
+	{
+		std::vector<Diagnostic> diagnostics = {};
+		size_t begin = 0;
+		while (begin < log.size())
+		{
+			size_t end = log.find('\n', begin);
+			if (end == std::string::npos)
+				end = log.size();
+			std::string line = log.substr(begin, end - begin);
+			begin = end + 1;
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (line.empty())
+				continue;
+
+			Diagnostic diagnostic;
+			size_t position = 0;
+			const size_t open = line.find('(');
+			const size_t close = line.find("): ");
+			if (open != std::string::npos && close != std::string::npos && open < close)
+			{
+				diagnostic.file = line.substr(0, open);
+				std::string location = line.substr(open + 1, close - open - 1);
+				diagnostic.line = atoi(location.c_str());
+				const size_t comma = location.find(',');
+				if (comma != std::string::npos)
+					diagnostic.column = atoi(location.c_str() + comma + 1);
+				position = close + 3;
+			}
+			std::string rest = line.substr(position);
+			if (rest.rfind("error", 0) == 0)
+				diagnostic.severity = Diagnostic::Severity::Error;
+			else if (rest.rfind("warning", 0) == 0)
+				diagnostic.severity = Diagnostic::Severity::Warning;
+			else
+				diagnostic.severity = Diagnostic::Severity::Info;
+			const size_t codeBegin = rest.find(' ');
+			const size_t codeEnd = rest.find(": ");
+			if (diagnostic.severity != Diagnostic::Severity::Info && codeBegin != std::string::npos && codeEnd != std::string::npos && codeBegin < codeEnd)
+			{
+				diagnostic.code = rest.substr(codeBegin + 1, codeEnd - codeBegin - 1);
+				diagnostic.message = rest.substr(codeEnd + 2);
+			}
+			else
+			{
+				diagnostic.message = rest;
+			}
+			diagnostics.push_back(diagnostic);
+		}
+		return diagnostics;
+	}
+};
\ No newline at end of file
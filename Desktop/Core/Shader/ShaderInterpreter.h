@@ -0,0 +1,1536 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Runs preview pixel shaders on the CPU, for machines without a GPU. The source is preprocessed, parsed by
+// HlslParser and compiled to a flat program over SoA registers: a register holds four components for Lanes
+// pixels and every instruction loops over the lanes, which the compiler turns into SIMD. Divergent control
+// flow keeps a stack of lane masks, only stores to variables honour it. Rendering splits the target into
+// tiles on the ThreadPool.
+// Covered: scalars and vectors (integers are kept as floats), swizzles, operators, if/else, loops with break
+// and continue, user functions (inlined), static globals, component-wise intrinsics, Texture2D.Sample and
+// tex2D with the bilinear wrap sampler, and PS_INPUT style inputs matched by semantic. Matrices, arrays,
+// switch and bitwise operators are rejected, cbuffer and uniform values read as zero.
+template <size_t Lanes = 8>
+class ShaderInterpreter
+{
+	static_assert(Lanes >= 1 && Lanes <= 32, "Lane masks are 32 bit");
+
+public:
+	// Tightly packed RGBA8 pixels bound to a texture slot
+	class Texture
+	{
+	public:
+		const unsigned char* rgba = nullptr;
+		int width = 0;
+		int height = 0;
+	};
+
+	class Statistics
+	{
+	public:
+		uint64_t instructions = 0;
+		uint64_t registers = 0;
+		// Milliseconds
+		float compileTime = 0.f;
+		float renderTime = 0.f;
+	};
+
+	static constexpr int TileSize = 32;
+
+private:
+	using Node = HlslParser::Node;
+
+	enum class Op : uint8_t
+	{
+		// destination = a
+		Move,
+		// destination[i] = a[swizzle[i]]
+		Swizzle,
+		// destination[swizzle[i]] = a[i] in every lane
+		Insert,
+		// destination[swizzle[i]] = a[i] in the active lanes
+		Store,
+		Unary,
+		Binary,
+		Ternary,
+		Dot,
+		Cross,
+		// destination = texture target sampled at a.xy
+		Sample,
+		// Pushes the active lanes where a is not zero
+		If,
+		// Replaces the top with the lanes below it where a is zero
+		Else,
+		// Keeps the active lanes where a is not zero
+		While,
+		Push,
+		Pop,
+		// Active lanes leave every mask from depth target up, for return, break and continue
+		Clear,
+		Discard,
+		Jump,
+		JumpIfNone
+	};
+
+	enum class Function : uint8_t
+	{
+		Add,
+		Subtract,
+		Multiply,
+		Divide,
+		Modulo,
+		Less,
+		LessEqual,
+		Greater,
+		GreaterEqual,
+		Equal,
+		NotEqual,
+		LogicalAnd,
+		LogicalOr,
+		Negate,
+		Not,
+		Abs,
+		Saturate,
+		Frac,
+		Floor,
+		Ceil,
+		Round,
+		Trunc,
+		Sqrt,
+		Rsqrt,
+		Rcp,
+		Exp,
+		Exp2,
+		Log,
+		Log2,
+		Log10,
+		Sin,
+		Cos,
+		Tan,
+		Asin,
+		Acos,
+		Atan,
+		Sign,
+		Radians,
+		Degrees,
+		Min,
+		Max,
+		Pow,
+		Step,
+		Fmod,
+		Atan2,
+		Lerp,
+		Clamp,
+		Smoothstep,
+		Mad,
+		Select
+	};
+
+	class Instruction
+	{
+	public:
+		Op op = Op::Move;
+		Function function = Function::Add;
+		uint8_t width = 4;
+		uint8_t swizzle[4] = { 0, 1, 2, 3 };
+		uint16_t destination = 0;
+		uint16_t a = 0;
+		uint16_t b = 0;
+		uint16_t c = 0;
+		// Jump target, texture slot or mask depth
+		uint32_t target = 0;
+	};
+
+	class alignas(32) Register
+	{
+	public:
+		float v[4][Lanes] = {};
+	};
+
+	class Value
+	{
+	public:
+		uint16_t index = 0;
+		uint8_t width = 1;
+	};
+
+	// Register components an assignment writes
+	class Location
+	{
+	public:
+		uint16_t index = 0;
+		uint8_t width = 1;
+		uint8_t components[4] = { 0, 1, 2, 3 };
+	};
+
+	class Symbol
+	{
+	public:
+		enum class Kind : uint8_t
+		{
+			Value,
+			Struct,
+			Texture,
+			Sampler
+		};
+
+		Kind kind = Kind::Value;
+		Value value = Value();
+		uint32_t slot = 0;
+		std::vector<std::pair<std::string_view, Value>> fields = {};
+	};
+
+	// Function being inlined, its return writes result and leaves the masks from depth up
+	class Frame
+	{
+	public:
+		Value result = Value();
+		int depth = 0;
+	};
+
+	static constexpr uint16_t PositionRegister = 0;
+	static constexpr uint16_t ColorRegister = 1;
+	static constexpr uint16_t TexcoordRegister = 2;
+	static constexpr uint16_t OutputRegister = 3;
+	static constexpr int MaxDepth = 64;
+	// Backward jumps per batch before the shader counts as hung
+	static constexpr uint32_t MaxIterations = 1 << 20;
+	static constexpr uint32_t AllLanes = Lanes == 32 ? 0xffffffffu : (1u << Lanes) - 1;
+
+	std::vector<Instruction> code = {};
+	// Registers at the start of every batch, constants included
+	std::vector<Register> prototype = {};
+
+	// Compile state, the tree points into text
+	std::string text = "";
+	std::string file = "";
+	std::string error = "";
+	Arena arena = Arena();
+	std::vector<std::unordered_map<std::string_view, Symbol>> scopes = {};
+	// Lookups skip the scopes of callers, scopes[0] holds the globals
+	size_t scopeBase = 1;
+	std::unordered_map<std::string_view, const Node*> functions = {};
+	std::unordered_map<std::string_view, const Node*> structs = {};
+	std::unordered_map<std::string_view, uint8_t> typedefs = {};
+	std::unordered_map<std::string, uint16_t> constants = {};
+	std::vector<const Node*> inlining = {};
+	std::vector<int> loops = {};
+	std::vector<Frame> frames = {};
+	int depth = 0;
+	uint32_t textureCount = 0;
+
+	// Keeps the first error, compiling goes on with a placeholder so callers need no checks
+	Value Fail(const Node* node, const std::string& message)
+	{
+		if (error.empty())
+			error = file + "(" + std::to_string(node->line) + "," + std::to_string(node->column) + "): " + message;
+		return Value();
+	}
+
+	uint16_t NewRegister(const Node* node)
+	{
+		if (prototype.size() >= 0xffff)
+		{
+			Fail(node, "shader is too large for the CPU interpreter");
+			return 0;
+		}
+		prototype.emplace_back();
+		return (uint16_t)(prototype.size() - 1);
+	}
+
+	size_t Emit(const Instruction& instruction)
+	{
+		code.push_back(instruction);
+		return code.size() - 1;
+	}
+
+	size_t Emit(Op op, uint16_t destination = 0, uint16_t a = 0, uint8_t width = 4, uint32_t target = 0)
+	{
+		Instruction instruction;
+		instruction.op = op;
+		instruction.destination = destination;
+		instruction.a = a;
+		instruction.width = width;
+		instruction.target = target;
+		return Emit(instruction);
+	}
+
+	void PushMask(const Node* node, Op op, uint16_t condition = 0)
+	{
+		if (++depth >= MaxDepth)
+			Fail(node, "control flow is nested too deeply");
+		Emit(op, 0, condition);
+	}
+
+	void PopMask()
+	{
+		depth--;
+		Emit(Op::Pop);
+	}
+
+	Value Constant(const Node* node, float x, float y, float z, float w, uint8_t width)
+	{
+		const float components[4] = { x, y, z, w };
+		const std::string key((const char*)components, sizeof(components));
+		auto found = constants.find(key);
+		if (found != constants.end())
+			return Value{ found->second, width };
+		const uint16_t index = NewRegister(node);
+		for (int c = 0; c < 4; c++)
+		{
+			for (size_t l = 0; l < Lanes; l++)
+				prototype[index].v[c][l] = components[c];
+		}
+		constants[key] = index;
+		return Value{ index, width };
+	}
+
+	Value Constant(const Node* node, float value)
+	{
+		return Constant(node, value, value, value, value, 1);
+	}
+
+	// Scalars are replicated, wider values keep their first components
+	Value Convert(const Node* node, Value value, uint8_t width)
+	{
+		if (value.width == width)
+			return value;
+		if (value.width > width)
+			return Value{ value.index, width };
+		if (value.width != 1)
+			return Fail(node, "cannot convert from a " + std::to_string(value.width) + " to a " + std::to_string(width) + " component value");
+		Instruction instruction;
+		instruction.op = Op::Swizzle;
+		instruction.destination = NewRegister(node);
+		instruction.a = value.index;
+		instruction.width = width;
+		memset(instruction.swizzle, 0, sizeof(instruction.swizzle));
+		Emit(instruction);
+		return Value{ instruction.destination, width };
+	}
+
+	Value Apply(const Node* node, Op op, Function function, Value a, Value b = Value(), Value c = Value())
+	{
+		const int operands = op == Op::Unary ? 1 : op == Op::Binary ? 2 : 3;
+		const Value* others[] = { &b, &c };
+		uint8_t width = a.width;
+		// Mixing vector sizes truncates to the smaller one, scalars go with any size
+		for (int i = 0; i + 1 < operands; i++)
+		{
+			if (width == 1 || (others[i]->width != 1 && others[i]->width < width))
+				width = others[i]->width;
+		}
+		Instruction instruction;
+		instruction.op = op;
+		instruction.function = function;
+		instruction.width = width;
+		instruction.destination = NewRegister(node);
+		instruction.a = Convert(node, a, width).index;
+		if (operands > 1)
+			instruction.b = Convert(node, b, width).index;
+		if (operands > 2)
+			instruction.c = Convert(node, c, width).index;
+		Emit(instruction);
+		return Value{ instruction.destination, width };
+	}
+
+	Value Dot(const Node* node, Value a, Value b)
+	{
+		const uint8_t width = std::min(a.width, b.width);
+		Instruction instruction;
+		instruction.op = Op::Dot;
+		instruction.width = width;
+		instruction.destination = NewRegister(node);
+		instruction.a = a.index;
+		instruction.b = b.index;
+		Emit(instruction);
+		return Value{ instruction.destination, 1 };
+	}
+
+	// Components of a scalar or vector type, 0 for anything else
+	uint8_t WidthOf(std::string_view name) const
+	{
+		auto found = typedefs.find(name);
+		if (found != typedefs.end())
+			return found->second;
+		static const char* scalars[] = { "float", "half", "double", "int", "uint", "dword", "bool", "min16float", "min10float", "min16int",
+			"min12int", "min16uint" };
+		for (const char* scalar : scalars)
+		{
+			const size_t length = strlen(scalar);
+			if (name.compare(0, length, scalar) != 0)
+				continue;
+			if (name.size() == length)
+				return 1;
+			if (name.size() == length + 1 && name[length] >= '1' && name[length] <= '4')
+				return (uint8_t)(name[length] - '0');
+		}
+		return 0;
+	}
+
+	uint8_t WidthOf(const Node* type) const
+	{
+		// vector<float, 3>
+		if (type->name == "vector" && type->first != nullptr && type->first->next != nullptr && type->first->next->kind == Node::Kind::Literal)
+			return (uint8_t)std::clamp(atoi(std::string(type->first->next->name).c_str()), 1, 4);
+		return WidthOf(type->name);
+	}
+
+	static bool IsInteger(std::string_view name)
+	{
+		return name.compare(0, 3, "int") == 0 || name.compare(0, 4, "uint") == 0 || name.compare(0, 5, "dword") == 0 || name.compare(0, 8, "min16int") == 0
+			|| name.compare(0, 8, "min12int") == 0 || name.compare(0, 9, "min16uint") == 0;
+	}
+
+	const Symbol* Find(std::string_view name) const
+	{
+		for (size_t i = scopes.size(); i > scopeBase; i--)
+		{
+			auto found = scopes[i - 1].find(name);
+			if (found != scopes[i - 1].end())
+				return &found->second;
+		}
+		auto found = scopes[0].find(name);
+		return found != scopes[0].end() ? &found->second : nullptr;
+	}
+
+	// .xyzw or .rgba of a value with width components
+	bool ParseSwizzle(const Node* node, std::string_view swizzle, uint8_t width, uint8_t components[4])
+	{
+		if (swizzle.empty() || swizzle.size() > 4)
+		{
+			Fail(node, "invalid swizzle '" + std::string(swizzle) + "'");
+			return false;
+		}
+		for (size_t i = 0; i < swizzle.size(); i++)
+		{
+			size_t component = std::string_view("xyzw").find(swizzle[i]);
+			if (component == std::string_view::npos)
+				component = std::string_view("rgba").find(swizzle[i]);
+			if (component >= width)
+			{
+				Fail(node, "invalid swizzle '" + std::string(swizzle) + "'");
+				return false;
+			}
+			components[i] = (uint8_t)component;
+		}
+		return true;
+	}
+
+	Location Lvalue(const Node* node)
+	{
+		Location location;
+		if (node->kind == Node::Kind::Name)
+		{
+			const Symbol* symbol = Find(node->name);
+			if (symbol == nullptr || symbol->kind != Symbol::Kind::Value)
+			{
+				Fail(node, symbol == nullptr ? "undeclared identifier '" + std::string(node->name) + "'" : "'" + std::string(node->name) + "' is not assignable");
+				return location;
+			}
+			location.index = symbol->value.index;
+			location.width = symbol->value.width;
+			return location;
+		}
+		if (node->kind != Node::Kind::Member)
+		{
+			Fail(node, "l-value required");
+			return location;
+		}
+		if (const Value* field = Field(node))
+		{
+			location.index = field->index;
+			location.width = field->width;
+			return location;
+		}
+		const Location base = Lvalue(node->value);
+		uint8_t components[4] = {};
+		if (!ParseSwizzle(node, node->name, base.width, components))
+			return location;
+		location.index = base.index;
+		location.width = (uint8_t)node->name.size();
+		for (uint8_t i = 0; i < location.width; i++)
+		{
+			location.components[i] = base.components[components[i]];
+			for (uint8_t j = 0; j < i; j++)
+			{
+				if (location.components[j] == location.components[i])
+					Fail(node, "duplicate component in an assigned swizzle");
+			}
+		}
+		return location;
+	}
+
+	// Member of a struct parameter, nullptr when node is a swizzle
+	const Value* Field(const Node* node)
+	{
+		if (node->value->kind != Node::Kind::Name)
+			return nullptr;
+		const Symbol* symbol = Find(node->value->name);
+		if (symbol == nullptr || symbol->kind != Symbol::Kind::Struct)
+			return nullptr;
+		for (const auto& field : symbol->fields)
+		{
+			if (field.first == node->name)
+				return &field.second;
+		}
+		Fail(node, "'" + std::string(node->name) + "' is not a member of '" + std::string(node->value->name) + "'");
+		return nullptr;
+	}
+
+	void Store(const Node* node, const Location& location, Value value)
+	{
+		value = Convert(node, value, location.width);
+		Instruction instruction;
+		instruction.op = Op::Store;
+		instruction.destination = location.index;
+		instruction.a = value.index;
+		instruction.width = location.width;
+		memcpy(instruction.swizzle, location.components, sizeof(instruction.swizzle));
+		Emit(instruction);
+	}
+
+	static bool BinaryFunction(std::string_view op, Function& function)
+	{
+		static const std::pair<const char*, Function> operators[] = {
+			{ "+", Function::Add }, { "-", Function::Subtract }, { "*", Function::Multiply }, { "/", Function::Divide }, { "%", Function::Modulo },
+			{ "<", Function::Less }, { "<=", Function::LessEqual }, { ">", Function::Greater }, { ">=", Function::GreaterEqual },
+			{ "==", Function::Equal }, { "!=", Function::NotEqual }, { "&&", Function::LogicalAnd }, { "||", Function::LogicalOr } };
+		for (const auto& entry : operators)
+		{
+			if (op == entry.first)
+			{
+				function = entry.second;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Value Assign(const Node* node)
+	{
+		const Location location = Lvalue(node->left);
+		Value value = Expression(node->right);
+		if (node->name != "=")
+		{
+			Function function = Function::Add;
+			if (!BinaryFunction(node->name.substr(0, node->name.size() - 1), function))
+				return Fail(node, "operator '" + std::string(node->name) + "' is not supported by the CPU interpreter");
+			value = Apply(node, Op::Binary, function, Expression(node->left), value);
+		}
+		Store(node, location, value);
+		return Convert(node, value, location.width);
+	}
+
+	// ++ and --, postfix returns a copy of the old value
+	Value Increment(const Node* node, bool postfix)
+	{
+		const Location location = Lvalue(node->value);
+		Value old = Expression(node->value);
+		if (postfix)
+		{
+			const Value copy = { NewRegister(node), old.width };
+			Emit(Op::Move, copy.index, old.index, old.width);
+			old = copy;
+		}
+		const Value updated = Apply(node, Op::Binary, node->name == "++" ? Function::Add : Function::Subtract, old, Constant(node, 1.f));
+		Store(node, location, updated);
+		return postfix ? old : updated;
+	}
+
+	Value Construct(const Node* node, uint8_t width)
+	{
+		if (node->first != nullptr && node->first->next == nullptr)
+		{
+			const Value value = Expression(node->first);
+			if (value.width == 1)
+				return Convert(node, value, width);
+		}
+		const Value result = { NewRegister(node), width };
+		uint8_t filled = 0;
+		for (const Node* argument = node->first; argument != nullptr; argument = argument->next)
+		{
+			const Value value = Expression(argument);
+			if (filled + value.width > width)
+				return Fail(node, "too many components in a constructor");
+			Instruction instruction;
+			instruction.op = Op::Insert;
+			instruction.destination = result.index;
+			instruction.a = value.index;
+			instruction.width = value.width;
+			for (uint8_t c = 0; c < value.width; c++)
+				instruction.swizzle[c] = filled + c;
+			Emit(instruction);
+			filled += value.width;
+		}
+		if (filled != width)
+			return Fail(node, "not enough components in a constructor");
+		return result;
+	}
+
+	Value Sample(const Node* node, uint32_t slot, const Node* texcoord)
+	{
+		const Value uv = Convert(texcoord, Expression(texcoord), 2);
+		const Value result = { NewRegister(node), 4 };
+		Emit(Op::Sample, result.index, uv.index, 4, slot);
+		return result;
+	}
+
+	Value Inline(const Node* node, const Node* function)
+	{
+		for (const Node* active : inlining)
+		{
+			if (active == function)
+				return Fail(node, "recursive call to '" + std::string(function->name) + "'");
+		}
+		if (function->body == nullptr)
+			return Fail(node, "function '" + std::string(function->name) + "' has no body");
+		// Arguments are evaluated in the caller's scope, out parameters are written back after the body
+		std::unordered_map<std::string_view, Symbol> parameters;
+		std::vector<std::pair<Location, Value>> outputs;
+		const Node* argument = node->first;
+		for (const Node* parameter = function->first; parameter != nullptr; parameter = parameter->next)
+		{
+			const uint8_t width = WidthOf(parameter->type);
+			if (width == 0)
+				return Fail(parameter, "parameters of type '" + std::string(parameter->type->name) + "' are not supported by the CPU interpreter");
+			const Node* source = argument != nullptr ? argument : parameter->value;
+			if (source == nullptr)
+				return Fail(node, "not enough arguments to '" + std::string(function->name) + "'");
+			Symbol symbol;
+			symbol.value = Value{ NewRegister(parameter), width };
+			if (parameter->modifiers & Node::In || !(parameter->modifiers & Node::Out))
+			{
+				const Value value = Convert(source, Expression(source), width);
+				Emit(Op::Move, symbol.value.index, value.index, width);
+			}
+			if (parameter->modifiers & Node::Out)
+				outputs.emplace_back(Lvalue(source), symbol.value);
+			parameters[parameter->name] = symbol;
+			if (argument != nullptr)
+				argument = argument->next;
+		}
+		if (argument != nullptr)
+			return Fail(node, "too many arguments to '" + std::string(function->name) + "'");
+
+		Frame frame;
+		frame.result.width = 0;
+		if (function->type->name != "void")
+		{
+			const uint8_t width = WidthOf(function->type);
+			if (width == 0)
+				return Fail(node, "functions returning '" + std::string(function->type->name) + "' are not supported by the CPU interpreter");
+			frame.result = Value{ NewRegister(node), width };
+		}
+		const size_t base = scopeBase;
+		scopeBase = scopes.size();
+		scopes.push_back(std::move(parameters));
+		inlining.push_back(function);
+		PushMask(node, Op::Push);
+		frame.depth = depth;
+		frames.push_back(frame);
+		Statement(function->body);
+		frames.pop_back();
+		PopMask();
+		inlining.pop_back();
+		scopes.pop_back();
+		scopeBase = base;
+		for (const auto& output : outputs)
+			Store(node, output.first, output.second);
+		return frame.result;
+	}
+
+	Value Call(const Node* node)
+	{
+		const Node* callee = node->value;
+		std::vector<const Node*> arguments;
+		for (const Node* argument = node->first; argument != nullptr; argument = argument->next)
+			arguments.push_back(argument);
+		// texture.Sample(sampler, uv) and its level, bias and gradient forms, which read the only level there is
+		if (callee->kind == Node::Kind::Member)
+		{
+			const Symbol* texture = callee->value->kind == Node::Kind::Name ? Find(callee->value->name) : nullptr;
+			if (texture == nullptr || texture->kind != Symbol::Kind::Texture || callee->name.compare(0, 6, "Sample") != 0 || arguments.size() < 2)
+				return Fail(node, "method '" + std::string(callee->name) + "' is not supported by the CPU interpreter");
+			return Sample(node, texture->slot, arguments[1]);
+		}
+		if (callee->kind != Node::Kind::Name)
+			return Fail(node, "call of a non-function");
+		const std::string_view name = callee->name;
+		if (const uint8_t width = WidthOf(name))
+			return Construct(node, width);
+		auto function = functions.find(name);
+		if (function != functions.end())
+			return Inline(node, function->second);
+
+		static const std::pair<const char*, Function> unary[] = {
+			{ "abs", Function::Abs }, { "saturate", Function::Saturate }, { "frac", Function::Frac }, { "floor", Function::Floor },
+			{ "ceil", Function::Ceil }, { "round", Function::Round }, { "trunc", Function::Trunc }, { "sqrt", Function::Sqrt },
+			{ "rsqrt", Function::Rsqrt }, { "rcp", Function::Rcp }, { "exp", Function::Exp }, { "exp2", Function::Exp2 }, { "log", Function::Log },
+			{ "log2", Function::Log2 }, { "log10", Function::Log10 }, { "sin", Function::Sin }, { "cos", Function::Cos }, { "tan", Function::Tan },
+			{ "asin", Function::Asin }, { "acos", Function::Acos }, { "atan", Function::Atan }, { "sign", Function::Sign },
+			{ "radians", Function::Radians }, { "degrees", Function::Degrees } };
+		static const std::pair<const char*, Function> binary[] = {
+			{ "min", Function::Min }, { "max", Function::Max }, { "pow", Function::Pow }, { "step", Function::Step }, { "fmod", Function::Fmod },
+			{ "atan2", Function::Atan2 } };
+		static const std::pair<const char*, Function> ternary[] = {
+			{ "lerp", Function::Lerp }, { "clamp", Function::Clamp }, { "smoothstep", Function::Smoothstep }, { "mad", Function::Mad } };
+		auto expect = [&](size_t count) {
+			if (arguments.size() == count)
+				return true;
+			Fail(node, "'" + std::string(name) + "' takes " + std::to_string(count) + " arguments");
+			return false;
+			};
+		for (const auto& entry : unary)
+		{
+			if (name == entry.first)
+				return expect(1) ? Apply(node, Op::Unary, entry.second, Expression(arguments[0])) : Value();
+		}
+		for (const auto& entry : binary)
+		{
+			if (name == entry.first)
+				return expect(2) ? Apply(node, Op::Binary, entry.second, Expression(arguments[0]), Expression(arguments[1])) : Value();
+		}
+		for (const auto& entry : ternary)
+		{
+			if (name == entry.first)
+			{
+				if (!expect(3))
+					return Value();
+				return Apply(node, Op::Ternary, entry.second, Expression(arguments[0]), Expression(arguments[1]), Expression(arguments[2]));
+			}
+		}
+		if (name == "dot" && expect(2))
+			return Dot(node, Expression(arguments[0]), Expression(arguments[1]));
+		if (name == "length" && expect(1))
+		{
+			const Value value = Expression(arguments[0]);
+			return Apply(node, Op::Unary, Function::Sqrt, Dot(node, value, value));
+		}
+		if (name == "distance" && expect(2))
+		{
+			const Value difference = Apply(node, Op::Binary, Function::Subtract, Expression(arguments[0]), Expression(arguments[1]));
+			return Apply(node, Op::Unary, Function::Sqrt, Dot(node, difference, difference));
+		}
+		if (name == "normalize" && expect(1))
+		{
+			const Value value = Expression(arguments[0]);
+			return Apply(node, Op::Binary, Function::Multiply, value, Apply(node, Op::Unary, Function::Rsqrt, Dot(node, value, value)));
+		}
+		if (name == "reflect" && expect(2))
+		{
+			// i - 2 * dot(n, i) * n
+			const Value incident = Expression(arguments[0]);
+			const Value normal = Expression(arguments[1]);
+			const Value scale = Apply(node, Op::Binary, Function::Multiply, Constant(node, 2.f), Dot(node, normal, incident));
+			return Apply(node, Op::Binary, Function::Subtract, incident, Apply(node, Op::Binary, Function::Multiply, scale, normal));
+		}
+		if (name == "cross" && expect(2))
+		{
+			Instruction instruction;
+			instruction.op = Op::Cross;
+			instruction.width = 3;
+			instruction.destination = NewRegister(node);
+			instruction.a = Convert(node, Expression(arguments[0]), 3).index;
+			instruction.b = Convert(node, Expression(arguments[1]), 3).index;
+			Emit(instruction);
+			return Value{ instruction.destination, 3 };
+		}
+		if (name == "tex2D" && expect(2))
+		{
+			const Symbol* sampler = arguments[0]->kind == Node::Kind::Name ? Find(arguments[0]->name) : nullptr;
+			if (sampler == nullptr || (sampler->kind != Symbol::Kind::Sampler && sampler->kind != Symbol::Kind::Texture))
+				return Fail(arguments[0], "tex2D needs a sampler");
+			return Sample(node, sampler->slot, arguments[1]);
+		}
+		if (!error.empty())
+			return Value();
+		return Fail(node, "'" + std::string(name) + "' is not supported by the CPU interpreter");
+	}
+
+	Value Expression(const Node* node)
+	{
+		switch (node->kind)
+		{
+		case Node::Kind::Literal:
+		{
+			if (node->name == "true" || node->name == "false")
+				return Constant(node, node->name == "true" ? 1.f : 0.f);
+			if (node->name[0] == '"' || node->name[0] == '\'')
+				return Fail(node, "strings are not supported by the CPU interpreter");
+			// strtod stops at the f, h, u and l suffixes
+			return Constant(node, (float)strtod(std::string(node->name).c_str(), nullptr));
+		}
+		case Node::Kind::Name:
+		{
+			const Symbol* symbol = Find(node->name);
+			if (symbol == nullptr)
+				return Fail(node, "undeclared identifier '" + std::string(node->name) + "'");
+			if (symbol->kind != Symbol::Kind::Value)
+				return Fail(node, "'" + std::string(node->name) + "' cannot be used as a value");
+			return symbol->value;
+		}
+		case Node::Kind::Member:
+		{
+			if (const Value* field = Field(node))
+				return *field;
+			const Value base = Expression(node->value);
+			Instruction instruction;
+			instruction.op = Op::Swizzle;
+			if (!ParseSwizzle(node, node->name, base.width, instruction.swizzle))
+				return Value();
+			instruction.width = (uint8_t)node->name.size();
+			instruction.destination = NewRegister(node);
+			instruction.a = base.index;
+			Emit(instruction);
+			return Value{ instruction.destination, instruction.width };
+		}
+		case Node::Kind::Binary:
+		{
+			if (node->name == ",")
+			{
+				Expression(node->left);
+				return Expression(node->right);
+			}
+			Function function = Function::Add;
+			if (!BinaryFunction(node->name, function))
+				return Fail(node, "operator '" + std::string(node->name) + "' is not supported by the CPU interpreter");
+			return Apply(node, Op::Binary, function, Expression(node->left), Expression(node->right));
+		}
+		case Node::Kind::Assign:
+			return Assign(node);
+		case Node::Kind::Unary:
+		{
+			if (node->name == "++" || node->name == "--")
+				return Increment(node, false);
+			if (node->name == "+")
+				return Expression(node->value);
+			if (node->name == "-" || node->name == "!")
+				return Apply(node, Op::Unary, node->name == "-" ? Function::Negate : Function::Not, Expression(node->value));
+			return Fail(node, "operator '" + std::string(node->name) + "' is not supported by the CPU interpreter");
+		}
+		case Node::Kind::Postfix:
+			return Increment(node, true);
+		case Node::Kind::Ternary:
+		{
+			const Value condition = Expression(node->condition);
+			return Apply(node, Op::Ternary, Function::Select, condition, Expression(node->left), Expression(node->right));
+		}
+		case Node::Kind::Call:
+			return Call(node);
+		case Node::Kind::Cast:
+		{
+			const uint8_t width = WidthOf(node->type);
+			if (width == 0 || node->dimensions != nullptr)
+				return Fail(node, "casts to '" + std::string(node->type->name) + "' are not supported by the CPU interpreter");
+			Value value = Convert(node, Expression(node->value), width);
+			if (node->type->name.compare(0, 4, "bool") == 0)
+				value = Apply(node, Op::Binary, Function::NotEqual, value, Constant(node, 0.f));
+			else if (IsInteger(node->type->name))
+				value = Apply(node, Op::Unary, Function::Trunc, value);
+			return value;
+		}
+		default:
+			return Fail(node, "expression is not supported by the CPU interpreter");
+		}
+	}
+
+	// if and loop conditions use the first component
+	Value Condition(const Node* node)
+	{
+		return Convert(node, Expression(node), 1);
+	}
+
+	void Declare(const Node* variable)
+	{
+		const uint8_t width = WidthOf(variable->type);
+		if (width == 0 || variable->dimensions != nullptr)
+		{
+			Fail(variable, "variables of type '" + std::string(variable->type->name) + (variable->dimensions != nullptr ? "[]" : "")
+				+ "' are not supported by the CPU interpreter");
+			return;
+		}
+		Symbol symbol;
+		symbol.value = Value{ NewRegister(variable), width };
+		if (variable->value != nullptr)
+		{
+			if (variable->value->kind == Node::Kind::InitializerList)
+			{
+				Fail(variable->value, "initializer lists are not supported by the CPU interpreter");
+				return;
+			}
+			Location location;
+			location.index = symbol.value.index;
+			location.width = width;
+			Store(variable, location, Expression(variable->value));
+		}
+		// Visible from its own initializer on, as in C
+		scopes.back()[variable->name] = symbol;
+	}
+
+	// Loop with the condition checked before (for, while) or after (do) the body
+	void Loop(const Node* node, bool checkFirst)
+	{
+		PushMask(node, Op::Push);
+		const int entry = depth;
+		const size_t start = code.size();
+		size_t exit = 0;
+		if (checkFirst && node->condition != nullptr)
+			Emit(Op::While, 0, Condition(node->condition).index);
+		if (checkFirst)
+			exit = Emit(Op::JumpIfNone);
+		PushMask(node, Op::Push);
+		loops.push_back(entry);
+		Statement(node->body);
+		loops.pop_back();
+		PopMask();
+		if (node->step != nullptr)
+			Expression(node->step);
+		if (!checkFirst)
+		{
+			Emit(Op::While, 0, Condition(node->condition).index);
+			exit = Emit(Op::JumpIfNone);
+		}
+		Emit(Op::Jump, 0, 0, 4, (uint32_t)start);
+		code[exit].target = (uint32_t)code.size();
+		PopMask();
+	}
+
+	void Statement(const Node* node)
+	{
+		switch (node->kind)
+		{
+		case Node::Kind::Block:
+			scopes.emplace_back();
+			for (const Node* statement = node->first; statement != nullptr && error.empty(); statement = statement->next)
+				Statement(statement);
+			scopes.pop_back();
+			break;
+		case Node::Kind::Declaration:
+			for (const Node* variable = node->first; variable != nullptr; variable = variable->next)
+				Declare(variable);
+			break;
+		case Node::Kind::ExpressionStatement:
+			Expression(node->value);
+			break;
+		case Node::Kind::If:
+		{
+			const Value condition = Condition(node->condition);
+			PushMask(node, Op::If, condition.index);
+			const size_t skip = Emit(Op::JumpIfNone);
+			Statement(node->body);
+			if (node->otherwise != nullptr)
+			{
+				code[skip].target = (uint32_t)Emit(Op::Else, 0, condition.index);
+				const size_t skipOtherwise = Emit(Op::JumpIfNone);
+				Statement(node->otherwise);
+				code[skipOtherwise].target = (uint32_t)code.size();
+			}
+			else
+			{
+				code[skip].target = (uint32_t)code.size();
+			}
+			PopMask();
+			break;
+		}
+		case Node::Kind::For:
+			scopes.emplace_back();
+			if (node->init != nullptr && node->init->kind == Node::Kind::Declaration)
+				Statement(node->init);
+			else if (node->init != nullptr)
+				Expression(node->init);
+			Loop(node, true);
+			scopes.pop_back();
+			break;
+		case Node::Kind::While:
+			Loop(node, true);
+			break;
+		case Node::Kind::DoWhile:
+			Loop(node, false);
+			break;
+		case Node::Kind::Return:
+		{
+			const Frame& frame = frames.back();
+			if (node->value != nullptr && frame.result.width > 0)
+			{
+				Location location;
+				location.index = frame.result.index;
+				location.width = frame.result.width;
+				Store(node, location, Expression(node->value));
+			}
+			Emit(Op::Clear, 0, 0, 4, (uint32_t)frame.depth);
+			break;
+		}
+		case Node::Kind::Break:
+		case Node::Kind::Continue:
+			if (loops.empty())
+			{
+				Fail(node, "break or continue outside a loop");
+				break;
+			}
+			Emit(Op::Clear, 0, 0, 4, (uint32_t)(loops.back() + (node->kind == Node::Kind::Continue ? 1 : 0)));
+			break;
+		case Node::Kind::Discard:
+			Emit(Op::Discard);
+			break;
+		case Node::Kind::Empty:
+			break;
+		default:
+			Fail(node, "statement is not supported by the CPU interpreter");
+			break;
+		}
+	}
+
+	// Binds a parameter or struct member of the entry point to the input its semantic names
+	Value Input(const Node* node, std::string_view semantic, const Node* type)
+	{
+		const uint8_t width = WidthOf(type);
+		if (width == 0)
+			return Fail(node, "inputs of type '" + std::string(type->name) + "' are not supported by the CPU interpreter");
+		std::string upper(semantic);
+		for (char& c : upper)
+			c = (char)toupper((unsigned char)c);
+		const Value value = { NewRegister(node), width };
+		if (upper == "SV_POSITION" || upper == "POSITION" || upper == "VPOS")
+			Emit(Op::Move, value.index, PositionRegister, width);
+		else if (upper.compare(0, 5, "COLOR") == 0)
+			Emit(Op::Move, value.index, ColorRegister, width);
+		else if (upper.compare(0, 8, "TEXCOORD") == 0)
+			Emit(Op::Move, value.index, TexcoordRegister, width);
+		// Anything else reads zero
+		return value;
+	}
+
+	void Global(const Node* variable)
+	{
+		const std::string_view type = variable->type->name;
+		Symbol symbol;
+		if (type.compare(0, 7, "Texture") == 0 || type.compare(0, 7, "texture") == 0 || type.compare(0, 7, "sampler") == 0
+			|| type.compare(0, 7, "Sampler") == 0)
+		{
+			// Slot from register(t1) or register(s1), otherwise in declaration order
+			const bool texture = type[0] == 'T' || type[0] == 't';
+			symbol.kind = texture ? Symbol::Kind::Texture : Symbol::Kind::Sampler;
+			symbol.slot = textureCount++;
+			if (variable->binding.size() > 1 && (variable->binding[0] == 't' || variable->binding[0] == 's'))
+				symbol.slot = (uint32_t)atoi(std::string(variable->binding.substr(1)).c_str());
+			textureCount = std::max(textureCount, symbol.slot + 1);
+			scopes[0][variable->name] = symbol;
+			return;
+		}
+		if (variable->modifiers & Node::Static)
+		{
+			Declare(variable);
+			return;
+		}
+		// Uniforms keep the zero of an unbound constant buffer, their initializers are only defaults
+		const uint8_t width = WidthOf(variable->type);
+		if (width == 0 || variable->dimensions != nullptr)
+		{
+			Fail(variable, "uniforms of type '" + std::string(type) + "' are not supported by the CPU interpreter");
+			return;
+		}
+		symbol.value = Value{ NewRegister(variable), width };
+		scopes[0][variable->name] = symbol;
+	}
+
+	bool CompileEntry(const std::string& entry)
+	{
+		auto function = functions.find(entry);
+		if (function == functions.end())
+		{
+			error = file + ": entry point '" + entry + "' not found";
+			return false;
+		}
+		const Node* main = function->second;
+		std::unordered_map<std::string_view, Symbol> parameters;
+		for (const Node* parameter = main->first; parameter != nullptr; parameter = parameter->next)
+		{
+			Symbol symbol;
+			auto found = structs.find(parameter->type->name);
+			if (found != structs.end())
+			{
+				symbol.kind = Symbol::Kind::Struct;
+				for (const Node* declaration = found->second->first; declaration != nullptr; declaration = declaration->next)
+				{
+					for (const Node* field = declaration->first; field != nullptr; field = field->next)
+						symbol.fields.emplace_back(field->name, Input(field, field->semantic, field->type));
+				}
+			}
+			else
+			{
+				symbol.value = Input(parameter, parameter->semantic, parameter->type);
+			}
+			parameters[parameter->name] = symbol;
+		}
+		Frame frame;
+		frame.result = Value{ OutputRegister, WidthOf(main->type) };
+		if (frame.result.width == 0)
+		{
+			Fail(main, "entry points returning '" + std::string(main->type->name) + "' are not supported by the CPU interpreter");
+			return false;
+		}
+		scopes.push_back(std::move(parameters));
+		scopeBase = 1;
+		frames.push_back(frame);
+		Statement(main->body);
+		frames.pop_back();
+		scopes.pop_back();
+		return error.empty();
+	}
+
+	// Bilinear filtering with wrap addressing, the sampler every preview shader gets
+	static void Fetch(const Texture& texture, float u, float v, float texel[4])
+	{
+		if (texture.rgba == nullptr || texture.width <= 0 || texture.height <= 0 || !std::isfinite(u) || !std::isfinite(v))
+		{
+			texel[0] = texel[1] = texel[2] = texel[3] = 0.f;
+			return;
+		}
+		float x = u * texture.width - 0.5f;
+		float y = v * texture.height - 0.5f;
+		x -= std::floor(x / texture.width) * texture.width;
+		y -= std::floor(y / texture.height) * texture.height;
+		const int x0 = std::min((int)x, texture.width - 1);
+		const int y0 = std::min((int)y, texture.height - 1);
+		const int x1 = x0 + 1 < texture.width ? x0 + 1 : 0;
+		const int y1 = y0 + 1 < texture.height ? y0 + 1 : 0;
+		const float fx = x - x0;
+		const float fy = y - y0;
+		const unsigned char* p00 = texture.rgba + ((size_t)y0 * texture.width + x0) * 4;
+		const unsigned char* p10 = texture.rgba + ((size_t)y0 * texture.width + x1) * 4;
+		const unsigned char* p01 = texture.rgba + ((size_t)y1 * texture.width + x0) * 4;
+		const unsigned char* p11 = texture.rgba + ((size_t)y1 * texture.width + x1) * 4;
+		for (int c = 0; c < 4; c++)
+		{
+			const float top = p00[c] + (p10[c] - p00[c]) * fx;
+			const float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+			texel[c] = (top + (bottom - top) * fy) * (1.f / 255.f);
+		}
+	}
+
+	template <typename F>
+	static void Map(Register& d, const Register& a, int width, F f)
+	{
+		for (int c = 0; c < width; c++)
+		{
+			for (size_t l = 0; l < Lanes; l++)
+				d.v[c][l] = f(a.v[c][l]);
+		}
+	}
+
+	template <typename F>
+	static void Map(Register& d, const Register& a, const Register& b, int width, F f)
+	{
+		for (int c = 0; c < width; c++)
+		{
+			for (size_t l = 0; l < Lanes; l++)
+				d.v[c][l] = f(a.v[c][l], b.v[c][l]);
+		}
+	}
+
+	template <typename F>
+	static void Map(Register& d, const Register& a, const Register& b, const Register& e, int width, F f)
+	{
+		for (int c = 0; c < width; c++)
+		{
+			for (size_t l = 0; l < Lanes; l++)
+				d.v[c][l] = f(a.v[c][l], b.v[c][l], e.v[c][l]);
+		}
+	}
+
+	static void Unary(Function function, Register& d, const Register& a, int w)
+	{
+		switch (function)
+		{
+		case Function::Negate: Map(d, a, w, [](float x) { return -x; }); break;
+		case Function::Not: Map(d, a, w, [](float x) { return x == 0.f ? 1.f : 0.f; }); break;
+		case Function::Abs: Map(d, a, w, [](float x) { return std::fabs(x); }); break;
+		case Function::Saturate: Map(d, a, w, [](float x) { return std::min(std::max(x, 0.f), 1.f); }); break;
+		case Function::Frac: Map(d, a, w, [](float x) { return x - std::floor(x); }); break;
+		case Function::Floor: Map(d, a, w, [](float x) { return std::floor(x); }); break;
+		case Function::Ceil: Map(d, a, w, [](float x) { return std::ceil(x); }); break;
+		case Function::Round: Map(d, a, w, [](float x) { return std::nearbyint(x); }); break;
+		case Function::Trunc: Map(d, a, w, [](float x) { return std::trunc(x); }); break;
+		case Function::Sqrt: Map(d, a, w, [](float x) { return std::sqrt(x); }); break;
+		case Function::Rsqrt: Map(d, a, w, [](float x) { return 1.f / std::sqrt(x); }); break;
+		case Function::Rcp: Map(d, a, w, [](float x) { return 1.f / x; }); break;
+		case Function::Exp: Map(d, a, w, [](float x) { return std::exp(x); }); break;
+		case Function::Exp2: Map(d, a, w, [](float x) { return std::exp2(x); }); break;
+		case Function::Log: Map(d, a, w, [](float x) { return std::log(x); }); break;
+		case Function::Log2: Map(d, a, w, [](float x) { return std::log2(x); }); break;
+		case Function::Log10: Map(d, a, w, [](float x) { return std::log10(x); }); break;
+		case Function::Sin: Map(d, a, w, [](float x) { return std::sin(x); }); break;
+		case Function::Cos: Map(d, a, w, [](float x) { return std::cos(x); }); break;
+		case Function::Tan: Map(d, a, w, [](float x) { return std::tan(x); }); break;
+		case Function::Asin: Map(d, a, w, [](float x) { return std::asin(x); }); break;
+		case Function::Acos: Map(d, a, w, [](float x) { return std::acos(x); }); break;
+		case Function::Atan: Map(d, a, w, [](float x) { return std::atan(x); }); break;
+		case Function::Sign: Map(d, a, w, [](float x) { return (float)((x > 0.f) - (x < 0.f)); }); break;
+		case Function::Radians: Map(d, a, w, [](float x) { return x * 0.0174532925f; }); break;
+		case Function::Degrees: Map(d, a, w, [](float x) { return x * 57.2957795f; }); break;
+		default: break;
+		}
+	}
+
+	static void Binary(Function function, Register& d, const Register& a, const Register& b, int w)
+	{
+		switch (function)
+		{
+		case Function::Add: Map(d, a, b, w, [](float x, float y) { return x + y; }); break;
+		case Function::Subtract: Map(d, a, b, w, [](float x, float y) { return x - y; }); break;
+		case Function::Multiply: Map(d, a, b, w, [](float x, float y) { return x * y; }); break;
+		case Function::Divide: Map(d, a, b, w, [](float x, float y) { return x / y; }); break;
+		case Function::Modulo:
+		case Function::Fmod: Map(d, a, b, w, [](float x, float y) { return std::fmod(x, y); }); break;
+		case Function::Less: Map(d, a, b, w, [](float x, float y) { return x < y ? 1.f : 0.f; }); break;
+		case Function::LessEqual: Map(d, a, b, w, [](float x, float y) { return x <= y ? 1.f : 0.f; }); break;
+		case Function::Greater: Map(d, a, b, w, [](float x, float y) { return x > y ? 1.f : 0.f; }); break;
+		case Function::GreaterEqual: Map(d, a, b, w, [](float x, float y) { return x >= y ? 1.f : 0.f; }); break;
+		case Function::Equal: Map(d, a, b, w, [](float x, float y) { return x == y ? 1.f : 0.f; }); break;
+		case Function::NotEqual: Map(d, a, b, w, [](float x, float y) { return x != y ? 1.f : 0.f; }); break;
+		case Function::LogicalAnd: Map(d, a, b, w, [](float x, float y) { return x != 0.f && y != 0.f ? 1.f : 0.f; }); break;
+		case Function::LogicalOr: Map(d, a, b, w, [](float x, float y) { return x != 0.f || y != 0.f ? 1.f : 0.f; }); break;
+		case Function::Min: Map(d, a, b, w, [](float x, float y) { return std::min(x, y); }); break;
+		case Function::Max: Map(d, a, b, w, [](float x, float y) { return std::max(x, y); }); break;
+		case Function::Pow: Map(d, a, b, w, [](float x, float y) { return std::pow(x, y); }); break;
+		case Function::Step: Map(d, a, b, w, [](float edge, float x) { return x >= edge ? 1.f : 0.f; }); break;
+		case Function::Atan2: Map(d, a, b, w, [](float y, float x) { return std::atan2(y, x); }); break;
+		default: break;
+		}
+	}
+
+	static void Ternary(Function function, Register& d, const Register& a, const Register& b, const Register& c, int w)
+	{
+		switch (function)
+		{
+		case Function::Lerp: Map(d, a, b, c, w, [](float x, float y, float s) { return x + (y - x) * s; }); break;
+		case Function::Clamp: Map(d, a, b, c, w, [](float x, float low, float high) { return std::min(std::max(x, low), high); }); break;
+		case Function::Smoothstep: Map(d, a, b, c, w, [](float low, float high, float x) {
+			const float t = std::min(std::max((x - low) / (high - low), 0.f), 1.f);
+			return t * t * (3.f - 2.f * t);
+			}); break;
+		case Function::Mad: Map(d, a, b, c, w, [](float x, float y, float z) { return x * y + z; }); break;
+		case Function::Select: Map(d, a, b, c, w, [](float s, float x, float y) { return s != 0.f ? x : y; }); break;
+		default: break;
+		}
+	}
+
+	static uint32_t NonZero(const Register& r)
+	{
+		uint32_t mask = 0;
+		for (size_t l = 0; l < Lanes; l++)
+			mask |= (r.v[0][l] != 0.f ? 1u : 0u) << l;
+		return mask;
+	}
+
+	// Runs the program for one batch, false when a loop did not end
+	bool Execute(Register* r, uint32_t valid, const std::vector<Texture>& textures, uint32_t& discarded) const
+	{
+		uint32_t masks[MaxDepth + 1] = { valid };
+		int top = 0;
+		uint32_t iterations = 0;
+		const size_t count = code.size();
+		for (size_t pc = 0; pc < count; pc++)
+		{
+			const Instruction& in = code[pc];
+			Register& d = r[in.destination];
+			const Register& a = r[in.a];
+			switch (in.op)
+			{
+			case Op::Move:
+				for (int c = 0; c < in.width; c++)
+					memcpy(d.v[c], a.v[c], sizeof(d.v[c]));
+				break;
+			case Op::Swizzle:
+				for (int c = 0; c < in.width; c++)
+					memcpy(d.v[c], a.v[in.swizzle[c]], sizeof(d.v[c]));
+				break;
+			case Op::Insert:
+				for (int c = 0; c < in.width; c++)
+					memcpy(d.v[in.swizzle[c]], a.v[c], sizeof(d.v[c]));
+				break;
+			case Op::Store:
+			{
+				const uint32_t mask = masks[top];
+				for (int c = 0; c < in.width; c++)
+				{
+					float* destination = d.v[in.swizzle[c]];
+					if (mask == AllLanes)
+					{
+						memcpy(destination, a.v[c], sizeof(d.v[c]));
+						continue;
+					}
+					for (size_t l = 0; l < Lanes; l++)
+						destination[l] = (mask >> l & 1) ? a.v[c][l] : destination[l];
+				}
+				break;
+			}
+			case Op::Unary:
+				Unary(in.function, d, a, in.width);
+				break;
+			case Op::Binary:
+				Binary(in.function, d, a, r[in.b], in.width);
+				break;
+			case Op::Ternary:
+				Ternary(in.function, d, a, r[in.b], r[in.c], in.width);
+				break;
+			case Op::Dot:
+			{
+				const Register& b = r[in.b];
+				for (size_t l = 0; l < Lanes; l++)
+					d.v[0][l] = a.v[0][l] * b.v[0][l];
+				for (int c = 1; c < in.width; c++)
+				{
+					for (size_t l = 0; l < Lanes; l++)
+						d.v[0][l] += a.v[c][l] * b.v[c][l];
+				}
+				break;
+			}
+			case Op::Cross:
+			{
+				const Register& b = r[in.b];
+				for (size_t l = 0; l < Lanes; l++)
+				{
+					const float x = a.v[1][l] * b.v[2][l] - a.v[2][l] * b.v[1][l];
+					const float y = a.v[2][l] * b.v[0][l] - a.v[0][l] * b.v[2][l];
+					const float z = a.v[0][l] * b.v[1][l] - a.v[1][l] * b.v[0][l];
+					d.v[0][l] = x;
+					d.v[1][l] = y;
+					d.v[2][l] = z;
+				}
+				break;
+			}
+			case Op::Sample:
+			{
+				static const Texture unbound = Texture();
+				const Texture& texture = in.target < textures.size() ? textures[in.target] : unbound;
+				for (size_t l = 0; l < Lanes; l++)
+				{
+					float texel[4];
+					Fetch(texture, a.v[0][l], a.v[1][l], texel);
+					for (int c = 0; c < 4; c++)
+						d.v[c][l] = texel[c];
+				}
+				break;
+			}
+			case Op::If:
+				masks[top + 1] = masks[top] & NonZero(a);
+				top++;
+				break;
+			case Op::Else:
+				masks[top] = masks[top - 1] & ~NonZero(a);
+				break;
+			case Op::While:
+				masks[top] &= NonZero(a);
+				break;
+			case Op::Push:
+				masks[top + 1] = masks[top];
+				top++;
+				break;
+			case Op::Pop:
+				top--;
+				break;
+			case Op::Clear:
+			{
+				const uint32_t leaving = masks[top];
+				for (int i = (int)in.target; i <= top; i++)
+					masks[i] &= ~leaving;
+				break;
+			}
+			case Op::Discard:
+				discarded |= masks[top];
+				for (int i = 0; i <= top; i++)
+					masks[i] &= ~discarded;
+				break;
+			case Op::Jump:
+				if (in.target <= pc && ++iterations > MaxIterations)
+					return false;
+				pc = (size_t)in.target - 1;
+				break;
+			case Op::JumpIfNone:
+				if (masks[top] == 0)
+					pc = (size_t)in.target - 1;
+				break;
+			}
+		}
+		return true;
+	}
+
+public:
+	Statistics statistics = Statistics();
+
+	// Preprocesses request.source and compiles its entry point, error holds the first problem
+	bool Compile(const ShaderCompiler::Request& request, std::string& error)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		code.clear();
+		prototype.assign(4, Register());
+		constants.clear();
+		functions.clear();
+		structs.clear();
+		typedefs.clear();
+		scopes.assign(1, {});
+		inlining.clear();
+		loops.clear();
+		frames.clear();
+		depth = 0;
+		textureCount = 0;
+		file = request.sourceName;
+		this->error = "";
+
+		ShaderPreprocessor preprocessor;
+		std::string log = "";
+		std::vector<ShaderCompiler::Include> includes;
+		if (!preprocessor.Run(request, text, log, includes))
+		{
+			error = log;
+			return false;
+		}
+		HlslLexer lexer;
+		lexer.Lex(text);
+		arena.Reset();
+		std::vector<ShaderCompiler::Diagnostic> diagnostics;
+		const Node* root = HlslParser(text, lexer.tokens, arena, diagnostics, file).Parse();
+		if (!diagnostics.empty())
+		{
+			const ShaderCompiler::Diagnostic& first = diagnostics[0];
+			error = first.file + "(" + std::to_string(first.line) + "," + std::to_string(first.column) + "): error " + first.code + ": " + first.message;
+			return false;
+		}
+
+		// Declarations first, globals with static initializers run before the entry point each batch
+		const Value opaque = Constant(root, 0.f, 0.f, 0.f, 1.f, 4);
+		Emit(Op::Move, OutputRegister, opaque.index, 4);
+		for (const Node* node = root->first; node != nullptr && this->error.empty(); node = node->next)
+		{
+			switch (node->kind)
+			{
+			case Node::Kind::Struct:
+				structs[node->name] = node;
+				if (node->value != nullptr)
+					Fail(node, "struct variables are not supported by the CPU interpreter");
+				break;
+			case Node::Kind::Typedef:
+				if (WidthOf(node->type) == 0)
+					Fail(node, "typedef of '" + std::string(node->type->name) + "' is not supported by the CPU interpreter");
+				typedefs[node->name] = WidthOf(node->type);
+				break;
+			case Node::Kind::Function:
+				functions[node->name] = node;
+				break;
+			case Node::Kind::CBuffer:
+				for (const Node* declaration = node->first; declaration != nullptr; declaration = declaration->next)
+				{
+					for (const Node* variable = declaration->first; variable != nullptr; variable = variable->next)
+						Global(variable);
+				}
+				break;
+			case Node::Kind::Declaration:
+				for (const Node* variable = node->first; variable != nullptr; variable = variable->next)
+					Global(variable);
+				break;
+			default:
+				break;
+			}
+		}
+		if (this->error.empty())
+			CompileEntry(request.entry);
+		error = this->error;
+		statistics.instructions = code.size();
+		statistics.registers = prototype.size();
+		statistics.compileTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (!error.empty())
+			code.clear();
+		return error.empty();
+	}
+
+	bool IsCompiled() const
+	{
+		return !code.empty();
+	}
+
+	// Shades width x height pixels into rgba, tiles run on pool when there is one. color is the vertex color the
+	// previews are drawn with, uv spans the target once.
+	bool Render(ThreadPool* pool, const std::vector<Texture>& textures, unsigned char* rgba, int width, int height, const float color[4], std::string& error)
+	{
+		if (code.empty())
+		{
+			error = "Shader is not compiled";
+			return false;
+		}
+		const auto start = std::chrono::steady_clock::now();
+		const int tilesX = (width + TileSize - 1) / TileSize;
+		const int tilesY = (height + TileSize - 1) / TileSize;
+		std::atomic<bool> hung{ false };
+		auto shade = [&](size_t index) {
+			std::vector<Register> registers = prototype;
+			Register* r = registers.data();
+			for (int c = 0; c < 4; c++)
+			{
+				for (size_t l = 0; l < Lanes; l++)
+					r[ColorRegister].v[c][l] = color[c];
+			}
+			const int x0 = (int)(index % tilesX) * TileSize;
+			const int y0 = (int)(index / tilesX) * TileSize;
+			const int x1 = std::min(x0 + TileSize, width);
+			const int y1 = std::min(y0 + TileSize, height);
+			for (int y = y0; y < y1; y++)
+			{
+				for (int x = x0; x < x1; x += (int)Lanes)
+				{
+					for (size_t l = 0; l < Lanes; l++)
+					{
+						const float px = x + l + 0.5f;
+						r[PositionRegister].v[0][l] = px;
+						r[PositionRegister].v[1][l] = y + 0.5f;
+						r[PositionRegister].v[2][l] = 0.f;
+						r[PositionRegister].v[3][l] = 1.f;
+						r[TexcoordRegister].v[0][l] = px / width;
+						r[TexcoordRegister].v[1][l] = (y + 0.5f) / height;
+					}
+					const int active = std::min((int)Lanes, x1 - x);
+					const uint32_t valid = AllLanes >> (Lanes - active);
+					uint32_t discarded = 0;
+					if (!Execute(r, valid, textures, discarded))
+						hung = true;
+					unsigned char* row = rgba + ((size_t)y * width + x) * 4;
+					for (int l = 0; l < active; l++)
+					{
+						for (int c = 0; c < 4; c++)
+						{
+							const float value = (discarded >> l & 1) ? 0.f : std::min(std::max(r[OutputRegister].v[c][l], 0.f), 1.f);
+							row[l * 4 + c] = (unsigned char)(value * 255.f + 0.5f);
+						}
+					}
+				}
+			}
+			};
+		if (pool != nullptr)
+		{
+			pool->ParallelFor((size_t)tilesX * tilesY, shade);
+		}
+		else
+		{
+			for (size_t i = 0; i < (size_t)tilesX * tilesY; i++)
+				shade(i);
+		}
+		statistics.renderTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (hung)
+		{
+			error = "A loop ran more than " + std::to_string(MaxIterations) + " iterations";
+			return false;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,468 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../../Dependence/MappedFile.h"
+#include "../../Dependence/Sha256.h"
+
+// Bytecode of the shaders of earlier sessions in one file, so a restored session shows its previews before any
+// compiler ran. Entries are keyed by a hash of the source, target, entry point and flags, and by the variant.
+// A compacted file is a header, an index of every entry, then their blobs. Entries stored since follow as records
+// behind headers of their own, Open walks those headers after reading the index. Read hands out the mapped bytes
+// themselves, so device shaders are created from the file without a copy.
+// Stores are appended by a background thread, which also rewrites the file once superseded entries or records
+// outside the index make up too much of it.
+class ShaderPack
+{
+public:
+	using Key = Sha256::Digest;
+
+	class Statistics
+	{
+	public:
+		uint64_t entries = 0;
+		// Entries outside the index, appended since the last compaction
+		uint64_t records = 0;
+		uint64_t reads = 0;
+		uint64_t misses = 0;
+		uint64_t appends = 0;
+		uint64_t compactions = 0;
+		// Entries dropped because their checksum did not match
+		uint64_t corrupt = 0;
+		uint64_t fileBytes = 0;
+		// Superseded entries still taking space in the file
+		uint64_t deadBytes = 0;
+		// Milliseconds Open took
+		float openTime = 0.f;
+	};
+
+	// Past this size, compaction drops the entries nobody read or stored since Open
+	uint64_t budget = 64ull << 20;
+
+private:
+	static constexpr uint32_t Magic = 0x5043534e; // "NSCP"
+	static constexpr uint32_t RecordMagic = 0x5243534e; // "NSCR"
+	static constexpr uint32_t Version = 1;
+	static constexpr uint64_t Alignment = 16;
+	// Records outside the index before a compaction is due
+	static constexpr uint64_t MaxRecords = 256;
+
+	class FileHeader
+	{
+	public:
+		uint32_t magic = Magic;
+		uint32_t version = Version;
+		// Indexed entries, their headers follow this one
+		uint64_t count = 0;
+		// Where the records start
+		uint64_t end = 0;
+		uint64_t reserved = 0;
+	};
+
+	// Used both in the index and in front of every record
+	class EntryHeader
+	{
+	public:
+		uint32_t magic = RecordMagic;
+		uint32_t size = 0;
+		uint64_t variant = 0;
+		// Of the bytecode from the start of the file, 0 while it is only queued
+		uint64_t offset = 0;
+		uint64_t checksum = 0;
+		Key key = {};
+	};
+	static_assert(sizeof(FileHeader) == 32 && sizeof(EntryHeader) == 64, "Pack headers are written as they are laid out in memory");
+
+	class Entry
+	{
+	public:
+		EntryHeader header = EntryHeader();
+		// The checksum is only compared on the first Read, most entries are never read in a session
+		bool checked = false;
+		bool used = false;
+	};
+
+	class Append
+	{
+	public:
+		std::string id = "";
+		EntryHeader header = EntryHeader();
+		std::vector<uint8_t> bytecode = {};
+	};
+
+	std::filesystem::path path = "";
+	MappedFile mapping = MappedFile();
+	std::unordered_map<std::string, Entry> entries = {};
+	// Set when the file is missing, damaged or has a torn tail, the first write rewrites it
+	bool rewrite = false;
+	std::mutex mutex;
+	std::condition_variable queued;
+	std::condition_variable written;
+	std::vector<Append> appends = {};
+	bool writing = false;
+	bool stopping = false;
+	std::thread writer = std::thread();
+	Statistics statistics = Statistics();
+
+	static uint64_t Align(uint64_t value)
+	{
+		return (value + Alignment - 1) & ~(Alignment - 1);
+	}
+
+	// FNV-1a, only guards against damaged files
+	static uint64_t Checksum(const uint8_t* data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ data[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	static std::string MakeId(const Key& key, uint64_t variant)
+	{
+		return Sha256::ToHex(key) + ":" + std::to_string(variant);
+	}
+
+	// Called with the mutex held, reads the index and walks the records behind it
+	void Load()
+	{
+		entries.clear();
+		statistics.records = 0;
+		statistics.deadBytes = 0;
+		statistics.fileBytes = mapping.Size();
+		const uint8_t* data = mapping.Data();
+		const uint64_t size = mapping.Size();
+		FileHeader file;
+		if (size >= sizeof(FileHeader))
+			memcpy(&file, data, sizeof(file));
+		if (size < sizeof(FileHeader) || file.magic != Magic || file.version != Version
+			|| file.count > (size - sizeof(FileHeader)) / sizeof(EntryHeader) || file.end > size)
+		{
+			rewrite = true;
+			return;
+		}
+		auto Add = [&](const EntryHeader& header) {
+			Entry& entry = entries[MakeId(header.key, header.variant)];
+			if (entry.header.offset != 0)
+				statistics.deadBytes += Align(entry.header.size) + sizeof(EntryHeader);
+			entry = Entry();
+			entry.header = header;
+			};
+		for (uint64_t i = 0; i < file.count; i++)
+		{
+			EntryHeader header;
+			memcpy(&header, data + sizeof(FileHeader) + i * sizeof(EntryHeader), sizeof(header));
+			if (header.offset < sizeof(FileHeader) || header.offset + header.size > file.end)
+				continue;
+			Add(header);
+		}
+		uint64_t position = Align(file.end);
+		while (position + sizeof(EntryHeader) <= size)
+		{
+			EntryHeader header;
+			memcpy(&header, data + position, sizeof(header));
+			if (header.magic != RecordMagic || header.offset != position + sizeof(EntryHeader) || header.offset + header.size > size)
+				break;
+			Add(header);
+			statistics.records++;
+			position = Align(header.offset + header.size);
+		}
+		// A write that was cut off, appending behind it would hide everything that follows
+		if (position < size)
+			rewrite = true;
+	}
+
+	// Called with the mutex held. Writes the entries that are in the file and intact with a fresh index next to
+	// it, then swaps it in. Returns false and keeps the old file when that fails.
+	bool Compact()
+	{
+		std::string error = "";
+		std::error_code failure;
+		mapping.Close();
+		if (std::filesystem::exists(path, failure))
+			mapping.Open(path, error);
+		const uint8_t* data = mapping.Data();
+		uint64_t total = 0;
+		std::vector<Entry*> live = {};
+		for (auto& [id, entry] : entries)
+		{
+			const EntryHeader& header = entry.header;
+			if (header.offset == 0 || header.offset + header.size > mapping.Size())
+				continue;
+			if (!entry.checked && Checksum(data + header.offset, header.size) != header.checksum)
+			{
+				statistics.corrupt++;
+				continue;
+			}
+			entry.checked = true;
+			live.push_back(&entry);
+			total += Align(header.size) + sizeof(EntryHeader);
+		}
+		if (total > budget)
+		{
+			live.erase(std::remove_if(live.begin(), live.end(), [](Entry* entry) { return !entry->used; }), live.end());
+		}
+
+		FileHeader file;
+		file.count = live.size();
+		uint64_t position = Align(sizeof(FileHeader) + live.size() * sizeof(EntryHeader));
+		std::vector<EntryHeader> index = {};
+		for (Entry* entry : live)
+		{
+			EntryHeader header = entry->header;
+			header.magic = 0;
+			header.offset = position;
+			index.push_back(header);
+			position = Align(position + header.size);
+		}
+		file.end = position;
+		const std::filesystem::path temporary = path.string() + ".tmp";
+		{
+			std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+			const char padding[Alignment] = {};
+			output.write((const char*)&file, sizeof(file));
+			output.write((const char*)index.data(), index.size() * sizeof(EntryHeader));
+			output.write(padding, Align(output.tellp()) - output.tellp());
+			for (Entry* entry : live)
+			{
+				output.write((const char*)data + entry->header.offset, entry->header.size);
+				output.write(padding, Align(entry->header.size) - entry->header.size);
+			}
+			if (!output.good())
+			{
+				output.close();
+				std::filesystem::remove(temporary, failure);
+				return false;
+			}
+		}
+		// Windows cannot replace a file while it is mapped
+		mapping.Close();
+		std::filesystem::rename(temporary, path, failure);
+		if (failure)
+		{
+			std::filesystem::remove(temporary, failure);
+			mapping.Open(path, error);
+			return false;
+		}
+		mapping.Open(path, error);
+		const std::unordered_set<const Entry*> kept(live.begin(), live.end());
+		for (auto it = entries.begin(); it != entries.end();)
+		{
+			// Queued entries stay, they are appended after this
+			if (it->second.header.offset != 0 && kept.count(&it->second) == 0)
+				it = entries.erase(it);
+			else
+				++it;
+		}
+		for (size_t i = 0; i < live.size(); i++)
+			live[i]->header.offset = index[i].offset;
+		statistics.records = 0;
+		statistics.deadBytes = 0;
+		statistics.fileBytes = file.end;
+		statistics.compactions++;
+		rewrite = false;
+		return true;
+	}
+
+	void Write()
+	{
+		std::vector<Append> batch = {};
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				writing = false;
+				written.notify_all();
+				queued.wait(lock, [this]() { return stopping || !appends.empty(); });
+				if (appends.empty())
+					return;
+				batch.clear();
+				batch.swap(appends);
+				writing = true;
+				if (rewrite && !Compact())
+				{
+					// The file cannot be written, this session keeps what it has in memory
+					continue;
+				}
+			}
+			std::error_code failure;
+			uint64_t position = std::filesystem::file_size(path, failure);
+			if (failure || position != Align(position))
+				continue;
+			std::vector<std::pair<const Append*, uint64_t>> offsets = {};
+			{
+				std::ofstream output(path, std::ios::binary | std::ios::app);
+				const char padding[Alignment] = {};
+				for (Append& append : batch)
+				{
+					append.header.offset = position + sizeof(EntryHeader);
+					output.write((const char*)&append.header, sizeof(append.header));
+					output.write((const char*)append.bytecode.data(), append.bytecode.size());
+					output.write(padding, Align(append.bytecode.size()) - append.bytecode.size());
+					offsets.push_back({ &append, append.header.offset });
+					position = Align(append.header.offset + append.bytecode.size());
+				}
+				if (!output.good())
+					offsets.clear();
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			for (const auto& [append, offset] : offsets)
+			{
+				auto it = entries.find(append->id);
+				// Stored again since, the newer bytecode is still queued
+				if (it != entries.end() && it->second.header.offset == 0 && it->second.header.checksum == append->header.checksum)
+					it->second.header.offset = offset;
+			}
+			statistics.appends += offsets.size();
+			statistics.records += offsets.size();
+			statistics.fileBytes = position;
+			if (statistics.records > MaxRecords || statistics.deadBytes > statistics.fileBytes / 2)
+				Compact();
+		}
+	}
+
+public:
+	ShaderPack() {}
+	ShaderPack(const ShaderPack&) = delete;
+	ShaderPack& operator=(const ShaderPack&) = delete;
+
+	~ShaderPack()
+	{
+		Close();
+	}
+
+	static Key MakeKey(const ShaderCompiler::Request& request)
+	{
+		Sha256 hash;
+		hash.Update(request.source);
+		hash.Update(request.target);
+		hash.Update(request.entry);
+		hash.Update(&request.flags, sizeof(request.flags));
+		return hash.Final();
+	}
+
+	// A missing file is not an error, it is created by the first Store
+	bool Open(const std::filesystem::path& file, std::string& error)
+	{
+		Close();
+		const auto start = std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> lock(mutex);
+		path = file;
+		stopping = false;
+		std::error_code failure;
+		if (!std::filesystem::exists(path, failure))
+		{
+			std::filesystem::create_directories(path.parent_path(), failure);
+			entries.clear();
+			rewrite = true;
+			return true;
+		}
+		if (!mapping.Open(path, error))
+			return false;
+		rewrite = false;
+		Load();
+		statistics.openTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return true;
+	}
+
+	// Writes what is still queued
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			queued.notify_all();
+		}
+		if (writer.joinable())
+			writer.join();
+		std::lock_guard<std::mutex> lock(mutex);
+		mapping.Close();
+		entries.clear();
+	}
+
+	// Calls use with the entry's bytes in the mapping, which stay valid only during the call
+	bool Read(const Key& key, uint64_t variant, const std::function<void(const uint8_t* data, size_t size)>& use)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(MakeId(key, variant));
+		Entry* entry = it != entries.end() ? &it->second : nullptr;
+		if (entry == nullptr || entry->header.offset == 0 || entry->header.offset + entry->header.size > mapping.Size())
+		{
+			statistics.misses++;
+			return false;
+		}
+		const uint8_t* data = mapping.Data() + entry->header.offset;
+		if (!entry->checked && Checksum(data, entry->header.size) != entry->header.checksum)
+		{
+			entries.erase(it);
+			statistics.corrupt++;
+			statistics.misses++;
+			return false;
+		}
+		entry->checked = true;
+		entry->used = true;
+		statistics.reads++;
+		use(data, entry->header.size);
+		return true;
+	}
+
+	// Queues the bytecode for appending, nothing is written when the pack already holds the same
+	void Store(const Key& key, uint64_t variant, const std::vector<uint8_t>& bytecode)
+	{
+		if (bytecode.empty() || bytecode.size() > UINT32_MAX)
+			return;
+		const std::string id = MakeId(key, variant);
+		const uint64_t checksum = Checksum(bytecode.data(), bytecode.size());
+		std::lock_guard<std::mutex> lock(mutex);
+		if (path.empty() || stopping)
+			return;
+		Entry& entry = entries[id];
+		if (entry.header.size == bytecode.size() && entry.header.checksum == checksum)
+		{
+			entry.used = true;
+			return;
+		}
+		if (entry.header.offset != 0)
+			statistics.deadBytes += Align(entry.header.size) + sizeof(EntryHeader);
+		entry = Entry();
+		entry.header.size = (uint32_t)bytecode.size();
+		entry.header.variant = variant;
+		entry.header.checksum = checksum;
+		entry.header.key = key;
+		entry.checked = true;
+		entry.used = true;
+		Append append;
+		append.id = id;
+		append.header = entry.header;
+		append.bytecode = bytecode;
+		appends.push_back(std::move(append));
+		if (!writer.joinable())
+			writer = std::thread([this]() { Write(); });
+		queued.notify_one();
+	}
+
+	// Waits until every queued entry is in the file
+	void Flush()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		written.wait(lock, [this]() { return appends.empty() && !writing; });
+	}
+
+	Statistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.entries = entries.size();
+		return statistics;
+	}
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Option axes of a shader. Each axis is a define with a list of values, a variant picks one value per axis
+// and is numbered by a mixed-radix key with the first axis varying fastest. Every key below GetVariantCount()
+// is a valid variant, so tables of variants can be flat arrays indexed by key.
+class ShaderPermutations
+{
+public:
+	using Key = uint64_t;
+
+	class Axis
+	{
+	public:
+		std::string name = "";
+		std::vector<std::string> values = {};
+	};
+
+	std::vector<Axis> axes = {};
+
+	// Without values the axis switches between 0 and 1
+	void AddAxis(const std::string& name, const std::vector<std::string>& values = {})
+	{
+		Axis axis;
+		axis.name = name;
+		axis.values = values.empty() ? std::vector<std::string>{ "0", "1" } : values;
+		axes.push_back(axis);
+	}
+
+	bool IsEmpty() const
+	{
+		return axes.empty();
+	}
+
+	// Saturates at UINT64_MAX
+	uint64_t GetVariantCount() const
+	{
+		uint64_t count = 1;
+		for (const Axis& axis : axes)
+		{
+			if (axis.values.empty())
+				return 0;
+			if (count > UINT64_MAX / axis.values.size())
+				return UINT64_MAX;
+			count *= axis.values.size();
+		}
+		return count;
+	}
+
+	// Value index per axis
+	Key MakeKey(const std::vector<size_t>& choices) const
+	{
+		Key key = 0;
+		Key stride = 1;
+		for (size_t i = 0; i < axes.size(); i++)
+		{
+			key += (i < choices.size() ? choices[i] : 0) * stride;
+			stride *= axes[i].values.size();
+		}
+		return key;
+	}
+
+	std::vector<size_t> Decode(Key key) const
+	{
+		std::vector<size_t> choices(axes.size(), 0);
+		for (size_t i = 0; i < axes.size(); i++)
+		{
+			choices[i] = (size_t)(key % axes[i].values.size());
+			key /= axes[i].values.size();
+		}
+		return choices;
+	}
+
+	// Changes the value of one axis in key, false when the axis or value is unknown
+	bool Select(Key& key, const std::string& name, const std::string& value) const
+	{
+		Key stride = 1;
+		for (const Axis& axis : axes)
+		{
+			if (axis.name == name)
+			{
+				for (size_t i = 0; i < axis.values.size(); i++)
+				{
+					if (axis.values[i] == value)
+					{
+						const Key current = key / stride % axis.values.size();
+						key = key - current * stride + i * stride;
+						return true;
+					}
+				}
+				return false;
+			}
+			stride *= axis.values.size();
+		}
+		return false;
+	}
+
+	// The defines of variant key, in axis order
+	std::vector<std::pair<std::string, std::string>> GetDefines(Key key) const
+	{
+		std::vector<std::pair<std::string, std::string>> defines = {};
+		const std::vector<size_t> choices = Decode(key);
+		for (size_t i = 0; i < axes.size(); i++)
+			defines.push_back({ axes[i].name, axes[i].values[choices[i]] });
+		return defines;
+	}
+
+	// "NAME=VALUE NAME=VALUE"
+	std::string Describe(Key key) const
+	{
+		std::string text = "";
+		for (const auto& define : GetDefines(key))
+			text += (text.empty() ? "" : " ") + define.first + "=" + define.second;
+		return text;
+	}
+
+	// Axes declared in the source as "// @option NAME [VALUE...]" lines
+	static ShaderPermutations Parse(const std::string& source)
+	{
+		ShaderPermutations permutations;
+		for (size_t begin = 0; begin < source.size();)
+		{
+			size_t end = source.find('\n', begin);
+			if (end == std::string::npos)
+				end = source.size();
+			const size_t start = source.find_first_not_of(" \t", begin);
+			if (start != std::string::npos && start < end && source.compare(start, 2, "//") == 0)
+			{
+				const size_t tag = source.find_first_not_of(" \t", start + 2);
+				if (tag != std::string::npos && tag < end && source.compare(tag, 7, "@option") == 0)
+				{
+					std::vector<std::string> words = {};
+					size_t position = tag + 7;
+					while (position < end)
+					{
+						position = source.find_first_not_of(" \t\r", position);
+						if (position == std::string::npos || position >= end)
+							break;
+						size_t wordEnd = source.find_first_of(" \t\r\n", position);
+						if (wordEnd == std::string::npos || wordEnd > end)
+							wordEnd = end;
+						words.push_back(source.substr(position, wordEnd - position));
+						position = wordEnd;
+					}
+					if (!words.empty())
+						permutations.AddAxis(words[0], std::vector<std::string>(words.begin() + 1, words.end()));
+				}
+			}
+			begin = end + 1;
+		}
+		return permutations;
+	}
+};
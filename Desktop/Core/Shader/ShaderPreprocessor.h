@@ -0,0 +1,1197 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "IncludeResolver.h"
+
+// Portable C-style preprocessor for HLSL: #include through the request's IncludeResolver, object and
+// function-like macros with # and ##, #if expressions, include guards and #pragma once. The output keeps
+// line numbers with blank lines and #line markers, so diagnostics still point at the right file and line.
+// Included files are tokenized once and reused by later runs until their contents change. Thread safe,
+// a run keeps all of its state on the stack.
+class ShaderPreprocessor
+{
+public:
+	static constexpr int MaxIncludeDepth = 32;
+
+	class Token
+	{
+	public:
+		enum class Kind : uint8_t
+		{
+			Identifier,
+			Number,
+			String,
+			Punctuator,
+			Other,
+			Newline
+		};
+
+		std::string_view text = {};
+		uint32_t line = 0;
+		uint32_t column = 0;
+		Kind kind = Kind::Other;
+		// Whitespace or a comment came before it
+		bool space = false;
+
+		bool Is(const char* punctuator) const
+		{
+			return kind == Kind::Punctuator && text == punctuator;
+		}
+	};
+
+	// Tokens of one file, always ending with a Newline
+	class File
+	{
+	public:
+		IncludeResolver::Content content = nullptr;
+		std::vector<Token> tokens = {};
+		// Macro of an #ifndef/#define/#endif guard around the whole file, empty when there is none
+		std::string guard = "";
+	};
+
+	class Statistics
+	{
+	public:
+		uint64_t runs = 0;
+		uint64_t tokenized = 0;
+		uint64_t cacheHits = 0;
+	};
+
+private:
+	class Macro
+	{
+	public:
+		uint32_t id = 0;
+		bool function = false;
+		bool variadic = false;
+		std::vector<std::string_view> parameters = {};
+		std::vector<Token> body = {};
+	};
+
+	// A token during expansion, hide indexes the set of macros that must not expand it again
+	class Expanded
+	{
+	public:
+		Token token = Token();
+		uint32_t hide = 0;
+	};
+
+	// Where the tokens being processed come from, delta is what #line added to the physical line
+	class Source
+	{
+	public:
+		std::string name = "";
+		std::string path = "";
+		std::string directory = "";
+		int64_t delta = 0;
+	};
+
+	// Result of a #if expression, intmax_t or uintmax_t
+	class Value
+	{
+	public:
+		int64_t number = 0;
+		bool isUnsigned = false;
+	};
+
+	class Conditional
+	{
+	public:
+		bool parentActive = true;
+		// A branch was taken, or none may be because the parent is inactive
+		bool taken = false;
+		bool seenElse = false;
+		uint32_t line = 0;
+	};
+
+	class Context
+	{
+	public:
+		const ShaderCompiler::Request& request;
+		std::string& output;
+		std::string& log;
+		std::vector<ShaderCompiler::Include>& includes;
+		std::unordered_map<std::string_view, Macro> macros = {};
+		uint32_t nextMacro = 1;
+		// Hide sets are sorted macro ids, set 0 is empty
+		std::vector<std::vector<uint32_t>> hideSets = { {} };
+		std::unordered_map<uint64_t, uint32_t> unions = {};
+		std::unordered_map<uint64_t, uint32_t> additions = {};
+		// Text of pasted, stringized and built-in tokens, a deque so views stay valid
+		std::deque<std::string> strings = {};
+		std::vector<std::shared_ptr<const File>> files = {};
+		std::unordered_set<std::string> once = {};
+		bool failed = false;
+		// Buffers of Flush, kept to save allocations
+		std::vector<Expanded> stack = {};
+		std::vector<Expanded> expanded = {};
+		// Output position, the source line the current output line belongs to
+		std::string file = "";
+		int64_t line = 1;
+		bool lineStart = true;
+
+		Context(const ShaderCompiler::Request& request, std::string& output, std::string& log, std::vector<ShaderCompiler::Include>& includes)
+			: request(request), output(output), log(log), includes(includes) {}
+	};
+
+	mutable std::mutex mutex = {};
+	std::unordered_map<std::string, std::shared_ptr<const File>> files = {};
+	Statistics statistics = Statistics();
+
+	// Length of the escaped newline at offset, 0 when there is none
+	static size_t SpliceLength(std::string_view text, size_t offset)
+	{
+		if (offset + 1 >= text.size() || text[offset] != '\\')
+			return 0;
+		if (text[offset + 1] == '\n')
+			return 2;
+		return text[offset + 1] == '\r' && offset + 2 < text.size() && text[offset + 2] == '\n' ? 3 : 0;
+	}
+
+	static bool IsIdentifierCharacter(char c)
+	{
+		return isalnum((unsigned char)c) || c == '_';
+	}
+
+	static void Error(Context& context, const Source& source, int64_t line, uint32_t column, const char* code, const std::string& message)
+	{
+		context.log += source.name + "(" + std::to_string(line + source.delta) + "," + std::to_string(column) + "): error " + code + ": " + message + "\n";
+		context.failed = true;
+	}
+
+	static uint32_t Union(Context& context, uint32_t a, uint32_t b)
+	{
+		if (a == 0 || a == b)
+			return b;
+		if (b == 0)
+			return a;
+		const uint64_t key = (uint64_t)std::min(a, b) << 32 | std::max(a, b);
+		auto it = context.unions.find(key);
+		if (it != context.unions.end())
+			return it->second;
+		std::vector<uint32_t> merged = {};
+		std::set_union(context.hideSets[a].begin(), context.hideSets[a].end(), context.hideSets[b].begin(), context.hideSets[b].end(), std::back_inserter(merged));
+		context.hideSets.push_back(std::move(merged));
+		return context.unions[key] = (uint32_t)context.hideSets.size() - 1;
+	}
+
+	static uint32_t Add(Context& context, uint32_t set, uint32_t macro)
+	{
+		const uint64_t key = (uint64_t)set << 32 | macro;
+		auto it = context.additions.find(key);
+		if (it != context.additions.end())
+			return it->second;
+		std::vector<uint32_t> added = context.hideSets[set];
+		added.insert(std::lower_bound(added.begin(), added.end(), macro), macro);
+		context.hideSets.push_back(std::move(added));
+		return context.additions[key] = (uint32_t)context.hideSets.size() - 1;
+	}
+
+	static bool IsHidden(const Context& context, uint32_t set, uint32_t macro)
+	{
+		return set != 0 && std::binary_search(context.hideSets[set].begin(), context.hideSets[set].end(), macro);
+	}
+
+	static std::string_view Store(Context& context, std::string text)
+	{
+		context.strings.push_back(std::move(text));
+		return context.strings.back();
+	}
+
+	// The macro of an #ifndef/#define guard around the whole file, empty when there is none
+	static std::string FindGuard(const std::vector<Token>& tokens)
+	{
+		size_t i = 0;
+		auto SkipBlank = [&]() {
+			while (i < tokens.size() && tokens[i].kind == Token::Kind::Newline)
+				i++;
+			};
+		SkipBlank();
+		if (i + 3 >= tokens.size() || !tokens[i].Is("#") || tokens[i + 1].text != "ifndef" || tokens[i + 2].kind != Token::Kind::Identifier || tokens[i + 3].kind != Token::Kind::Newline)
+			return "";
+		const std::string_view guard = tokens[i + 2].text;
+		i += 4;
+		SkipBlank();
+		if (i + 2 >= tokens.size() || !tokens[i].Is("#") || tokens[i + 1].text != "define" || tokens[i + 2].text != guard)
+			return "";
+		int depth = 1;
+		bool lineStart = false;
+		for (; i < tokens.size(); i++)
+		{
+			const Token& token = tokens[i];
+			if (token.kind == Token::Kind::Newline)
+			{
+				lineStart = true;
+				continue;
+			}
+			if (lineStart && token.Is("#") && i + 1 < tokens.size())
+			{
+				const std::string_view keyword = tokens[i + 1].text;
+				if (keyword == "if" || keyword == "ifdef" || keyword == "ifndef")
+					depth++;
+				else if (keyword == "endif" && --depth == 0)
+				{
+					while (i < tokens.size() && tokens[i].kind != Token::Kind::Newline)
+						i++;
+					for (; i < tokens.size(); i++)
+					{
+						if (tokens[i].kind != Token::Kind::Newline)
+							return "";
+					}
+					return std::string(guard);
+				}
+			}
+			lineStart = false;
+		}
+		return "";
+	}
+
+	// Literals with a u suffix or too large for intmax_t are unsigned
+	static bool ParseNumber(std::string_view text, Value& value)
+	{
+		const std::string digits(text);
+		char* end = nullptr;
+		const uint64_t number = strtoull(digits.c_str(), &end, 0);
+		value.number = (int64_t)number;
+		value.isUnsigned = number > (uint64_t)INT64_MAX;
+		while (*end == 'u' || *end == 'U' || *end == 'l' || *end == 'L')
+		{
+			if (*end == 'u' || *end == 'U')
+				value.isUnsigned = true;
+			end++;
+		}
+		return end != digits.c_str() && *end == 0;
+	}
+
+	static int Precedence(const Token& token)
+	{
+		if (token.kind != Token::Kind::Punctuator)
+			return 0;
+		static const std::pair<const char*, int> operators[] = {
+			{ "||", 1 }, { "&&", 2 }, { "|", 3 }, { "^", 4 }, { "&", 5 }, { "==", 6 }, { "!=", 6 }, { "<", 7 }, { ">", 7 }, { "<=", 7 }, { ">=", 7 },
+			{ "<<", 8 }, { ">>", 8 }, { "+", 9 }, { "-", 9 }, { "*", 10 }, { "/", 10 }, { "%", 10 } };
+		for (const auto& entry : operators)
+		{
+			if (token.text == entry.first)
+				return entry.second;
+		}
+		return 0;
+	}
+
+	// Both operands are converted to unsigned when either is, shifts keep the type of the left one and
+	// logical and comparison operators give a signed 0 or 1. Division by zero is checked by the caller
+	static Value Apply(std::string_view op, const Value& a, const Value& b)
+	{
+		const uint64_t x = (uint64_t)a.number;
+		const uint64_t y = (uint64_t)b.number;
+		const bool isUnsigned = a.isUnsigned || b.isUnsigned;
+		if (op == "||")
+			return { a.number || b.number, false };
+		if (op == "&&")
+			return { a.number && b.number, false };
+		if (op == "<<")
+			return { (int64_t)(x << (y & 63)), a.isUnsigned };
+		if (op == ">>")
+			return { a.isUnsigned ? (int64_t)(x >> (y & 63)) : a.number >> (y & 63), a.isUnsigned };
+		if (op == "==")
+			return { x == y, false };
+		if (op == "!=")
+			return { x != y, false };
+		if (op == "<")
+			return { isUnsigned ? x < y : a.number < b.number, false };
+		if (op == ">")
+			return { isUnsigned ? x > y : a.number > b.number, false };
+		if (op == "<=")
+			return { isUnsigned ? x <= y : a.number <= b.number, false };
+		if (op == ">=")
+			return { isUnsigned ? x >= y : a.number >= b.number, false };
+		// Wraps instead of overflowing, which gives the same bits for signed operands
+		if (op == "|")
+			return { (int64_t)(x | y), isUnsigned };
+		if (op == "^")
+			return { (int64_t)(x ^ y), isUnsigned };
+		if (op == "&")
+			return { (int64_t)(x & y), isUnsigned };
+		if (op == "+")
+			return { (int64_t)(x + y), isUnsigned };
+		if (op == "-")
+			return { (int64_t)(x - y), isUnsigned };
+		if (op == "*")
+			return { (int64_t)(x * y), isUnsigned };
+		if (op == "/")
+			return { isUnsigned ? (int64_t)(x / y) : a.number / b.number, isUnsigned };
+		return { isUnsigned ? (int64_t)(x % y) : a.number % b.number, isUnsigned };
+	}
+
+	// evaluated is false inside the skipped operand of &&, || and ?:, which is parsed but may divide by zero
+	static bool EvaluateUnary(const std::vector<Expanded>& tokens, size_t& position, Value& value, bool evaluated)
+	{
+		if (position >= tokens.size())
+			return false;
+		const Token& token = tokens[position++].token;
+		if (token.Is("!") || token.Is("~") || token.Is("-") || token.Is("+"))
+		{
+			if (!EvaluateUnary(tokens, position, value, evaluated))
+				return false;
+			if (token.Is("!"))
+				value = { !value.number, false };
+			else if (token.Is("~"))
+				value.number = ~value.number;
+			else if (token.Is("-"))
+				value.number = (int64_t)(0 - (uint64_t)value.number);
+			return true;
+		}
+		if (token.Is("("))
+		{
+			if (!EvaluateConditional(tokens, position, value, evaluated) || position >= tokens.size() || !tokens[position].token.Is(")"))
+				return false;
+			position++;
+			return true;
+		}
+		if (token.kind == Token::Kind::Number)
+			return ParseNumber(token.text, value);
+		// Identifiers left after expansion are 0
+		if (token.kind == Token::Kind::Identifier)
+		{
+			value = { token.text == "true" ? 1 : 0, false };
+			return true;
+		}
+		if (token.kind == Token::Kind::String && token.text.size() >= 3 && token.text[0] == '\'')
+		{
+			value = { token.text[1] == '\\' ? token.text[2] : token.text[1], false };
+			return true;
+		}
+		return false;
+	}
+
+	static bool EvaluateBinary(const std::vector<Expanded>& tokens, size_t& position, Value& value, int minimum, bool evaluated)
+	{
+		if (!EvaluateUnary(tokens, position, value, evaluated))
+			return false;
+		int precedence = 0;
+		while (position < tokens.size() && (precedence = Precedence(tokens[position].token)) >= minimum)
+		{
+			const std::string_view op = tokens[position++].token.text;
+			Value right = Value();
+			const bool shortCircuit = (op == "&&" && value.number == 0) || (op == "||" && value.number != 0);
+			if (!EvaluateBinary(tokens, position, right, precedence + 1, evaluated && !shortCircuit))
+				return false;
+			if (!evaluated)
+				continue;
+			if ((op == "/" || op == "%") && (right.number == 0 || (!value.isUnsigned && !right.isUnsigned && value.number == INT64_MIN && right.number == -1)))
+				return false;
+			value = Apply(op, value, right);
+		}
+		return true;
+	}
+
+	static bool EvaluateConditional(const std::vector<Expanded>& tokens, size_t& position, Value& value, bool evaluated)
+	{
+		if (!EvaluateBinary(tokens, position, value, 1, evaluated))
+			return false;
+		if (position >= tokens.size() || !tokens[position].token.Is("?"))
+			return true;
+		position++;
+		Value whenTrue = Value(), whenFalse = Value();
+		if (!EvaluateConditional(tokens, position, whenTrue, evaluated && value.number != 0) || position >= tokens.size() || !tokens[position].token.Is(":"))
+			return false;
+		position++;
+		if (!EvaluateConditional(tokens, position, whenFalse, evaluated && value.number == 0))
+			return false;
+		value = { value.number ? whenTrue.number : whenFalse.number, whenTrue.isUnsigned || whenFalse.isUnsigned };
+		return true;
+	}
+
+	static int FindParameter(const Macro& macro, const Token& token)
+	{
+		if (!macro.function || token.kind != Token::Kind::Identifier)
+			return -1;
+		for (size_t i = 0; i < macro.parameters.size(); i++)
+		{
+			if (macro.parameters[i] == token.text)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	static Token Stringize(Context& context, const std::vector<Expanded>& argument, const Token& hash)
+	{
+		std::string text = "\"";
+		for (size_t i = 0; i < argument.size(); i++)
+		{
+			const Token& token = argument[i].token;
+			if (i > 0 && token.space)
+				text += ' ';
+			for (const char c : token.text)
+			{
+				if (token.kind == Token::Kind::String && (c == '"' || c == '\\'))
+					text += '\\';
+				text += c;
+			}
+		}
+		text += '"';
+		Token token = hash;
+		token.kind = Token::Kind::String;
+		token.text = Store(context, std::move(text));
+		return token;
+	}
+
+	// An empty argument next to ## is a placemarker, it disappears in the paste
+	static void Paste(Context& context, Expanded& left, const Expanded& right)
+	{
+		if (right.token.text.empty())
+			return;
+		if (left.token.text.empty())
+		{
+			const bool space = left.token.space;
+			left = right;
+			left.token.space = space;
+			return;
+		}
+		const std::string_view text = Store(context, std::string(left.token.text) + std::string(right.token.text));
+		// Names and numbers keep the kind of the left side, anything else is tokenized again
+		const bool word = (left.token.kind == Token::Kind::Identifier || left.token.kind == Token::Kind::Number)
+			&& (right.token.kind == Token::Kind::Identifier || right.token.kind == Token::Kind::Number);
+		if (!word)
+		{
+			std::vector<Token> tokens = {};
+			Tokenize(text, tokens);
+			left.token.kind = tokens.size() == 2 ? tokens[0].kind : Token::Kind::Other;
+		}
+		left.token.text = text;
+		left.hide = Union(context, left.hide, right.hide);
+	}
+
+	static bool Substitute(Context& context, const Source& source, const Macro& macro, const std::vector<std::vector<Expanded>>& arguments, uint32_t hide,
+		std::vector<Expanded>& output)
+	{
+		std::vector<std::vector<Expanded>> expanded(arguments.size());
+		std::vector<bool> isExpanded(arguments.size(), false);
+		const std::vector<Token>& body = macro.body;
+		for (size_t i = 0; i < body.size(); i++)
+		{
+			const Token& token = body[i];
+			if (macro.function && token.Is("#") && i + 1 < body.size() && FindParameter(macro, body[i + 1]) >= 0)
+			{
+				output.push_back({ Stringize(context, arguments[FindParameter(macro, body[++i])], token), hide });
+				continue;
+			}
+			if (token.Is("##") && !output.empty() && i + 1 < body.size())
+			{
+				const Token& next = body[++i];
+				const int parameter = FindParameter(macro, next);
+				std::vector<Expanded> right = parameter >= 0 ? arguments[parameter] : std::vector<Expanded>{ { next, 0 } };
+				if (right.empty())
+					continue;
+				right[0].hide = Union(context, right[0].hide, hide);
+				Paste(context, output.back(), right[0]);
+				for (size_t j = 1; j < right.size(); j++)
+					output.push_back({ right[j].token, Union(context, right[j].hide, hide) });
+				continue;
+			}
+			const int parameter = FindParameter(macro, token);
+			if (parameter < 0)
+			{
+				output.push_back({ token, hide });
+				continue;
+			}
+			// Arguments are fully expanded first, unless they are pasted
+			const bool raw = i + 1 < body.size() && body[i + 1].Is("##");
+			if (!raw && !isExpanded[parameter])
+			{
+				std::vector<Expanded> stack(arguments[parameter].rbegin(), arguments[parameter].rend());
+				if (!Expand(context, source, stack, expanded[parameter], false))
+					return false;
+				isExpanded[parameter] = true;
+			}
+			const std::vector<Expanded>& argument = raw ? arguments[parameter] : expanded[parameter];
+			if (argument.empty() && raw)
+			{
+				Expanded placemarker = { token, hide };
+				placemarker.token.text = {};
+				placemarker.token.kind = Token::Kind::Other;
+				output.push_back(placemarker);
+			}
+			for (size_t j = 0; j < argument.size(); j++)
+			{
+				Expanded inserted = { argument[j].token, Union(context, argument[j].hide, hide) };
+				if (j == 0)
+					inserted.token.space = token.space;
+				output.push_back(inserted);
+			}
+		}
+		output.erase(std::remove_if(output.begin(), output.end(), [](const Expanded& expanded) {
+			return expanded.token.kind == Token::Kind::Other && expanded.token.text.empty();
+			}), output.end());
+		return true;
+	}
+
+	// Collects the arguments of an invocation whose '(' was already taken from the stack
+	static bool CollectArguments(Context& context, const Source& source, std::vector<Expanded>& stack, const Token& invocation, const Macro& macro,
+		std::vector<std::vector<Expanded>>& arguments)
+	{
+		arguments.emplace_back();
+		int depth = 0;
+		bool space = false;
+		while (true)
+		{
+			if (stack.empty())
+			{
+				Error(context, source, invocation.line, invocation.column, "X1004", "unexpected end of file in macro expansion of '" + std::string(invocation.text) + "'");
+				return false;
+			}
+			Expanded expanded = stack.back();
+			stack.pop_back();
+			if (expanded.token.kind == Token::Kind::Newline)
+			{
+				space = true;
+				continue;
+			}
+			if (expanded.token.Is("("))
+				depth++;
+			else if (expanded.token.Is(")") && depth-- == 0)
+				break;
+			else if (expanded.token.Is(",") && depth == 0 && !(macro.variadic && arguments.size() == macro.parameters.size()))
+			{
+				arguments.emplace_back();
+				continue;
+			}
+			if (space)
+				expanded.token.space = true;
+			space = false;
+			arguments.back().push_back(expanded);
+		}
+		if (macro.parameters.empty() && arguments.size() == 1 && arguments[0].empty())
+			arguments.clear();
+		if (macro.variadic && arguments.size() + 1 == macro.parameters.size())
+			arguments.emplace_back();
+		if (arguments.size() != macro.parameters.size())
+		{
+			Error(context, source, invocation.line, invocation.column, "X1502", "wrong number of arguments for macro '" + std::string(invocation.text) + "'");
+			return false;
+		}
+		return true;
+	}
+
+	// Expands the tokens on stack, which holds them in reverse order, into output
+	static bool Expand(Context& context, const Source& source, std::vector<Expanded>& stack, std::vector<Expanded>& output, bool condition)
+	{
+		while (!stack.empty())
+		{
+			Expanded current = stack.back();
+			stack.pop_back();
+			const Token& token = current.token;
+			if (token.kind != Token::Kind::Identifier)
+			{
+				output.push_back(current);
+				continue;
+			}
+			if (condition && token.text == "defined")
+			{
+				const bool parenthesis = !stack.empty() && stack.back().token.Is("(");
+				if (parenthesis)
+					stack.pop_back();
+				if (stack.empty() || stack.back().token.kind != Token::Kind::Identifier)
+				{
+					Error(context, source, token.line, token.column, "X1000", "'defined' needs a macro name");
+					return false;
+				}
+				const bool defined = context.macros.count(stack.back().token.text) != 0;
+				stack.pop_back();
+				if (parenthesis)
+				{
+					if (stack.empty() || !stack.back().token.Is(")"))
+					{
+						Error(context, source, token.line, token.column, "X1000", "missing ')' after 'defined'");
+						return false;
+					}
+					stack.pop_back();
+				}
+				current.token.kind = Token::Kind::Number;
+				current.token.text = defined ? "1" : "0";
+				output.push_back(current);
+				continue;
+			}
+			if (token.text == "__LINE__" || token.text == "__FILE__")
+			{
+				const bool line = token.text == "__LINE__";
+				current.token.kind = line ? Token::Kind::Number : Token::Kind::String;
+				current.token.text = Store(context, line ? std::to_string(token.line + source.delta) : "\"" + source.name + "\"");
+				output.push_back(current);
+				continue;
+			}
+			auto it = context.macros.find(token.text);
+			if (it == context.macros.end() || IsHidden(context, current.hide, it->second.id))
+			{
+				output.push_back(current);
+				continue;
+			}
+			const Macro& macro = it->second;
+			std::vector<std::vector<Expanded>> arguments = {};
+			if (macro.function)
+			{
+				// Only an invocation when '(' follows, possibly on a later line
+				size_t next = stack.size();
+				while (next > 0 && stack[next - 1].token.kind == Token::Kind::Newline)
+					next--;
+				if (next == 0 || !stack[next - 1].token.Is("("))
+				{
+					output.push_back(current);
+					continue;
+				}
+				stack.resize(next - 1);
+				if (!CollectArguments(context, source, stack, token, macro, arguments))
+					return false;
+			}
+			std::vector<Expanded> replacement = {};
+			if (!Substitute(context, source, macro, arguments, Add(context, current.hide, macro.id), replacement))
+				return false;
+			for (Expanded& expanded : replacement)
+				expanded.token.line = token.line;
+			if (!replacement.empty())
+			{
+				replacement[0].token.space = token.space;
+				replacement[0].token.column = token.column;
+			}
+			stack.insert(stack.end(), replacement.rbegin(), replacement.rend());
+		}
+		return true;
+	}
+
+	// Starts the output line that belongs to line of file, with blank lines for short gaps and #line otherwise
+	static void Move(Context& context, const std::string& file, int64_t line)
+	{
+		if (!context.lineStart)
+		{
+			context.output += '\n';
+			context.line++;
+			context.lineStart = true;
+		}
+		if (file != context.file || line < context.line || line > context.line + 8)
+		{
+			context.output += "#line " + std::to_string(line) + " \"" + file + "\"\n";
+			context.file = file;
+			context.line = line;
+			return;
+		}
+		context.output.append((size_t)(line - context.line), '\n');
+		context.line = line;
+	}
+
+	static void Write(Context& context, const Source& source, const Expanded& expanded)
+	{
+		const Token& token = expanded.token;
+		if (token.kind == Token::Kind::Newline)
+		{
+			context.output += '\n';
+			context.line++;
+			context.lineStart = true;
+			// Lines joined by a multi-line invocation or a comment
+			if (context.line != token.line + 1 + source.delta)
+				Move(context, source.name, token.line + 1 + source.delta);
+			return;
+		}
+		if (context.lineStart)
+		{
+			if (token.column > 1)
+				context.output.append(std::min<size_t>(token.column - 1, 256), ' ');
+			context.lineStart = false;
+		}
+		else if (token.space)
+		{
+			context.output += ' ';
+		}
+		else if (!context.output.empty() && !token.text.empty())
+		{
+			// Keep tokens apart that would read as one after an expansion
+			const char last = context.output.back();
+			const char first = token.text[0];
+			if ((IsIdentifierCharacter(last) && IsIdentifierCharacter(first)) || (last == first && strchr("+-&|<>=", first) != nullptr) || (last == '-' && first == '>'))
+				context.output += ' ';
+		}
+		context.output.append(token.text.data(), token.text.size());
+	}
+
+	static bool Flush(Context& context, const Source& source, std::vector<Expanded>& run)
+	{
+		if (run.empty())
+			return true;
+		Move(context, source.name, run.front().token.line + source.delta);
+		context.stack.assign(run.rbegin(), run.rend());
+		context.expanded.clear();
+		run.clear();
+		if (!Expand(context, source, context.stack, context.expanded, false))
+			return false;
+		for (const Expanded& token : context.expanded)
+			Write(context, source, token);
+		return true;
+	}
+
+	static bool Evaluate(Context& context, const Source& source, const std::vector<Token>& tokens, size_t begin, size_t end, bool& value)
+	{
+		std::vector<Expanded> stack = {};
+		for (size_t i = end; i > begin; i--)
+			stack.push_back({ tokens[i - 1], 0 });
+		std::vector<Expanded> expanded = {};
+		if (!Expand(context, source, stack, expanded, true))
+			return false;
+		size_t position = 0;
+		Value result = Value();
+		if (expanded.empty() || !EvaluateConditional(expanded, position, result, true) || position != expanded.size())
+		{
+			Error(context, source, tokens[begin - 1].line, tokens[begin - 1].column, "X1000", "invalid #if expression");
+			value = false;
+			return true;
+		}
+		value = result.number != 0;
+		return true;
+	}
+
+	bool Include(Context& context, const Source& source, const std::vector<Token>& tokens, size_t begin, size_t end, int depth)
+	{
+		const Token& directive = tokens[begin - 1];
+		std::vector<Expanded> operands = {};
+		if (begin < end && (tokens[begin].kind == Token::Kind::String || tokens[begin].Is("<")))
+		{
+			for (size_t i = begin; i < end; i++)
+				operands.push_back({ tokens[i], 0 });
+		}
+		else
+		{
+			std::vector<Expanded> stack = {};
+			for (size_t i = end; i > begin; i--)
+				stack.push_back({ tokens[i - 1], 0 });
+			if (!Expand(context, source, stack, operands, false))
+				return false;
+		}
+		std::string name = "";
+		bool system = false;
+		if (!operands.empty() && operands[0].token.kind == Token::Kind::String && operands[0].token.text[0] == '"')
+		{
+			name = std::string(operands[0].token.text.substr(1, operands[0].token.text.size() - 2));
+		}
+		else if (!operands.empty() && operands[0].token.Is("<"))
+		{
+			system = true;
+			size_t i = 1;
+			for (; i < operands.size() && !operands[i].token.Is(">"); i++)
+			{
+				if (!name.empty() && operands[i].token.space)
+					name += ' ';
+				name += operands[i].token.text;
+			}
+			if (i == operands.size())
+				name.clear();
+		}
+		if (name.empty())
+		{
+			Error(context, source, directive.line, directive.column, "X1000", "#include expects \"FILENAME\" or <FILENAME>");
+			return false;
+		}
+		const uint32_t column = begin < end ? tokens[begin].column : directive.column;
+		if (depth >= MaxIncludeDepth)
+		{
+			Error(context, source, directive.line, column, "X1504", "'" + name + "': include nesting too deep");
+			return false;
+		}
+		std::string included = "";
+		IncludeResolver::Content content = nullptr;
+		if (context.request.resolver == nullptr || !context.request.resolver->Open(name, system, source.directory, included, content))
+		{
+			Error(context, source, directive.line, column, "X1507", "failed to open source file: '" + name + "'");
+			return false;
+		}
+		ShaderCompiler::AddInclude(context.includes, included, source.path);
+		if (context.once.count(included) != 0)
+			return true;
+		std::shared_ptr<const File> file = Load(included, content);
+		if (!file->guard.empty() && context.macros.count(file->guard) != 0)
+			return true;
+		context.files.push_back(file);
+		Source child;
+		child.name = included;
+		child.path = included;
+		child.directory = std::filesystem::path(included).parent_path().string();
+		return Process(context, child, *file, depth + 1);
+	}
+
+	static bool Define(Context& context, const Source& source, const std::vector<Token>& tokens, size_t begin, size_t end)
+	{
+		const Token& directive = tokens[begin - 1];
+		if (begin >= end || tokens[begin].kind != Token::Kind::Identifier)
+		{
+			Error(context, source, directive.line, directive.column, "X1000", "#define needs a macro name");
+			return true;
+		}
+		Macro macro;
+		macro.id = context.nextMacro++;
+		size_t i = begin + 1;
+		if (i < end && tokens[i].Is("(") && !tokens[i].space)
+		{
+			macro.function = true;
+			bool closed = false;
+			for (i++; i < end && !closed; i++)
+			{
+				const Token& token = tokens[i];
+				if (token.Is(")") && macro.parameters.empty())
+				{
+					closed = true;
+					continue;
+				}
+				if (macro.variadic || (token.kind != Token::Kind::Identifier && !token.Is("...")) || i + 1 >= end)
+					break;
+				macro.variadic = token.Is("...");
+				macro.parameters.push_back(macro.variadic ? std::string_view("__VA_ARGS__") : token.text);
+				i++;
+				closed = tokens[i].Is(")");
+				if (!closed && !tokens[i].Is(","))
+					break;
+			}
+			if (!closed)
+			{
+				Error(context, source, directive.line, directive.column, "X1000", "invalid parameter list for macro '" + std::string(tokens[begin].text) + "'");
+				return true;
+			}
+		}
+		macro.body.assign(tokens.begin() + i, tokens.begin() + end);
+		if (!macro.body.empty())
+			macro.body[0].space = false;
+		context.macros[tokens[begin].text] = std::move(macro);
+		return true;
+	}
+
+	// false stops the run
+	bool Directive(Context& context, Source& source, const std::vector<Token>& tokens, size_t begin, size_t end, std::vector<Conditional>& conditionals,
+		bool& active, int depth)
+	{
+		const Token& hash = tokens[begin - 1];
+		if (begin >= end)
+			return true;
+		const std::string_view keyword = tokens[begin].text;
+		if (keyword == "if" || keyword == "ifdef" || keyword == "ifndef")
+		{
+			Conditional conditional;
+			conditional.parentActive = active;
+			conditional.line = hash.line;
+			bool value = false;
+			if (active && keyword == "if" && !Evaluate(context, source, tokens, begin + 1, end, value))
+				return false;
+			if (active && keyword != "if")
+			{
+				if (begin + 1 >= end || tokens[begin + 1].kind != Token::Kind::Identifier)
+					Error(context, source, hash.line, hash.column, "X1000", "#" + std::string(keyword) + " needs a macro name");
+				else
+					value = (context.macros.count(tokens[begin + 1].text) != 0) == (keyword == "ifdef");
+			}
+			conditional.taken = !active || value;
+			active = active && value;
+			conditionals.push_back(conditional);
+			return true;
+		}
+		if (keyword == "elif" || keyword == "else" || keyword == "endif")
+		{
+			if (conditionals.empty() || (keyword != "endif" && conditionals.back().seenElse))
+			{
+				Error(context, source, hash.line, hash.column, "X1000", "unexpected #" + std::string(keyword));
+				return true;
+			}
+			Conditional& conditional = conditionals.back();
+			if (keyword == "endif")
+			{
+				active = conditional.parentActive;
+				conditionals.pop_back();
+			}
+			else if (conditional.taken)
+			{
+				active = false;
+				conditional.seenElse = keyword == "else";
+			}
+			else if (keyword == "else")
+			{
+				active = true;
+				conditional.taken = true;
+				conditional.seenElse = true;
+			}
+			else
+			{
+				bool value = false;
+				if (!Evaluate(context, source, tokens, begin + 1, end, value))
+					return false;
+				active = value;
+				conditional.taken = value;
+			}
+			return true;
+		}
+		if (!active)
+			return true;
+		if (keyword == "include")
+			return Include(context, source, tokens, begin + 1, end, depth);
+		if (keyword == "define")
+			return Define(context, source, tokens, begin + 1, end);
+		if (keyword == "undef")
+		{
+			if (begin + 1 < end)
+				context.macros.erase(tokens[begin + 1].text);
+			return true;
+		}
+		if (keyword == "pragma" && begin + 1 < end && tokens[begin + 1].text == "once" && !source.path.empty())
+		{
+			context.once.insert(source.path);
+			return true;
+		}
+		std::string text = "";
+		for (size_t i = begin + 1; i < end; i++)
+			text += (i > begin + 1 && tokens[i].space ? " " : "") + std::string(tokens[i].text);
+		if (keyword == "error")
+		{
+			Error(context, source, hash.line, hash.column, "X1503", text);
+			return true;
+		}
+		if (keyword == "line")
+		{
+			Value line = Value();
+			if (begin + 1 >= end || !ParseNumber(tokens[begin + 1].text, line))
+			{
+				Error(context, source, hash.line, hash.column, "X1000", "#line needs a line number");
+				return true;
+			}
+			// The line after the directive becomes line
+			source.delta = line.number - (int64_t)hash.line - 1;
+			if (begin + 2 < end && tokens[begin + 2].kind == Token::Kind::String && tokens[begin + 2].text.size() >= 2)
+				source.name = std::string(tokens[begin + 2].text.substr(1, tokens[begin + 2].text.size() - 2));
+			return true;
+		}
+		// Pragmas are for the compiler
+		if (keyword == "pragma")
+		{
+			Move(context, source.name, hash.line + source.delta);
+			context.output += "#pragma " + text + "\n";
+			context.line++;
+			return true;
+		}
+		Error(context, source, hash.line, hash.column, "X1000", "invalid preprocessor command '" + std::string(keyword) + "'");
+		return true;
+	}
+
+	bool Process(Context& context, Source& source, const File& file, int depth)
+	{
+		const std::vector<Token>& tokens = file.tokens;
+		std::vector<Conditional> conditionals = {};
+		std::vector<Expanded> run = {};
+		bool active = true;
+		for (size_t begin = 0; begin < tokens.size();)
+		{
+			size_t end = begin;
+			while (tokens[end].kind != Token::Kind::Newline)
+				end++;
+			if (tokens[begin].Is("#"))
+			{
+				if (!Flush(context, source, run) || !Directive(context, source, tokens, begin + 1, end, conditionals, active, depth))
+					return false;
+			}
+			else if (active)
+			{
+				for (size_t i = begin; i <= end; i++)
+					run.push_back({ tokens[i], 0 });
+			}
+			begin = end + 1;
+		}
+		if (!Flush(context, source, run))
+			return false;
+		if (!conditionals.empty())
+			Error(context, source, conditionals.back().line, 1, "X1000", "unterminated conditional directive");
+		return true;
+	}
+
+public:
+	// Splits text into tokens, comments become whitespace and escaped newlines join lines
+	static void Tokenize(std::string_view text, std::vector<Token>& tokens)
+	{
+		static const char* punctuators[] = { ">>=", "<<=", "...", "##", "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+			"+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "::" };
+		const char* data = text.data();
+		const size_t size = text.size();
+		uint32_t line = 1;
+		size_t lineBegin = 0;
+		bool space = false;
+		for (size_t i = 0; i < size;)
+		{
+			const char c = data[i];
+			const char next = i + 1 < size ? data[i + 1] : 0;
+			if (c == '\n')
+			{
+				tokens.push_back({ text.substr(i, 1), line, (uint32_t)(i - lineBegin + 1), Token::Kind::Newline, space });
+				line++;
+				lineBegin = ++i;
+				space = false;
+				continue;
+			}
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f')
+			{
+				space = true;
+				i++;
+				continue;
+			}
+			if (const size_t splice = SpliceLength(text, i))
+			{
+				i += splice;
+				line++;
+				lineBegin = i;
+				space = true;
+				continue;
+			}
+			if (c == '/' && next == '/')
+			{
+				// Lines are spliced before comments are removed, so an escaped newline continues the comment
+				while (i < size && data[i] != '\n')
+				{
+					if (const size_t splice = SpliceLength(text, i))
+					{
+						i += splice;
+						line++;
+						lineBegin = i;
+						continue;
+					}
+					i++;
+				}
+				space = true;
+				continue;
+			}
+			if (c == '/' && next == '*')
+			{
+				for (i += 2; i < size && !(data[i] == '*' && i + 1 < size && data[i + 1] == '/'); i++)
+				{
+					if (data[i] == '\n')
+					{
+						line++;
+						lineBegin = i + 1;
+					}
+				}
+				i = std::min(i + 2, size);
+				space = true;
+				continue;
+			}
+			const size_t start = i;
+			Token::Kind kind = Token::Kind::Punctuator;
+			if (isalpha((unsigned char)c) || c == '_')
+			{
+				kind = Token::Kind::Identifier;
+				while (i < size && IsIdentifierCharacter(data[i]))
+					i++;
+			}
+			else if (isdigit((unsigned char)c) || (c == '.' && isdigit((unsigned char)next)))
+			{
+				kind = Token::Kind::Number;
+				for (i++; i < size; i++)
+				{
+					const char previous = data[i - 1];
+					if (!IsIdentifierCharacter(data[i]) && data[i] != '.' && !((data[i] == '+' || data[i] == '-') && strchr("eEpP", previous) != nullptr))
+						break;
+				}
+			}
+			else if (c == '"' || c == '\'')
+			{
+				kind = Token::Kind::String;
+				for (i++; i < size && data[i] != c && data[i] != '\n'; i++)
+				{
+					if (data[i] == '\\' && i + 1 < size)
+						i++;
+				}
+				if (i < size && data[i] == c)
+					i++;
+			}
+			else
+			{
+				size_t length = 1;
+				for (const char* punctuator : punctuators)
+				{
+					const size_t candidate = strlen(punctuator);
+					if (candidate > length && text.compare(i, candidate, punctuator) == 0)
+						length = candidate;
+				}
+				if (length == 1 && strchr("+-*/%<>=!&|^~?:;,.()[]{}#", c) == nullptr)
+					kind = Token::Kind::Other;
+				i += length;
+			}
+			tokens.push_back({ text.substr(start, i - start), line, (uint32_t)(start - lineBegin + 1), kind, space });
+			space = false;
+		}
+		if (tokens.empty() || tokens.back().kind != Token::Kind::Newline)
+			tokens.push_back({ std::string_view("\n"), line, (uint32_t)(size - lineBegin + 1), Token::Kind::Newline, space });
+	}
+
+	// The tokens of an included file, from the cache while its contents are unchanged
+	std::shared_ptr<const File> Load(const std::string& path, const IncludeResolver::Content& content)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = files.find(path);
+			if (it != files.end() && (it->second->content == content || *it->second->content == *content))
+			{
+				statistics.cacheHits++;
+				return it->second;
+			}
+		}
+		std::shared_ptr<File> file = std::make_shared<File>();
+		file->content = content;
+		Tokenize(*content, file->tokens);
+		file->guard = FindGuard(file->tokens);
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.tokenized++;
+		files[path] = file;
+		return file;
+	}
+
+	// Same contract as ShaderCompiler::Preprocess, request.defines are defined before the first line
+	bool Run(const ShaderCompiler::Request& request, std::string& output, std::string& log, std::vector<ShaderCompiler::Include>& includes)
+	{
+		output.clear();
+		Context context(request, output, log, includes);
+		for (const auto& define : request.defines)
+		{
+			Macro macro;
+			macro.id = context.nextMacro++;
+			Tokenize(Store(context, define.second), macro.body);
+			macro.body.pop_back();
+			if (!macro.body.empty())
+				macro.body[0].space = false;
+			context.macros[Store(context, define.first)] = std::move(macro);
+		}
+		File file;
+		Tokenize(request.source, file.tokens);
+		Source source;
+		source.name = request.sourceName.empty() ? "Source" : request.sourceName;
+		source.directory = request.directory;
+		context.file = source.name;
+		const bool finished = Process(context, source, file, 0);
+		if (!context.lineStart)
+			output += '\n';
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.runs++;
+		return finished && !context.failed;
+	}
+
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		files.clear();
+	}
+
+	Statistics GetStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return statistics;
+	}
+};
@@ -0,0 +1,147 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../../Dependence/ThreadPool.h"
+#include "ShaderPermutations.h"
+
+// Every variant of one shader. Build preprocesses all variants in parallel, variants that share a cache key
+// (their preprocessed output is identical) share one compile, and the unique results are compiled in parallel.
+// Find is a table lookup by variant key.
+class ShaderVariantSet
+{
+public:
+	// Larger sets are refused, the lookup table holds one entry per variant
+	static constexpr uint64_t MaxVariants = 1ull << 20;
+
+	class Statistics
+	{
+	public:
+		uint64_t variants = 0;
+		uint64_t unique = 0;
+		uint64_t failed = 0;
+		// Unique results answered by ShaderCache
+		uint64_t cached = 0;
+		// Wall clock milliseconds of both phases
+		float preprocessTime = 0.f;
+		float compileTime = 0.f;
+	};
+
+private:
+	// Variant key -> index into results
+	std::vector<uint32_t> table = {};
+	std::vector<ShaderCompiler::Result> results = {};
+
+public:
+	ShaderPermutations permutations = ShaderPermutations();
+	Statistics statistics = Statistics();
+
+	ShaderVariantSet() {}
+	ShaderVariantSet(const ShaderPermutations& permutations) : permutations(permutations) {}
+
+	// base is compiled once per variant with the variant's defines appended. cache may be nullptr.
+	bool Build(ThreadPool* pool, ShaderCompiler* compiler, ShaderCache* cache, const ShaderCompiler::Request& base, std::string& error)
+	{
+		const uint64_t count = permutations.GetVariantCount();
+		if (count == 0)
+		{
+			auto empty = std::find_if(permutations.axes.begin(), permutations.axes.end(), [](const ShaderPermutations::Axis& axis) { return axis.values.empty(); });
+			error = "Axis " + empty->name + " has no values";
+			return false;
+		}
+		if (count > MaxVariants)
+		{
+			error = "Too many variants (" + std::to_string(count) + "), at most " + std::to_string(MaxVariants) + " are supported";
+			return false;
+		}
+		statistics = Statistics();
+		statistics.variants = count;
+
+		class Variant
+		{
+		public:
+			ShaderCache::Key key = {};
+			std::vector<ShaderCompiler::Include> includes = {};
+			bool preprocessed = false;
+		};
+		std::vector<Variant> variants(count);
+		auto MakeRequest = [&](uint64_t key) {
+			ShaderCompiler::Request request = base;
+			for (const auto& define : permutations.GetDefines(key))
+				request.defines.push_back(define);
+			return request;
+			};
+
+		auto start = std::chrono::steady_clock::now();
+		pool->ParallelFor(count, [&](size_t index) {
+			const ShaderCompiler::Request request = MakeRequest(index);
+			std::string preprocessed = "", log = "";
+			Variant& variant = variants[index];
+			variant.preprocessed = compiler->Preprocess(request, preprocessed, log, variant.includes);
+			if (variant.preprocessed)
+				variant.key = ShaderCache::MakeKey(compiler, request, preprocessed);
+			});
+		statistics.preprocessTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		// Variants that failed to preprocess are compiled on their own to get their diagnostics
+		std::unordered_map<std::string, uint32_t> uniques = {};
+		std::vector<uint64_t> representatives = {};
+		table.assign(count, 0);
+		for (uint64_t i = 0; i < count; i++)
+		{
+			if (variants[i].preprocessed)
+			{
+				auto inserted = uniques.emplace(std::string((const char*)variants[i].key.data(), variants[i].key.size()), (uint32_t)representatives.size());
+				table[i] = inserted.first->second;
+				if (!inserted.second)
+					continue;
+			}
+			else
+			{
+				table[i] = (uint32_t)representatives.size();
+			}
+			representatives.push_back(i);
+		}
+		statistics.unique = representatives.size();
+
+		start = std::chrono::steady_clock::now();
+		results.assign(representatives.size(), ShaderCompiler::Result());
+		std::atomic<uint64_t> failed{ 0 }, cached{ 0 };
+		pool->ParallelFor(representatives.size(), [&](size_t index) {
+			const uint64_t key = representatives[index];
+			const Variant& variant = variants[key];
+			ShaderCompiler::Result& result = results[index];
+			if (cache != nullptr && variant.preprocessed && cache->Lookup(variant.key, result))
+			{
+				cached++;
+			}
+			else
+			{
+				result = compiler->Compile(MakeRequest(key));
+				if (cache != nullptr && variant.preprocessed)
+					cache->Store(variant.key, result);
+			}
+			if (variant.preprocessed)
+				result.includes = variant.includes;
+			if (!result.success)
+				failed++;
+			});
+		statistics.compileTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		statistics.failed = failed.load();
+		statistics.cached = cached.load();
+		return true;
+	}
+
+	// nullptr when the key is outside the built set
+	const ShaderCompiler::Result* Find(ShaderPermutations::Key key) const
+	{
+		return key < table.size() ? &results[table[key]] : nullptr;
+	}
+
+	bool IsBuilt() const
+	{
+		return !table.empty();
+	}
+};
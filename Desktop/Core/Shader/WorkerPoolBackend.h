@@ -0,0 +1,271 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../Dependence/ChildProcess.h"
+#include "CompilerProtocol.h"
+
+// Runs compiles in persistent worker processes (the batch compiler started with --worker) instead of in-process,
+// so a compiler that crashes, hangs or runs out of memory only takes its worker down, and compiles do not
+// serialize on locks inside the compiler. Sources are preprocessed here by an in-process instance of the workers'
+// backend, so workers only see self contained source and cache keys match a compile without the pool. A job
+// that does not answer within timeout kills its worker and fails, and a job that crashes its worker fails too;
+// either way the worker is started again for the next batch.
+class WorkerPoolBackend : public ShaderCompiler
+{
+public:
+	class Statistics
+	{
+	public:
+		uint64_t jobs = 0;
+		uint64_t batches = 0;
+		// Jobs that shared a frame with others
+		uint64_t batchedJobs = 0;
+		uint64_t timeouts = 0;
+		uint64_t crashes = 0;
+		uint64_t starts = 0;
+	};
+
+	// Milliseconds a single job may take before its worker is killed
+	uint32_t timeout = 30000;
+	// Jobs whose source is at most this many bytes go out together, up to maxBatch in one frame
+	size_t smallJob = 8 * 1024;
+	size_t maxBatch = 8;
+
+private:
+	// Jobs not yet started when their worker went down are queued again, at most this many times
+	static constexpr int MaxAttempts = 3;
+
+	class Job
+	{
+	public:
+		const Request* request = nullptr;
+		std::string source = "";
+		Result* result = nullptr;
+		int attempts = 0;
+		bool finished = false;
+	};
+
+	class Worker
+	{
+	public:
+		ChildProcess process = ChildProcess();
+		std::thread thread = std::thread();
+	};
+
+	std::vector<std::string> command = {};
+	ShaderCompiler* backend = nullptr;
+	std::string name = "";
+	std::vector<std::unique_ptr<Worker>> workers = {};
+	std::mutex mutex;
+	std::condition_variable queued;
+	std::condition_variable finished;
+	std::deque<Job*> jobs = {};
+	bool stopping = false;
+	Statistics statistics = Statistics();
+
+	void Finish(Job* job, bool success, const std::string& message)
+	{
+		if (!success)
+		{
+			const std::string file = job->request->sourceName.empty() ? "Source" : job->request->sourceName;
+			job->result->success = false;
+			job->result->bytecode.clear();
+			job->result->log = file + "(1,1): error X0000: " + message + "\n";
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		job->finished = true;
+		finished.notify_all();
+	}
+
+	// Jobs of a batch that never reached the compiler go back to the front of the queue
+	void Requeue(const std::vector<Job*>& batch, size_t begin, const std::string& message)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		std::vector<Job*> failed = {};
+		for (size_t i = batch.size(); i-- > begin;)
+		{
+			if (++batch[i]->attempts < MaxAttempts && !stopping)
+				jobs.push_front(batch[i]);
+			else
+				failed.push_back(batch[i]);
+		}
+		queued.notify_all();
+		lock.unlock();
+		for (Job* job : failed)
+			Finish(job, false, message);
+	}
+
+	// Sends one batch and collects its results, every job ends up finished or queued again
+	void Run(Worker& worker, const std::vector<Job*>& batch)
+	{
+		if (!worker.process.IsRunning())
+		{
+			std::string error = "";
+			if (!worker.process.Start(command, error))
+			{
+				for (Job* job : batch)
+					Finish(job, false, "cannot start compiler worker: " + error);
+				return;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			statistics.starts++;
+		}
+		CompilerProtocol::Writer writer;
+		writer.Begin(CompilerProtocol::FrameType::Requests);
+		writer.U32((uint32_t)batch.size());
+		for (const Job* job : batch)
+			CompilerProtocol::WriteRequest(writer, *job->request, job->source);
+		writer.Finish();
+		if (!worker.process.Write(writer.data.data(), writer.data.size()))
+		{
+			// Died while idle, nothing of the batch ran yet
+			worker.process.Kill();
+			Requeue(batch, 0, "compiler worker exited");
+			return;
+		}
+
+		std::vector<uint8_t> payload = {};
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			uint8_t header[CompilerProtocol::HeaderSize];
+			CompilerProtocol::FrameType type = CompilerProtocol::FrameType::Result;
+			uint32_t size = 0;
+			ChildProcess::Status status = worker.process.Read(header, sizeof(header), timeout);
+			if (status == ChildProcess::Status::Ok && (!CompilerProtocol::ParseHeader(header, type, size) || type != CompilerProtocol::FrameType::Result))
+				status = ChildProcess::Status::Closed;
+			if (status == ChildProcess::Status::Ok)
+			{
+				payload.resize(size);
+				status = worker.process.Read(payload.data(), size, timeout);
+			}
+			Result result;
+			if (status == ChildProcess::Status::Ok)
+			{
+				CompilerProtocol::Reader reader(payload.data(), payload.size());
+				if (CompilerProtocol::ReadResult(reader, result) != i || reader.failed)
+					status = ChildProcess::Status::Closed;
+			}
+			if (status != ChildProcess::Status::Ok)
+			{
+				// The job in flight is the one to blame, the ones after it get another worker
+				worker.process.Kill();
+				const bool hung = status == ChildProcess::Status::Timeout;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					(hung ? statistics.timeouts : statistics.crashes)++;
+				}
+				Finish(batch[i], false, hung ? "compiler worker did not answer within " + std::to_string(timeout) + " ms and was killed" : "compiler worker crashed");
+				Requeue(batch, i + 1, "compiler worker crashed");
+				return;
+			}
+			Result& target = *batch[i]->result;
+			target.success = result.success;
+			target.bytecode = std::move(result.bytecode);
+			target.log = std::move(result.log);
+			Finish(batch[i], true, "");
+		}
+	}
+
+	void Serve(Worker& worker)
+	{
+		std::vector<Job*> batch = {};
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				queued.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping)
+					return;
+				batch.push_back(jobs.front());
+				jobs.pop_front();
+				while (batch.size() < maxBatch && batch.front()->source.size() <= smallJob && !jobs.empty() && jobs.front()->source.size() <= smallJob)
+				{
+					batch.push_back(jobs.front());
+					jobs.pop_front();
+				}
+				statistics.batches++;
+				statistics.batchedJobs += batch.size() > 1 ? batch.size() : 0;
+			}
+			Run(worker, batch);
+			batch.clear();
+		}
+	}
+
+protected:
+	void CompileSource(const Request& request, Result& result) override
+	{
+		Job job;
+		job.request = &request;
+		job.result = &result;
+		if (!backend->Preprocess(request, job.source, result.log, result.includes))
+			return;
+		std::unique_lock<std::mutex> lock(mutex);
+		if (stopping)
+		{
+			lock.unlock();
+			Finish(&job, false, "compiler worker pool is shut down");
+			return;
+		}
+		jobs.push_back(&job);
+		statistics.jobs++;
+		queued.notify_one();
+		finished.wait(lock, [&job]() { return job.finished; });
+	}
+
+public:
+	// command starts one worker, e.g. { "Compiler.exe", "--worker" }, backend is the same backend the workers run.
+	// Workers start with their first batch.
+	WorkerPoolBackend(const std::vector<std::string>& command, int count, ShaderCompiler* backend)
+		: command(command), backend(backend), name(std::string("Worker pool (") + backend->GetName() + ")")
+	{
+		for (int i = 0; i < std::max(1, count); i++)
+		{
+			workers.push_back(std::make_unique<Worker>());
+			Worker* worker = workers.back().get();
+			worker->thread = std::thread([this, worker]() { Serve(*worker); });
+		}
+	}
+
+	// Waits for the batches being compiled, queued jobs fail
+	~WorkerPoolBackend()
+	{
+		std::deque<Job*> abandoned = {};
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			abandoned.swap(jobs);
+			queued.notify_all();
+		}
+		for (Job* job : abandoned)
+			Finish(job, false, "compiler worker pool is shut down");
+		for (const auto& worker : workers)
+			worker->thread.join();
+	}
+
+	const char* GetName() const override
+	{
+		return name.c_str();
+	}
+
+	bool ExpandsDefines() const override
+	{
+		return backend->ExpandsDefines();
+	}
+
+	bool Preprocess(const Request& request, std::string& output, std::string& log, std::vector<Include>& includes) override
+	{
+		return backend->Preprocess(request, output, log, includes);
+	}
+
+	Statistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return statistics;
+	}
+};
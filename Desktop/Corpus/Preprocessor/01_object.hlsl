@@ -0,0 +1,6 @@
+#define A 1
+#define B A + A
+#define C (B) * 2
+float x = C;
+#undef A
+float y = B;
@@ -0,0 +1,9 @@
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define SQ(x) ((x) * (x))
+float v = MAX(SQ(2), MAX(3,
+   4));
+float w = MAX((1, 2), 3);
+#define EMPTY()
+int e = EMPTY() 5;
+#define F
+int f F (1);
@@ -0,0 +1,11 @@
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#define CAT(a, b) a ## b
+#define N 42
+const char* s = STR(hello "w\n" world);
+const char* t = XSTR(N);
+int CAT(foo, bar) = CAT(1, 2);
+int CAT(, z) = CAT(q, );
+int CAT(N, 1);
+#define GLUE3(a,b,c) a##b##c
+int GLUE3(x,y,z);
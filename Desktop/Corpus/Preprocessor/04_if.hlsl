@@ -0,0 +1,35 @@
+#define V 3
+#if V > 2 && defined(V) && !defined(W)
+int a;
+#elif V == 3
+int b;
+#else
+int c;
+#endif
+#if (1 << 4) == 16 ? 0x10 % 3 : 0
+int d;
+#endif
+#ifdef W
+int e;
+#elif EXT == 3
+int ext;
+#endif
+#if 0
+#error not here
+#if 1
+int f;
+#else
+int g;
+#endif
+#endif
+#ifndef V
+int h;
+#else
+int i;
+#endif
+#if -1 < 0 && ~0 == -1 && 07 == 7 && 10u == 10
+int j;
+#endif
+#if UNDEFINED_NAME
+int k;
+#endif
@@ -0,0 +1,7 @@
+#include "guard.hlsli"
+#include "guard.hlsli"
+#include <once.hlsli>
+#include "once.hlsli"
+#define HDR "guard.hlsli"
+#include HDR
+float4 main() : SV_Target { return Guarded() + Once(); }
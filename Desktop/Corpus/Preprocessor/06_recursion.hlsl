@@ -0,0 +1,11 @@
+#define foo foo a
+foo
+#define f(x) x g
+#define g f
+f(1)(2)(3)
+#define x 2 * x
+#define y (x + y)
+int z = y;
+#define AA BB
+#define BB AA
+AA BB
@@ -0,0 +1,5 @@
+#define CALL(f, ...) f(__VA_ARGS__)
+int r = CALL(max, 1, 2, (3, 4));
+#define ONLY(...) [__VA_ARGS__]
+int s ONLY();
+int t ONLY(a,b);
@@ -0,0 +1,9 @@
+/* block
+   comment */ int a; // line
+#define LONG 1 + \
+   2 + \
+   3
+int b = LONG;
+int c = /* inline */ 4;
+#define CMT(a) a /* c */ + 1
+int d = CMT(2);
@@ -0,0 +1,11 @@
+#define THREADS 64
+#define REGISTER(t, n) register(t##n)
+Texture2D<float4> tex : REGISTER(t, 0);
+SamplerState samp : REGISTER(s, 1);
+cbuffer Params : REGISTER(b, 0) { float4x4 world; float2 uv; };
+[numthreads(THREADS, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    float4 c = tex.SampleLevel(samp, uv * 0.5f + 1.e-3f, 0);
+    c.xyz *= 2.0h;
+}
@@ -0,0 +1,8 @@
+#define NEG -1
+int a = -NEG;
+#define PLUS +
+int b = 1 PLUS+ 2;
+#define EMPTY
+int c EMPTY = 1;
+#define P(x) x
+int d = P(P(P(3)));
@@ -0,0 +1,11 @@
+// a comment ending in a backslash \
+int hidden;
+int visible;
+#define SPLIT 1 \
++ 2 // trailing comment \
++ 3
+int s = SPLIT;
+/* block \
+   */ int after;
+int last; // \
+int end;
@@ -0,0 +1,29 @@
+#if -1 < 0u
+int wrong_signed_compare;
+#else
+int unsigned_compare;
+#endif
+#if -1 < 0
+int signed_compare;
+#endif
+#if (0u - 1) > 0
+int wraps;
+#endif
+#if -1 >> 63 == -1
+int arithmetic_shift;
+#endif
+#if (-1u >> 63) == 1
+int logical_shift;
+#endif
+#if 0xFFFFFFFFFFFFFFFF > 0
+int large_hex_unsigned;
+#endif
+#if (1 ? -1 : 0u) > 0
+int conditional_converts;
+#endif
+#if -2 / 2u > 1
+int unsigned_division;
+#endif
+#if !0u == 1 && (1 < 2) - 2 < 0
+int logical_signed;
+#endif
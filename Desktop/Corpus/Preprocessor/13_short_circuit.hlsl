@@ -0,0 +1,26 @@
+#if 0 && (1/0)
+int wrong_and;
+#else
+int and_skips_right;
+#endif
+#if (2 || 1/0)
+int or_skips_right;
+#endif
+#if defined(TILE) && (64 % TILE == 0)
+int wrong_tile;
+#else
+int tile_undefined;
+#endif
+#define TILE 16
+#if defined(TILE) && (64 % TILE == 0)
+int tile_divides;
+#endif
+#if 1 ? 2 : 1/0
+int conditional_skips_false;
+#endif
+#if 0 ? 1 % 0 : 3
+int conditional_skips_true;
+#endif
+#if 0 && (1 || 2/0) || 1
+int nested_skip;
+#endif
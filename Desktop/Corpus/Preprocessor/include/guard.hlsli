@@ -0,0 +1,4 @@
+#ifndef GUARD_HLSLI
+#define GUARD_HLSLI
+float Guarded() { return 1; }
+#endif
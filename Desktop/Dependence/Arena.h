@@ -0,0 +1,87 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator. Objects are never destroyed one by one, Reset frees everything at once and keeps the
+// first block for the next round, so only trivially destructible types may live here.
+class Arena
+{
+private:
+	class Block
+	{
+	public:
+		std::unique_ptr<uint8_t[]> data = nullptr;
+		size_t size = 0;
+	};
+
+	std::vector<Block> blocks = {};
+	size_t used = 0;
+	size_t blockSize = 0;
+	size_t allocated = 0;
+
+	void Grow(size_t size)
+	{
+		Block block;
+		block.size = std::max(blockSize, size);
+		block.data = std::make_unique<uint8_t[]>(block.size);
+		blocks.push_back(std::move(block));
+		used = 0;
+	}
+
+public:
+	Arena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+
+	void* Allocate(size_t size, size_t alignment)
+	{
+		if (!blocks.empty())
+		{
+			const uintptr_t base = (uintptr_t)blocks.back().data.get();
+			const size_t offset = ((base + used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+			if (offset + size <= blocks.back().size)
+			{
+				used = offset + size;
+				allocated += size;
+				return blocks.back().data.get() + offset;
+			}
+		}
+		// Fresh blocks come from new[], which is aligned for every fundamental type
+		Grow(size);
+		used = size;
+		allocated += size;
+		return blocks.back().data.get();
+	}
+
+	template <typename T, typename... Args>
+	T* New(Args&&... args)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Arena never runs destructors");
+		return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	void Reset()
+	{
+		if (blocks.size() > 1)
+			blocks.erase(blocks.begin() + 1, blocks.end());
+		used = 0;
+		allocated = 0;
+	}
+
+	// Bytes handed out since the last Reset
+	size_t GetAllocated() const
+	{
+		return allocated;
+	}
+
+	size_t GetReserved() const
+	{
+		size_t reserved = 0;
+		for (const Block& block : blocks)
+			reserved += block.size;
+		return reserved;
+	}
+};
@@ -1,5 +1,15 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <functional>
 
+// Callbacks are published as immutable snapshots.
+// InvokeCallbacks walks the current snapshot without any lock, while AddCallback/RemoveCallback
+// copy it under the writer mutex, publish the copy atomically and retire the old one.
+// A retired snapshot is freed once every reader that could still be walking it has left,
+// which is tracked with two reader slots flipped by an epoch counter.
 template<typename Period, typename ...FuncArg>
 class CallbackManager
 {
@@ -8,44 +18,141 @@ public:
 	{
 	public:
 		using CallbackFunc = std::function<void(FuncArg...)>;
+		size_t id = 0;
 		Period period = Period::None;
 		CallbackFunc callback = CallbackFunc();
 
 		Callback() {}
-		Callback(Period period, CallbackFunc callback)
+		Callback(size_t id, Period period, CallbackFunc callback)
 		{
+			this->id = id;
 			this->period = period;
 			this->callback = callback;
 		}
 	};
+	using Snapshot = std::vector<Callback>;
 
-	std::vector<Callback> callbacks;
+private:
+	class Retired
+	{
+	public:
+		const Snapshot* snapshot = nullptr;
+		uint64_t epoch = 0;
+	};
+
+	class ReaderGuard
+	{
+	private:
+		std::atomic<size_t>& slot;
+	public:
+		ReaderGuard(std::atomic<size_t>& slot) : slot(slot) { slot.fetch_add(1); }
+		~ReaderGuard() { slot.fetch_sub(1); }
+	};
+
+	std::atomic<const Snapshot*> snapshot{ new Snapshot() };
+	std::atomic<uint64_t> epoch{ 1 };
+	std::atomic<size_t> readers[2] = { 0, 0 };
+	std::atomic<size_t> retiredCount{ 0 };
+	std::vector<Retired> retired = {};
+	std::mutex writerMutex = {};
+	size_t nextId = 1;
+
+	// Must be called with writerMutex held
+	void Publish(const Snapshot* next)
+	{
+		retired.push_back({ snapshot.exchange(next), epoch.load() });
+		retiredCount.store(retired.size());
+		Reclaim();
+	}
+
+	// Must be called with writerMutex held.
+	// Readers that entered the slot of the current epoch loaded their snapshot after the epoch was
+	// reached, so once the previous slot is empty every snapshot retired before that point is unreachable.
+	void Reclaim()
+	{
+		const uint64_t current = epoch.load();
+		if (readers[(current - 1) & 1].load() != 0)
+			return;
+		for (auto it = retired.begin(); it != retired.end();)
+		{
+			if (it->epoch < current)
+			{
+				delete it->snapshot;
+				it = retired.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		epoch.store(current + 1);
+		retiredCount.store(retired.size());
+	}
+
+public:
+	CallbackManager() {}
+	CallbackManager(const CallbackManager&) = delete;
+	CallbackManager& operator=(const CallbackManager&) = delete;
+
+	~CallbackManager()
+	{
+		for (auto& entry : retired)
+		{
+			delete entry.snapshot;
+		}
+		delete snapshot.load();
+	}
 
-	void AddCallback(Period period, typename Callback::CallbackFunc callback)
+	size_t AddCallback(Period period, typename Callback::CallbackFunc callback)
 	{
-		callbacks.push_back(Callback(period, callback));
+		std::lock_guard<std::mutex> lock(writerMutex);
+		Snapshot* next = new Snapshot(*snapshot.load());
+		next->push_back(Callback(nextId, period, callback));
+		Publish(next);
+		return nextId++;
 	}
 
-	void RemoveCallback(Period period, typename Callback::CallbackFunc callback)
+	bool RemoveCallback(size_t id)
 	{
-		for (auto it = callbacks.begin(); it != callbacks.end(); ++it)
+		std::lock_guard<std::mutex> lock(writerMutex);
+		const Snapshot* current = snapshot.load();
+		for (size_t i = 0; i < current->size(); i++)
 		{
-			if (it->period == period && it->callback == callback)
+			if ((*current)[i].id == id)
 			{
-				callbacks.erase(it);
-				break;
+				Snapshot* next = new Snapshot(*current);
+				next->erase(next->begin() + i);
+				Publish(next);
+				return true;
 			}
 		}
+		return false;
 	}
 
+	// Wait-free: callbacks added or removed while invoking take effect from the next invocation
 	void InvokeCallbacks(Period period, FuncArg... arg)
 	{
-		for (auto& callback : callbacks)
 		{
-			if (callback.period == period)
+			ReaderGuard guard(readers[epoch.load() & 1]);
+			const Snapshot* callbacks = snapshot.load();
+			for (auto& callback : *callbacks)
 			{
-				callback.callback(arg...);
+				if (callback.period == period)
+				{
+					callback.callback(arg...);
+				}
 			}
 		}
+		if (retiredCount.load(std::memory_order_relaxed) > 0)
+		{
+			std::unique_lock<std::mutex> lock(writerMutex, std::try_to_lock);
+			if (lock.owns_lock())
+				Reclaim();
+		}
+	}
+
+	size_t CallbackCount() const
+	{
+		return snapshot.load()->size();
 	}
 };
\ No newline at end of file
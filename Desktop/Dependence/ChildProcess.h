@@ -0,0 +1,344 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// A child process with its stdin and stdout connected to pipes, stderr is shared with the parent. Reads give up
+// after a timeout, so a hung child can be noticed and killed. One thread at a time may use an instance.
+class ChildProcess
+{
+public:
+	enum class Status
+	{
+		Ok,
+		Timeout,
+		Closed
+	};
+
+private:
+#ifdef _WIN32
+	HANDLE process = nullptr;
+	// Our ends: the child's stdin, and its stdout which is a named pipe so reads can wait with a timeout
+	HANDLE input = nullptr;
+	HANDLE output = nullptr;
+	HANDLE readEvent = nullptr;
+
+	static void Close(HANDLE& handle)
+	{
+		if (handle != nullptr && handle != INVALID_HANDLE_VALUE)
+			CloseHandle(handle);
+		handle = nullptr;
+	}
+
+	static std::string Quote(const std::string& argument)
+	{
+		if (!argument.empty() && argument.find_first_of(" \t\"") == std::string::npos)
+			return argument;
+		std::string quoted = "\"";
+		size_t slashes = 0;
+		for (char c : argument)
+		{
+			if (c == '\\')
+			{
+				slashes++;
+				continue;
+			}
+			quoted.append(c == '"' ? slashes * 2 + 1 : slashes, '\\');
+			quoted += c;
+			slashes = 0;
+		}
+		quoted.append(slashes * 2, '\\');
+		return quoted + "\"";
+	}
+#else
+	pid_t process = -1;
+	int input = -1;
+	int output = -1;
+
+	static void Close(int& descriptor)
+	{
+		if (descriptor >= 0)
+			close(descriptor);
+		descriptor = -1;
+	}
+
+	static bool Pipe(int descriptors[2])
+	{
+		if (pipe(descriptors) != 0)
+			return false;
+		fcntl(descriptors[0], F_SETFD, FD_CLOEXEC);
+		fcntl(descriptors[1], F_SETFD, FD_CLOEXEC);
+		return true;
+	}
+#endif
+
+public:
+	ChildProcess() {}
+	ChildProcess(const ChildProcess&) = delete;
+	ChildProcess& operator=(const ChildProcess&) = delete;
+
+	~ChildProcess()
+	{
+		Kill();
+	}
+
+	// arguments[0] is the executable, looked up in PATH when it has no directory
+	bool Start(const std::vector<std::string>& arguments, std::string& error)
+	{
+		Kill();
+		if (arguments.empty())
+		{
+			error = "No executable given";
+			return false;
+		}
+#ifdef _WIN32
+		// Inheritable handles leak into every process created meanwhile, which would keep our pipes open
+		static std::mutex mutex;
+		static std::atomic<uint32_t> counter{ 0 };
+		std::lock_guard<std::mutex> lock(mutex);
+		SECURITY_ATTRIBUTES inherit = { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+		HANDLE childInput = nullptr, childOutput = nullptr;
+		if (!CreatePipe(&childInput, &input, &inherit, 0))
+		{
+			error = "CreatePipe failed: " + std::to_string(GetLastError());
+			return false;
+		}
+		SetHandleInformation(input, HANDLE_FLAG_INHERIT, 0);
+		const std::string name = "\\\\.\\pipe\\NaShaderCompiler." + std::to_string(GetCurrentProcessId()) + "." + std::to_string(counter++);
+		output = CreateNamedPipeA(name.c_str(), PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+			PIPE_TYPE_BYTE | PIPE_WAIT, 1, 65536, 65536, 0, nullptr);
+		if (output != INVALID_HANDLE_VALUE)
+			childOutput = CreateFileA(name.c_str(), GENERIC_WRITE, 0, &inherit, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (output == INVALID_HANDLE_VALUE || childOutput == INVALID_HANDLE_VALUE)
+		{
+			error = "Cannot create pipe " + name + ": " + std::to_string(GetLastError());
+			Close(childInput);
+			Close(childOutput);
+			Kill();
+			return false;
+		}
+		readEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+		std::string commandLine = "";
+		for (const std::string& argument : arguments)
+			commandLine += (commandLine.empty() ? "" : " ") + Quote(argument);
+		STARTUPINFOA startup = {};
+		startup.cb = sizeof(startup);
+		startup.dwFlags = STARTF_USESTDHANDLES;
+		startup.hStdInput = childInput;
+		startup.hStdOutput = childOutput;
+		startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+		PROCESS_INFORMATION information = {};
+		const BOOL created = CreateProcessA(nullptr, commandLine.data(), nullptr, nullptr, TRUE, CREATE_NO_WINDOW, nullptr, nullptr, &startup, &information);
+		Close(childInput);
+		Close(childOutput);
+		if (!created)
+		{
+			error = "Cannot start " + arguments[0] + ": " + std::to_string(GetLastError());
+			Kill();
+			return false;
+		}
+		CloseHandle(information.hThread);
+		process = information.hProcess;
+		return true;
+#else
+		// A write to a worker that just died must fail with EPIPE instead of ending this process
+		static const bool ignored = signal(SIGPIPE, SIG_IGN) != SIG_ERR;
+		(void)ignored;
+		// Close on exec is set after pipe returns, a fork on another thread in between would hand our ends to its
+		// child and keep them open. Held until the parent has closed the child's ends.
+		static std::mutex mutex;
+		std::unique_lock<std::mutex> lock(mutex);
+		int toChild[2], fromChild[2], status[2];
+		if (!Pipe(toChild))
+		{
+			error = strerror(errno);
+			return false;
+		}
+		if (!Pipe(fromChild))
+		{
+			error = strerror(errno);
+			close(toChild[0]);
+			close(toChild[1]);
+			return false;
+		}
+		// Stays open until exec succeeds, a failed exec writes its errno here
+		if (!Pipe(status))
+		{
+			error = strerror(errno);
+			for (int descriptor : { toChild[0], toChild[1], fromChild[0], fromChild[1] })
+				close(descriptor);
+			return false;
+		}
+		std::vector<char*> argv = {};
+		for (const std::string& argument : arguments)
+			argv.push_back((char*)argument.c_str());
+		argv.push_back(nullptr);
+		process = fork();
+		if (process < 0)
+		{
+			error = strerror(errno);
+			for (int descriptor : { toChild[0], toChild[1], fromChild[0], fromChild[1], status[0], status[1] })
+				close(descriptor);
+			return false;
+		}
+		if (process == 0)
+		{
+			dup2(toChild[0], 0);
+			dup2(fromChild[1], 1);
+			execvp(argv[0], argv.data());
+			const int code = errno;
+			(void)!write(status[1], &code, sizeof(code));
+			_exit(127);
+		}
+		close(toChild[0]);
+		close(fromChild[1]);
+		close(status[1]);
+		lock.unlock();
+		input = toChild[1];
+		output = fromChild[0];
+		int code = 0;
+		ssize_t count = 0;
+		while ((count = read(status[0], &code, sizeof(code))) < 0 && errno == EINTR)
+			;
+		close(status[0]);
+		if (count > 0)
+		{
+			error = "Cannot start " + arguments[0] + ": " + strerror(code);
+			Kill();
+			return false;
+		}
+		return true;
+#endif
+	}
+
+	bool IsRunning()
+	{
+#ifdef _WIN32
+		return process != nullptr && WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+#else
+		if (process > 0 && waitpid(process, nullptr, WNOHANG) != 0)
+			process = -1; // Reaped, the id may be reused from now on
+		return process > 0;
+#endif
+	}
+
+	// Writes everything or fails, the child must be reading
+	bool Write(const void* data, size_t size)
+	{
+		const uint8_t* bytes = (const uint8_t*)data;
+		while (size > 0)
+		{
+#ifdef _WIN32
+			DWORD written = 0;
+			if (input == nullptr || !WriteFile(input, bytes, (DWORD)std::min<size_t>(size, 1 << 30), &written, nullptr))
+				return false;
+#else
+			const ssize_t written = input >= 0 ? write(input, bytes, size) : -1;
+			if (written < 0 && errno == EINTR)
+				continue;
+			if (written <= 0)
+				return false;
+#endif
+			bytes += written;
+			size -= written;
+		}
+		return true;
+	}
+
+	// Reads exactly size bytes, waiting at most timeout milliseconds for all of them
+	Status Read(void* data, size_t size, uint32_t timeout)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+		uint8_t* bytes = (uint8_t*)data;
+		while (size > 0)
+		{
+			const int64_t remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if (remaining < 0)
+				return Status::Timeout;
+#ifdef _WIN32
+			if (output == nullptr)
+				return Status::Closed;
+			OVERLAPPED overlapped = {};
+			overlapped.hEvent = readEvent;
+			ResetEvent(readEvent);
+			DWORD count = 0;
+			if (!ReadFile(output, bytes, (DWORD)std::min<size_t>(size, 1 << 30), nullptr, &overlapped))
+			{
+				if (GetLastError() != ERROR_IO_PENDING)
+					return Status::Closed;
+				if (WaitForSingleObject(readEvent, (DWORD)remaining) != WAIT_OBJECT_0)
+				{
+					// The read still owns the buffer until the cancel completes
+					CancelIoEx(output, &overlapped);
+					GetOverlappedResult(output, &overlapped, &count, TRUE);
+					if (count == 0)
+						return Status::Timeout;
+				}
+			}
+			if (count == 0 && (!GetOverlappedResult(output, &overlapped, &count, TRUE) || count == 0))
+				return Status::Closed;
+#else
+			if (output < 0)
+				return Status::Closed;
+			pollfd descriptor = { output, POLLIN, 0 };
+			const int ready = poll(&descriptor, 1, (int)remaining);
+			if (ready < 0 && errno == EINTR)
+				continue;
+			if (ready < 0)
+				return Status::Closed;
+			if (ready == 0)
+				return Status::Timeout;
+			const ssize_t count = read(output, bytes, size);
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return Status::Closed;
+#endif
+			bytes += count;
+			size -= count;
+		}
+		return Status::Ok;
+	}
+
+	// Terminates the child if it still runs and waits for it, safe to call at any time
+	void Kill()
+	{
+#ifdef _WIN32
+		if (process != nullptr)
+		{
+			TerminateProcess(process, 1);
+			WaitForSingleObject(process, INFINITE);
+		}
+		Close(process);
+		Close(input);
+		Close(output);
+		Close(readEvent);
+#else
+		if (process > 0)
+		{
+			kill(process, SIGKILL);
+			while (waitpid(process, nullptr, 0) < 0 && errno == EINTR)
+				;
+		}
+		process = -1;
+		Close(input);
+		Close(output);
+#endif
+	}
+};
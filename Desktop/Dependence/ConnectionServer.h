@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Accepts connections on a listening Listener from a thread of its own and serves each one on a detached thread,
+// shared by the servers over LocalListener and TcpListener. Stop waits until every connection was served.
+template <typename Listener, typename Connection>
+class ConnectionServer
+{
+public:
+	// Milliseconds between checks for Stop while a connection or the listener is idle
+	static constexpr uint32_t PollInterval = 250;
+
+	Listener listener = Listener();
+
+private:
+	std::function<void(Connection&)> serve = nullptr;
+	std::thread acceptThread = std::thread();
+	std::atomic<bool> stopping{ false };
+	std::mutex mutex;
+	std::condition_variable disconnected;
+	size_t activeConnections = 0;
+	uint64_t connections = 0;
+
+	void Serve(typename Connection::Handle handle)
+	{
+		Connection connection(handle);
+		serve(connection);
+		connection.Close();
+		std::lock_guard<std::mutex> lock(mutex);
+		activeConnections--;
+		disconnected.notify_all();
+	}
+
+	void Accept()
+	{
+		while (!stopping)
+		{
+			const typename Connection::Handle handle = listener.Accept(PollInterval);
+			if (handle == Connection::Invalid)
+				continue;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				activeConnections++;
+				connections++;
+			}
+			std::thread([this, handle]() { Serve(handle); }).detach();
+		}
+		listener.Close();
+	}
+
+public:
+	ConnectionServer() {}
+	ConnectionServer(const ConnectionServer&) = delete;
+	ConnectionServer& operator=(const ConnectionServer&) = delete;
+
+	~ConnectionServer()
+	{
+		Stop();
+	}
+
+	// listener must already listen. serve runs once per connection and should return soon after IsStopping.
+	void Start(std::function<void(Connection&)> serve)
+	{
+		this->serve = serve;
+		stopping = false;
+		acceptThread = std::thread([this]() { Accept(); });
+	}
+
+	bool IsStopping() const
+	{
+		return stopping;
+	}
+
+	void Stop()
+	{
+		stopping = true;
+		if (acceptThread.joinable())
+			acceptThread.join();
+		std::unique_lock<std::mutex> lock(mutex);
+		disconnected.wait(lock, [this]() { return activeConnections == 0; });
+	}
+
+	// Accepted since construction
+	uint64_t GetConnections()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return connections;
+	}
+};
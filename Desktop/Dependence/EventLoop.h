@@ -0,0 +1,356 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <ctime>
+#else
+#include <condition_variable>
+#endif
+
+// The one place the main thread blocks. The wait ends on a window message (Windows), a Wake from
+// any thread, a ready source handle or the nearest timer deadline, whichever comes first.
+// Windows waits on an auto-reset event with MsgWaitForMultipleObjectsEx, Linux on an eventfd with ppoll.
+class EventLoop
+{
+public:
+	using Duration = std::chrono::nanoseconds;
+	using TimePoint = std::chrono::steady_clock::time_point;
+#ifdef _WIN32
+	using NativeHandle = HANDLE;
+#else
+	using NativeHandle = int;
+#endif
+
+	enum class WaitResult
+	{
+		Wake,
+		Message,
+		Source,
+		Timeout,
+		Error
+	};
+
+	class Statistics
+	{
+	public:
+		uint64_t waits = 0;
+		uint64_t wakes = 0;
+		uint64_t messages = 0;
+		uint64_t sources = 0;
+		uint64_t timeouts = 0;
+		uint64_t timersFired = 0;
+		// Time from the first Wake call to the wait returning, in microseconds
+		uint64_t latencySamples = 0;
+		double lastLatency = 0.0;
+		double meanLatency = 0.0;
+		double maxLatency = 0.0;
+	};
+
+private:
+	class Timer
+	{
+	public:
+		size_t id = 0;
+		TimePoint deadline = {};
+		std::function<void()> callback = nullptr;
+	};
+
+	class Source
+	{
+	public:
+		size_t id = 0;
+		NativeHandle handle = {};
+		std::function<void()> callback = nullptr;
+	};
+
+	std::mutex timerMutex = {};
+	std::vector<Timer> timers = {};
+	std::vector<Source> sources = {};
+	size_t nextId = 1;
+	// Steady clock time of the first Wake since the last wait, 0 while nothing is signaled
+	std::atomic<int64_t> signaled{ 0 };
+#ifdef _WIN32
+	HANDLE event = NULL;
+#elif defined(__linux__)
+	int descriptor = -1;
+#else
+	std::mutex wakeMutex = {};
+	std::condition_variable wakeCondition = {};
+	bool woken = false;
+#endif
+
+	static int64_t Now()
+	{
+		return std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void Signal()
+	{
+#ifdef _WIN32
+		SetEvent(event);
+#elif defined(__linux__)
+		uint64_t value = 1;
+		ssize_t written = write(descriptor, &value, sizeof(value));
+		(void)written;
+#else
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			woken = true;
+		}
+		wakeCondition.notify_one();
+#endif
+	}
+
+	// Returns whether a Wake was pending
+	bool Consume()
+	{
+#if !defined(_WIN32) && defined(__linux__)
+		// Drained before signaled is cleared, a Wake landing in between then finds signaled still set and is
+		// consumed below. The other order leaves signaled set over an empty descriptor and every later Wake is lost.
+		uint64_t value = 0;
+		ssize_t drained = read(descriptor, &value, sizeof(value));
+		(void)drained;
+#endif
+		const int64_t signalTime = signaled.exchange(0);
+		if (signalTime == 0)
+			return false;
+		const double latency = (Now() - signalTime) / 1000.0;
+		statistics.wakes++;
+		statistics.latencySamples++;
+		statistics.lastLatency = latency;
+		statistics.meanLatency += (latency - statistics.meanLatency) / statistics.latencySamples;
+		statistics.maxLatency = std::max(statistics.maxLatency, latency);
+		return true;
+	}
+
+	TimePoint NextDeadline(Duration timeout)
+	{
+		TimePoint deadline = timeout == Duration::max() ? TimePoint::max() : std::chrono::steady_clock::now() + timeout;
+		std::lock_guard<std::mutex> lock(timerMutex);
+		for (const Timer& timer : timers)
+			deadline = std::min(deadline, timer.deadline);
+		return deadline;
+	}
+
+public:
+	// Also return when the calling thread receives window messages (Windows only)
+	bool waitMessages = true;
+	Statistics statistics = Statistics();
+
+	EventLoop()
+	{
+#ifdef _WIN32
+		event = CreateEvent(NULL, FALSE, FALSE, NULL);
+#elif defined(__linux__)
+		descriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+	}
+
+	~EventLoop()
+	{
+#ifdef _WIN32
+		if (event != NULL)
+			CloseHandle(event);
+#elif defined(__linux__)
+		if (descriptor >= 0)
+			close(descriptor);
+#endif
+	}
+
+	EventLoop(const EventLoop&) = delete;
+	EventLoop& operator=(const EventLoop&) = delete;
+
+	// Thread safe, only the first Wake before the loop resumes touches the kernel object
+	void Wake()
+	{
+		int64_t expected = 0;
+		if (signaled.compare_exchange_strong(expected, Now()))
+			Signal();
+	}
+
+	// Runs callback on the loop thread from RunDueTimers once delay has passed, thread safe
+	size_t AddTimer(Duration delay, std::function<void()> callback)
+	{
+		size_t id = 0;
+		{
+			std::lock_guard<std::mutex> lock(timerMutex);
+			id = nextId++;
+			timers.push_back({ id, std::chrono::steady_clock::now() + delay, callback });
+		}
+		// The loop may be sleeping past the new deadline
+		Signal();
+		return id;
+	}
+
+	bool CancelTimer(size_t id)
+	{
+		std::lock_guard<std::mutex> lock(timerMutex);
+		auto it = std::find_if(timers.begin(), timers.end(), [id](const Timer& timer) { return timer.id == id; });
+		if (it == timers.end())
+			return false;
+		timers.erase(it);
+		return true;
+	}
+
+	// Runs callback on the loop thread whenever handle becomes signaled (a waitable HANDLE on Windows,
+	// a readable descriptor elsewhere). Only call from the loop thread.
+	size_t AddSource(NativeHandle handle, std::function<void()> callback)
+	{
+		std::lock_guard<std::mutex> lock(timerMutex);
+		const size_t id = nextId++;
+		sources.push_back({ id, handle, callback });
+		return id;
+	}
+
+	bool RemoveSource(size_t id)
+	{
+		std::lock_guard<std::mutex> lock(timerMutex);
+		auto it = std::find_if(sources.begin(), sources.end(), [id](const Source& source) { return source.id == id; });
+		if (it == sources.end())
+			return false;
+		sources.erase(it);
+		return true;
+	}
+
+	// Fires the expired timers, returns how many ran
+	size_t RunDueTimers()
+	{
+		std::vector<Timer> due = {};
+		{
+			std::lock_guard<std::mutex> lock(timerMutex);
+			if (timers.empty())
+				return 0;
+			const TimePoint now = std::chrono::steady_clock::now();
+			auto it = std::stable_partition(timers.begin(), timers.end(), [now](const Timer& timer) { return timer.deadline > now; });
+			due.assign(std::make_move_iterator(it), std::make_move_iterator(timers.end()));
+			timers.erase(it, timers.end());
+		}
+		for (Timer& timer : due)
+			timer.callback();
+		statistics.timersFired += due.size();
+		return due.size();
+	}
+
+	// Blocks until woken, a message or source arrives, a timer is due or timeout elapsed
+	WaitResult Wait(Duration timeout)
+	{
+		statistics.waits++;
+		const TimePoint deadline = NextDeadline(timeout);
+		std::vector<Source> ready = {};
+		{
+			std::lock_guard<std::mutex> lock(timerMutex);
+			ready = sources;
+		}
+		WaitResult result = WaitResult::Timeout;
+#ifdef _WIN32
+		DWORD milliseconds = INFINITE;
+		if (deadline != TimePoint::max())
+		{
+			const TimePoint now = std::chrono::steady_clock::now();
+			milliseconds = deadline > now ? (DWORD)std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count() : 0;
+		}
+		std::vector<HANDLE> handles = { event };
+		for (const Source& source : ready)
+			handles.push_back(source.handle);
+		const DWORD count = (DWORD)handles.size();
+		const DWORD signal = waitMessages ?
+			MsgWaitForMultipleObjectsEx(count, handles.data(), milliseconds, QS_ALLINPUT, MWMO_INPUTAVAILABLE) :
+			WaitForMultipleObjectsEx(count, handles.data(), FALSE, milliseconds, FALSE);
+		if (signal == WAIT_OBJECT_0)
+		{
+			result = WaitResult::Wake;
+		}
+		else if (signal > WAIT_OBJECT_0 && signal < WAIT_OBJECT_0 + count)
+		{
+			result = WaitResult::Source;
+			ready[signal - WAIT_OBJECT_0 - 1].callback();
+		}
+		else if (signal == WAIT_OBJECT_0 + count)
+		{
+			result = WaitResult::Message;
+		}
+		else if (signal != WAIT_TIMEOUT)
+		{
+			result = WaitResult::Error;
+		}
+#elif defined(__linux__)
+		std::vector<pollfd> descriptors = { { descriptor, POLLIN, 0 } };
+		for (const Source& source : ready)
+			descriptors.push_back({ source.handle, POLLIN, 0 });
+		timespec time = {};
+		timespec* timeoutPointer = nullptr;
+		if (deadline != TimePoint::max())
+		{
+			const TimePoint now = std::chrono::steady_clock::now();
+			const int64_t nanoseconds = deadline > now ? std::chrono::duration_cast<Duration>(deadline - now).count() : 0;
+			time.tv_sec = nanoseconds / 1000000000;
+			time.tv_nsec = nanoseconds % 1000000000;
+			timeoutPointer = &time;
+		}
+		const int count = ppoll(descriptors.data(), descriptors.size(), timeoutPointer, nullptr);
+		if (count < 0)
+		{
+			result = WaitResult::Error;
+		}
+		else if (count > 0)
+		{
+			if (descriptors[0].revents & POLLIN)
+				result = WaitResult::Wake;
+			for (size_t i = 1; i < descriptors.size(); i++)
+			{
+				if (descriptors[i].revents == 0)
+					continue;
+				if (result != WaitResult::Wake)
+					result = WaitResult::Source;
+				ready[i - 1].callback();
+			}
+		}
+#else
+		{
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			if (deadline == TimePoint::max())
+				wakeCondition.wait(lock, [this]() { return woken; });
+			else
+				wakeCondition.wait_until(lock, deadline, [this]() { return woken; });
+			if (woken)
+				result = WaitResult::Wake;
+			woken = false;
+		}
+#endif
+		// AddTimer signals without a Wake, the loop only has to recompute its deadline
+		if (Consume())
+		{
+			if (result == WaitResult::Timeout)
+				result = WaitResult::Wake;
+		}
+		else if (result == WaitResult::Wake)
+		{
+			result = WaitResult::Timeout;
+		}
+		switch (result)
+		{
+		case WaitResult::Message:
+			statistics.messages++;
+			break;
+		case WaitResult::Source:
+			statistics.sources++;
+			break;
+		case WaitResult::Timeout:
+			statistics.timeouts++;
+			break;
+		default:
+			break;
+		}
+		return result;
+	}
+};
\ No newline at end of file
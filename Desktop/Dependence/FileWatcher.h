@@ -0,0 +1,426 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "EventLoop.h"
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// Reports which watched files were touched. Native backends watch the parent directories, so thousands of
+// files spread over a few directories cost a few kernel watches. Reports are hints, the same save may be
+// reported several times and callers are expected to compare contents.
+class FileWatcher
+{
+protected:
+	// Directory -> watched file names in it
+	std::unordered_map<std::string, std::unordered_set<std::string>> directories = {};
+
+	virtual bool AddWatch(const std::string& directory) = 0;
+	virtual void RemoveWatch(const std::string& directory) = 0;
+
+	// Every watched file in directory, used when the backend lost events
+	void ReportAll(const std::string& directory, std::vector<std::filesystem::path>& changed) const
+	{
+		auto it = directories.find(directory);
+		if (it == directories.end())
+			return;
+		for (const std::string& name : it->second)
+			changed.push_back(std::filesystem::path(directory) / name);
+	}
+
+	void Report(const std::string& directory, const std::string& name, std::vector<std::filesystem::path>& changed) const
+	{
+		auto it = directories.find(directory);
+		if (it != directories.end() && it->second.count(name) > 0)
+			changed.push_back(std::filesystem::path(directory) / name);
+	}
+
+public:
+	virtual ~FileWatcher() {}
+
+	virtual const char* GetName() const = 0;
+
+	static std::filesystem::path Normalize(const std::filesystem::path& file)
+	{
+		std::error_code error;
+		std::filesystem::path full = std::filesystem::absolute(file, error);
+		return (error ? file : full).lexically_normal();
+	}
+
+	// Watching a file twice is harmless, one Unwatch removes it
+	virtual bool Watch(const std::filesystem::path& file)
+	{
+		const std::filesystem::path full = Normalize(file);
+		const std::string directory = full.parent_path().string();
+		auto it = directories.find(directory);
+		if (it == directories.end())
+		{
+			if (!AddWatch(directory))
+				return false;
+			it = directories.emplace(directory, std::unordered_set<std::string>()).first;
+		}
+		it->second.insert(full.filename().string());
+		return true;
+	}
+
+	virtual void Unwatch(const std::filesystem::path& file)
+	{
+		const std::filesystem::path full = Normalize(file);
+		const std::string directory = full.parent_path().string();
+		auto it = directories.find(directory);
+		if (it == directories.end())
+			return;
+		it->second.erase(full.filename().string());
+		if (it->second.empty())
+		{
+			RemoveWatch(directory);
+			directories.erase(it);
+		}
+	}
+
+	// A handle for EventLoop::AddSource that is signaled when Poll has something to report.
+	// Backends without one return false and are polled on a timer.
+	virtual bool GetHandle(EventLoop::NativeHandle&) const
+	{
+		return false;
+	}
+
+	// Appends the watched files touched since the last call, never blocks
+	virtual void Poll(std::vector<std::filesystem::path>& changed) = 0;
+};
+
+// Compares modification time and size, checking at most filesPerPoll files per call so a large set is spread
+// over several polls instead of stalling one
+class PollingFileWatcher : public FileWatcher
+{
+private:
+	class Entry
+	{
+	public:
+		std::filesystem::path path = "";
+		std::filesystem::file_time_type time = {};
+		uintmax_t size = 0;
+	};
+
+	std::vector<Entry> entries = {};
+	// Path -> position in entries
+	std::unordered_map<std::string, size_t> indices = {};
+	size_t cursor = 0;
+
+	static void Stat(Entry& entry)
+	{
+		std::error_code error;
+		entry.time = std::filesystem::last_write_time(entry.path, error);
+		entry.size = error ? 0 : std::filesystem::file_size(entry.path, error);
+	}
+
+protected:
+	bool AddWatch(const std::string&) override
+	{
+		return true;
+	}
+
+	void RemoveWatch(const std::string&) override {}
+
+public:
+	size_t filesPerPoll = 256;
+
+	const char* GetName() const override
+	{
+		return "Polling";
+	}
+
+	bool Watch(const std::filesystem::path& file) override
+	{
+		Entry entry;
+		entry.path = Normalize(file);
+		if (indices.count(entry.path.string()) > 0)
+			return true;
+		Stat(entry);
+		indices[entry.path.string()] = entries.size();
+		entries.push_back(entry);
+		return FileWatcher::Watch(entry.path);
+	}
+
+	void Unwatch(const std::filesystem::path& file) override
+	{
+		const std::filesystem::path full = Normalize(file);
+		auto it = indices.find(full.string());
+		if (it == indices.end())
+			return;
+		const size_t index = it->second;
+		indices.erase(it);
+		if (index + 1 < entries.size())
+		{
+			entries[index] = entries.back();
+			indices[entries[index].path.string()] = index;
+		}
+		entries.pop_back();
+		FileWatcher::Unwatch(full);
+	}
+
+	void Poll(std::vector<std::filesystem::path>& changed) override
+	{
+		const size_t count = std::min(filesPerPoll, entries.size());
+		for (size_t i = 0; i < count; i++)
+		{
+			if (cursor >= entries.size())
+				cursor = 0;
+			Entry& entry = entries[cursor++];
+			const std::filesystem::file_time_type time = entry.time;
+			const uintmax_t size = entry.size;
+			Stat(entry);
+			if (entry.time != time || entry.size != size)
+				changed.push_back(entry.path);
+		}
+	}
+};
+
+#ifdef _WIN32
+// One overlapped ReadDirectoryChangesW per directory, all completing into the same manual-reset event
+class Win32FileWatcher : public FileWatcher
+{
+private:
+	class Directory
+	{
+	public:
+		std::string path = "";
+		HANDLE handle = INVALID_HANDLE_VALUE;
+		OVERLAPPED overlapped = {};
+		alignas(DWORD) BYTE buffer[16384] = {};
+	};
+
+	HANDLE event = NULL;
+	std::unordered_map<std::string, std::unique_ptr<Directory>> watches = {};
+
+	bool Issue(Directory& directory)
+	{
+		directory.overlapped = {};
+		directory.overlapped.hEvent = event;
+		return ReadDirectoryChangesW(directory.handle, directory.buffer, sizeof(directory.buffer), FALSE,
+			FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE, NULL, &directory.overlapped, NULL) != FALSE;
+	}
+
+	static void Close(Directory& directory)
+	{
+		CancelIoEx(directory.handle, &directory.overlapped);
+		DWORD bytes = 0;
+		GetOverlappedResult(directory.handle, &directory.overlapped, &bytes, TRUE);
+		CloseHandle(directory.handle);
+	}
+
+protected:
+	bool AddWatch(const std::string& path) override
+	{
+		if (event == NULL)
+			return false;
+		std::unique_ptr<Directory> directory = std::make_unique<Directory>();
+		directory->path = path;
+		directory->handle = CreateFileW(std::filesystem::path(path).wstring().c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+		if (directory->handle == INVALID_HANDLE_VALUE)
+			return false;
+		if (!Issue(*directory))
+		{
+			CloseHandle(directory->handle);
+			return false;
+		}
+		watches[path] = std::move(directory);
+		return true;
+	}
+
+	void RemoveWatch(const std::string& path) override
+	{
+		auto it = watches.find(path);
+		if (it == watches.end())
+			return;
+		Close(*it->second);
+		watches.erase(it);
+	}
+
+public:
+	Win32FileWatcher()
+	{
+		event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	}
+
+	~Win32FileWatcher()
+	{
+		for (auto& watch : watches)
+			Close(*watch.second);
+		if (event != NULL)
+			CloseHandle(event);
+	}
+
+	Win32FileWatcher(const Win32FileWatcher&) = delete;
+	Win32FileWatcher& operator=(const Win32FileWatcher&) = delete;
+
+	bool IsValid() const
+	{
+		return event != NULL;
+	}
+
+	const char* GetName() const override
+	{
+		return "ReadDirectoryChangesW";
+	}
+
+	bool GetHandle(EventLoop::NativeHandle& handle) const override
+	{
+		handle = event;
+		return event != NULL;
+	}
+
+	void Poll(std::vector<std::filesystem::path>& changed) override
+	{
+		// Reset first, a completion after this point signals again
+		ResetEvent(event);
+		for (auto& watch : watches)
+		{
+			Directory& directory = *watch.second;
+			DWORD bytes = 0;
+			if (!GetOverlappedResult(directory.handle, &directory.overlapped, &bytes, FALSE))
+			{
+				if (GetLastError() != ERROR_IO_INCOMPLETE)
+					Issue(directory);
+				continue;
+			}
+			// Zero bytes means the buffer overflowed and the changes are unknown
+			if (bytes == 0)
+			{
+				ReportAll(directory.path, changed);
+			}
+			else
+			{
+				const BYTE* position = directory.buffer;
+				while (true)
+				{
+					const FILE_NOTIFY_INFORMATION* information = (const FILE_NOTIFY_INFORMATION*)position;
+					const std::wstring name(information->FileName, information->FileNameLength / sizeof(WCHAR));
+					Report(directory.path, std::filesystem::path(name).string(), changed);
+					if (information->NextEntryOffset == 0)
+						break;
+					position += information->NextEntryOffset;
+				}
+			}
+			Issue(directory);
+		}
+	}
+};
+#elif defined(__linux__)
+// One inotify descriptor, one watch per directory
+class InotifyFileWatcher : public FileWatcher
+{
+private:
+	int descriptor = -1;
+	std::unordered_map<int, std::string> watches = {};
+	std::unordered_map<std::string, int> watchIds = {};
+
+protected:
+	bool AddWatch(const std::string& directory) override
+	{
+		if (descriptor < 0)
+			return false;
+		// Editors either rewrite in place or write a temporary and rename it over the original
+		const int id = inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE);
+		if (id < 0)
+			return false;
+		watches[id] = directory;
+		watchIds[directory] = id;
+		return true;
+	}
+
+	void RemoveWatch(const std::string& directory) override
+	{
+		auto it = watchIds.find(directory);
+		if (it == watchIds.end())
+			return;
+		inotify_rm_watch(descriptor, it->second);
+		watches.erase(it->second);
+		watchIds.erase(it);
+	}
+
+public:
+	InotifyFileWatcher()
+	{
+		descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	}
+
+	~InotifyFileWatcher()
+	{
+		if (descriptor >= 0)
+			close(descriptor);
+	}
+
+	InotifyFileWatcher(const InotifyFileWatcher&) = delete;
+	InotifyFileWatcher& operator=(const InotifyFileWatcher&) = delete;
+
+	bool IsValid() const
+	{
+		return descriptor >= 0;
+	}
+
+	const char* GetName() const override
+	{
+		return "inotify";
+	}
+
+	bool GetHandle(EventLoop::NativeHandle& handle) const override
+	{
+		handle = descriptor;
+		return descriptor >= 0;
+	}
+
+	void Poll(std::vector<std::filesystem::path>& changed) override
+	{
+		alignas(inotify_event) char buffer[16384];
+		while (true)
+		{
+			const ssize_t size = read(descriptor, buffer, sizeof(buffer));
+			if (size <= 0)
+				break;
+			for (ssize_t position = 0; position < size;)
+			{
+				const inotify_event* event = (const inotify_event*)(buffer + position);
+				position += sizeof(inotify_event) + event->len;
+				if (event->mask & IN_Q_OVERFLOW)
+				{
+					for (const auto& directory : directories)
+						ReportAll(directory.first, changed);
+					continue;
+				}
+				auto it = watches.find(event->wd);
+				if (it != watches.end() && event->len > 0)
+					Report(it->second, event->name, changed);
+			}
+		}
+	}
+};
+#endif
+
+// The native backend of this platform, the polling one when it is unavailable
+inline std::unique_ptr<FileWatcher> CreateFileWatcher()
+{
+#ifdef _WIN32
+	std::unique_ptr<Win32FileWatcher> watcher = std::make_unique<Win32FileWatcher>();
+	if (watcher->IsValid())
+		return watcher;
+#elif defined(__linux__)
+	std::unique_ptr<InotifyFileWatcher> watcher = std::make_unique<InotifyFileWatcher>();
+	if (watcher->IsValid())
+		return watcher;
+#endif
+	return std::make_unique<PollingFileWatcher>();
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include "TcpSocket.h"
+
+// Just enough HTTP/1.1 for the remote shader cache: bodies sized by Content-Length on persistent connections,
+// no chunked transfer and no continuation lines. Header names are compared in lower case.
+class Http
+{
+public:
+	static constexpr size_t MaxHeadSize = 64 * 1024;
+	static constexpr size_t MaxBodySize = 256 << 20;
+
+	class Message
+	{
+	public:
+		// Requests only
+		std::string method = "";
+		std::string path = "";
+		// Responses only
+		int status = 0;
+		std::string reason = "";
+		std::unordered_map<std::string, std::string> headers = {};
+		std::string body = "";
+
+		std::string Header(const std::string& name) const
+		{
+			auto it = headers.find(name);
+			return it != headers.end() ? it->second : "";
+		}
+	};
+
+	static std::string Format(const Message& message, bool request)
+	{
+		std::string text = request ? message.method + " " + message.path + " HTTP/1.1\r\n"
+			: "HTTP/1.1 " + std::to_string(message.status) + " " + message.reason + "\r\n";
+		for (const auto& [name, value] : message.headers)
+		{
+			if (name != "content-length")
+				text += name + ": " + value + "\r\n";
+		}
+		text += "content-length: " + std::to_string(message.body.size()) + "\r\n\r\n";
+		return text + message.body;
+	}
+
+	static bool Write(TcpConnection& connection, const Message& message, bool request)
+	{
+		const std::string text = Format(message, request);
+		return connection.Write(text.data(), text.size());
+	}
+
+	// buffer keeps bytes read past the message for the next call on the same connection. The message stays in
+	// buffer until it arrived whole, so a call that times out partway can be repeated. Closed also covers
+	// malformed messages, the connection is unusable after either.
+	static TcpConnection::Status Read(TcpConnection& connection, std::string& buffer, Message& message, bool request, uint32_t timeout)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+		auto Fill = [&]() {
+			const int64_t remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if (remaining < 0)
+				return TcpConnection::Status::Timeout;
+			char chunk[16 * 1024];
+			size_t received = 0;
+			const TcpConnection::Status status = connection.ReadSome(chunk, sizeof(chunk), received, (uint32_t)remaining);
+			buffer.append(chunk, received);
+			return status;
+			};
+		size_t headEnd = 0;
+		while ((headEnd = buffer.find("\r\n\r\n")) == std::string::npos)
+		{
+			if (buffer.size() > MaxHeadSize)
+				return TcpConnection::Status::Closed;
+			const TcpConnection::Status status = Fill();
+			if (status != TcpConnection::Status::Ok)
+				return status;
+		}
+
+		message = Message();
+		size_t lineEnd = buffer.find("\r\n");
+		const std::string first = buffer.substr(0, lineEnd);
+		const size_t space = first.find(' ');
+		const size_t second = first.find(' ', space + 1);
+		if (space == std::string::npos)
+			return TcpConnection::Status::Closed;
+		if (request)
+		{
+			message.method = first.substr(0, space);
+			message.path = first.substr(space + 1, second == std::string::npos ? std::string::npos : second - space - 1);
+		}
+		else
+		{
+			message.status = atoi(first.c_str() + space + 1);
+			message.reason = second == std::string::npos ? "" : first.substr(second + 1);
+		}
+		for (size_t begin = lineEnd + 2; begin < headEnd; begin = lineEnd + 2)
+		{
+			lineEnd = buffer.find("\r\n", begin);
+			const std::string line = buffer.substr(begin, lineEnd - begin);
+			const size_t colon = line.find(':');
+			if (colon == std::string::npos)
+				return TcpConnection::Status::Closed;
+			std::string name = line.substr(0, colon);
+			std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+			const size_t value = line.find_first_not_of(' ', colon + 1);
+			message.headers[name] = value == std::string::npos ? "" : line.substr(value);
+		}
+
+		const size_t bodySize = (size_t)strtoull(message.Header("content-length").c_str(), nullptr, 10);
+		if (bodySize > MaxBodySize)
+			return TcpConnection::Status::Closed;
+		const size_t bodyBegin = headEnd + 4;
+		while (buffer.size() < bodyBegin + bodySize)
+		{
+			const TcpConnection::Status status = Fill();
+			if (status != TcpConnection::Status::Ok)
+				return status;
+		}
+		message.body = buffer.substr(bodyBegin, bodySize);
+		buffer.erase(0, bodyBegin + bodySize);
+		return TcpConnection::Status::Ok;
+	}
+};
@@ -0,0 +1,370 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Stream connections between processes on one machine, addressed by a name: a Unix domain socket in
+// $XDG_RUNTIME_DIR (or /tmp) on POSIX, \\.\pipe\<name> on Windows. A name containing a slash is used as
+// the socket path as is.
+class LocalConnection
+{
+public:
+	enum class Status
+	{
+		Ok,
+		Timeout,
+		Closed
+	};
+
+#ifdef _WIN32
+	using Handle = HANDLE;
+	static constexpr Handle Invalid = nullptr;
+#else
+	using Handle = int;
+	static constexpr Handle Invalid = -1;
+#endif
+
+private:
+	Handle handle = Invalid;
+#ifdef _WIN32
+	HANDLE event = nullptr;
+
+	// Waits for an overlapped read or write, cancelling it on timeout, false once the pipe is gone
+	Status Finish(BOOL started, OVERLAPPED& overlapped, DWORD& count, int64_t timeout)
+	{
+		if (!started && GetLastError() != ERROR_IO_PENDING)
+			return Status::Closed;
+		if (!started && WaitForSingleObject(event, timeout < 0 ? INFINITE : (DWORD)timeout) != WAIT_OBJECT_0)
+		{
+			CancelIoEx(handle, &overlapped);
+			GetOverlappedResult(handle, &overlapped, &count, TRUE);
+			return count > 0 ? Status::Ok : Status::Timeout;
+		}
+		return GetOverlappedResult(handle, &overlapped, &count, TRUE) && count > 0 ? Status::Ok : Status::Closed;
+	}
+#endif
+
+public:
+	LocalConnection() {}
+	LocalConnection(Handle handle) : handle(handle)
+	{
+#ifdef _WIN32
+		event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+#endif
+	}
+	LocalConnection(const LocalConnection&) = delete;
+	LocalConnection& operator=(const LocalConnection&) = delete;
+
+	~LocalConnection()
+	{
+		Close();
+	}
+
+#ifndef _WIN32
+	// Not inherited by child processes, a worker holding a copy would keep the socket open
+	static int Socket()
+	{
+		const int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (descriptor >= 0)
+			fcntl(descriptor, F_SETFD, FD_CLOEXEC);
+		return descriptor;
+	}
+#endif
+
+	static std::string PathFor(const std::string& name)
+	{
+#ifdef _WIN32
+		return "\\\\.\\pipe\\" + name;
+#else
+		if (name.find('/') != std::string::npos)
+			return name;
+		const char* directory = getenv("XDG_RUNTIME_DIR");
+		return std::string(directory != nullptr && directory[0] != 0 ? directory : "/tmp") + "/" + name + ".sock";
+#endif
+	}
+
+	bool Connect(const std::string& name, uint32_t timeout, std::string& error)
+	{
+		Close();
+		const std::string path = PathFor(name);
+#ifdef _WIN32
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+		while (true)
+		{
+			handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+			if (handle != INVALID_HANDLE_VALUE)
+				break;
+			handle = nullptr;
+			const int64_t remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			// Every instance is busy until the server creates the next one
+			if (GetLastError() != ERROR_PIPE_BUSY || remaining <= 0 || !WaitNamedPipeA(path.c_str(), (DWORD)remaining))
+			{
+				error = "Cannot connect to " + path + ": " + std::to_string(GetLastError());
+				return false;
+			}
+		}
+		event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+		return true;
+#else
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path))
+		{
+			error = "Socket path too long: " + path;
+			return false;
+		}
+		memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		handle = Socket();
+		// A local connect either succeeds or fails at once, timeout only bounds later reads
+		(void)timeout;
+		if (handle < 0 || connect(handle, (sockaddr*)&address, sizeof(address)) != 0)
+		{
+			error = "Cannot connect to " + path + ": " + strerror(errno);
+			Close();
+			return false;
+		}
+		return true;
+#endif
+	}
+
+	bool IsOpen() const
+	{
+		return handle != Invalid;
+	}
+
+	bool Write(const void* data, size_t size)
+	{
+		const uint8_t* bytes = (const uint8_t*)data;
+		while (size > 0 && handle != Invalid)
+		{
+#ifdef _WIN32
+			OVERLAPPED overlapped = {};
+			overlapped.hEvent = event;
+			ResetEvent(event);
+			DWORD count = 0;
+			const BOOL started = WriteFile(handle, bytes, (DWORD)std::min<size_t>(size, 1 << 30), nullptr, &overlapped);
+			if (Finish(started, overlapped, count, -1) != Status::Ok)
+				return false;
+#else
+#ifdef MSG_NOSIGNAL
+			const ssize_t count = send(handle, bytes, size, MSG_NOSIGNAL);
+#else
+			static const bool ignored = signal(SIGPIPE, SIG_IGN) != SIG_ERR;
+			(void)ignored;
+			const ssize_t count = send(handle, bytes, size, 0);
+#endif
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return false;
+#endif
+			bytes += count;
+			size -= count;
+		}
+		return size == 0;
+	}
+
+	// Reads exactly size bytes within timeout milliseconds
+	Status Read(void* data, size_t size, uint32_t timeout)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+		uint8_t* bytes = (uint8_t*)data;
+		while (size > 0)
+		{
+			if (handle == Invalid)
+				return Status::Closed;
+			const int64_t remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if (remaining < 0)
+				return Status::Timeout;
+#ifdef _WIN32
+			OVERLAPPED overlapped = {};
+			overlapped.hEvent = event;
+			ResetEvent(event);
+			DWORD count = 0;
+			const BOOL started = ReadFile(handle, bytes, (DWORD)std::min<size_t>(size, 1 << 30), nullptr, &overlapped);
+			const Status status = Finish(started, overlapped, count, remaining);
+			if (status != Status::Ok)
+				return status;
+#else
+			pollfd descriptor = { handle, POLLIN, 0 };
+			const int ready = poll(&descriptor, 1, (int)remaining);
+			if (ready < 0 && errno == EINTR)
+				continue;
+			if (ready < 0)
+				return Status::Closed;
+			if (ready == 0)
+				return Status::Timeout;
+			const ssize_t count = recv(handle, bytes, size, 0);
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return Status::Closed;
+#endif
+			bytes += count;
+			size -= count;
+		}
+		return Status::Ok;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (handle != nullptr)
+			CloseHandle(handle);
+		if (event != nullptr)
+			CloseHandle(event);
+		event = nullptr;
+#else
+		if (handle >= 0)
+			close(handle);
+#endif
+		handle = Invalid;
+	}
+};
+
+// Accepts LocalConnections under a name, only one listener per name may exist at a time
+class LocalListener
+{
+private:
+	std::string path = "";
+#ifdef _WIN32
+	// The next instance, created ahead so a client can always find one
+	HANDLE pending = nullptr;
+	HANDLE event = nullptr;
+
+	HANDLE CreateInstance(bool first)
+	{
+		const HANDLE pipe = CreateNamedPipeA(path.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+			PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES, 65536, 65536, 0, nullptr);
+		return pipe == INVALID_HANDLE_VALUE ? nullptr : pipe;
+	}
+#else
+	int handle = -1;
+#endif
+
+public:
+	LocalListener() {}
+	LocalListener(const LocalListener&) = delete;
+	LocalListener& operator=(const LocalListener&) = delete;
+
+	~LocalListener()
+	{
+		Close();
+	}
+
+	bool Listen(const std::string& name, std::string& error)
+	{
+		Close();
+		path = LocalConnection::PathFor(name);
+#ifdef _WIN32
+		pending = CreateInstance(true);
+		if (pending == nullptr)
+		{
+			error = "Cannot listen on " + path + ": " + std::to_string(GetLastError());
+			return false;
+		}
+		event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+		return true;
+#else
+		// A socket file nobody answers on is left over from a server that died
+		LocalConnection probe;
+		std::string ignored = "";
+		if (probe.Connect(name, 0, ignored))
+		{
+			error = "Another server is already listening on " + path;
+			return false;
+		}
+		unlink(path.c_str());
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path))
+		{
+			error = "Socket path too long: " + path;
+			return false;
+		}
+		memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		handle = LocalConnection::Socket();
+		if (handle < 0 || bind(handle, (sockaddr*)&address, sizeof(address)) != 0 || listen(handle, 64) != 0)
+		{
+			error = "Cannot listen on " + path + ": " + strerror(errno);
+			Close();
+			return false;
+		}
+		return true;
+#endif
+	}
+
+	// Waits up to timeout milliseconds for a client, Invalid when none came
+	LocalConnection::Handle Accept(uint32_t timeout)
+	{
+#ifdef _WIN32
+		if (pending == nullptr)
+			return nullptr;
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent = event;
+		ResetEvent(event);
+		bool connected = ConnectNamedPipe(pending, &overlapped) != 0 || GetLastError() == ERROR_PIPE_CONNECTED;
+		if (!connected && GetLastError() == ERROR_IO_PENDING)
+		{
+			DWORD ignored = 0;
+			if (WaitForSingleObject(event, timeout) == WAIT_OBJECT_0)
+			{
+				connected = GetOverlappedResult(pending, &overlapped, &ignored, FALSE) != 0;
+			}
+			else
+			{
+				CancelIoEx(pending, &overlapped);
+				connected = GetOverlappedResult(pending, &overlapped, &ignored, TRUE) != 0;
+			}
+		}
+		if (!connected)
+			return nullptr;
+		const HANDLE client = pending;
+		pending = CreateInstance(false);
+		return client;
+#else
+		if (handle < 0)
+			return -1;
+		pollfd descriptor = { handle, POLLIN, 0 };
+		if (poll(&descriptor, 1, (int)timeout) <= 0)
+			return -1;
+		const int client = accept(handle, nullptr, nullptr);
+		if (client >= 0)
+			fcntl(client, F_SETFD, FD_CLOEXEC);
+		return client;
+#endif
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (pending != nullptr)
+			CloseHandle(pending);
+		if (event != nullptr)
+			CloseHandle(event);
+		pending = nullptr;
+		event = nullptr;
+#else
+		if (handle >= 0)
+		{
+			close(handle);
+			unlink(path.c_str());
+		}
+		handle = -1;
+#endif
+	}
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Byte-oriented LZ77 in the LZ4 block layout: a token of literal and match length nibbles, extra length bytes of
+// 255 when a nibble is 15, the literals, then a two byte offset. The last sequence carries literals only.
+// Fast enough to run on every cache transfer, and bytecode with its repeated opcodes shrinks by half or more.
+class Lz
+{
+private:
+	static constexpr size_t MinMatch = 4;
+	static constexpr size_t MaxOffset = 65535;
+	static constexpr int HashBits = 14;
+
+	static void WriteLength(std::vector<uint8_t>& output, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			output.push_back(255);
+		output.push_back((uint8_t)length);
+	}
+
+	static void WriteSequence(std::vector<uint8_t>& output, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+	{
+		const size_t match = matchLength >= MinMatch ? matchLength - MinMatch : 0;
+		output.push_back((uint8_t)((literalLength < 15 ? literalLength : 15) << 4 | (offset > 0 ? (match < 15 ? match : 15) : 0)));
+		if (literalLength >= 15)
+			WriteLength(output, literalLength - 15);
+		output.insert(output.end(), literals, literals + literalLength);
+		if (offset == 0)
+			return;
+		output.push_back((uint8_t)offset);
+		output.push_back((uint8_t)(offset >> 8));
+		if (match >= 15)
+			WriteLength(output, match - 15);
+	}
+
+	static bool ReadLength(const uint8_t* data, size_t size, size_t& position, size_t& length)
+	{
+		uint8_t byte = 255;
+		while (byte == 255)
+		{
+			if (position >= size)
+				return false;
+			byte = data[position++];
+			length += byte;
+		}
+		return true;
+	}
+
+public:
+	static std::vector<uint8_t> Compress(const uint8_t* data, size_t size)
+	{
+		std::vector<uint8_t> output = {};
+		output.reserve(size / 2 + 16);
+		// Last position + 1 of each hashed 4 byte sequence, 0 for none
+		std::vector<uint32_t> table((size_t)1 << HashBits, 0);
+		size_t anchor = 0;
+		size_t i = 0;
+		while (i + MinMatch <= size)
+		{
+			uint32_t sequence = 0;
+			memcpy(&sequence, data + i, 4);
+			const uint32_t hash = (sequence * 2654435761u) >> (32 - HashBits);
+			const size_t candidate = table[hash];
+			table[hash] = (uint32_t)(i + 1);
+			if (candidate == 0 || i - (candidate - 1) > MaxOffset || memcmp(data + candidate - 1, data + i, MinMatch) != 0)
+			{
+				// Steps grow over long stretches without matches, incompressible data passes through quickly
+				i += 1 + ((i - anchor) >> 6);
+				continue;
+			}
+			const size_t from = candidate - 1;
+			size_t length = MinMatch;
+			while (i + length < size && data[from + length] == data[i + length])
+				length++;
+			WriteSequence(output, data + anchor, i - anchor, i - from, length);
+			i += length;
+			anchor = i;
+		}
+		WriteSequence(output, data + anchor, size - anchor, 0, 0);
+		return output;
+	}
+
+	// false for damaged input or when the output would not be exactly size bytes
+	static bool Decompress(const uint8_t* data, size_t size, size_t outputSize, std::vector<uint8_t>& output)
+	{
+		output.clear();
+		output.reserve(outputSize);
+		size_t position = 0;
+		while (position < size)
+		{
+			const uint8_t token = data[position++];
+			size_t literalLength = token >> 4;
+			if (literalLength == 15 && !ReadLength(data, size, position, literalLength))
+				return false;
+			if (literalLength > size - position || literalLength > outputSize - output.size())
+				return false;
+			output.insert(output.end(), data + position, data + position + literalLength);
+			position += literalLength;
+			if (position == size)
+				break;
+			if (size - position < 2)
+				return false;
+			const size_t offset = data[position] | (data[position + 1] << 8);
+			position += 2;
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !ReadLength(data, size, position, matchLength))
+				return false;
+			matchLength += MinMatch;
+			if (offset == 0 || offset > output.size() || matchLength > outputSize - output.size())
+				return false;
+			// Byte by byte, a match may overlap the bytes it produces
+			const size_t from = output.size() - offset;
+			for (size_t j = 0; j < matchLength; j++)
+				output.push_back(output[from + j]);
+		}
+		return output.size() == outputSize;
+	}
+};
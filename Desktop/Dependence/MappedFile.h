@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A whole file mapped read-only. Pages are read by the kernel when first touched, so opening a large file
+// costs nothing until its bytes are used. Other processes may append to the file meanwhile, the mapping keeps
+// the size it had at Open.
+class MappedFile
+{
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int file = -1;
+#endif
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+public:
+	MappedFile() {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	// An empty file opens with Data() nullptr and Size() 0
+	bool Open(const std::filesystem::path& path, std::string& error)
+	{
+		Close();
+#ifdef _WIN32
+		// Shared for writing and deleting, the owner keeps appending while the mapping is open
+		file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER length = {};
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &length))
+		{
+			error = "Cannot open " + path.string();
+			Close();
+			return false;
+		}
+		size = (size_t)length.QuadPart;
+		if (size == 0)
+			return true;
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		data = mapping != nullptr ? (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+		file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		struct stat status = {};
+		if (file < 0 || fstat(file, &status) != 0)
+		{
+			error = "Cannot open " + path.string();
+			Close();
+			return false;
+		}
+		size = (size_t)status.st_size;
+		if (size == 0)
+			return true;
+		void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+		data = view != MAP_FAILED ? (const uint8_t*)view : nullptr;
+#endif
+		if (data == nullptr)
+		{
+			error = "Cannot map " + path.string();
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	const uint8_t* Data() const
+	{
+		return data;
+	}
+
+	size_t Size() const
+	{
+		return size;
+	}
+
+	bool IsOpen() const
+	{
+#ifdef _WIN32
+		return file != INVALID_HANDLE_VALUE;
+#else
+		return file >= 0;
+#endif
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (data != nullptr)
+			UnmapViewOfFile(data);
+		if (mapping != nullptr)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data != nullptr)
+			munmap((void*)data, size);
+		if (file >= 0)
+			close(file);
+		file = -1;
+#endif
+		data = nullptr;
+		size = 0;
+	}
+};
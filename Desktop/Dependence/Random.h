@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <cstdlib>
+#include <ctime>
 
 namespace Random
 {
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 
 // Single Instance
 template <typename T>
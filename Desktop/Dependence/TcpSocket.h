@@ -0,0 +1,330 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#ifdef _WIN32
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Blocking TCP connections whose connects and reads give up after a timeout, for talking to cache servers
+// that may be slow or gone
+class TcpConnection
+{
+public:
+	enum class Status
+	{
+		Ok,
+		Timeout,
+		Closed
+	};
+
+#ifdef _WIN32
+	using Handle = SOCKET;
+	static constexpr Handle Invalid = INVALID_SOCKET;
+#else
+	using Handle = int;
+	static constexpr Handle Invalid = -1;
+#endif
+
+private:
+	Handle handle = Invalid;
+
+	static int64_t Remaining(std::chrono::steady_clock::time_point deadline)
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+	}
+
+public:
+	// Once per process on Windows, nothing to do elsewhere
+	static bool Startup()
+	{
+#ifdef _WIN32
+		static const bool started = []() {
+			WSADATA data;
+			return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+			}();
+		return started;
+#else
+		return true;
+#endif
+	}
+
+	static int Poll(Handle handle, short events, int timeout)
+	{
+		pollfd descriptor = {};
+		descriptor.fd = handle;
+		descriptor.events = events;
+#ifdef _WIN32
+		return WSAPoll(&descriptor, 1, timeout);
+#else
+		int ready = 0;
+		while ((ready = poll(&descriptor, 1, timeout)) < 0 && errno == EINTR)
+			;
+		return ready;
+#endif
+	}
+
+	static void Release(Handle& handle)
+	{
+		if (handle == Invalid)
+			return;
+#ifdef _WIN32
+		closesocket(handle);
+#else
+		close(handle);
+#endif
+		handle = Invalid;
+	}
+
+	// Small requests and answers go out at once instead of waiting for more data
+	static void Configure(Handle handle)
+	{
+		int enabled = 1;
+		setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&enabled, sizeof(enabled));
+#ifndef _WIN32
+		fcntl(handle, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+		setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#endif
+#endif
+	}
+
+	TcpConnection() {}
+	TcpConnection(Handle handle) : handle(handle)
+	{
+		if (handle != Invalid)
+			Configure(handle);
+	}
+	TcpConnection(const TcpConnection&) = delete;
+	TcpConnection& operator=(const TcpConnection&) = delete;
+
+	~TcpConnection()
+	{
+		Close();
+	}
+
+	bool Connect(const std::string& host, uint16_t port, uint32_t timeout, std::string& error)
+	{
+		Close();
+		if (!Startup())
+		{
+			error = "WSAStartup failed";
+			return false;
+		}
+		addrinfo hints = {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo* addresses = nullptr;
+		if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0 || addresses == nullptr)
+		{
+			error = "Cannot resolve " + host;
+			return false;
+		}
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+		error = "Cannot connect to " + host + ":" + std::to_string(port);
+		for (addrinfo* address = addresses; address != nullptr && handle == Invalid; address = address->ai_next)
+		{
+			handle = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+			if (handle == Invalid)
+				continue;
+			// Non-blocking only while connecting, so the connect can time out
+#ifdef _WIN32
+			u_long blocking = 1;
+			ioctlsocket(handle, FIONBIO, &blocking);
+			const bool started = connect(handle, address->ai_addr, (int)address->ai_addrlen) == 0 || WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+			const int flags = fcntl(handle, F_GETFL, 0);
+			fcntl(handle, F_SETFL, flags | O_NONBLOCK);
+			const bool started = connect(handle, address->ai_addr, address->ai_addrlen) == 0 || errno == EINPROGRESS;
+#endif
+			int failure = 0;
+			socklen_t length = sizeof(failure);
+			const int64_t remaining = Remaining(deadline);
+			if (!started || remaining < 0 || Poll(handle, POLLOUT, (int)remaining) <= 0
+				|| getsockopt(handle, SOL_SOCKET, SO_ERROR, (char*)&failure, &length) != 0 || failure != 0)
+			{
+				Release(handle);
+				continue;
+			}
+#ifdef _WIN32
+			blocking = 0;
+			ioctlsocket(handle, FIONBIO, &blocking);
+#else
+			fcntl(handle, F_SETFL, flags);
+#endif
+			Configure(handle);
+		}
+		freeaddrinfo(addresses);
+		return handle != Invalid;
+	}
+
+	bool IsOpen() const
+	{
+		return handle != Invalid;
+	}
+
+	bool Write(const void* data, size_t size)
+	{
+		const char* bytes = (const char*)data;
+		while (size > 0 && handle != Invalid)
+		{
+#ifdef _WIN32
+			const int count = send(handle, bytes, (int)std::min<size_t>(size, 1 << 30), 0);
+#elif defined(MSG_NOSIGNAL)
+			const ssize_t count = send(handle, bytes, size, MSG_NOSIGNAL);
+#else
+			const ssize_t count = send(handle, bytes, size, 0);
+#endif
+#ifndef _WIN32
+			if (count < 0 && errno == EINTR)
+				continue;
+#endif
+			if (count <= 0)
+				return false;
+			bytes += count;
+			size -= count;
+		}
+		return size == 0;
+	}
+
+	// Whatever arrives first, at least one byte and at most capacity
+	Status ReadSome(void* data, size_t capacity, size_t& received, uint32_t timeout)
+	{
+		received = 0;
+		if (handle == Invalid)
+			return Status::Closed;
+		const int ready = Poll(handle, POLLIN, (int)timeout);
+		if (ready == 0)
+			return Status::Timeout;
+		if (ready < 0)
+			return Status::Closed;
+#ifdef _WIN32
+		const int count = recv(handle, (char*)data, (int)std::min<size_t>(capacity, 1 << 30), 0);
+#else
+		ssize_t count = 0;
+		while ((count = recv(handle, data, capacity, 0)) < 0 && errno == EINTR)
+			;
+#endif
+		if (count <= 0)
+			return Status::Closed;
+		received = (size_t)count;
+		return Status::Ok;
+	}
+
+	// Exactly size bytes within timeout milliseconds
+	Status Read(void* data, size_t size, uint32_t timeout)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+		uint8_t* bytes = (uint8_t*)data;
+		while (size > 0)
+		{
+			const int64_t remaining = Remaining(deadline);
+			if (remaining < 0)
+				return Status::Timeout;
+			size_t received = 0;
+			const Status status = ReadSome(bytes, size, received, (uint32_t)remaining);
+			if (status != Status::Ok)
+				return status;
+			bytes += received;
+			size -= received;
+		}
+		return Status::Ok;
+	}
+
+	void Close()
+	{
+		Release(handle);
+	}
+};
+
+// Accepts TcpConnections on one address, 127.0.0.1 keeps a server private to this machine
+class TcpListener
+{
+private:
+	TcpConnection::Handle handle = TcpConnection::Invalid;
+	uint16_t port = 0;
+
+public:
+	TcpListener() {}
+	TcpListener(const TcpListener&) = delete;
+	TcpListener& operator=(const TcpListener&) = delete;
+
+	~TcpListener()
+	{
+		Close();
+	}
+
+	// Port 0 picks a free one, GetPort tells which
+	bool Listen(const std::string& host, uint16_t port, std::string& error)
+	{
+		Close();
+		if (!TcpConnection::Startup())
+		{
+			error = "WSAStartup failed";
+			return false;
+		}
+		addrinfo hints = {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_PASSIVE;
+		addrinfo* addresses = nullptr;
+		if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0 || addresses == nullptr)
+		{
+			error = "Cannot resolve " + host;
+			return false;
+		}
+		handle = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+		int enabled = 1;
+#ifndef _WIN32
+		// A restarted server may bind while connections of the last one linger in TIME_WAIT
+		if (handle != TcpConnection::Invalid)
+			setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled));
+#else
+		(void)enabled;
+#endif
+		const bool bound = handle != TcpConnection::Invalid && bind(handle, addresses->ai_addr, (int)addresses->ai_addrlen) == 0 && listen(handle, 64) == 0;
+		freeaddrinfo(addresses);
+		if (!bound)
+		{
+			error = "Cannot listen on " + host + ":" + std::to_string(port);
+			Close();
+			return false;
+		}
+		sockaddr_storage address = {};
+		socklen_t length = sizeof(address);
+		getsockname(handle, (sockaddr*)&address, &length);
+		this->port = ntohs(address.ss_family == AF_INET6 ? ((sockaddr_in6*)&address)->sin6_port : ((sockaddr_in*)&address)->sin_port);
+		return true;
+	}
+
+	uint16_t GetPort() const
+	{
+		return port;
+	}
+
+	// Waits up to timeout milliseconds for a client, Invalid when none came
+	TcpConnection::Handle Accept(uint32_t timeout)
+	{
+		if (handle == TcpConnection::Invalid || TcpConnection::Poll(handle, POLLIN, (int)timeout) <= 0)
+			return TcpConnection::Invalid;
+		return accept(handle, nullptr, nullptr);
+	}
+
+	void Close()
+	{
+		TcpConnection::Release(handle);
+	}
+};
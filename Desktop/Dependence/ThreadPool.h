@@ -1,10 +1,14 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <thread>
 #include <vector>
 #include <queue>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
+#include "Timeline.h"
 
 class ThreadPool
 {
@@ -113,8 +117,9 @@ private:
 		inline void Start()
 		{
 			running = true;
-			thread = std::thread([this]()
+			thread = std::thread([this, index = pool->threads.size()]()
 				{
+					Timeline::SetThreadName("Worker " + std::to_string(index));
 					while (running)
 					{
 						Task* task = nullptr;
@@ -136,10 +141,14 @@ private:
 
 						if (task)
 						{
-							task->Run();
+							{
+								TIMELINE_ZONE("ThreadPool Task");
+								task->Run();
+							}
 							delete task;
+							if (pool->taskFinished)
+								pool->taskFinished();
 						}
-						std::this_thread::sleep_for(std::chrono::milliseconds(1));
 					}
 					done = true;
 				});
@@ -161,6 +170,7 @@ private:
 	std::vector<Thread*> threads = {};
 	std::mutex queueMutex = {};
 	std::condition_variable taskAvailable = {};
+	std::function<void()> taskFinished = nullptr;
 
 public:
 	ThreadPool() {}
@@ -181,6 +191,12 @@ public:
 		}
 	}
 
+	// Invoked on the worker thread after each task, set it before Start
+	inline void SetTaskFinishedCallback(const std::function<void()>& callback)
+	{
+		taskFinished = callback;
+	}
+
 	inline void Start()
 	{
 		for (int i = 0; i < threadCount; i++)
@@ -203,6 +219,42 @@ public:
 		taskAvailable.notify_one(); // Notify one waiting thread that a task is available
 	}
 
+	// Calls function(i) for every i below count on the workers and the calling thread, returns once all calls
+	// finished. The caller keeps taking indices itself, so this is safe to use from inside a task.
+	inline void ParallelFor(size_t count, const std::function<void(size_t)>& function)
+	{
+		if (count == 0)
+			return;
+		class State
+		{
+		public:
+			std::atomic<size_t> next{ 0 };
+			std::atomic<size_t> done{ 0 };
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+		std::shared_ptr<State> state = std::make_shared<State>();
+		// Helpers that start after everything was taken return without touching function
+		auto work = [state, count, &function]() {
+			size_t index = 0;
+			while ((index = state->next.fetch_add(1)) < count)
+			{
+				function(index);
+				if (state->done.fetch_add(1) + 1 == count)
+				{
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->finished.notify_all();
+				}
+			}
+			};
+		const size_t helpers = std::min(count - 1, threads.size());
+		for (size_t i = 0; i < helpers; i++)
+			AddTask(work);
+		work();
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->finished.wait(lock, [&]() { return state->done.load() == count; });
+	}
+
 	inline void Wait()
 	{
 		std::lock_guard<std::mutex> lock(queueMutex);
@@ -0,0 +1,232 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include "SingleInstance.h"
+
+// Scoped instrumentation zones recorded into per-thread ring buffers.
+// Each thread only ever writes its own buffer, readers copy a buffer and drop whatever the owner
+// overwrote meanwhile, so recording takes no lock. While disabled a zone costs one relaxed load.
+class Timeline
+{
+public:
+	class Event
+	{
+	public:
+		const char* name = "";
+		// Nanoseconds since the timeline was created
+		int64_t begin = 0;
+		int64_t end = 0;
+		uint32_t depth = 0;
+	};
+
+	class ThreadBuffer
+	{
+	public:
+		static constexpr size_t Capacity = 1 << 14;
+		Event events[Capacity] = {};
+		// Number of events ever written, the owner thread is the only writer
+		std::atomic<uint64_t> written{ 0 };
+		uint32_t depth = 0;
+		uint32_t threadId = 0;
+		std::string threadName = "";
+
+		void Push(const Event& event)
+		{
+			const uint64_t index = written.load(std::memory_order_relaxed);
+			events[index & (Capacity - 1)] = event;
+			written.store(index + 1, std::memory_order_release);
+		}
+
+		// Copies the events that ended at or after the given time
+		void Collect(int64_t from, std::vector<Event>& out) const
+		{
+			const uint64_t end = written.load(std::memory_order_acquire);
+			const uint64_t begin = end > Capacity ? end - Capacity : 0;
+			const size_t first = out.size();
+			std::vector<uint64_t> indices = {};
+			for (uint64_t i = begin; i < end; i++)
+			{
+				const Event& event = events[i & (Capacity - 1)];
+				if (event.end >= from)
+				{
+					out.push_back(event);
+					indices.push_back(i);
+				}
+			}
+			// Anything the owner wrapped over while copying may be torn, drop it. Event after may be in the middle of
+			// being written over its slot too.
+			const uint64_t after = written.load(std::memory_order_acquire);
+			const uint64_t valid = after + 1 > Capacity ? after + 1 - Capacity : 0;
+			size_t drop = 0;
+			while (drop < indices.size() && indices[drop] < valid)
+				drop++;
+			out.erase(out.begin() + first, out.begin() + first + drop);
+		}
+	};
+
+	class Zone
+	{
+	private:
+		ThreadBuffer* buffer = nullptr;
+		const char* name = "";
+		int64_t begin = 0;
+	public:
+		Zone(const char* name)
+		{
+			if (!IsEnabled())
+				return;
+			this->name = name;
+			buffer = GetThreadBuffer();
+			buffer->depth++;
+			begin = Now();
+		}
+
+		~Zone()
+		{
+			if (buffer == nullptr)
+				return;
+			buffer->depth--;
+			buffer->Push({ name, begin, Now(), buffer->depth });
+		}
+	};
+
+	static constexpr size_t FrameCapacity = 256;
+
+private:
+	inline static std::atomic<bool> enabled{ false };
+	std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+	std::mutex buffersMutex = {};
+	std::vector<ThreadBuffer*> buffers = {};
+	// Frame start times, written by the main thread only
+	int64_t frames[FrameCapacity] = {};
+	uint64_t frameCount = 0;
+
+	static std::string Escape(const std::string& text)
+	{
+		std::string result = "";
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				result += '\\';
+			result += c;
+		}
+		return result;
+	}
+
+public:
+	~Timeline()
+	{
+		for (auto buffer : buffers)
+		{
+			delete buffer;
+		}
+	}
+
+	static bool IsEnabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	static void SetEnabled(bool state)
+	{
+		enabled.store(state, std::memory_order_relaxed);
+	}
+
+	static int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - SingleInstance<Timeline>::Get()->origin).count();
+	}
+
+	static ThreadBuffer* GetThreadBuffer()
+	{
+		thread_local ThreadBuffer* buffer = SingleInstance<Timeline>::Get()->AddThreadBuffer();
+		return buffer;
+	}
+
+	static void SetThreadName(const std::string& name)
+	{
+		ThreadBuffer* buffer = GetThreadBuffer();
+		std::lock_guard<std::mutex> lock(SingleInstance<Timeline>::Get()->buffersMutex);
+		buffer->threadName = name;
+	}
+
+	// Called by the main thread at the start of every frame
+	static void MarkFrame()
+	{
+		if (!IsEnabled())
+			return;
+		Timeline* timeline = SingleInstance<Timeline>::Get();
+		timeline->frames[timeline->frameCount % FrameCapacity] = Now();
+		timeline->frameCount++;
+	}
+
+	ThreadBuffer* AddThreadBuffer()
+	{
+		ThreadBuffer* buffer = new ThreadBuffer();
+		std::lock_guard<std::mutex> lock(buffersMutex);
+		buffer->threadId = (uint32_t)buffers.size() + 1;
+		buffer->threadName = "Thread " + std::to_string(buffer->threadId);
+		buffers.push_back(buffer);
+		return buffer;
+	}
+
+	std::vector<ThreadBuffer*> GetThreadBuffers()
+	{
+		std::lock_guard<std::mutex> lock(buffersMutex);
+		return buffers;
+	}
+
+	// Start time of the frame that began `framesAgo` frames before the latest one, -1 if not recorded
+	int64_t GetFrameStart(size_t framesAgo) const
+	{
+		if (framesAgo >= frameCount || framesAgo >= FrameCapacity)
+			return -1;
+		return frames[(frameCount - 1 - framesAgo) % FrameCapacity];
+	}
+
+	uint64_t GetFrameCount() const
+	{
+		return frameCount;
+	}
+
+	// Writes every buffered event as Chrome trace / Perfetto JSON
+	bool ExportChromeTrace(const std::string& path)
+	{
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+		file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+		std::vector<Event> events = {};
+		for (auto buffer : GetThreadBuffers())
+		{
+			file << (first ? "" : ",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+				<< ",\"args\":{\"name\":\"" << Escape(buffer->threadName) << "\"}}";
+			first = false;
+			events.clear();
+			buffer->Collect(0, events);
+			for (auto& event : events)
+			{
+				file << ",{\"name\":\"" << Escape(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+					<< ",\"ts\":" << event.begin / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+			}
+		}
+		file << "]}";
+		return file.good();
+	}
+};
+
+#define TIMELINE_CONCAT_INNER(a, b) a##b
+#define TIMELINE_CONCAT(a, b) TIMELINE_CONCAT_INNER(a, b)
+#ifdef NA_DISABLE_TIMELINE
+#define TIMELINE_ZONE(name)
+#else
+#define TIMELINE_ZONE(name) Timeline::Zone TIMELINE_CONCAT(timelineZone, __LINE__)(name)
+#endif
\ No newline at end of file
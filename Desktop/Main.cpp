@@ -6,94 +6,1244 @@
 #define APPLICATION_NAME "NaShaderCompiler Preview" " " VERSION
 #define THREAD_COUNT 4
 
-extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
-
-// Windows Entry Point
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
+// Wire the window, the render device and ImGui together and run until the platform quits
+int Run(Platform* platform, RenderDevice* device, ShaderCompiler* compiler, int width, int height)
 {
 	FORMAT_LOG(Info, "Already start" APPLICATION_NAME);
 
-	SingleInstance<ThreadPool>::Get(THREAD_COUNT)->Start();
+	Timeline::SetThreadName("Main");
 
-	static bool isResetWindowSize = false;
-
-	// Set Window's WndPoc
-	SingleInstance<Application>::Get()->GetMainWindow().SetWindowsProcess([](HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)->LRESULT {
-		if (ImGui_ImplWin32_WndProcHandler(hWnd, msg, wParam, lParam))
-			return true;
-		switch (msg)
-		{
-		case WM_SIZE:
-			if (wParam == SIZE_MINIMIZED)
-				return 0;
-			isResetWindowSize = true;
-			SingleInstance<Application>::Get()->GetMainWindow().width = (UINT)LOWORD(lParam); // Queue resize
-			SingleInstance<Application>::Get()->GetMainWindow().height = (UINT)HIWORD(lParam);
-			return 0;
-		case WM_SYSCOMMAND:
-			if ((wParam & 0xfff0) == SC_KEYMENU) // Disable ALT application menu
-				return 0;
-			break;
-		case WM_DESTROY:
-			::PostQuitMessage(0);
-			return 0;
+	// Every redraw request wakes the main loop, set before any worker can request one
+	SingleInstance<FrameScheduler>::Get()->SetWakeCallback([]() {
+		SingleInstance<EventLoop>::Get()->Wake();
+		});
+
+	// A finished background job may change what is on screen
+	SingleInstance<ThreadPool>::Get(THREAD_COUNT)->SetTaskFinishedCallback([]() {
+		SingleInstance<FrameScheduler>::Get()->RequestRedraw(FrameScheduler::Reason::AsyncJob);
+		});
+	SingleInstance<ThreadPool>::Get()->Start();
+
+	// Saved shader files are recompiled once their content really changed
+	SingleInstance<FileWatchService>::Get()->Start([](const fs::path& path, const std::string& content) {
+		SingleInstance<ShaderPreviewManager>::Get()->OnFileChanged(path, content);
+		});
+
+	// Queue resize, the swap chain manager applies it once the size settled
+	platform->SetResizeCallback([](int width, int height) {
+		if (width > 0 && height > 0)
+		{
+			SingleInstance<Application>::Get()->GetMainWindow().width = width;
+			SingleInstance<Application>::Get()->GetMainWindow().height = height;
 		}
-		return ::DefWindowProcW(hWnd, msg, wParam, lParam);
+		SingleInstance<SwapChainManager>::Get()->OnResize(width, height);
 		});
-	FORMAT_LOG(Info, "Already set application's WndProc");
+	SingleInstance<Application>::Get()->GetMainWindow().SetPlatform(platform);
+	SingleInstance<ShaderPreviewManager>::Get()->compiler = compiler;
+	SingleInstance<ShaderPreviewManager>::Get()->compileQueue.pool = SingleInstance<ThreadPool>::Get();
+	SingleInstance<ShaderPreviewManager>::Get()->compileQueue.compiler = compiler;
+	SingleInstance<ShaderPreviewManager>::Get()->compileQueue.cache = SingleInstance<ShaderCache>::Get();
+	// NASHADERCOMPILER_REMOTE_CACHE=host:port shares compile results with a cache server (Compiler --serve-cache)
+	static RemoteCache remote = RemoteCache();
+#ifdef _WIN32
+	char remoteAddress[256] = {};
+	GetEnvironmentVariableA("NASHADERCOMPILER_REMOTE_CACHE", remoteAddress, sizeof(remoteAddress));
+#else
+	const char* remoteAddress = getenv("NASHADERCOMPILER_REMOTE_CACHE");
+#endif
+	if (remoteAddress != nullptr && RemoteCache::ParseAddress(remoteAddress, remote.host, remote.port))
+	{
+		SingleInstance<ShaderCache>::Get()->remote = &remote;
+		FORMAT_LOG(Info, "Using remote shader cache %s", remoteAddress);
+	}
+	// Bytecode of the last session, mapped so restored previews need no compiler
+	ShaderPreviewManager* manager = SingleInstance<ShaderPreviewManager>::Get();
+	std::string packError = "";
+	if (!manager->sessionDirectory.empty() && manager->packEnabled && !SingleInstance<ShaderPack>::Get()->Open(manager->sessionDirectory / "shaders.pack", packError))
+		FORMAT_LOG(Warning, "Shader pack unavailable: %s", packError.c_str());
+	FORMAT_LOG(Info, "Using %s shader compiler", compiler->GetName());
+	FORMAT_LOG(Info, "Already set application's platform");
 
-	// Add DirectX11 and ImGui Create
+	// Add render device and ImGui Create
+	static RenderDevice* renderDevice = device;
 	SingleInstance<Application>::Get()->GetMainWindow().AddCallback(Application::Window::CallbackPeriod::Create, [](Application::Window* window) {
-		SingleInstance<Render>::Get()->Create(window->handl, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
+		SingleInstance<Render>::Get()->Create(renderDevice, window->platform, window->width, window->height);
+		SingleInstance<SwapChainManager>::Get()->Create(renderDevice, window->width, window->height);
 		ImGui::CreateContext();
 		ImGui::StyleColorsDark();
-		//ImGui::GetIO().Fonts->AddFontFromFileTTF("C:\\Windows\\Fonts\\CascadiaCode.ttf", 16.f);
-		ImGui::GetIO().Fonts->AddFontFromFileTTF("C:\\Windows\\Fonts\\msyh.ttc", 16.f);
-		ImGui_ImplWin32_Init(SingleInstance<Application>::Get()->GetMainWindow().handl);
-		ImGui_ImplDX11_Init(SingleInstance<Render>::Get()->device, SingleInstance<Render>::Get()->context);
-		});
-	FORMAT_LOG(Info, "Already add callback for DirectX11 and ImGui Create");
+		window->platform->ImGuiInit();
+		renderDevice->ImGuiInit();
+		}, "Render Device And ImGui Create");
+	FORMAT_LOG(Info, "Already add callback for render device and ImGui Create");
+
+	// Restore the previous session once the device can create its shaders and textures, save it on exit
+	SingleInstance<Application>::Get()->GetMainWindow().AddCallback(Application::Window::CallbackPeriod::Create, [](Application::Window*) {
+		std::string error = "";
+		if (!SingleInstance<ShaderPreviewManager>::Get()->sessionDirectory.empty() && !SingleInstance<ShaderPreviewManager>::Get()->RestoreSession(error))
+			FORMAT_LOG(Info, "Session not restored: %s", error.c_str());
+		}, "Session Restore");
+	SingleInstance<Application>::Get()->GetMainWindow().AddCallback(Application::Window::CallbackPeriod::Destroy, [](Application::Window*) {
+		std::string error = "";
+		if (!SingleInstance<ShaderPreviewManager>::Get()->sessionDirectory.empty() && !SingleInstance<ShaderPreviewManager>::Get()->SaveSession(error))
+			FORMAT_LOG(Warning, "Session not saved: %s", error.c_str());
+		SingleInstance<ShaderPack>::Get()->Flush();
+		}, "Session Save");
+	FORMAT_LOG(Info, "Already add callback for session restore and save");
 
 	// Create Main Window
-	SingleInstance<Application>::Get()->GetMainWindow().Create(TEXT(APPLICATION_NAME), DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
+	SingleInstance<Application>::Get()->GetMainWindow().Create(APPLICATION_NAME, width, height);
 	FORMAT_LOG(Info, "Already create main window");
 
 	// Add ImGui Render
 	SingleInstance<Render>::Get()->AddCallback(Render::CallbackPeriod::UpdateBeforeSetRenderTargets, []() {
 		// Start the Dear ImGui frame
-		ImGui_ImplDX11_NewFrame();
-		ImGui_ImplWin32_NewFrame();
-		ImGui::NewFrame();
-		SingleInstance<Content>::Get()->Render();
+		{
+			TIMELINE_ZONE("ImGui::NewFrame");
+			renderDevice->ImGuiNewFrame();
+			SingleInstance<Application>::Get()->GetMainWindow().platform->ImGuiNewFrame();
+			ImGui::NewFrame();
+		}
+		{
+			TIMELINE_ZONE("Content::Render");
+			SingleInstance<Content>::Get()->Render();
+		}
+		TIMELINE_ZONE("ImGui::Render");
 		ImGui::Render();
-		});
+		}, "ImGui Frame");
 	FORMAT_LOG(Info, "Already add callback for ImGui Render and Content Render");
 
-	// Add DirectX11 Render
+	// Add render device draw
 	SingleInstance<Render>::Get()->AddCallback(Render::CallbackPeriod::UpdateAfterSetRenderTargets, []() {
-		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
-		});
-	FORMAT_LOG(Info, "Already add callback for ImGui ImplDX11 Render");
+		TIMELINE_ZONE("ImGui RenderDrawData");
+		renderDevice->ImGuiRenderDrawData(ImGui::GetDrawData());
+		}, "ImGui Render Draw Data");
+	FORMAT_LOG(Info, "Already add callback for ImGui render draw data");
+
+	// Finished shader compiles become device objects here, before the frame that draws with them
+	SingleInstance<Application>::Get()->GetMainWindow().AddCallback(Application::Window::CallbackPeriod::Update, [](Application::Window*) {
+		SingleInstance<ShaderPreviewManager>::Get()->Update();
+		}, "Shader Compile Completions");
+	FORMAT_LOG(Info, "Already add callback for Shader Compile Completions");
 
 	// Add Update
 	SingleInstance<Application>::Get()->GetMainWindow().AddCallback(Application::Window::CallbackPeriod::Update, [](Application::Window*) {
-		if (isResetWindowSize)
-		{
-			SingleInstance<Render>::Get()->renderTargetView->Release();
-			SingleInstance<Render>::Get()->swapChain->ResizeBuffers(0,
-				SingleInstance<Application>::Get()->GetMainWindow().width,
-				SingleInstance<Application>::Get()->GetMainWindow().height,
-				DXGI_FORMAT_UNKNOWN, 0);
-			SingleInstance<Render>::Get()->CreateRenderTargetView();
-		}
-		SingleInstance<Render>::Get()->Update();
-		});
+		if (!SingleInstance<SwapChainManager>::Get()->BeginFrame())
+			return;
+		if (!SingleInstance<Render>::Get()->Update())
+			SingleInstance<SwapChainManager>::Get()->OnOccluded();
+		}, "Render Update");
 	FORMAT_LOG(Info, "Already add callback for Render Update");
 
 	// Join Message Loop
 	FORMAT_LOG(Info, "Join Message Loop");
 	SingleInstance<Application>::Get()->GetMainWindow().JoinMessageLoop();
 
+	return 0;
+}
 
+#ifdef _WIN32
+// Windows Entry Point
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
+{
+	static Win32Platform platform = Win32Platform();
+	static D3D11RenderDevice device = D3D11RenderDevice();
+	static D3DCompilerBackend compiler = D3DCompilerBackend();
+	// With the batch compiler next to the app compiles run in its worker processes, a compiler crash or hang
+	// then only fails the shader being compiled
+	static std::unique_ptr<WorkerPoolBackend> workers = nullptr;
+	char module[MAX_PATH] = {};
+	GetModuleFileNameA(nullptr, module, MAX_PATH);
+	const fs::path worker = fs::path(module).parent_path() / "Compiler.exe";
+	std::error_code error;
+	if (fs::is_regular_file(worker, error))
+		workers = std::make_unique<WorkerPoolBackend>(std::vector<std::string>{ worker.string(), "--worker" }, THREAD_COUNT, &compiler);
+	ShaderCompiler* backend = workers != nullptr ? (ShaderCompiler*)workers.get() : &compiler;
+	// With --server <name> compiles go to the compile server started with Compiler.exe --serve --server <name>,
+	// which shares its cache with every instance, and run on backend while it is not available
+	static std::unique_ptr<CompileServerBackend> server = nullptr;
+	std::istringstream arguments(lpCmdLine);
+	std::string argument = "";
+	while (arguments >> argument)
+	{
+		if (argument == "--server" && arguments >> argument)
+		{
+			server = std::make_unique<CompileServerBackend>(argument, backend);
+			backend = server.get();
+		}
+	}
+	SingleInstance<ShaderPreviewManager>::Get()->sessionDirectory = fs::current_path() / "cache";
+	return Run(&platform, &device, backend, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
+}
+#else
+// Builds a generated shader with at least count variants twice, cold and against a warm memory cache,
+// then measures variant lookups
+int RunVariantBenchmark(ShaderCompiler* compiler, uint64_t count)
+{
+	SingleInstance<ThreadPool>::Get(THREAD_COUNT)->Start();
+	ShaderPermutations permutations;
+	permutations.AddAxis("QUALITY", { "LOW", "MEDIUM", "HIGH" });
+	while (permutations.GetVariantCount() < count)
+		permutations.AddAxis("FEATURE_" + std::to_string(permutations.axes.size()));
+
+	ShaderCompiler::Request request;
+	request.sourceName = "Variants.hlsl";
+	request.source = "float4 main(float4 color : COLOR0) : SV_Target\n{\n";
+	for (const ShaderPermutations::Axis& axis : permutations.axes)
+		request.source += "#if " + axis.name + "\n\tcolor *= 0.5;\n#endif\n";
+	request.source += "\treturn color;\n}\n";
+
+	ShaderCache cache;
+	cache.diskEnabled = false;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		ShaderVariantSet set(permutations);
+		std::string error = "";
+		if (!set.Build(SingleInstance<ThreadPool>::Get(), compiler, &cache, request, error))
+		{
+			std::cerr << error << std::endl;
+			return 1;
+		}
+		const ShaderVariantSet::Statistics& built = set.statistics;
+		std::cout << (pass == 0 ? "Cold" : "Warm") << " build: " << built.variants << " variants, " << built.unique << " unique, "
+			<< built.cached << " cached, " << built.failed << " failed, preprocess " << built.preprocessTime << " ms, compile "
+			<< built.compileTime << " ms" << std::endl;
+		if (pass == 0)
+			continue;
+		const uint64_t lookups = 10000000;
+		uint64_t bytes = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < lookups; i++)
+			bytes += set.Find((i * 2654435761ull) % built.variants)->bytecode.size();
+		const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Lookup: " << elapsed / lookups << " ns per variant (" << bytes << " bytes touched)" << std::endl;
+	}
+	return 0;
+}
+
+// Parses a shader file from scratch, then again after each of a run of single character edits in its middle
+int RunParseBenchmark(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Failed to open shader: " << path << std::endl;
+		return 1;
+	}
+	std::stringstream stream;
+	stream << file.rdbuf();
+	std::string source = stream.str();
+	const double kilobytes = std::max<double>(source.size(), 1) / 1024.0;
+
+	const int rounds = 100;
+	float lexTime = 0.f, parseTime = 0.f;
+	for (int i = 0; i < rounds; i++)
+	{
+		HlslFrontEnd cold;
+		cold.Update(source, path);
+		lexTime += cold.lexTime;
+		parseTime += cold.parseTime;
+	}
+	HlslFrontEnd frontEnd;
+	frontEnd.Update(source, path);
+	for (const auto& diagnostic : frontEnd.diagnostics)
+		std::cout << diagnostic.file << "(" << diagnostic.line << "," << diagnostic.column << "): error " << diagnostic.code << ": " << diagnostic.message << std::endl;
+	std::cout << "Full: " << source.size() << " bytes, " << frontEnd.lexer.tokens.size() << " tokens, " << frontEnd.GetNodeCount() << " nodes, lex "
+		<< lexTime / rounds / kilobytes << " us/KB, parse " << parseTime / rounds / kilobytes << " us/KB" << std::endl;
+
+	// Types a comment line character by character at the line nearest the middle, the source stays valid throughout
+	const size_t line = source.rfind('\n', source.size() / 2) + 1;
+	source.insert(line, "//\n");
+	frontEnd.Update(source, path);
+	lexTime = parseTime = 0.f;
+	uint64_t lexed = 0;
+	for (int i = 0; i < rounds; i++)
+	{
+		source.insert(line + 2 + i, "x");
+		frontEnd.Update(source, path);
+		lexTime += frontEnd.lexTime;
+		parseTime += frontEnd.parseTime;
+		lexed += frontEnd.lexer.statistics.lexed;
+	}
+	std::cout << "Edit: lex " << lexTime / rounds << " us (" << (double)lexed / rounds << " tokens re-lexed), parse " << parseTime / rounds << " us" << std::endl;
 	return 0;
 }
+
+// Renders 1920x1080 with the CPU interpreter at the given lane count, on the calling thread and on the pool
+template <size_t Lanes>
+int RunRenderBenchmark(const ShaderCompiler::Request& request, const unsigned char* image, int imageWidth, int imageHeight)
+{
+	ShaderInterpreter<Lanes> interpreter;
+	std::string error = "";
+	if (!interpreter.Compile(request, error))
+	{
+		std::cerr << error << std::endl;
+		return 1;
+	}
+	typename ShaderInterpreter<Lanes>::Texture texture;
+	texture.rgba = image;
+	texture.width = imageWidth;
+	texture.height = imageHeight;
+	const int width = 1920, height = 1080;
+	const float white[4] = { 1.f, 1.f, 1.f, 1.f };
+	std::vector<unsigned char> rgba((size_t)width * height * 4);
+	for (ThreadPool* pool : { (ThreadPool*)nullptr, SingleInstance<ThreadPool>::Get() })
+	{
+		float best = FLT_MAX;
+		for (int i = 0; i < 3; i++)
+		{
+			if (!interpreter.Render(pool, { texture }, rgba.data(), width, height, white, error))
+			{
+				std::cerr << error << std::endl;
+				return 1;
+			}
+			best = std::min(best, interpreter.statistics.renderTime);
+		}
+		uint32_t checksum = 0;
+		for (unsigned char value : rgba)
+			checksum = checksum * 31 + value;
+		std::cout << Lanes << " lanes, " << (pool != nullptr ? "pool" : "1 thread") << ": " << best << " ms, " << width * height / 1000.f / best
+			<< " MP/s (" << interpreter.statistics.instructions << " instructions, checksum " << std::hex << checksum << std::dec << ")" << std::endl;
+	}
+	return 0;
+}
+
+// Shades a shader file on the CPU over an image, or a generated one, with 1, 8 and 16 lanes
+int RunRenderBenchmark(const std::string& path, const std::string& imagePath)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Failed to open shader: " << path << std::endl;
+		return 1;
+	}
+	std::stringstream stream;
+	stream << file.rdbuf();
+	ShaderCompiler::Request request;
+	request.source = stream.str();
+	request.sourceName = fs::path(path).filename().string();
+	request.resolver = SingleInstance<IncludeResolver>::Get();
+	request.directory = fs::path(path).parent_path().string();
+
+	int imageWidth = 256, imageHeight = 256;
+	std::vector<unsigned char> image;
+	if (!imagePath.empty())
+	{
+		unsigned char* data = stbi_load(imagePath.c_str(), &imageWidth, &imageHeight, NULL, 4);
+		if (data == NULL)
+		{
+			std::cerr << "Failed to load image: " << imagePath << std::endl;
+			return 1;
+		}
+		image.assign(data, data + (size_t)imageWidth * imageHeight * 4);
+		stbi_image_free(data);
+	}
+	else
+	{
+		// Checkerboard over a gradient
+		image.resize((size_t)imageWidth * imageHeight * 4);
+		for (int y = 0; y < imageHeight; y++)
+		{
+			for (int x = 0; x < imageWidth; x++)
+			{
+				unsigned char* pixel = &image[((size_t)y * imageWidth + x) * 4];
+				const bool dark = ((x / 32) + (y / 32)) % 2 != 0;
+				pixel[0] = (unsigned char)x;
+				pixel[1] = (unsigned char)y;
+				pixel[2] = dark ? 64 : 192;
+				pixel[3] = 255;
+			}
+		}
+	}
+	SingleInstance<ThreadPool>::Get(THREAD_COUNT)->Start();
+	if (RunRenderBenchmark<1>(request, image.data(), imageWidth, imageHeight) != 0)
+		return 1;
+	if (RunRenderBenchmark<8>(request, image.data(), imageWidth, imageHeight) != 0)
+		return 1;
+	return RunRenderBenchmark<16>(request, image.data(), imageWidth, imageHeight);
+}
+
+// Compiles generated shaders, mostly small with some large ones, in-process and through fake workers started from
+// the batch compiler at path, then again with jobs that crash or hang their worker mixed in
+int RunWorkerBenchmark(const std::string& path)
+{
+	SingleInstance<ThreadPool>::Get(THREAD_COUNT)->Start();
+	std::vector<ShaderCompiler::Request> requests(256);
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		ShaderCompiler::Request& request = requests[i];
+		request.sourceName = "Worker" + std::to_string(i) + ".hlsl";
+		request.source = "float4 main(float4 color : COLOR0) : SV_Target\n{\n";
+		const size_t lines = i % 16 == 0 ? 2000 : 10;
+		for (size_t line = 0; line < lines; line++)
+			request.source += "\tcolor = color * 0.99 + " + std::to_string(line) + ".0 / 4096.0;\n";
+		request.source += "\treturn color * " + std::to_string(i) + ";\n}\n";
+	}
+	auto Build = [](ShaderCompiler* compiler, const std::vector<ShaderCompiler::Request>& requests, std::vector<ShaderCompiler::Result>& results) {
+		results.assign(requests.size(), ShaderCompiler::Result());
+		const auto start = std::chrono::steady_clock::now();
+		SingleInstance<ThreadPool>::Get()->ParallelFor(requests.size(), [&](size_t index) { results[index] = compiler->Compile(requests[index]); });
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		};
+
+	FakeCompilerBackend compiler;
+	std::vector<ShaderCompiler::Result> expected, results;
+	const float inProcessTime = Build(&compiler, requests, expected);
+	WorkerPoolBackend workers({ path, "--worker", "--backend", "fake" }, THREAD_COUNT, &compiler);
+	workers.timeout = 2000;
+	// The first pass also starts the workers
+	Build(&workers, requests, results);
+	const float workerTime = Build(&workers, requests, results);
+	size_t mismatches = 0;
+	for (size_t i = 0; i < requests.size(); i++)
+		mismatches += results[i].success && results[i].bytecode == expected[i].bytecode ? 0 : 1;
+	std::cout << "In-process: " << inProcessTime << " ms, workers: " << workerTime << " ms, " << mismatches << " mismatches of "
+		<< requests.size() << std::endl;
+
+	std::vector<ShaderCompiler::Request> faulty = requests;
+	size_t crashes = 0, hangs = 0;
+	for (size_t i = 5; i < faulty.size(); i += 40)
+	{
+		// A pragma, comments do not survive preprocessing
+		faulty[i].source += (i / 40) % 2 == 0 ? "#pragma NA_WORKER_CRASH\n" : "#pragma NA_WORKER_HANG\n";
+		((i / 40) % 2 == 0 ? crashes : hangs)++;
+	}
+	const float faultyTime = Build(&workers, faulty, results);
+	size_t failed = 0;
+	mismatches = 0;
+	for (size_t i = 0; i < faulty.size(); i++)
+	{
+		const bool fault = faulty[i].source.find("NA_WORKER_") != std::string::npos;
+		failed += results[i].success ? 0 : 1;
+		mismatches += fault != !results[i].success || (!fault && results[i].bytecode != expected[i].bytecode) ? 1 : 0;
+		if (fault && i == 5)
+			std::cout << results[i].log;
+	}
+	const WorkerPoolBackend::Statistics statistics = workers.GetStatistics();
+	std::cout << "With " << crashes << " crashing and " << hangs << " hanging jobs: " << faultyTime << " ms, " << failed << " failed, "
+		<< mismatches << " mismatches" << std::endl;
+	std::cout << "Workers: " << statistics.jobs << " jobs in " << statistics.batches << " batches (" << statistics.batchedJobs << " batched), "
+		<< statistics.starts << " starts, " << statistics.crashes << " crashes, " << statistics.timeouts << " timeouts" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// Starts a compile server from the batch compiler at path and compiles the same shaders from two clients at once,
+// then restarts the server and compiles them again, which its cache on disk answers
+int RunServerBenchmark(const std::string& path)
+{
+	SingleInstance<ThreadPool>::Get(THREAD_COUNT)->Start();
+	std::vector<ShaderCompiler::Request> requests(64);
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		requests[i].sourceName = "Server" + std::to_string(i) + ".hlsl";
+		requests[i].source = "float4 main(float4 color : COLOR0) : SV_Target\n{\n\treturn color * " + std::to_string(i) + ";\n}\n";
+	}
+	std::error_code error;
+	const fs::path directory = fs::temp_directory_path(error) / ("NaShaderCompilerServer." + Random::GetString(8));
+	const std::string name = (directory / "server.sock").string();
+	fs::create_directories(directory, error);
+	FakeCompilerBackend fallback;
+	uint64_t failures = 0;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		ChildProcess server;
+		std::string message = "";
+		if (!server.Start({ path, "--serve", "--quiet", "--backend", "fake", "--server", name, "--cache", (directory / "cache").string() }, message))
+		{
+			std::cerr << message << std::endl;
+			return 1;
+		}
+		LocalConnection probe;
+		for (int attempt = 0; attempt < 200 && !probe.Connect(name, 0, message); attempt++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		probe.Close();
+
+		CompileServerBackend first(name, &fallback), second(name, &fallback);
+		std::vector<ShaderCompiler::Result> results(requests.size() * 2);
+		const auto start = std::chrono::steady_clock::now();
+		SingleInstance<ThreadPool>::Get()->ParallelFor(results.size(), [&](size_t index) {
+			results[index] = (index % 2 == 0 ? first : second).Compile(requests[index / 2]);
+			});
+		const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		size_t mismatches = 0;
+		for (size_t i = 0; i < results.size(); i++)
+			mismatches += results[i].success && results[i].bytecode == results[i - i % 2].bytecode ? 0 : 1;
+		const CompileServerBackend::Statistics a = first.GetStatistics(), b = second.GetStatistics();
+		failures += mismatches + a.fallbacks + b.fallbacks;
+		std::cout << (pass == 0 ? "Cold" : "Restarted") << " server: " << results.size() << " compiles in " << milliseconds << " ms, "
+			<< a.served + b.served << " served, " << a.shared + b.shared << " shared, " << a.fallbacks + b.fallbacks << " fallbacks, "
+			<< mismatches << " mismatches" << std::endl;
+		server.Kill();
+	}
+	fs::remove_all(directory, error);
+	return failures == 0 ? 0 : 1;
+}
+
+// Starts a remote cache server from the batch compiler at path. One local cache compiles and uploads, a second
+// empty one is then answered by the server. Lookups against a server that never answers and against a stopped
+// one show how long a dead remote tier can hold up a compile.
+int RunRemoteBenchmark(const std::string& path)
+{
+	SingleInstance<ThreadPool>::Get(THREAD_COUNT)->Start();
+	FakeCompilerBackend compiler;
+	std::vector<ShaderCompiler::Request> requests(64);
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		requests[i].sourceName = "Remote" + std::to_string(i) + ".hlsl";
+		requests[i].source = "float4 main(float4 color : COLOR0) : SV_Target\n{\n\treturn color * " + std::to_string(i) + ";\n}\n";
+	}
+	std::error_code error;
+	const fs::path directory = fs::temp_directory_path(error) / ("NaShaderCompilerRemote." + Random::GetString(8));
+	ChildProcess server;
+	std::string message = "";
+	if (!server.Start({ path, "--serve-cache", "0", "--cache", (directory / "remote").string() }, message))
+	{
+		std::cerr << message << std::endl;
+		return 1;
+	}
+	// The first line names the port
+	std::string line = "";
+	char c = 0;
+	while (c != '\n' && server.Read(&c, 1, 5000) == ChildProcess::Status::Ok)
+		line += c;
+	const size_t colon = line.rfind(':', line.find(", cache"));
+	const uint16_t port = (uint16_t)(colon == std::string::npos ? 0 : atoi(line.c_str() + colon + 1));
+	if (port == 0)
+	{
+		std::cerr << "Remote cache server did not start: " << line << std::endl;
+		return 1;
+	}
+
+	auto Pass = [&](const char* name, const std::string& local, RemoteCache& remote, std::vector<ShaderCompiler::Result>& results) {
+		ShaderCache cache(directory / local);
+		cache.remote = &remote;
+		results.assign(requests.size(), ShaderCompiler::Result());
+		const auto start = std::chrono::steady_clock::now();
+		SingleInstance<ThreadPool>::Get()->ParallelFor(requests.size(), [&](size_t index) {
+			results[index] = cache.Compile(&compiler, requests[index]);
+			});
+		remote.Flush();
+		const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		const ShaderCache::Statistics statistics = cache.GetStatistics();
+		const RemoteCache::Statistics shared = remote.GetStatistics();
+		std::cout << name << ": " << requests.size() << " compiles in " << milliseconds << " ms, " << statistics.remoteHits << " remote hits, "
+			<< statistics.misses << " misses, " << shared.uploads << " uploaded (" << shared.bytesUploaded << " of " << shared.bytesUncompressed
+			<< " bytes), " << shared.skipped << " already there, " << shared.errors << " errors" << std::endl;
+		};
+
+	std::vector<ShaderCompiler::Result> uploaded, downloaded, unanswered, stopped;
+	RemoteCache first("127.0.0.1", port), second("127.0.0.1", port);
+	Pass("Uploading cache", "a", first, uploaded);
+	Pass("Empty cache", "b", second, downloaded);
+	size_t mismatches = 0;
+	for (size_t i = 0; i < requests.size(); i++)
+		mismatches += downloaded[i].success && downloaded[i].bytecode == uploaded[i].bytecode ? 0 : 1;
+
+	// Accepts connections but never reads them
+	TcpListener silent;
+	silent.Listen("127.0.0.1", 0, message);
+	RemoteCache hanging("127.0.0.1", silent.GetPort());
+	hanging.timeout = 200;
+	Pass("Unanswering server", "c", hanging, unanswered);
+	server.Kill();
+	RemoteCache gone("127.0.0.1", port);
+	Pass("Stopped server", "d", gone, stopped);
+	for (size_t i = 0; i < requests.size(); i++)
+		mismatches += unanswered[i].bytecode == uploaded[i].bytecode && stopped[i].bytecode == uploaded[i].bytecode ? 0 : 1;
+	std::cout << mismatches << " mismatches" << std::endl;
+	fs::remove_all(directory, error);
+	return mismatches == 0 ? 0 : 1;
+}
+
+// Reports an expectation of a --check run that did not hold
+static void Expect(bool condition, const std::string& what, int& failures)
+{
+	if (condition)
+		return;
+	std::cout << "FAILED: " << what << std::endl;
+	failures++;
+}
+
+// Steps FrameScheduler through settle frames, idle throttling, the FPS cap and animations on a manual clock
+int RunSchedulerCheck()
+{
+	class ManualClock : public FrameScheduler::Clock
+	{
+	public:
+		FrameScheduler::TimePoint now = FrameScheduler::TimePoint() + std::chrono::hours(1);
+
+		FrameScheduler::TimePoint Now() override
+		{
+			return now;
+		}
+	};
+	using std::chrono::milliseconds;
+	ManualClock clock;
+	FrameScheduler scheduler(&clock);
+	scheduler.targetFps = 100.f;
+	scheduler.idleFps = 4.f;
+	scheduler.settleFrameCount = 2;
+	int wakes = 0;
+	scheduler.SetWakeCallback([&wakes]() { wakes++; });
+	int failures = 0;
+
+	// The first frame is due immediately, then the cap holds until 10 ms later
+	Expect(scheduler.ShouldRender(), "first frame is not due", failures);
+	scheduler.BeginFrame();
+	Expect(scheduler.statistics.lastReasons == FrameScheduler::Reason::Request, "first frame reason is not Request", failures);
+	clock.now += milliseconds(5);
+	Expect(!scheduler.ShouldRender(), "frame due before the target FPS interval", failures);
+	Expect(scheduler.TimeUntilNextFrame() == milliseconds(5), "wait until the capped frame is not 5 ms", failures);
+	clock.now += milliseconds(5);
+	Expect(scheduler.ShouldRender(), "settle frame not due after the target FPS interval", failures);
+
+	// Two settle frames at the capped rate, then idle frames 250 ms apart
+	scheduler.BeginFrame();
+	clock.now += milliseconds(10);
+	scheduler.BeginFrame();
+	Expect(scheduler.statistics.idleFrames == 0, "settle frames counted as idle", failures);
+	clock.now += milliseconds(10);
+	Expect(!scheduler.ShouldRender(), "frame due at the target FPS after settling", failures);
+	Expect(scheduler.TimeUntilNextFrame() == milliseconds(240), "idle wait is not 250 ms from the last frame", failures);
+	clock.now += milliseconds(240);
+	Expect(scheduler.ShouldRender(), "idle frame not due", failures);
+	scheduler.BeginFrame();
+	Expect(scheduler.statistics.idleFrames == 1 && scheduler.statistics.lastReasons == FrameScheduler::Reason::Idle,
+		"idle frame not counted", failures);
+
+	// Without idle redraws the loop may sleep until an event, which wakes it and is due at the cap
+	scheduler.idleFps = 0.f;
+	Expect(scheduler.TimeUntilNextFrame() == FrameScheduler::Duration::max(), "idle loop does not sleep without idle FPS", failures);
+	scheduler.RequestRedraw(FrameScheduler::Reason::Input);
+	Expect(wakes == 1, "RequestRedraw did not wake the loop", failures);
+	Expect(scheduler.TimeUntilNextFrame() == milliseconds(10), "input frame not capped at the target FPS", failures);
+	clock.now += milliseconds(10);
+	scheduler.BeginFrame();
+	Expect(scheduler.statistics.lastReasons == FrameScheduler::Reason::Input, "input frame reason is not Input", failures);
+	for (int i = 0; i < 2; i++)
+	{
+		clock.now += milliseconds(10);
+		scheduler.BeginFrame();
+	}
+	Expect(scheduler.TimeUntilNextFrame() == FrameScheduler::Duration::max(), "loop does not sleep after the input settled", failures);
+
+	// Animations keep frames coming at the cap until they end, uncapped frames are always due
+	scheduler.BeginAnimation();
+	for (int i = 0; i < 5; i++)
+	{
+		clock.now += milliseconds(10);
+		Expect(scheduler.ShouldRender(), "animation frame " + std::to_string(i) + " not due", failures);
+		scheduler.BeginFrame();
+		Expect((scheduler.statistics.lastReasons & FrameScheduler::Reason::Animation) != 0, "animation frame reason missing", failures);
+	}
+	scheduler.EndAnimation();
+	for (int i = 0; i < 2; i++)
+	{
+		clock.now += milliseconds(10);
+		scheduler.BeginFrame();
+	}
+	Expect(scheduler.TimeUntilNextFrame() == FrameScheduler::Duration::max(), "loop does not sleep after the animation ended", failures);
+	scheduler.targetFps = 0.f;
+	scheduler.RequestRedraw();
+	Expect(scheduler.ShouldRender() && scheduler.TimeUntilNextFrame() == FrameScheduler::Duration::zero(), "uncapped frame not due at once", failures);
+
+	std::cout << "Scheduler check: " << scheduler.statistics.framesRendered << " frames, " << failures << " failed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
+
+// Wakes an EventLoop from another thread and checks each wait returns in time, then checks timeouts, timers and
+// that wakes arriving before a wait coalesce into one
+int RunEventLoopCheck()
+{
+	using std::chrono::milliseconds;
+	using Clock = std::chrono::steady_clock;
+	// Generous for loaded machines, a wait that misses its wake by this much is broken rather than slow
+	const milliseconds budget = milliseconds(10);
+	const int wakeCount = 50;
+	EventLoop loop;
+	int failures = 0;
+
+	std::atomic<int> sent{ 0 };
+	std::thread waker([&loop, &sent]() {
+		for (int i = 0; i < wakeCount; i++)
+		{
+			std::this_thread::sleep_for(milliseconds(2));
+			sent++;
+			loop.Wake();
+		}
+		});
+	int woken = 0;
+	while (woken < wakeCount)
+	{
+		if (loop.Wait(std::chrono::seconds(1)) != EventLoop::WaitResult::Wake)
+		{
+			Expect(false, "wait " + std::to_string(woken) + " did not end with a wake", failures);
+			break;
+		}
+		woken++;
+	}
+	waker.join();
+	Expect(loop.statistics.wakes == (uint64_t)wakeCount, std::to_string(loop.statistics.wakes) + " wakes counted for " + std::to_string(wakeCount), failures);
+	Expect(loop.statistics.maxLatency < std::chrono::duration<double, std::micro>(budget).count(),
+		"worst wake latency " + std::to_string(loop.statistics.maxLatency) + " us is over budget", failures);
+
+	// Wakes before the wait are coalesced, the next wait has nothing left and times out on its deadline
+	for (int i = 0; i < 3; i++)
+		loop.Wake();
+	Expect(loop.Wait(milliseconds(0)) == EventLoop::WaitResult::Wake, "pending wake not returned", failures);
+	Expect(loop.statistics.wakes == (uint64_t)wakeCount + 1, "wakes before a wait were not coalesced", failures);
+	Clock::time_point start = Clock::now();
+	Expect(loop.Wait(milliseconds(20)) == EventLoop::WaitResult::Timeout, "wait without a wake did not time out", failures);
+	Clock::duration elapsed = Clock::now() - start;
+	Expect(elapsed >= milliseconds(20) && elapsed < milliseconds(20) + budget, "timeout missed its 20 ms deadline", failures);
+
+	// A timer shortens an unbounded wait to its own deadline
+	bool fired = false;
+	start = Clock::now();
+	loop.AddTimer(milliseconds(15), [&fired]() { fired = true; });
+	while (!fired && Clock::now() - start < std::chrono::seconds(1))
+	{
+		loop.Wait(EventLoop::Duration::max());
+		loop.RunDueTimers();
+	}
+	elapsed = Clock::now() - start;
+	Expect(fired, "timer never fired", failures);
+	Expect(elapsed >= milliseconds(15) && elapsed < milliseconds(15) + budget, "timer missed its 15 ms deadline", failures);
+	Expect(loop.statistics.wakes == (uint64_t)wakeCount + 1, "adding a timer was counted as a wake", failures);
+
+	// Wakes hammered from another thread while the loop consumes them, every wait has to end promptly. A Wake
+	// lost between consuming and draining leaves the loop asleep until its timeout.
+	std::atomic<bool> hammering{ true };
+	std::thread hammer([&loop, &hammering]() {
+		const Clock::time_point end = Clock::now() + milliseconds(200);
+		while (Clock::now() < end)
+			loop.Wake();
+		hammering = false;
+		loop.Wake();
+		});
+	int hammered = 0;
+	bool lost = false;
+	while (hammering && !lost)
+	{
+		start = Clock::now();
+		loop.Wait(std::chrono::seconds(1));
+		lost = Clock::now() - start >= budget;
+		hammered++;
+	}
+	hammer.join();
+	Expect(!lost, "wake lost after " + std::to_string(hammered) + " hammered waits", failures);
+
+	std::cout << "Event loop check: " << loop.statistics.waits << " waits, wake latency mean " << loop.statistics.meanLatency << " us, max "
+		<< loop.statistics.maxLatency << " us, " << failures << " failed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
+
+// Drives a SwapChainManager over the headless device through a resize burst, a repeated size, minimize and
+// restore, and an occlusion, checking how often the device is resized and which frames are skipped
+int RunSwapChainCheck()
+{
+	using std::chrono::milliseconds;
+	HeadlessRenderDevice device;
+	device.Create(nullptr, 800, 600);
+	SwapChainManager swapChain;
+	swapChain.Create(&device, 800, 600);
+	swapChain.settleTime = milliseconds(20);
+	swapChain.occlusionPollTime = milliseconds(20);
+	EventLoop* loop = SingleInstance<EventLoop>::Get();
+	int failures = 0;
+	// One frame the way the main loop runs it, false when it was skipped
+	auto Frame = [&]() {
+		if (!swapChain.BeginFrame())
+			return false;
+		if (!device.Present(false))
+			swapChain.OnOccluded();
+		return true;
+		};
+	// Waits for the timer the manager set to bring the loop back
+	auto WaitForTimer = [&]() {
+		const auto start = std::chrono::steady_clock::now();
+		size_t fired = 0;
+		while (fired == 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(1))
+		{
+			loop->Wait(milliseconds(100));
+			fired = loop->RunDueTimers();
+		}
+		return fired > 0;
+		};
+
+	// A drag delivers a burst of sizes, frames keep the old buffers until the last one settled
+	for (int i = 0; i < 4; i++)
+	{
+		swapChain.OnResize(820 + i * 20, 620 + i * 20);
+		Expect(Frame(), "frame skipped during a resize burst", failures);
+	}
+	Expect(device.resizes == 0, "resized before the size settled", failures);
+	Expect(WaitForTimer(), "no settle timer after a resize burst", failures);
+	Expect(Frame(), "frame skipped after the size settled", failures);
+	Expect(device.resizes == 1 && device.width == 880 && device.height == 680, "settled size not applied exactly once", failures);
+	Frame();
+	Expect(device.resizes == 1, "resized again without a new size", failures);
+
+	// A settled size equal to the current one costs nothing
+	swapChain.OnResize(880, 680);
+	std::this_thread::sleep_for(swapChain.settleTime);
+	Expect(Frame(), "frame skipped after a repeated size", failures);
+	Expect(device.resizes == 1, "repeated size resized the device", failures);
+
+	// Minimized frames are skipped without touching the device, restoring resizes once
+	swapChain.OnResize(0, 0);
+	for (int i = 0; i < 3; i++)
+		Expect(!Frame(), "frame drawn while minimized", failures);
+	Expect(swapChain.statistics.minimizedFrames == 3, "minimized frames not counted", failures);
+	swapChain.OnResize(1024, 768);
+	std::this_thread::sleep_for(swapChain.settleTime);
+	Expect(Frame(), "frame skipped after restoring", failures);
+	Expect(device.resizes == 2 && device.width == 1024, "restored size not applied", failures);
+
+	// A present to a covered window stops drawing until a poll finds it visible again
+	device.occluded = true;
+	Frame();
+	Expect(swapChain.occluded && swapChain.statistics.occlusions == 1, "occluded present not noticed", failures);
+	const uint64_t presents = device.presents;
+	Expect(!Frame() && !Frame(), "frame drawn while occluded", failures);
+	Expect(device.presents == presents, "presented while occluded", failures);
+	Expect(WaitForTimer(), "no visibility poll while occluded", failures);
+	Expect(!Frame(), "frame drawn while still occluded", failures);
+	device.occluded = false;
+	Expect(WaitForTimer(), "visibility poll stopped while occluded", failures);
+	Expect(Frame() && !swapChain.occluded, "drawing did not resume once visible", failures);
+	Expect(swapChain.statistics.occludedFrames == 3 && swapChain.statistics.occlusions == 1, "occluded frames not counted", failures);
+	Expect(device.resizes == 2 && swapChain.statistics.resizes == 2, "device resized without a size change", failures);
+
+	std::cout << "Swap chain check: " << swapChain.statistics.events << " resize events, " << swapChain.statistics.resizes << " resizes, "
+		<< swapChain.statistics.minimizedFrames << " minimized and " << swapChain.statistics.occludedFrames << " occluded frames, " << failures
+		<< " failed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
+
+// Tokens of preprocessed text without blank lines and #line markers, one line per source line
+static std::vector<std::string> PreprocessedLines(const std::string& text)
+{
+	std::vector<ShaderPreprocessor::Token> tokens = {};
+	ShaderPreprocessor::Tokenize(text, tokens);
+	std::vector<std::string> lines = {};
+	std::string line = "";
+	bool directive = false;
+	for (const ShaderPreprocessor::Token& token : tokens)
+	{
+		if (token.kind == ShaderPreprocessor::Token::Kind::Newline)
+		{
+			if (!line.empty())
+				lines.push_back(line);
+			line.clear();
+			directive = false;
+			continue;
+		}
+		if (line.empty() && token.Is("#"))
+			directive = true;
+		if (directive)
+			continue;
+		if (!line.empty())
+			line += ' ';
+		line.append(token.text.data(), token.text.size());
+	}
+	return lines;
+}
+
+// Preprocesses every .hlsl file in directory and compares its tokens with the .expected file next to it,
+// which is the output of the reference preprocessor: cpp -P -undef -nostdinc -DEXT=3 -Iinclude <file>
+int RunPreprocessorCheck(const fs::path& directory)
+{
+	ShaderPreprocessor preprocessor = ShaderPreprocessor();
+	IncludeResolver resolver = IncludeResolver();
+	resolver.AddSearchPath(directory / "include");
+	std::vector<fs::path> files = {};
+	std::error_code error;
+	for (const fs::directory_entry& entry : fs::directory_iterator(directory, error))
+	{
+		if (entry.path().extension() == ".hlsl")
+			files.push_back(entry.path());
+	}
+	std::sort(files.begin(), files.end());
+	int failures = 0;
+	for (const fs::path& file : files)
+	{
+		ShaderCompiler::Request request = ShaderCompiler::Request();
+		std::string expected = "";
+		if (!FileWatchService::ReadFile(file, request.source) || !FileWatchService::ReadFile(fs::path(file).replace_extension(".expected"), expected))
+		{
+			Expect(false, file.filename().string() + " or its .expected file could not be read", failures);
+			continue;
+		}
+		request.sourceName = file.filename().string();
+		request.directory = directory.string();
+		request.resolver = &resolver;
+		request.defines = { { "EXT", "3" } };
+		std::string output = "", log = "";
+		std::vector<ShaderCompiler::Include> includes = {};
+		if (!preprocessor.Run(request, output, log, includes))
+		{
+			Expect(false, request.sourceName + " failed to preprocess: " + log, failures);
+			continue;
+		}
+		const std::vector<std::string> actual = PreprocessedLines(output);
+		const std::vector<std::string> reference = PreprocessedLines(expected);
+		size_t line = 0;
+		while (line < actual.size() && line < reference.size() && actual[line] == reference[line])
+			line++;
+		if (line < actual.size() || line < reference.size())
+		{
+			Expect(false, request.sourceName + " differs from the reference at line " + std::to_string(line + 1) + ": \"" +
+				(line < actual.size() ? actual[line] : "") + "\" instead of \"" + (line < reference.size() ? reference[line] : "") + "\"", failures);
+		}
+	}
+	Expect(!files.empty(), "no .hlsl files in " + directory.string(), failures);
+
+	std::cout << "Preprocessor check: " << files.size() << " files, " << failures << " failed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
+
+// Headless Entry Point: --frames <count> --width <pixels> --height <pixels> --script <input file> --latency <wakes>
+// --typing <keystrokes> --debounce <ms> --variants <count> --parse <shader file> --render <shader file> --image <texture file>
+// --workers <batch compiler> --server <batch compiler> --remote <batch compiler> --session <directory> --pack <0|1>
+// --populate <shaders> --startup <0|1> --telemetry <file> --check <scheduler|eventloop|swapchain|preprocessor> --corpus <directory>
+int main(int argc, char** argv)
+{
+	static HeadlessPlatform platform = HeadlessPlatform();
+	static HeadlessRenderDevice device = HeadlessRenderDevice();
+	static FakeCompilerBackend compiler = FakeCompilerBackend();
+	static int latencyWakes = 0;
+	static int typingKeystrokes = 0;
+	static int populateCount = 0;
+	static bool measureStartup = false;
+	uint64_t variantCount = 0;
+	std::string parsePath = "";
+	std::string renderPath = "";
+	std::string imagePath = "";
+	std::string workerPath = "";
+	std::string serverPath = "";
+	std::string remotePath = "";
+	std::string telemetryPath = "";
+	std::string check = "";
+	std::string corpusPath = "Corpus/Preprocessor";
+	int width = DEFAULT_WINDOW_WIDTH;
+	int height = DEFAULT_WINDOW_HEIGHT;
+	platform.maxFrames = 600;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string option = argv[i];
+		if (option == "--frames")
+			platform.maxFrames = std::stoull(argv[i + 1]);
+		else if (option == "--width")
+			width = std::stoi(argv[i + 1]);
+		else if (option == "--height")
+			height = std::stoi(argv[i + 1]);
+		else if (option == "--script" && !platform.LoadScript(argv[i + 1]))
+			std::cerr << "Failed to open input script: " << argv[i + 1] << std::endl;
+		else if (option == "--latency")
+			latencyWakes = std::stoi(argv[i + 1]);
+		else if (option == "--typing")
+			typingKeystrokes = std::stoi(argv[i + 1]);
+		else if (option == "--debounce")
+			SingleInstance<ShaderPreviewManager>::Get()->debounceTime = std::stoi(argv[i + 1]);
+		else if (option == "--variants")
+			variantCount = std::stoull(argv[i + 1]);
+		else if (option == "--parse")
+			parsePath = argv[i + 1];
+		else if (option == "--render")
+			renderPath = argv[i + 1];
+		else if (option == "--image")
+			imagePath = argv[i + 1];
+		else if (option == "--workers")
+			workerPath = argv[i + 1];
+		else if (option == "--server")
+			serverPath = argv[i + 1];
+		else if (option == "--remote")
+			remotePath = argv[i + 1];
+		else if (option == "--session")
+			SingleInstance<ShaderPreviewManager>::Get()->sessionDirectory = argv[i + 1];
+		else if (option == "--pack")
+			SingleInstance<ShaderPreviewManager>::Get()->packEnabled = std::stoi(argv[i + 1]) != 0;
+		else if (option == "--populate")
+			populateCount = std::stoi(argv[i + 1]);
+		else if (option == "--startup")
+			measureStartup = std::stoi(argv[i + 1]) != 0;
+		else if (option == "--telemetry")
+			telemetryPath = argv[i + 1];
+		else if (option == "--check")
+			check = argv[i + 1];
+		else if (option == "--corpus")
+			corpusPath = argv[i + 1];
+	}
+	if (check == "scheduler")
+		return RunSchedulerCheck();
+	if (check == "eventloop")
+		return RunEventLoopCheck();
+	if (check == "swapchain")
+		return RunSwapChainCheck();
+	if (check == "preprocessor")
+		return RunPreprocessorCheck(corpusPath);
+	if (!check.empty())
+	{
+		std::cerr << "Unknown check: " << check << std::endl;
+		return 2;
+	}
+	if (variantCount > 0)
+		return RunVariantBenchmark(&compiler, variantCount);
+	if (!parsePath.empty())
+		return RunParseBenchmark(parsePath);
+	if (!renderPath.empty())
+		return RunRenderBenchmark(renderPath, imagePath);
+	if (!workerPath.empty())
+		return RunWorkerBenchmark(workerPath);
+	if (!serverPath.empty())
+		return RunServerBenchmark(serverPath);
+	if (!remotePath.empty())
+		return RunRemoteBenchmark(remotePath);
+	if (latencyWakes > 0)
+	{
+		// Idle until a worker finishes a job, every frame then measures how fast the wait returned
+		platform.continuous = false;
+		platform.maxFrames = 0;
+		SingleInstance<FrameScheduler>::Get()->idleFps = 0.f;
+		SingleInstance<Application>::Get()->GetMainWindow().AddCallback(Application::Window::CallbackPeriod::Create, [](Application::Window*) {
+			SingleInstance<ThreadPool>::Get()->AddTask([]() {
+				for (int i = 0; i < latencyWakes; i++)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(5));
+					SingleInstance<FrameScheduler>::Get()->RequestRedraw(FrameScheduler::Reason::AsyncJob);
+				}
+				platform.Quit();
+				});
+			}, "Latency Test");
+	}
+	if (typingKeystrokes > 0)
+	{
+		// Types into a shader in bursts of 20 keystrokes 40 ms apart with a pause after each, every keystroke
+		// changes a constant so no two versions share a cache entry. Compiles take 20 ms to give edits something to cancel.
+		compiler.fixedCost = 20000;
+		platform.continuous = false;
+		platform.maxFrames = 0;
+		SingleInstance<FrameScheduler>::Get()->idleFps = 0.f;
+		static auto Source = [](int keystroke) {
+			return "float4 main(float4 color : COLOR0) : SV_Target\n{\n\treturn color * " + std::to_string(keystroke) + ".0;\n}\n";
+			};
+		static std::function<void(int)> Type = [](int keystroke) {
+			ShaderPreviewManager::Shader& shader = SingleInstance<ShaderPreviewManager>::Get()->shaders.back();
+			if (keystroke > typingKeystrokes)
+			{
+				// Done once the last version is on screen
+				if (shader.compileTimer == 0 && shader.editedAt == std::chrono::steady_clock::time_point())
+					platform.Quit();
+				else
+					SingleInstance<EventLoop>::Get()->AddTimer(std::chrono::milliseconds(5), [keystroke]() { Type(keystroke); });
+				return;
+			}
+			shader.source = Source(keystroke);
+			shader.OnEdited();
+			SingleInstance<EventLoop>::Get()->AddTimer(std::chrono::milliseconds(keystroke % 20 == 0 ? 400 : 40), [keystroke]() { Type(keystroke + 1); });
+			};
+		SingleInstance<Application>::Get()->GetMainWindow().AddCallback(Application::Window::CallbackPeriod::Create, [](Application::Window*) {
+			SingleInstance<ShaderPreviewManager>::Get()->shaders.push_back(ShaderPreviewManager::Shader(Source(0), "Typing.hlsl", ""));
+			SingleInstance<ShaderPreviewManager>::Get()->shaders.back().ComplieShader();
+			Type(1);
+			}, "Typing Test");
+	}
+
+	static auto AllCompiled = []() {
+		for (const ShaderPreviewManager::Shader& shader : SingleInstance<ShaderPreviewManager>::Get()->shaders)
+		{
+			if (shader.pending != nullptr || !shader.IsComplied())
+				return false;
+		}
+		return true;
+		};
+	if (populateCount > 0 || measureStartup)
+	{
+		// Compiles take 30 ms and the disk cache is off, so previews waiting on the compiler show in the startup time
+		compiler.fixedCost = 30000;
+		SingleInstance<ShaderCache>::Get()->diskEnabled = false;
+		platform.maxFrames = 0;
+	}
+	if (populateCount > 0)
+	{
+		// A fresh session of shaders each bound to a preview, saved with the pack once all are compiled
+		std::error_code error;
+		fs::remove(SingleInstance<ShaderPreviewManager>::Get()->sessionDirectory / "session.txt", error);
+		SingleInstance<Application>::Get()->GetMainWindow().AddCallback(Application::Window::CallbackPeriod::Create, [](Application::Window*) {
+			ShaderPreviewManager* manager = SingleInstance<ShaderPreviewManager>::Get();
+			for (int i = 0; i < populateCount; i++)
+			{
+				const std::string source = "float4 main(float4 color : COLOR0) : SV_Target\n{\n\treturn color * " + std::to_string(i) + ".0;\n}\n";
+				manager->shaders.push_back(ShaderPreviewManager::Shader(source, "Session" + std::to_string(i) + ".hlsl", ""));
+			}
+			for (ShaderPreviewManager::Shader& shader : manager->shaders)
+			{
+				ShaderPreviewManager::Preview preview;
+				preview.name = shader.name;
+				manager->previews.push_back(preview);
+				manager->previews.back().ApplyShader(shader.id);
+				shader.ComplieShader();
+			}
+			}, "Populate Session");
+		SingleInstance<Application>::Get()->GetMainWindow().AddCallback(Application::Window::CallbackPeriod::Update, [](Application::Window*) {
+			if (AllCompiled())
+				platform.Quit();
+			}, "Populate Session Done");
+	}
+	static auto startupBegin = std::chrono::steady_clock::now();
+	static float startupVisible = 0.f, startupCompiled = 0.f;
+	if (measureStartup)
+	{
+		// Previews are visible once every one of them has a shader bound, compiled or loaded from the pack
+		SingleInstance<Application>::Get()->GetMainWindow().AddCallback(Application::Window::CallbackPeriod::Update, [](Application::Window*) {
+			ShaderPreviewManager* manager = SingleInstance<ShaderPreviewManager>::Get();
+			const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startupBegin).count();
+			if (startupVisible == 0.f)
+			{
+				bool visible = !manager->previews.empty();
+				for (const ShaderPreviewManager::Preview& preview : manager->previews)
+				{
+					const ShaderPreviewManager::Shader* shader = manager->FindShader(preview.shaderId);
+					visible = visible && shader != nullptr && shader->IsComplied();
+				}
+				if (visible)
+					startupVisible = elapsed;
+			}
+			// Ends once the compiles queued by the restore confirmed what the pack bound
+			if (startupVisible != 0.f && AllCompiled())
+			{
+				startupCompiled = elapsed;
+				platform.Quit();
+			}
+			}, "Startup Test");
+	}
+
+	// Measure raw frame cost, nothing is waiting on a display
+	SingleInstance<FrameScheduler>::Get()->targetFps = 0;
+	SingleInstance<Profiler>::Get()->enabled = true;
+	int result = Run(&platform, &device, &compiler, width, height);
+
+	SingleInstance<Profiler>::Get()->UpdateStatistics();
+	std::cout << "Frames: " << device.frames.size() << std::endl;
+	for (const Profiler::Item* item : SingleInstance<Profiler>::Get()->GetItems())
+	{
+		std::cout << item->name << ": mean " << item->mean << " ms, p95 " << item->p95 << " ms, max " << item->max << " ms" << std::endl;
+	}
+	if (!device.frames.empty())
+	{
+		uint64_t allocations = 0, drawCommands = 0, vertices = 0;
+		for (const auto& frame : device.frames)
+		{
+			allocations += frame.allocations;
+			drawCommands += frame.drawCommands;
+			vertices += frame.vertices;
+		}
+		const size_t count = device.frames.size();
+		std::cout << "Per frame: " << allocations / (double)count << " allocations, "
+			<< drawCommands / (double)count << " draw commands, " << vertices / (double)count << " vertices" << std::endl;
+	}
+	const SwapChainManager::Statistics& swapChain = SingleInstance<SwapChainManager>::Get()->statistics;
+	std::cout << "Swap chain: " << swapChain.events << " resize events, " << swapChain.resizes << " resizes (device saw "
+		<< device.resizes << "), " << swapChain.minimizedFrames << " minimized frames, " << swapChain.occludedFrames << " occluded frames, "
+		<< swapChain.totalResizeTime << " ms resizing" << std::endl;
+	const ShaderCache::Statistics cache = SingleInstance<ShaderCache>::Get()->GetStatistics();
+	std::cout << "Shader cache: " << cache.memoryHits << " memory hits, " << cache.diskHits << " disk hits, " << cache.remoteHits << " remote hits, " << cache.misses
+		<< " misses, " << cache.bytesSaved << " bytes saved" << std::endl;
+	const AsyncShaderCompiler::Statistics& compiles = SingleInstance<ShaderPreviewManager>::Get()->compileQueue.statistics;
+	std::cout << "Async compiles: " << compiles.submitted << " submitted, " << compiles.completed << " completed, " << compiles.failed
+		<< " failed, latency last " << compiles.lastLatency << " ms, max " << compiles.maxLatency << " ms" << std::endl;
+	const ShaderPreviewManager* manager = SingleInstance<ShaderPreviewManager>::Get();
+	if (!manager->shaders.empty())
+	{
+		DxbcContainer::Statistics total;
+		size_t analyzed = 0;
+		for (const ShaderPreviewManager::Shader& shader : manager->shaders)
+		{
+			if (!shader.hasAnalysis)
+				continue;
+			analyzed++;
+			total.instructions += shader.analysis.instructions;
+			total.alu += shader.analysis.alu;
+			total.texture += shader.analysis.texture;
+			total.flowControl += shader.analysis.flowControl;
+		}
+		std::cout << "Bytecode: " << analyzed << " of " << manager->shaders.size() << " shaders analyzed, " << total.instructions << " instructions ("
+			<< total.alu << " ALU, " << total.texture << " texture, " << total.flowControl << " flow control), " << manager->sharedShaders.size()
+			<< " distinct device shaders, " << manager->sharedHits << " reused" << std::endl;
+	}
+	if (typingKeystrokes > 0)
+	{
+		const ShaderPreviewManager::Shader& shader = SingleInstance<ShaderPreviewManager>::Get()->shaders.back();
+		const ShaderPreviewManager::EditStatistics& edits = SingleInstance<ShaderPreviewManager>::Get()->editStatistics;
+		// What is bound has to be the compile of the final text
+		ShaderCompiler::Request request = shader.MakeRequest();
+		const std::vector<uint8_t> expected = compiler.Compile(request).bytecode;
+		const bool current = shader.shader != nullptr && ((HeadlessRenderDevice::Shader*)shader.shader)->bytecode == expected;
+		std::cout << "Typing: " << edits.edits << " edits, " << edits.compiles << " compiles (" << compiles.cancelled << " cancelled, "
+			<< compiles.discarded << " discarded), " << edits.applied << " versions on screen, final version " << (current ? "on screen" : "MISSING")
+			<< ", edit to pixels last " << edits.lastLatency << " ms, mean " << edits.meanLatency << " ms, max " << edits.maxLatency << " ms" << std::endl;
+		std::cout << "Last edit: debounce " << shader.latency.debounce << " ms, queued " << shader.latency.queue << " ms, compile "
+			<< shader.latency.compile << " ms, apply " << shader.latency.apply << " ms" << std::endl;
+	}
+	if (measureStartup)
+	{
+		// Whatever the pack bound was replaced by the compile since, so check against the compiler directly
+		const ShaderPreviewManager::SessionStatistics& session = SingleInstance<ShaderPreviewManager>::Get()->sessionStatistics;
+		const ShaderPack::Statistics pack = SingleInstance<ShaderPack>::Get()->GetStatistics();
+		size_t mismatches = 0;
+		for (const ShaderPreviewManager::Shader& shader : SingleInstance<ShaderPreviewManager>::Get()->shaders)
+		{
+			ShaderCompiler::Request request = shader.MakeRequest();
+			if (shader.shader == nullptr || ((HeadlessRenderDevice::Shader*)shader.shader)->bytecode != compiler.Compile(request).bytecode)
+				mismatches++;
+		}
+		std::cout << "Startup: " << session.previews << " previews visible after " << startupVisible << " ms, all compiled after " << startupCompiled
+			<< " ms, " << session.packed << " of " << session.shaders << " shaders from the pack (opened in " << pack.openTime << " ms, "
+			<< pack.entries << " entries, " << pack.fileBytes << " bytes), restore " << session.restoreTime << " ms, " << mismatches << " mismatches" << std::endl;
+	}
+	const std::deque<CompileTelemetry::Record>& records = SingleInstance<CompileTelemetry>::Get()->GetRecords();
+	if (!records.empty())
+	{
+		float queue = 0.f, preprocess = 0.f, compile = 0.f, create = 0.f, total = 0.f;
+		uint64_t hits = 0, applied = 0, superseded = 0, cancelled = 0;
+		for (const CompileTelemetry::Record& record : records)
+		{
+			if (record.outcome != CompileTelemetry::Outcome::Applied)
+			{
+				(record.outcome == CompileTelemetry::Outcome::Superseded ? superseded : cancelled)++;
+				continue;
+			}
+			applied++;
+			queue += record.queue;
+			preprocess += record.preprocess;
+			compile += record.compile;
+			create += record.create;
+			total += record.total;
+			hits += record.cacheTier != ShaderCompiler::CacheTier::None ? 1 : 0;
+		}
+		const float count = (float)std::max<uint64_t>(applied, 1);
+		std::cout << "Compile telemetry: " << records.size() << " records (" << superseded << " superseded, " << cancelled << " cancelled), "
+			<< hits << " cache hits, mean queue " << queue / count << " ms, preprocess "
+			<< preprocess / count << " ms, compile " << compile / count << " ms, create " << create / count << " ms, total " << total / count << " ms" << std::endl;
+	}
+	if (!telemetryPath.empty() && !SingleInstance<CompileTelemetry>::Get()->Export(telemetryPath))
+		std::cerr << "Failed to export compile telemetry to " << telemetryPath << std::endl;
+	const FileWatchService::Statistics& watch = SingleInstance<FileWatchService>::Get()->statistics;
+	std::cout << "File watch (" << SingleInstance<FileWatchService>::Get()->GetBackendName() << "): " << watch.events << " events, "
+		<< watch.coalesced << " coalesced, " << watch.changed << " changed, " << watch.unchanged << " unchanged" << std::endl;
+	const EventLoop::Statistics& wakeups = SingleInstance<EventLoop>::Get()->statistics;
+	std::cout << "Waits: " << wakeups.waits << ", wakes " << wakeups.wakes << ", timeouts " << wakeups.timeouts
+		<< ", wake latency mean " << wakeups.meanLatency << " us, max " << wakeups.maxLatency << " us" << std::endl;
+	if (latencyWakes > 0)
+	{
+		// Every job wakes the idle loop once, well within 10 ms, and nothing times out without idle redraws
+		int failures = 0;
+		Expect(wakeups.wakes == (uint64_t)latencyWakes, std::to_string(wakeups.wakes) + " wakes for " + std::to_string(latencyWakes) + " jobs", failures);
+		Expect(wakeups.timeouts == 0, std::to_string(wakeups.timeouts) + " waits timed out", failures);
+		Expect(wakeups.maxLatency < 10000.0, "worst wake latency " + std::to_string(wakeups.maxLatency) + " us is over 10 ms", failures);
+		if (failures > 0)
+			return 1;
+	}
+	return result;
+}
+#endif
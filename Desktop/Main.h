@@ -1,34 +1,89 @@
 #pragma once
 
+#ifdef _WIN32
+#include <WinSock2.h>
 #include <Windows.h>
+#pragma comment(lib, "d3d11.lib")
+#endif
 #include <iostream>
 #include <string>
 #include <thread>
 #include <fstream>
 #include <filesystem>
-#pragma comment(lib, "d3d11.lib")
+#include <sstream>
 namespace fs = std::filesystem;
 
 #include "Dependence/ThreadPool.h"
 #include "Dependence/CallbackManager.h"
+#include "Dependence/EventLoop.h"
 #include "Dependence/SingleInstance.h"
 #include "Dependence/Random.h"
+#include "Dependence/Sha256.h"
+#include "Dependence/FileWatcher.h"
+#include "Dependence/Arena.h"
+#include "Dependence/ChildProcess.h"
+#include "Dependence/LocalSocket.h"
+#include "Dependence/TcpSocket.h"
+#include "Dependence/Lz.h"
+#include "Dependence/Http.h"
+#include "Dependence/MappedFile.h"
 
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include "Dependence/ImGui/imgui.h"
 #include "Dependence/ImGui/imgui_internal.h"
+#ifdef _WIN32
 #include "Dependence/ImGui/backends/imgui_impl_dx11.h"
 #include "Dependence/ImGui/backends/imgui_impl_win32.h"
+#endif
 #include "Dependence/ImGui/misc/cpp/imgui_stdlib.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "Dependence/stb_image.h"
 
 #undef LoadImage
 
+#include "Core/Controller/Profiler.h"
+#include "Core/Controller/FrameScheduler.h"
+#include "Core/Controller/Platform.h"
+#include "Core/Controller/RenderDevice.h"
 #include "Core/Controller/Application.h"
 #include "Core/Controller/Content.h"
 #include "Core/Controller/Render.h"
 #include "Core/Controller/Logger.h"
+#include "Core/Controller/SwapChainManager.h"
+#include "Core/Controller/FileWatchService.h"
+
+#ifdef _WIN32
+#include "Core/Platform/Win32Platform.h"
+#include "Core/Platform/D3D11RenderDevice.h"
+#endif
+#include "Core/Platform/HeadlessPlatform.h"
+#include "Core/Platform/HeadlessRenderDevice.h"
+
+#include "Core/Shader/IncludeResolver.h"
+#include "Core/Shader/ShaderCompiler.h"
+#include "Core/Shader/ShaderPermutations.h"
+#include "Core/Shader/ShaderPreprocessor.h"
+#include "Core/Shader/HlslLexer.h"
+#include "Core/Shader/HlslParser.h"
+#include "Core/Shader/HlslFrontEnd.h"
+#include "Core/Shader/ShaderInterpreter.h"
+#ifdef _WIN32
+#include "Core/Shader/D3DCompilerBackend.h"
+#endif
+#include "Core/Shader/DxbcContainer.h"
+#include "Core/Shader/FakeCompilerBackend.h"
+#include "Core/Shader/CompilerProtocol.h"
+#include "Core/Shader/WorkerPoolBackend.h"
+#include "Core/Shader/CompileServerBackend.h"
+#include "Core/Shader/RemoteCache.h"
+#include "Core/Shader/RemoteCacheServer.h"
+#include "Core/Shader/ShaderCache.h"
+#include "Core/Shader/ShaderPack.h"
+#include "Core/Shader/ShaderVariantSet.h"
+#include "Core/Shader/AsyncShaderCompiler.h"
+#include "Core/Shader/CompileTelemetry.h"
 
 #include "Core/Monitor/LoggerView.h"
-#include "Core/Monitor/Previews.h"
\ No newline at end of file
+#include "Core/Monitor/Previews.h"
+#include "Core/Monitor/FrameBudget.h"
+#include "Core/Monitor/TimelineView.h"
\ No newline at end of file